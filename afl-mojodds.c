@@ -68,6 +68,10 @@ int main(int argc, char *argv[]) {
 		return 4;
 	}
 
+	// same parse as MOJODDS_getTexture, so it can't fail now.
+	MOJODDS_Layout layout;
+	MOJODDS_getLayout(contents, size, &layout);
+
 	uint32_t hash = 0x12345678;
 	switch (textureType) {
 	case MOJODDS_TEXTURE_2D:
@@ -109,10 +113,49 @@ int main(int argc, char *argv[]) {
 		break;
 
 	case MOJODDS_TEXTURE_VOLUME:
-		// TODO: do something with the data
+		for (unsigned int miplevel = 0; miplevel < layout.miplevels; miplevel++) {
+			for (unsigned int slice = 0; slice < layout.mips[miplevel].d; slice++) {
+				const void *slicetex = NULL;
+				unsigned long slicelen = 0;
+				unsigned int sliceW = 0, sliceH = 0;
+				retval = MOJODDS_getVolumeSlice(&layout, miplevel, slice, &slicetex, &slicelen, &sliceW, &sliceH);
+				if (!retval) {
+					continue;
+				}
+
+				// read every byte to make sure any buffer overflows actually overflow
+				const char *slicetex_ = (const char *) slicetex;
+				for (unsigned int i = 0; i < slicelen; i++) {
+					hash = (hash * 65537) ^ slicetex_[i];
+				}
+			}
+		}
 		break;
 
 	}
+
+	// the rest of an array's elements
+	const unsigned int facesPerElement = layout.faces / layout.arraySize;
+	for (unsigned int element = 1; element < layout.arraySize; element++) {
+		for (unsigned int face = 0; face < facesPerElement; face++) {
+			for (unsigned int miplevel = 0; miplevel < layout.miplevels; miplevel++) {
+				const void *miptex = NULL;
+				unsigned long miptexlen = 0;
+				unsigned int mipW = 0, mipH = 0;
+				retval = MOJODDS_getArraySubresource(&layout, element, face, miplevel, &miptex, &miptexlen, &mipW, &mipH);
+				if (!retval) {
+					continue;
+				}
+
+				// read every byte to make sure any buffer overflows actually overflow
+				const char *miptex_ = (const char *) miptex;
+				for (unsigned int i = 0; i < miptexlen; i++) {
+					hash = (hash * 65537) ^ miptex_[i];
+				}
+			}
+		}
+	}
+
 	// do something the optimizer is not allowed to remove
 	printf("0x%08x\n", hash);
 
@@ -0,0 +1,349 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "mojodds.h"
+
+
+// packs DDS files of one format into a single atlas, copying the compressed
+// blocks and as much of each mip chain as lines up, and prints where each
+// one went as JSON on stdout
+
+
+typedef struct Input {
+	const char *path;
+	MOJODDS_File *file;
+	MOJODDS_Layout layout;
+} Input;
+
+
+static double seconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double) count.QuadPart / (double) freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+#endif
+}
+
+
+static int writeFile(void *userdata, const void *data, unsigned long len) {
+	return fwrite(data, 1, len, (FILE *) userdata) == len;
+}
+
+
+static void printJsonString(const char *str) {
+	putchar('"');
+	for (const unsigned char *ptr = (const unsigned char *) str; *ptr; ptr++) {
+		if ((*ptr == '"') || (*ptr == '\\')) {
+			printf("\\%c", *ptr);
+		} else if (*ptr < 0x20) {
+			printf("\\u%04x", *ptr);
+		} else {
+			putchar(*ptr);
+		}
+	}
+	putchar('"');
+}
+
+
+// levels that are still at least a block in both directions; below that
+// a texture's blocks can't be placed on the atlas's block grid
+static unsigned int usableLevels(const MOJODDS_Layout *layout) {
+	unsigned int levels = 0;
+	while ((levels < layout->miplevels) &&
+	       (layout->mips[levels].w >= layout->blockDim) &&
+	       (layout->mips[levels].h >= layout->blockDim)) {
+		levels++;
+	}
+	return (levels > 0) ? levels : 1;
+}
+
+
+static unsigned int roundUp(unsigned int val, unsigned int align) {
+	return (val + align - 1) & ~(align - 1);
+}
+
+
+// smallest power-of-two atlas, growing the shorter side first, that
+// everything fits in
+static bool packAtlas(MOJODDS_PackRect *rects, unsigned int count, unsigned int align,
+                      unsigned int maxSize, unsigned int *atlasW, unsigned int *atlasH) {
+	unsigned long long area = 0;
+	unsigned int w = align, h = align;
+
+	for (unsigned int i = 0; i < count; i++) {
+		area += (unsigned long long) roundUp(rects[i].w, align) * roundUp(rects[i].h, align);
+		while (w < rects[i].w) {
+			w *= 2;
+		}
+		while (h < rects[i].h) {
+			h *= 2;
+		}
+	}
+
+	while ((w <= maxSize) && (h <= maxSize)) {
+		if ((unsigned long long) w * h >= area) {
+			if (MOJODDS_packRects(rects, count, w, h, align)) {
+				*atlasW = w;
+				*atlasH = h;
+				return true;
+			}
+		}
+
+		if (w <= h) {
+			w *= 2;
+		} else {
+			h *= 2;
+		}
+	}
+
+	return false;
+}
+
+
+static void closeInputs(Input *inputs, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		if (inputs[i].file) {
+			MOJODDS_close(inputs[i].file);
+		}
+	}
+	free(inputs);
+}
+
+
+static void usage(const char *argv0) {
+	printf("Usage: %s [--max-size N] [--mips N] [--pow2] -o atlas.dds DDS-file ...\n", argv0);
+	printf("All inputs must be 2D textures of the same format. The atlas keeps as many\n");
+	printf("mip levels as every input can fill on block boundaries, at most --mips.\n");
+	printf("Its height is cut down to what's used unless --pow2 is given.\n");
+}
+
+
+int main(int argc, char *argv[]) {
+	const char *outPath = NULL;
+	unsigned int maxSize = 16384;
+	unsigned int maxMips = 0;
+	bool pow2 = false;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+			outPath = argv[++i];
+		} else if ((strcmp(argv[i], "--max-size") == 0) && (i + 1 < argc)) {
+			maxSize = (unsigned int) strtoul(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "--mips") == 0) && (i + 1 < argc)) {
+			maxMips = (unsigned int) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--pow2") == 0) {
+			pow2 = true;
+		} else if (strcmp(argv[i], "--help") == 0) {
+			usage(argv[0]);
+			return 0;
+		} else {
+			break;
+		}
+	}
+
+	unsigned int count = (unsigned int) (argc - i);
+	if ((outPath == NULL) || (count == 0)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	Input *inputs = calloc(count, sizeof (Input));
+	MOJODDS_PackRect *rects = calloc(count, sizeof (MOJODDS_PackRect));
+	if ((inputs == NULL) || (rects == NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		return 2;
+	}
+
+	unsigned int miplevels = 32;
+	for (unsigned int n = 0; n < count; n++) {
+		Input *input = &inputs[n];
+		input->path = argv[i + n];
+		input->file = MOJODDS_openFile(input->path);
+		if (!input->file) {
+			fprintf(stderr, "Error opening %s: %s (%d)\n", input->path, strerror(errno), errno);
+			closeInputs(inputs, count);
+			return 3;
+		}
+
+		unsigned long size = 0;
+		const void *contents = MOJODDS_getFileData(input->file, &size);
+		MOJODDS_error err = MOJODDS_validate(contents, size, size, &input->layout);
+		if (err != MOJODDS_ERR_NONE) {
+			fprintf(stderr, "%s: %s\n", input->path, MOJODDS_errorString(err));
+			closeInputs(inputs, count);
+			return 3;
+		}
+
+		if ((input->layout.textureType != MOJODDS_TEXTURE_2D) || (input->layout.arraySize != 1)) {
+			fprintf(stderr, "%s: only plain 2D textures can go in an atlas\n", input->path);
+			closeInputs(inputs, count);
+			return 4;
+		} else if (input->layout.glfmt != inputs[0].layout.glfmt) {
+			fprintf(stderr, "%s: format 0x%04x doesn't match %s's 0x%04x\n", input->path,
+			        input->layout.glfmt, inputs[0].path, inputs[0].layout.glfmt);
+			closeInputs(inputs, count);
+			return 4;
+		}
+
+		unsigned int levels = usableLevels(&input->layout);
+		if (levels < miplevels) {
+			miplevels = levels;
+		}
+		rects[n].w = input->layout.w;
+		rects[n].h = input->layout.h;
+	}
+
+	if ((maxMips > 0) && (maxMips < miplevels)) {
+		miplevels = maxMips;
+	}
+
+	const unsigned int glfmt = inputs[0].layout.glfmt;
+	const unsigned int blockDim = inputs[0].layout.blockDim;
+	const unsigned int blockSize = inputs[0].layout.blockSize;
+	const unsigned int align = blockDim << (miplevels - 1);
+
+	double start = seconds();
+	unsigned int atlasW = 0, atlasH = 0;
+	bool packed = packAtlas(rects, count, align, maxSize, &atlasW, &atlasH);
+	double packTime = seconds() - start;
+	if (!packed) {
+		fprintf(stderr, "Couldn't fit %u textures in %ux%u\n", count, maxSize, maxSize);
+		closeInputs(inputs, count);
+		return 5;
+	}
+
+	if (!pow2) {
+		// the packer fills from the top, so there's often a strip left at the
+		// bottom; keep the height a multiple of align so every level still
+		// has whole blocks
+		unsigned int usedH = 0;
+		for (unsigned int n = 0; n < count; n++) {
+			if (rects[n].y + roundUp(rects[n].h, align) > usedH) {
+				usedH = rects[n].y + roundUp(rects[n].h, align);
+			}
+		}
+		atlasH = usedH;
+	}
+
+	// every level is zeros (transparent black, for the DXT formats) until
+	// something is copied over it
+	start = seconds();
+	unsigned long atlasLen = MOJODDS_getMipChainSize(glfmt, atlasW, atlasH, miplevels);
+	unsigned char *atlas = calloc(1, atlasLen);
+	if (atlas == NULL) {
+		fprintf(stderr, "Out of memory for a %ux%u atlas\n", atlasW, atlasH);
+		closeInputs(inputs, count);
+		return 2;
+	}
+
+	const void *levels[32];
+	unsigned char *level = atlas;
+	for (unsigned int miplevel = 0; miplevel < miplevels; miplevel++) {
+		unsigned int levelW = atlasW >> miplevel, levelH = atlasH >> miplevel;
+		unsigned long pitch = (unsigned long) ((levelW + blockDim - 1) / blockDim) * blockSize;
+		levels[miplevel] = level;
+
+		for (unsigned int n = 0; n < count; n++) {
+			const void *tex = NULL;
+			unsigned long texlen = 0;
+			unsigned int texW = 0, texH = 0;
+			MOJODDS_getSubresource(&inputs[n].layout, 0, miplevel, &tex, &texlen, &texW, &texH);
+
+			unsigned int x = rects[n].x >> miplevel, y = rects[n].y >> miplevel;
+			MOJODDS_CopyRect copy;
+			copy.x = 0;
+			copy.y = 0;
+			copy.w = texW;
+			copy.h = texH;
+			copy.dst = level + (y / blockDim) * pitch + (x / blockDim) * blockSize;
+			copy.dstpitch = pitch;
+			if (!MOJODDS_copyRect(glfmt, tex, texlen, texW, texH, &copy)) {
+				fprintf(stderr, "%s: couldn't copy mip level %u\n", inputs[n].path, miplevel);
+				free(atlas);
+				closeInputs(inputs, count);
+				return 6;
+			}
+		}
+
+		level += pitch * ((levelH + blockDim - 1) / blockDim);
+	}
+
+	MOJODDS_WriteDesc desc;
+	memset(&desc, 0, sizeof (desc));
+	desc.glfmt = glfmt;
+	desc.textureType = MOJODDS_TEXTURE_2D;
+	desc.w = atlasW;
+	desc.h = atlasH;
+	desc.miplevels = miplevels;
+
+	FILE *out = fopen(outPath, "wb");
+	if (!out) {
+		fprintf(stderr, "Error creating %s: %s (%d)\n", outPath, strerror(errno), errno);
+		free(atlas);
+		closeInputs(inputs, count);
+		return 7;
+	}
+
+	int written = MOJODDS_write(&desc, levels, writeFile, out);
+	written = (fclose(out) == 0) && written;
+	free(atlas);
+	double buildTime = seconds() - start;
+	if (!written) {
+		fprintf(stderr, "Error writing %s\n", outPath);
+		closeInputs(inputs, count);
+		return 7;
+	}
+
+	unsigned long long used = 0;
+	for (unsigned int n = 0; n < count; n++) {
+		used += (unsigned long long) rects[n].w * rects[n].h;
+	}
+
+	// UVs have (0, 0) at the top left, the way the rows are stored
+	printf("{\n\"atlas\": ");
+	printJsonString(outPath);
+	printf(",\n\"glfmt\": \"0x%04x\",\n\"width\": %u,\n\"height\": %u,\n\"miplevels\": %u,\n", glfmt, atlasW, atlasH, miplevels);
+	printf("\"pack_ms\": %.3f,\n\"build_ms\": %.3f,\n\"occupancy\": %.4f,\n", packTime * 1000.0, buildTime * 1000.0,
+	       (double) used / ((double) atlasW * atlasH));
+	printf("\"entries\": [\n");
+	for (unsigned int n = 0; n < count; n++) {
+		const MOJODDS_PackRect *rect = &rects[n];
+		printf("{\"file\": ");
+		printJsonString(inputs[n].path);
+		printf(", \"x\": %u, \"y\": %u, \"w\": %u, \"h\": %u, \"u0\": %.6f, \"v0\": %.6f, \"u1\": %.6f, \"v1\": %.6f}%s\n",
+		       rect->x, rect->y, rect->w, rect->h,
+		       (double) rect->x / atlasW, (double) rect->y / atlasH,
+		       (double) (rect->x + rect->w) / atlasW, (double) (rect->y + rect->h) / atlasH,
+		       (n + 1 < count) ? "," : "");
+	}
+	printf("]\n}\n");
+
+	closeInputs(inputs, count);
+	free(rects);
+	return 0;
+}
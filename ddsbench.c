@@ -0,0 +1,967 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "mojodds.h"
+
+
+// throughput numbers for parsing, layout and decoding, as JSON on stdout
+// run it on the same machine before and after a change and compare
+
+
+static double seconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double) count.QuadPart / (double) freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+#endif
+}
+
+
+// how long to keep repeating each measurement
+static double minTime = 0.25;
+
+
+// something the optimizer can't throw away
+static volatile unsigned long sink;
+
+
+static void putLE32(uint8_t *ptr, uint32_t val) {
+	ptr[0] = (uint8_t) val;
+	ptr[1] = (uint8_t) (val >> 8);
+	ptr[2] = (uint8_t) (val >> 16);
+	ptr[3] = (uint8_t) (val >> 24);
+}
+
+
+static uint32_t fourCC(const char *str) {
+	return (uint32_t) str[0] | ((uint32_t) str[1] << 8) | ((uint32_t) str[2] << 16) | ((uint32_t) str[3] << 24);
+}
+
+
+typedef struct SynthFormat {
+	const char *name;
+	uint32_t dxgi;  // 0 to use the legacy pixel format below
+	uint32_t pfFlags;
+	uint32_t fourCC;
+	uint32_t bitCount;
+	uint32_t masks[4];
+} SynthFormat;
+
+
+#define DDPF_ALPHAPIXELS 0x1
+#define DDPF_ALPHA 0x2
+#define DDPF_FOURCC 0x4
+#define DDPF_RGB 0x40
+#define DDPF_LUMINANCE 0x20000
+
+
+// every way of spelling a format the library accepts
+static const SynthFormat synthFormats[] = {
+	{ "DXT1", 0, DDPF_FOURCC, 0x31545844, 0, { 0, 0, 0, 0 } },
+	{ "DXT3", 0, DDPF_FOURCC, 0x33545844, 0, { 0, 0, 0, 0 } },
+	{ "DXT5", 0, DDPF_FOURCC, 0x35545844, 0, { 0, 0, 0, 0 } },
+	{ "ATI1", 0, DDPF_FOURCC, 0x31495441, 0, { 0, 0, 0, 0 } },
+	{ "ATI2", 0, DDPF_FOURCC, 0x32495441, 0, { 0, 0, 0, 0 } },
+	{ "BC4U", 0, DDPF_FOURCC, 0x55344342, 0, { 0, 0, 0, 0 } },
+	{ "BC4S", 0, DDPF_FOURCC, 0x53344342, 0, { 0, 0, 0, 0 } },
+	{ "BC5U", 0, DDPF_FOURCC, 0x55354342, 0, { 0, 0, 0, 0 } },
+	{ "BC5S", 0, DDPF_FOURCC, 0x53354342, 0, { 0, 0, 0, 0 } },
+	{ "A16B16G16R16", 0, DDPF_FOURCC, 36, 0, { 0, 0, 0, 0 } },
+	{ "R16F", 0, DDPF_FOURCC, 111, 0, { 0, 0, 0, 0 } },
+	{ "G16R16F", 0, DDPF_FOURCC, 112, 0, { 0, 0, 0, 0 } },
+	{ "A16B16G16R16F", 0, DDPF_FOURCC, 113, 0, { 0, 0, 0, 0 } },
+	{ "R32F", 0, DDPF_FOURCC, 114, 0, { 0, 0, 0, 0 } },
+	{ "G32R32F", 0, DDPF_FOURCC, 115, 0, { 0, 0, 0, 0 } },
+	{ "A32B32G32R32F", 0, DDPF_FOURCC, 116, 0, { 0, 0, 0, 0 } },
+	{ "BGR8", 0, DDPF_RGB, 0, 24, { 0xFF0000, 0xFF00, 0xFF, 0 } },
+	{ "BGRA8", 0, DDPF_RGB | DDPF_ALPHAPIXELS, 0, 32, { 0xFF0000, 0xFF00, 0xFF, 0xFF000000 } },
+	{ "L8", 0, DDPF_LUMINANCE, 0, 8, { 0xFF, 0, 0, 0 } },
+	{ "L16", 0, DDPF_LUMINANCE, 0, 16, { 0xFFFF, 0, 0, 0 } },
+	{ "A4L4", 0, DDPF_LUMINANCE | DDPF_ALPHAPIXELS, 0, 8, { 0x0F, 0, 0, 0xF0 } },
+	{ "L8A8", 0, DDPF_LUMINANCE | DDPF_ALPHAPIXELS, 0, 16, { 0xFF, 0, 0, 0xFF00 } },
+	{ "A8", 0, DDPF_ALPHA, 0, 8, { 0, 0, 0, 0xFF } },
+	{ "R32G32B32A32_FLOAT", 2, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R16G16B16A16_FLOAT", 10, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R16G16B16A16_UNORM", 11, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R32G32_FLOAT", 16, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R10G10B10A2_UNORM", 24, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R11G11B10_FLOAT", 26, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R8G8B8A8_UNORM", 28, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R8G8B8A8_UNORM_SRGB", 29, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R16G16_FLOAT", 34, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R32_FLOAT", 41, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R8G8_UNORM", 49, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R16_FLOAT", 54, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "R8_UNORM", 61, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "A8_UNORM", 65, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC1_UNORM", 71, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC1_UNORM_SRGB", 72, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC2_UNORM", 74, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC2_UNORM_SRGB", 75, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC3_UNORM", 77, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC3_UNORM_SRGB", 78, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC4_UNORM", 80, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC4_SNORM", 81, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC5_UNORM", 83, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC5_SNORM", 84, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "B8G8R8A8_UNORM", 87, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC6H_UF16", 95, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC6H_SF16", 96, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC7_UNORM", 98, 0, 0, 0, { 0, 0, 0, 0 } },
+	{ "BC7_UNORM_SRGB", 99, 0, 0, 0, { 0, 0, 0, 0 } },
+};
+
+
+static const unsigned int synthSizes[] = { 1, 4, 13, 256, 1024, 4096, 16384 };
+
+
+// just the headers, with a full mip chain; returns the header length
+static unsigned int makeHeader(uint8_t *header, const SynthFormat *fmt, unsigned int size, bool cube) {
+	unsigned int miplevels = 1;
+	while ((size >> miplevels) > 0) {
+		miplevels++;
+	}
+
+	memset(header, '\0', MOJODDS_HEADER_MAXLEN);
+	putLE32(header + 0, fourCC("DDS "));
+	putLE32(header + 4, 124);
+	putLE32(header + 8, 0x1007 | 0x20000);  // caps, height, width, pixelformat, mipmapcount
+	putLE32(header + 12, size);
+	putLE32(header + 16, size);
+	putLE32(header + 28, miplevels);
+	putLE32(header + 76, 32);
+	if (fmt->dxgi) {
+		putLE32(header + 80, DDPF_FOURCC);
+		putLE32(header + 84, fourCC("DX10"));
+	} else {
+		putLE32(header + 80, fmt->pfFlags);
+		putLE32(header + 84, fmt->fourCC);
+		putLE32(header + 88, fmt->bitCount);
+		for (unsigned int i = 0; i < 4; i++) {
+			putLE32(header + 92 + (i * 4), fmt->masks[i]);
+		}
+	}
+	putLE32(header + 108, 0x1000 | 0x400000 | 0x8);  // texture, mipmap, complex
+	if (cube && !fmt->dxgi) {
+		putLE32(header + 112, 0x200 | 0xFC00);  // cubemap, all six faces
+	}
+
+	if (!fmt->dxgi) {
+		return 128;
+	}
+
+	putLE32(header + 128, fmt->dxgi);
+	putLE32(header + 132, 3);  // TEXTURE2D
+	putLE32(header + 136, cube ? 0x4 : 0);  // TEXTURECUBE
+	putLE32(header + 140, 1);
+	return 148;
+}
+
+
+typedef struct Comma {
+	bool first;
+} Comma;
+
+
+static void comma(Comma *c) {
+	printf(c->first ? "\n" : ",\n");
+	c->first = false;
+}
+
+
+// parse and lay out whole files, as an app loading them would
+static void benchCorpus(int argc, char *argv[]) {
+	MOJODDS_File **files = calloc(argc ? argc : 1, sizeof (MOJODDS_File *));
+	unsigned int numFiles = 0;
+	unsigned long totalBytes = 0;
+	for (int i = 0; i < argc; i++) {
+		MOJODDS_File *file = MOJODDS_openFile(argv[i]);
+		if (file) {
+			unsigned long len = 0;
+			MOJODDS_getFileData(file, &len);
+			totalBytes += len;
+			files[numFiles++] = file;
+		}
+	}
+
+	unsigned long iterations = 0;
+	double elapsed = 0.0;
+	unsigned long accepted = 0;
+	if (numFiles) {
+		const double start = seconds();
+		do {
+			for (unsigned int i = 0; i < numFiles; i++) {
+				unsigned long len = 0;
+				const void *data = MOJODDS_getFileData(files[i], &len);
+				MOJODDS_Layout layout;
+				if (MOJODDS_getLayout(data, len, &layout)) {
+					accepted++;
+					sink += layout.texlen;
+				}
+			}
+			iterations++;
+			elapsed = seconds() - start;
+		} while (elapsed < minTime);
+	}
+
+	const double perFile = numFiles ? (elapsed * 1e9) / ((double) iterations * numFiles) : 0.0;
+	printf("\"corpus\": {\"files\": %u, \"accepted\": %lu, \"bytes\": %lu, \"ns_per_file\": %.1f, \"gb_per_sec\": %.3f}",
+	       numFiles, numFiles ? (accepted / iterations) : 0, totalBytes, perFile,
+	       (elapsed > 0.0) ? ((double) totalBytes * iterations / elapsed / 1e9) : 0.0);
+
+	for (unsigned int i = 0; i < numFiles; i++) {
+		MOJODDS_close(files[i]);
+	}
+	free(files);
+}
+
+
+static void loadDone(void *userdata, MOJODDS_error err, const MOJODDS_Layout *layout, void *buffer) {
+	(void) buffer;
+	if (err == MOJODDS_ERR_NONE) {
+		*((unsigned long *) userdata) = layout->texlen;
+	}
+}
+
+
+// the same files read from disk (well, the page cache) into staging
+// buffers, synchronously and through each loader backend
+static void benchLoad(int argc, char *argv[]) {
+	unsigned char **buffers = calloc(argc ? argc : 1, sizeof (unsigned char *));
+	unsigned long *lens = calloc(argc ? argc : 1, sizeof (unsigned long));
+	unsigned long *loaded = calloc(argc ? argc : 1, sizeof (unsigned long));
+	unsigned long maxLen = 0;
+	Comma c = { true };
+
+	printf("\"load\": [");
+	for (int i = 0; buffers && lens && loaded && (i < argc); i++) {
+		MOJODDS_File *file = MOJODDS_openFile(argv[i]);
+		if (file) {
+			MOJODDS_getFileData(file, &lens[i]);
+			buffers[i] = malloc(lens[i] ? lens[i] : 1);
+			maxLen = (lens[i] > maxLen) ? lens[i] : maxLen;
+			MOJODDS_close(file);
+		}
+	}
+
+	unsigned char *whole = malloc(maxLen ? maxLen : 1);
+	for (int backend = 0; whole && (argc > 0) && (backend < 3); backend++) {
+		MOJODDS_Loader *loader = NULL;
+		const char *name = "sync";
+		if (backend > 0) {
+			loader = MOJODDS_createLoader(0, 0, (backend == 2) ? MOJODDS_LOADER_PREAD : 0);
+			if (!loader) {
+				continue;
+			}
+			name = MOJODDS_getLoaderBackend(loader);
+			if ((backend == 1) && (strcmp(name, "pread") == 0)) {
+				MOJODDS_destroyLoader(loader);
+				continue;  // no io_uring here; it's the next one.
+			}
+		}
+
+		unsigned long iterations = 0;
+		unsigned long bytes = 0;
+		double elapsed = 0.0;
+		const double start = seconds();
+		do {
+			for (int i = 0; i < argc; i++) {
+				loaded[i] = 0;
+				if (!buffers[i]) {
+					continue;
+				} else if (loader) {
+					MOJODDS_LoadRequest req;
+					memset(&req, 0, sizeof (req));
+					req.path = argv[i];
+					req.buffer = buffers[i];
+					req.bufferlen = lens[i];
+					req.callback = loadDone;
+					req.userdata = &loaded[i];
+					MOJODDS_load(loader, &req);
+					continue;
+				}
+
+				// what the sample programs do: read it all, then look
+				FILE *io = fopen(argv[i], "rb");
+				if (io) {
+					const unsigned long len = (unsigned long) fread(whole, 1, lens[i], io);
+					fclose(io);
+					MOJODDS_Layout layout;
+					if (MOJODDS_getLayout(whole, len, &layout)) {
+						memcpy(buffers[i], layout.tex, layout.texlen);
+						loaded[i] = layout.texlen;
+					}
+				}
+			}
+			if (loader) {
+				MOJODDS_waitLoader(loader);
+			}
+			for (int i = 0; i < argc; i++) {
+				bytes += loaded[i];
+			}
+			iterations++;
+			elapsed = seconds() - start;
+		} while (elapsed < minTime);
+		MOJODDS_destroyLoader(loader);
+
+		comma(&c);
+		printf("  {\"backend\": \"%s\", \"files\": %d, \"bytes\": %lu, \"us_per_batch\": %.1f, \"gb_per_sec\": %.3f}",
+		       name, argc, bytes / iterations, (elapsed * 1e6) / iterations, (double) bytes / elapsed / 1e9);
+	}
+	printf("\n]");
+
+	for (int i = 0; buffers && (i < argc); i++) {
+		free(buffers[i]);
+	}
+	free(whole);
+	free(buffers);
+	free(lens);
+	free(loaded);
+}
+
+
+// the corpus again, parsed every time and then through a layout cache that
+// holds all of it, both from memory and by path
+static void benchCache(int argc, char *argv[]) {
+	MOJODDS_File **files = calloc(argc ? argc : 1, sizeof (MOJODDS_File *));
+	const char **paths = calloc(argc ? argc : 1, sizeof (const char *));
+	unsigned int numFiles = 0;
+	Comma c = { true };
+
+	printf("\"cache\": [");
+	for (int i = 0; files && paths && (i < argc); i++) {
+		files[numFiles] = MOJODDS_openFile(argv[i]);
+		if (files[numFiles]) {
+			paths[numFiles++] = argv[i];
+		}
+	}
+
+	for (int mode = 0; (numFiles > 0) && (mode < 4); mode++) {
+		static const char *modeNames[] = { "parse", "cached", "parse_path", "cached_path" };
+		MOJODDS_LayoutCache *cache = (mode & 1) ? MOJODDS_createLayoutCache(4 * 1024 * 1024) : NULL;
+		if ((mode & 1) && !cache) {
+			continue;
+		}
+
+		unsigned long iterations = 0;
+		double elapsed = 0.0;
+		const double start = seconds();
+		do {
+			for (unsigned int i = 0; i < numFiles; i++) {
+				unsigned long len = 0;
+				const void *data = MOJODDS_getFileData(files[i], &len);
+				MOJODDS_Layout layout;
+				MOJODDS_error err = MOJODDS_ERR_IO;
+				if (mode == 0) {
+					err = MOJODDS_validate(data, len, len, &layout);
+				} else if (mode == 1) {
+					err = MOJODDS_getCachedLayout(cache, data, len, &layout);
+				} else if (mode == 3) {
+					err = MOJODDS_getCachedFileLayout(cache, paths[i], &layout);
+				} else {
+					// what a reload check does without a cache
+					FILE *io = fopen(paths[i], "rb");
+					if (io) {
+						unsigned char header[MOJODDS_HEADER_MAXLEN];
+						const unsigned long got = (unsigned long) fread(header, 1, sizeof (header), io);
+						fclose(io);
+						err = MOJODDS_validate(header, got, len, &layout);
+					}
+				}
+				sink += err;
+			}
+			iterations++;
+			elapsed = seconds() - start;
+		} while (elapsed < minTime);
+
+		comma(&c);
+		printf("  {\"mode\": \"%s\", \"files\": %u, \"ns_per_file\": %.1f", modeNames[mode], numFiles,
+		       (elapsed * 1e9) / ((double) iterations * numFiles));
+		if (cache) {
+			MOJODDS_LayoutCacheStats stats;
+			MOJODDS_getLayoutCacheStats(cache, &stats);
+			printf(", \"hits\": %lu, \"misses\": %lu", stats.hits, stats.misses);
+			MOJODDS_destroyLayoutCache(cache);
+		}
+		printf("}");
+	}
+	printf("\n]");
+
+	for (unsigned int i = 0; i < numFiles; i++) {
+		MOJODDS_close(files[i]);
+	}
+	free(paths);
+	free(files);
+}
+
+
+static int writeFile(void *userdata, const void *data, unsigned long len) {
+	return fwrite(data, 1, len, (FILE *) userdata) == len;
+}
+
+
+// the corpus as loose files, each mapped and parsed, against the same files
+// packed into one and looked up by name
+static void benchPack(int argc, char *argv[]) {
+	static const char *packPath = "ddsbench-tmp.pack";
+	MOJODDS_File **files = calloc(argc ? argc : 1, sizeof (MOJODDS_File *));
+	MOJODDS_PackInput *inputs = calloc(argc ? argc : 1, sizeof (MOJODDS_PackInput));
+	MOJODDS_Pack *pack = NULL;
+	unsigned int numFiles = 0;
+	Comma c = { true };
+
+	printf("\"pack\": [");
+	for (int i = 0; files && inputs && (i < argc); i++) {
+		MOJODDS_File *file = MOJODDS_openFile(argv[i]);
+		if (file) {
+			MOJODDS_PackInput *input = &inputs[numFiles];
+			MOJODDS_Layout layout;
+			input->name = argv[i];
+			input->data = MOJODDS_getFileData(file, &input->len);
+			if (MOJODDS_getLayout(input->data, input->len, &layout)) {
+				files[numFiles++] = file;
+			} else {
+				MOJODDS_close(file);
+			}
+		}
+	}
+
+	FILE *io = (numFiles > 0) ? fopen(packPath, "wb") : NULL;
+	if (io) {
+		const int written = MOJODDS_writePack(inputs, numFiles, 4096, writeFile, io);
+		if ((fclose(io) == 0) && written) {
+			pack = MOJODDS_openPack(packPath);
+		}
+	}
+
+	for (int mode = 0; pack && (mode < 2); mode++) {
+		unsigned long iterations = 0;
+		double elapsed = 0.0;
+		const double start = seconds();
+		do {
+			for (unsigned int i = 0; i < numFiles; i++) {
+				MOJODDS_Layout layout;
+				if (mode == 0) {
+					MOJODDS_File *file = MOJODDS_openFile(inputs[i].name);
+					if (file) {
+						unsigned long len = 0;
+						const void *data = MOJODDS_getFileData(file, &len);
+						sink += MOJODDS_getLayout(data, len, &layout);
+						MOJODDS_close(file);
+					}
+				} else {
+					MOJODDS_PackEntry entry;
+					unsigned int index = 0;
+					if (MOJODDS_findPackEntry(pack, inputs[i].name, &index)) {
+						sink += MOJODDS_getPackEntry(pack, index, &entry);
+					}
+				}
+			}
+			iterations++;
+			elapsed = seconds() - start;
+		} while (elapsed < minTime);
+
+		comma(&c);
+		printf("  {\"mode\": \"%s\", \"files\": %u, \"ns_per_file\": %.1f}", mode ? "pack" : "loose",
+		       numFiles, (elapsed * 1e9) / ((double) iterations * numFiles));
+	}
+	printf("\n]");
+
+	MOJODDS_closePack(pack);
+	if (numFiles > 0) {
+		remove(packPath);
+	}
+	for (unsigned int i = 0; i < numFiles; i++) {
+		MOJODDS_close(files[i]);
+	}
+	free(inputs);
+	free(files);
+}
+
+
+// headers only, checked against what the file size would be; this is how
+// big textures get parsed without allocating gigabytes for them
+static void benchSynthetic(void) {
+	Comma c = { true };
+	printf("\"synthetic\": [");
+	for (unsigned int f = 0; f < sizeof (synthFormats) / sizeof (synthFormats[0]); f++) {
+		const SynthFormat *fmt = &synthFormats[f];
+		for (unsigned int s = 0; s < sizeof (synthSizes) / sizeof (synthSizes[0]); s++) {
+			for (int cube = 0; cube <= 1; cube++) {
+				uint8_t header[MOJODDS_HEADER_MAXLEN];
+				const unsigned int headerLen = makeHeader(header, fmt, synthSizes[s], cube != 0);
+				MOJODDS_Layout layout;
+
+				// claim a huge file just to learn the size it needs to be
+				MOJODDS_error err = MOJODDS_validate(header, headerLen, ~0UL, &layout);
+				comma(&c);
+				printf("  {\"format\": \"%s\", \"type\": \"%s\", \"size\": %u", fmt->name, cube ? "cube" : "2D", synthSizes[s]);
+				if (err != MOJODDS_ERR_NONE) {
+					printf(", \"skipped\": \"%s\"}", MOJODDS_errorString(err));
+					continue;
+				}
+
+				const unsigned long fileLen = layout.dataoffset + layout.texlen;
+				unsigned long iterations = 0;
+				double elapsed = 0.0;
+				const double start = seconds();
+				do {
+					for (unsigned int i = 0; i < 64; i++) {
+						err = MOJODDS_validate(header, headerLen, fileLen, &layout);
+						sink += err;
+					}
+					iterations += 64;
+					elapsed = seconds() - start;
+				} while (elapsed < (minTime / 16.0));
+
+				printf(", \"glfmt\": \"0x%04x\", \"miplevels\": %u, \"bytes\": %lu, \"ns_per_file\": %.1f}",
+				       layout.glfmt, layout.miplevels, layout.texlen, (elapsed * 1e9) / iterations);
+			}
+		}
+	}
+	printf("\n]");
+}
+
+
+static const char *decodeFormatName(MOJODDS_decodeFormat fmt) {
+	switch (fmt) {
+	case MOJODDS_DECODE_RGBA8:
+		return "RGBA8";
+	case MOJODDS_DECODE_RGBA16F:
+		return "RGBA16F";
+	case MOJODDS_DECODE_RGBA32F:
+		return "RGBA32F";
+	case MOJODDS_DECODE_NORMAL8:
+		return "NORMAL8";
+	}
+	return "unknown";
+}
+
+
+static unsigned int decodePixelSize(MOJODDS_decodeFormat fmt) {
+	switch (fmt) {
+	case MOJODDS_DECODE_RGBA8:
+		return 4;
+	case MOJODDS_DECODE_RGBA16F:
+		return 8;
+	case MOJODDS_DECODE_RGBA32F:
+		return 16;
+	case MOJODDS_DECODE_NORMAL8:
+		return 4;
+	}
+	return 0;
+}
+
+
+// every (format, destination) pair MOJODDS_decode accepts, on random
+// blocks, which for BC6H and BC7 means a mix of all the modes
+static void benchDecode(unsigned int size) {
+	static const MOJODDS_decodeFormat dstFormats[] = { MOJODDS_DECODE_RGBA8, MOJODDS_DECODE_RGBA16F, MOJODDS_DECODE_RGBA32F, MOJODDS_DECODE_NORMAL8 };
+	MOJODDS_ThreadPool *pool = MOJODDS_createThreadPool(0);
+	const unsigned long maxSrcLen = (unsigned long) size * size;  // 16 bytes per 4x4 block at most
+	uint8_t *src = malloc(maxSrcLen);
+	uint8_t *dst = malloc((unsigned long) size * size * 16);
+	uint32_t seed = 0x12345678;
+	Comma c = { true };
+
+	printf("\"decode\": [");
+	if (!src || !dst) {
+		printf("\n]");
+		free(src);
+		free(dst);
+		MOJODDS_destroyThreadPool(pool);
+		return;
+	}
+
+	for (unsigned long i = 0; i < maxSrcLen; i++) {
+		seed = (seed * 1103515245) + 12345;
+		src[i] = (uint8_t) (seed >> 16);
+	}
+
+	for (unsigned int f = 0; f < sizeof (synthFormats) / sizeof (synthFormats[0]); f++) {
+		uint8_t header[MOJODDS_HEADER_MAXLEN];
+		MOJODDS_Layout layout;
+		const unsigned int headerLen = makeHeader(header, &synthFormats[f], size, false);
+		if (MOJODDS_validate(header, headerLen, ~0UL, &layout) != MOJODDS_ERR_NONE) {
+			continue;
+		}
+
+		// the sRGB variants and legacy spellings decode the same way
+		bool seen = false;
+		for (unsigned int g = 0; g < f; g++) {
+			uint8_t otherHeader[MOJODDS_HEADER_MAXLEN];
+			MOJODDS_Layout other;
+			const unsigned int otherLen = makeHeader(otherHeader, &synthFormats[g], size, false);
+			if ((MOJODDS_validate(otherHeader, otherLen, ~0UL, &other) == MOJODDS_ERR_NONE) && (other.glfmt == layout.glfmt)) {
+				seen = true;
+			}
+		}
+		const unsigned long srcLen = layout.mips[0].len;
+		if (seen || (srcLen > maxSrcLen)) {
+			continue;  // nothing decodes more than a byte per pixel
+		}
+
+		for (unsigned int d = 0; d < sizeof (dstFormats) / sizeof (dstFormats[0]); d++) {
+			const unsigned long pitch = (unsigned long) size * decodePixelSize(dstFormats[d]);
+			if (!MOJODDS_decode(layout.glfmt, src, srcLen, size, size, dstFormats[d], dst, pitch, NULL)) {
+				continue;  // no decoder for this pair
+			}
+
+			for (int simd = 1; simd >= 0; simd--) {
+				for (int threaded = 0; threaded <= 1; threaded++) {
+					MOJODDS_useSIMD(simd);
+					unsigned long iterations = 0;
+					double elapsed = 0.0;
+					const double start = seconds();
+					do {
+						MOJODDS_decode(layout.glfmt, src, srcLen, size, size, dstFormats[d], dst, pitch, threaded ? pool : NULL);
+						iterations++;
+						elapsed = seconds() - start;
+					} while (elapsed < minTime);
+					sink += dst[0];
+
+					const double pixels = (double) size * size * iterations;
+					comma(&c);
+					printf("  {\"format\": \"%s\", \"glfmt\": \"0x%04x\", \"dst\": \"%s\", \"size\": %u, \"simd\": %s, \"threaded\": %s, "
+					       "\"ns_per_image\": %.1f, \"mpix_per_sec\": %.2f, \"gb_per_sec\": %.3f}",
+					       synthFormats[f].name, layout.glfmt, decodeFormatName(dstFormats[d]), size,
+					       simd ? "true" : "false", threaded ? "true" : "false",
+					       (elapsed * 1e9) / iterations, pixels / elapsed / 1e6,
+					       ((double) srcLen * iterations) / elapsed / 1e9);
+				}
+			}
+		}
+	}
+	MOJODDS_useSIMD(1);
+	printf("\n]");
+
+	free(src);
+	free(dst);
+	MOJODDS_destroyThreadPool(pool);
+}
+
+
+// something like real texture content: smooth ramps, a bit of grain, hard
+// edges, and an alpha channel with both a soft ramp and a cutout
+static void makeEncodeImage(uint8_t *img, unsigned int size) {
+	uint32_t seed = 0x87654321;
+	for (unsigned int y = 0; y < size; y++) {
+		for (unsigned int x = 0; x < size; x++) {
+			uint8_t *px = img + (((unsigned long) y * size) + x) * 4;
+			seed = (seed * 1103515245) + 12345;
+			const int grain = (int) ((seed >> 16) & 15) - 8;
+			const int r = (int) ((x * 255) / size) + grain;
+			px[0] = (uint8_t) (r < 0 ? 0 : (r > 255 ? 255 : r));
+			px[1] = (uint8_t) ((y * 255) / size);
+			px[2] = (((x / 24) + (y / 40)) & 1) ? 200 : 40;
+			const int ramp = (int) (((x + y) * 255) / (size * 2)) + (grain / 2);
+			px[3] = (x < size / 2) ? (uint8_t) (ramp < 0 ? 0 : ramp) : ((((x / 8) ^ (y / 8)) & 1) ? 255 : 0);
+		}
+	}
+}
+
+
+// PSNR over channels [first, last], skipping the pixels of a that BC1 would
+// make transparent if opaqueOnly; 99 means lossless
+static double psnr(const uint8_t *a, const uint8_t *b, unsigned long pixels, int first, int last, bool opaqueOnly) {
+	unsigned long counted = 0;
+	double err = 0.0;
+	for (unsigned long i = 0; i < pixels; i++) {
+		if (opaqueOnly && (a[(i * 4) + 3] < 128)) {
+			continue;
+		}
+		counted++;
+		for (int c = first; c <= last; c++) {
+			const double d = (double) a[(i * 4) + c] - (double) b[(i * 4) + c];
+			err += d * d;
+		}
+	}
+	const double mse = counted ? (err / ((double) counted * (last - first + 1))) : 0.0;
+	return (mse == 0.0) ? 99.0 : 10.0 * log10((255.0 * 255.0) / mse);
+}
+
+
+// BC1 and BC3 in both qualities, with how close the result decodes to the
+// original so throughput can be traded against quality
+static void benchEncode(unsigned int size) {
+	static const struct { const char *name; unsigned int glfmt; unsigned int blockSize; } formats[] = {
+		{ "BC1", 0x83F1, 8 },  // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+		{ "BC3", 0x83F3, 16 },  // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	};
+	MOJODDS_ThreadPool *pool = MOJODDS_createThreadPool(0);
+	const unsigned long pixels = (unsigned long) size * size;
+	const unsigned long maxDstLen = pixels;  // 16 bytes per 4x4 block at most
+	uint8_t *src = malloc(pixels * 4);
+	uint8_t *decoded = malloc(pixels * 4);
+	uint8_t *dst = malloc(maxDstLen);
+	Comma c = { true };
+
+	printf("\"encode\": [");
+	if (!src || !decoded || !dst) {
+		printf("\n]");
+		free(src);
+		free(decoded);
+		free(dst);
+		MOJODDS_destroyThreadPool(pool);
+		return;
+	}
+
+	makeEncodeImage(src, size);
+	for (unsigned int f = 0; f < sizeof (formats) / sizeof (formats[0]); f++) {
+		const unsigned long dstLen = (((unsigned long) size + 3) / 4) * ((size + 3) / 4) * formats[f].blockSize;
+		for (int q = 0; q <= 1; q++) {
+			const MOJODDS_encodeQuality quality = q ? MOJODDS_ENCODE_HIGH : MOJODDS_ENCODE_FAST;
+
+			// the same bits come out either way; only the speed changes
+			MOJODDS_encode(formats[f].glfmt, src, size * 4, size, size, quality, dst, dstLen, pool);
+			MOJODDS_decode(formats[f].glfmt, dst, dstLen, size, size, MOJODDS_DECODE_RGBA8, decoded, size * 4, NULL);
+			const bool bc1 = (formats[f].blockSize == 8);
+			const double psnrRGB = psnr(src, decoded, pixels, 0, 2, bc1);
+			const double psnrAlpha = psnr(src, decoded, pixels, 3, 3, false);
+
+			// the high-quality mode has no SIMD path, so it only runs scalar
+			for (int simd = q ? 0 : 1; simd >= 0; simd--) {
+				for (int threaded = 0; threaded <= 1; threaded++) {
+					MOJODDS_useSIMD(simd);
+					unsigned long iterations = 0;
+					double elapsed = 0.0;
+					const double start = seconds();
+					do {
+						MOJODDS_encode(formats[f].glfmt, src, size * 4, size, size, quality, dst, dstLen, threaded ? pool : NULL);
+						iterations++;
+						elapsed = seconds() - start;
+					} while (elapsed < minTime);
+					sink += dst[0];
+
+					comma(&c);
+					printf("  {\"format\": \"%s\", \"quality\": \"%s\", \"size\": %u, \"simd\": %s, \"threaded\": %s, "
+					       "\"ns_per_image\": %.1f, \"mpix_per_sec\": %.2f, \"psnr_rgb\": %.2f",
+					       formats[f].name, q ? "high" : "fast", size,
+					       simd ? "true" : "false", threaded ? "true" : "false",
+					       (elapsed * 1e9) / iterations, ((double) pixels * iterations) / elapsed / 1e6, psnrRGB);
+					if (!bc1) {
+						printf(", \"psnr_alpha\": %.2f", psnrAlpha);  // BC1 only keeps 1-bit alpha
+					}
+					printf("}");
+				}
+			}
+		}
+	}
+	MOJODDS_useSIMD(1);
+	printf("\n]");
+
+	free(src);
+	free(decoded);
+	free(dst);
+	MOJODDS_destroyThreadPool(pool);
+}
+
+
+// premultiplying and unpremultiplying decoded images in place. Each pass
+// starts from a fresh copy, or float images would decay into denormals and
+// time those instead; only the conversion itself is timed
+static void benchAlpha(unsigned int size) {
+	static const MOJODDS_decodeFormat formats[] = { MOJODDS_DECODE_RGBA8, MOJODDS_DECODE_RGBA32F };
+	MOJODDS_ThreadPool *pool = MOJODDS_createThreadPool(0);
+	const unsigned long pixels = (unsigned long) size * size;
+	uint8_t *orig = malloc(pixels * 16);
+	uint8_t *img = malloc(pixels * 16);
+	Comma c = { true };
+
+	printf("\"alpha\": [");
+	if (!orig || !img) {
+		printf("\n]");
+		free(orig);
+		free(img);
+		MOJODDS_destroyThreadPool(pool);
+		return;
+	}
+
+	for (unsigned int f = 0; f < sizeof (formats) / sizeof (formats[0]); f++) {
+		const unsigned int pixelSize = decodePixelSize(formats[f]);
+		const unsigned long len = pixels * pixelSize;
+		makeEncodeImage(orig, size);
+		if (formats[f] == MOJODDS_DECODE_RGBA32F) {
+			float *px = (float *) orig;
+			for (unsigned long i = pixels * 4; i > 0; i--) {
+				px[i - 1] = orig[i - 1] / 255.0f;  // back to front, so nothing's overwritten before it's read
+			}
+		}
+
+		for (int premultiply = 1; premultiply >= 0; premultiply--) {
+			for (int simd = 1; simd >= 0; simd--) {
+				for (int threaded = 0; threaded <= 1; threaded++) {
+					MOJODDS_useSIMD(simd);
+					unsigned long iterations = 0;
+					double elapsed = 0.0;
+					do {
+						memcpy(img, orig, len);
+						const double start = seconds();
+						if (premultiply) {
+							MOJODDS_premultiplyAlpha(formats[f], img, size, size, size * pixelSize, threaded ? pool : NULL);
+						} else {
+							MOJODDS_unpremultiplyAlpha(formats[f], img, size, size, size * pixelSize, threaded ? pool : NULL);
+						}
+						elapsed += seconds() - start;
+						iterations++;
+					} while (elapsed < minTime);
+					sink += img[0];
+
+					comma(&c);
+					printf("  {\"format\": \"%s\", \"op\": \"%s\", \"size\": %u, \"simd\": %s, \"threaded\": %s, "
+					       "\"ns_per_image\": %.1f, \"mpix_per_sec\": %.2f}",
+					       decodeFormatName(formats[f]), premultiply ? "premultiply" : "unpremultiply", size,
+					       simd ? "true" : "false", threaded ? "true" : "false",
+					       (elapsed * 1e9) / iterations, ((double) pixels * iterations) / elapsed / 1e6);
+				}
+			}
+		}
+	}
+	MOJODDS_useSIMD(1);
+	printf("\n]");
+
+	free(orig);
+	free(img);
+	MOJODDS_destroyThreadPool(pool);
+}
+
+// half <-> float and the two HDR packers, on an RGBA32F image of light
+// levels from deep shadow to well past 1.0
+static void benchFloat(unsigned int size) {
+	static const char *ops[] = { "half_to_float", "float_to_half", "float_to_rgbe", "float_to_r11g11b10f" };
+	MOJODDS_ThreadPool *pool = MOJODDS_createThreadPool(0);
+	const unsigned long pixels = (unsigned long) size * size;
+	float *rgba = malloc(pixels * 16);
+	uint8_t *half = malloc(pixels * 8);
+	uint8_t *out = malloc(pixels * 16);
+	uint32_t seed = 0x12345678;
+	Comma c = { true };
+
+	printf("\"float\": [");
+	if (!rgba || !half || !out) {
+		printf("\n]");
+		free(rgba);
+		free(half);
+		free(out);
+		MOJODDS_destroyThreadPool(pool);
+		return;
+	}
+
+	for (unsigned long i = 0; i < pixels * 4; i++) {
+		seed = (seed * 1103515245) + 12345;
+		rgba[i] = ldexpf((seed >> 16) / 65536.0f, (int) (seed % 24) - 12);
+	}
+	MOJODDS_floatToHalf(rgba, half, pixels * 4, NULL);
+
+	for (unsigned int op = 0; op < sizeof (ops) / sizeof (ops[0]); op++) {
+		for (int simd = 1; simd >= 0; simd--) {
+			for (int threaded = 0; threaded <= 1; threaded++) {
+				MOJODDS_ThreadPool *p = threaded ? pool : NULL;
+				MOJODDS_useSIMD(simd);
+				unsigned long iterations = 0;
+				double elapsed = 0.0;
+				const double start = seconds();
+				do {
+					switch (op) {
+					case 0:
+						MOJODDS_halfToFloat(half, out, pixels * 4, p);
+						break;
+					case 1:
+						MOJODDS_floatToHalf(rgba, out, pixels * 4, p);
+						break;
+					case 2:
+						MOJODDS_floatToRGBE(rgba, out, pixels, p);
+						break;
+					default:
+						MOJODDS_floatToR11G11B10F(rgba, out, pixels, p);
+						break;
+					}
+					iterations++;
+					elapsed = seconds() - start;
+				} while (elapsed < minTime);
+				sink += out[0];
+
+				comma(&c);
+				printf("  {\"op\": \"%s\", \"size\": %u, \"simd\": %s, \"threaded\": %s, "
+				       "\"ns_per_image\": %.1f, \"mpix_per_sec\": %.2f}",
+				       ops[op], size, simd ? "true" : "false", threaded ? "true" : "false",
+				       (elapsed * 1e9) / iterations, ((double) pixels * iterations) / elapsed / 1e6);
+			}
+		}
+	}
+	MOJODDS_useSIMD(1);
+	printf("\n]");
+
+	free(rgba);
+	free(half);
+	free(out);
+	MOJODDS_destroyThreadPool(pool);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int decodeSize = 1024;
+	unsigned int encodeSize = 512;  // the high-quality encoder is slow
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0) {
+			minTime = 0.02;
+			decodeSize = 256;
+			encodeSize = 128;
+		} else if (strcmp(argv[i], "--help") == 0) {
+			printf("Usage: %s [--quick] [DDS-file ...]\n", argv[0]);
+			printf("Files given are timed through MOJODDS_getLayout as a corpus, and\n");
+			printf("loaded into staging buffers with and without MOJODDS_load, and\n");
+			printf("looked up loose and in a pack written to the current directory.\n");
+			return 0;
+		} else {
+			break;
+		}
+	}
+
+	printf("{\n\"version\": 1,\n");
+	benchCorpus(argc - i, argv + i);
+	printf(",\n");
+	benchLoad(argc - i, argv + i);
+	printf(",\n");
+	benchCache(argc - i, argv + i);
+	printf(",\n");
+	benchPack(argc - i, argv + i);
+	printf(",\n");
+	benchSynthetic();
+	printf(",\n");
+	benchDecode(decodeSize);
+	printf(",\n");
+	benchEncode(encodeSize);
+	printf(",\n");
+	benchAlpha(decodeSize);
+	printf(",\n");
+	benchFloat(decodeSize);
+	printf("\n}\n");
+
+	return 0;
+}
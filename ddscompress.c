@@ -0,0 +1,315 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "mojodds.h"
+
+
+// supercompresses a DDS file, or turns one back into a plain DDS file
+// (optionally just the smaller mip levels), and prints what it did as JSON
+// on stdout
+
+
+typedef struct Buffer {
+	char *data;
+	size_t len;
+	size_t cap;
+} Buffer;
+
+
+static double seconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double) count.QuadPart / (double) freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+#endif
+}
+
+
+static void printJsonString(const char *str) {
+	putchar('"');
+	for (const unsigned char *ptr = (const unsigned char *) str; *ptr; ptr++) {
+		if ((*ptr == '"') || (*ptr == '\\')) {
+			printf("\\%c", *ptr);
+		} else if (*ptr < 0x20) {
+			printf("\\u%04x", *ptr);
+		} else {
+			putchar(*ptr);
+		}
+	}
+	putchar('"');
+}
+
+
+static int writeFile(void *userdata, const void *data, unsigned long len) {
+	return fwrite(data, 1, len, (FILE *) userdata) == len;
+}
+
+
+static int writeBuffer(void *userdata, const void *data, unsigned long len) {
+	Buffer *buf = (Buffer *) userdata;
+	if (len > buf->cap - buf->len) {
+		size_t cap = (buf->cap + len) * 2;
+		char *grown = realloc(buf->data, cap);
+		if (!grown) {
+			return 0;
+		}
+		buf->data = grown;
+		buf->cap = cap;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+	return 1;
+}
+
+
+// decompresses everything once, for timing, and checks it against the
+// original's pixels
+static bool checkRoundTrip(const MOJODDS_Layout *original, const unsigned char *compressed,
+                           unsigned long compressedLen, MOJODDS_ThreadPool *pool, double *elapsed) {
+	MOJODDS_Layout planned, layout;
+	if (MOJODDS_getSupercompressedLayout(compressed, compressedLen, 0, &planned) != MOJODDS_ERR_NONE) {
+		return false;
+	}
+
+	void *pixels = malloc(planned.texlen);
+	if (!pixels) {
+		return false;
+	}
+
+	double start = seconds();
+	MOJODDS_error err = MOJODDS_decompress(compressed, compressedLen, 0, pixels, planned.texlen, pool, &layout);
+	*elapsed = seconds() - start;
+
+	bool ok = (err == MOJODDS_ERR_NONE) && (layout.texlen == original->texlen) &&
+	          (memcmp(pixels, original->tex, original->texlen) == 0);
+	free(pixels);
+	return ok;
+}
+
+
+static int compressFile(const char *inPath, const char *outPath, unsigned int codec,
+                        int level, MOJODDS_ThreadPool *pool) {
+	MOJODDS_File *file = MOJODDS_openFile(inPath);
+	if (!file) {
+		fprintf(stderr, "Error opening %s: %s (%d)\n", inPath, strerror(errno), errno);
+		return 3;
+	}
+
+	unsigned long len = 0;
+	const void *data = MOJODDS_getFileData(file, &len);
+	MOJODDS_Layout layout;
+	MOJODDS_error err = MOJODDS_validate(data, len, len, &layout);
+	if (err != MOJODDS_ERR_NONE) {
+		fprintf(stderr, "%s: %s\n", inPath, MOJODDS_errorString(err));
+		MOJODDS_close(file);
+		return 3;
+	}
+
+	// compress to memory first, so the round trip can be checked
+	Buffer mem = { NULL, 0, 0 };
+	double start = seconds();
+	int ok = MOJODDS_writeSupercompressed(data, len, codec, level, pool, writeBuffer, &mem);
+	double compressTime = seconds() - start;
+	char *compressed = mem.data;
+	size_t compressedLen = mem.len;
+	if (!ok) {
+		fprintf(stderr, "%s: couldn't compress\n", inPath);
+		free(compressed);
+		MOJODDS_close(file);
+		return 4;
+	}
+
+	double decompressTime = 0.0;
+	if (!checkRoundTrip(&layout, (const unsigned char *) compressed, (unsigned long) compressedLen, pool, &decompressTime)) {
+		fprintf(stderr, "%s: didn't decompress to the same pixels\n", inPath);
+		free(compressed);
+		MOJODDS_close(file);
+		return 5;
+	}
+
+	FILE *out = fopen(outPath, "wb");
+	if (!out || (fwrite(compressed, 1, compressedLen, out) != compressedLen) || (fclose(out) != 0)) {
+		fprintf(stderr, "Error writing %s: %s (%d)\n", outPath, strerror(errno), errno);
+		free(compressed);
+		MOJODDS_close(file);
+		return 7;
+	}
+
+	printf("{\n\"input\": ");
+	printJsonString(inPath);
+	printf(",\n\"output\": ");
+	printJsonString(outPath);
+	printf(",\n\"input_bytes\": %lu,\n\"pixel_bytes\": %lu,\n\"output_bytes\": %lu,\n\"ratio\": %.4f,\n",
+	       len, layout.texlen, (unsigned long) compressedLen, (double) compressedLen / len);
+	printf("\"compress_ms\": %.3f,\n\"decompress_ms\": %.3f,\n\"decompress_gb_per_sec\": %.3f\n}\n",
+	       compressTime * 1000.0, decompressTime * 1000.0,
+	       (decompressTime > 0.0) ? (layout.texlen / decompressTime / 1e9) : 0.0);
+
+	free(compressed);
+	MOJODDS_close(file);
+	return 0;
+}
+
+
+static int decompressFile(const char *inPath, const char *outPath, unsigned int firstmip,
+                          MOJODDS_ThreadPool *pool) {
+	MOJODDS_File *file = MOJODDS_openFile(inPath);
+	if (!file) {
+		fprintf(stderr, "Error opening %s: %s (%d)\n", inPath, strerror(errno), errno);
+		return 3;
+	}
+
+	unsigned long len = 0;
+	const void *data = MOJODDS_getFileData(file, &len);
+	MOJODDS_Layout layout;
+	MOJODDS_error err = MOJODDS_getSupercompressedLayout(data, len, firstmip, &layout);
+	void *pixels = (err == MOJODDS_ERR_NONE) ? malloc(layout.texlen) : NULL;
+	double start = seconds();
+	if (pixels) {
+		err = MOJODDS_decompress(data, len, firstmip, pixels, layout.texlen, pool, &layout);
+	} else if (err == MOJODDS_ERR_NONE) {
+		err = MOJODDS_ERR_NO_BUFFER;
+	}
+	double decompressTime = seconds() - start;
+	MOJODDS_close(file);
+
+	if (err != MOJODDS_ERR_NONE) {
+		fprintf(stderr, "%s: %s\n", inPath, MOJODDS_errorString(err));
+		free(pixels);
+		return 4;
+	}
+
+	const void **subresources = calloc((size_t) layout.faces * layout.miplevels, sizeof (void *));
+	if (!subresources) {
+		fprintf(stderr, "Out of memory\n");
+		free(pixels);
+		return 2;
+	}
+	for (unsigned int face = 0; face < layout.faces; face++) {
+		for (unsigned int mip = 0; mip < layout.miplevels; mip++) {
+			unsigned long texlen;
+			unsigned int w, h;
+			MOJODDS_getSubresource(&layout, face, mip, &subresources[(face * layout.miplevels) + mip], &texlen, &w, &h);
+		}
+	}
+
+	MOJODDS_WriteDesc desc;
+	memset(&desc, 0, sizeof (desc));
+	desc.glfmt = layout.glfmt;
+	desc.textureType = layout.textureType;
+	desc.w = layout.w;
+	desc.h = layout.h;
+	desc.depth = layout.depth;
+	desc.miplevels = layout.miplevels;
+	desc.arraySize = layout.arraySize;
+
+	FILE *out = fopen(outPath, "wb");
+	int written = out && MOJODDS_write(&desc, subresources, writeFile, out);
+	if (out && (fclose(out) != 0)) {
+		written = 0;
+	}
+	free(subresources);
+	free(pixels);
+	if (!written) {
+		fprintf(stderr, "Error writing %s\n", outPath);
+		return 7;
+	}
+
+	printf("{\n\"input\": ");
+	printJsonString(inPath);
+	printf(",\n\"output\": ");
+	printJsonString(outPath);
+	printf(",\n\"width\": %u,\n\"height\": %u,\n\"miplevels\": %u,\n\"pixel_bytes\": %lu,\n\"decompress_ms\": %.3f\n}\n",
+	       layout.w, layout.h, layout.miplevels, layout.texlen, decompressTime * 1000.0);
+	return 0;
+}
+
+
+static void usage(const char *argv0) {
+	printf("Usage: %s [--codec lz4|zstd|stored] [--level N] [--threads N] in.dds out.ddsz\n", argv0);
+	printf("       %s -d [--firstmip N] [--threads N] in.ddsz out.dds\n", argv0);
+	printf("Compressing checks that the output decompresses to the same pixels.\n");
+	printf("--firstmip drops that many of the biggest levels when decompressing.\n");
+	printf("zstd is there if the library was built with it; --level is zstd's.\n");
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned int codec = MOJODDS_CODEC_LZ4;
+	unsigned int firstmip = 0;
+	unsigned int threads = 0;
+	int level = 0;
+	bool decompress = false;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "--codec") == 0) && (i + 1 < argc)) {
+			const char *name = argv[++i];
+			if (strcmp(name, "lz4") == 0) {
+				codec = MOJODDS_CODEC_LZ4;
+			} else if (strcmp(name, "zstd") == 0) {
+				codec = MOJODDS_CODEC_ZSTD;
+			} else if (strcmp(name, "stored") == 0) {
+				codec = MOJODDS_CODEC_STORED;
+			} else {
+				fprintf(stderr, "Unknown codec %s\n", name);
+				return 1;
+			}
+		} else if ((strcmp(argv[i], "--level") == 0) && (i + 1 < argc)) {
+			level = atoi(argv[++i]);
+		} else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc)) {
+			threads = (unsigned int) strtoul(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "--firstmip") == 0) && (i + 1 < argc)) {
+			firstmip = (unsigned int) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-d") == 0) {
+			decompress = true;
+		} else if (strcmp(argv[i], "--help") == 0) {
+			usage(argv[0]);
+			return 0;
+		} else {
+			break;
+		}
+	}
+
+	if (argc - i != 2) {
+		usage(argv[0]);
+		return 1;
+	} else if (!MOJODDS_haveCodec(codec)) {
+		fprintf(stderr, "This build doesn't have that codec\n");
+		return 1;
+	}
+
+	// --threads 1 means just this one
+	MOJODDS_ThreadPool *pool = (threads == 1) ? NULL : MOJODDS_createThreadPool(threads);
+	int retval;
+	if (decompress) {
+		retval = decompressFile(argv[i], argv[i + 1], firstmip, pool);
+	} else {
+		retval = compressFile(argv[i], argv[i + 1], codec, level, pool);
+	}
+	MOJODDS_destroyThreadPool(pool);
+	return retval;
+}
@@ -4,12 +4,22 @@
  * Please see the file LICENSE.txt in the source's root directory.
  */
 
+#define _GNU_SOURCE
+
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "mojodds.h"
 
@@ -23,26 +33,14 @@ static bool isPow2(unsigned int v) {
 static int ddsinfo(const char *filename) {
     printf("%s\n", filename);
 
-	FILE *f = fopen(filename, "rb");
-	if (!f) {
+	MOJODDS_File *file = MOJODDS_openFile(filename);
+	if (!file) {
 		printf("Error opening %s: %s (%d)\n", filename, strerror(errno), errno);
 		return 1;
 	}
 
-	fseek(f, 0, SEEK_END);
-	long size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-
-	char *contents = malloc(size);
-	size_t readbytes = fread(contents, 1, size, f);
-	if (readbytes != size) {
-		printf("Only got %u of %ld bytes: %s\n", (unsigned int) readbytes, size, strerror(errno));
-		free(contents);
-		fclose(f);
-		return 2;
-	}
-
-	fclose(f);
+	unsigned long size = 0;
+	const char *contents = MOJODDS_getFileData(file, &size);
 
 	int isDDS = MOJODDS_isDDS(contents, size);
 	printf("isDDS: %d\n", isDDS);
@@ -55,16 +53,26 @@ static int ddsinfo(const char *filename) {
 		int retval = MOJODDS_getTexture(contents, size, &tex, &texlen, &glfmt, &w, &h, &miplevels, &cubemapfacelen, &textureType);
 		if (!retval) {
 			printf("MOJODDS_getTexture failed\n");
-			free(contents);
+			MOJODDS_close(file);
 			return 3;
 		}
 
+		// same parse as MOJODDS_getTexture, so it can't fail now.
+		MOJODDS_Layout layout;
+		MOJODDS_getLayout(contents, size, &layout);
+
 		uintptr_t texoffset = ((const char *)(tex)) - contents;
 		printf("texoffset: %u\n", (unsigned int)(texoffset));
 		printf("texlen: %lu\n", texlen);
 		printf("glfmt: 0x%x\n", glfmt);
 		printf("width x height: %u x %u\n", w, h);
 		printf("miplevels: %u\n", miplevels);
+		if (layout.arraySize > 1) {
+			printf("arraySize: %u (mips below are element 0)\n", layout.arraySize);
+		}
+		if (layout.premultiplied) {
+			printf("premultiplied alpha\n");
+		}
 		printf("textureType: ");
 		switch (textureType) {
 		case MOJODDS_TEXTURE_2D:
@@ -114,23 +122,487 @@ static int ddsinfo(const char *filename) {
 
 		case MOJODDS_TEXTURE_VOLUME:
 			printf("volume\n");
+			printf("depth: %u\n", layout.depth);
+			printf("\n");
+
+			for (unsigned int miplevel = 0; miplevel < miplevels; miplevel++) {
+				const MOJODDS_MipLevel *mip = &layout.mips[miplevel];
+				const void *slicetex = NULL;
+				unsigned long slicelen = 0;
+				unsigned int mipW = 0, mipH = 0;
+				for (unsigned int slice = 0; slice < mip->d; slice++) {
+					retval = MOJODDS_getVolumeSlice(&layout, miplevel, slice, &slicetex, &slicelen, &mipW, &mipH);
+					if (!retval) {
+						printf("MOJODDS_getVolumeSlice(%u, %u) error: %d\n", miplevel, slice, retval);
+						break;
+					}
+				}
+
+				uintptr_t miptexoffset = mip->offset;
+				bool npot = !(isPow2(mip->w) || isPow2(mip->h));
+				printf("%4u x %4u x %4u  %s", mip->w, mip->h, mip->d, npot ? "NPOT  " : "      ");
+				printf("miptexoffset: %8u  ", (unsigned int)(miptexoffset));
+				printf("miptexlen: %8lu  ", mip->len);
+				printf("slicelen: %8lu\n", slicelen);
+			}
 			break;
 
 		}
 	}
 
-	free(contents);
+	MOJODDS_close(file);
 
 	return 0;
 }
 
 
+// scan mode: walk directories with a pool of threads and print one line of
+// JSON or CSV per file, reading just the headers unless asked for the mips
+
+
+typedef struct ScanOptions {
+	bool csv;
+	bool mips;
+	unsigned int threads;
+} ScanOptions;
+
+
+typedef struct FormatCount {
+	unsigned int glfmt;
+	uint64_t count;
+} FormatCount;
+
+
+#define MAX_FORMATS 64
+#define NUM_ERRORS (MOJODDS_ERR_TRUNCATED_DATA + 1)
+
+
+typedef struct ScanStats {
+	uint64_t files;
+	uint64_t ok;
+	uint64_t unreadable;
+	uint64_t npot;
+	uint64_t gpuBytes;
+	uint64_t rejected[NUM_ERRORS];
+	FormatCount formats[MAX_FORMATS];
+	unsigned int numFormats;
+} ScanStats;
+
+
+typedef struct Buffer {
+	char *data;
+	size_t len;
+	size_t cap;
+} Buffer;
+
+
+typedef struct Scanner {
+	const ScanOptions *options;
+	char **paths;
+	size_t numPaths;
+	size_t nextPath;
+	pthread_mutex_t lock;  // guards nextPath, stats and stdout
+	ScanStats stats;
+} Scanner;
+
+
+static void bufPrintf(Buffer *buf, const char *format, ...) {
+	for (;;) {
+		va_list args;
+		va_start(args, format);
+		int len = vsnprintf(buf->data + buf->len, buf->cap - buf->len, format, args);
+		va_end(args);
+		if (len < 0) {
+			return;
+		} else if (buf->len + len < buf->cap) {
+			buf->len += len;
+			return;
+		}
+
+		size_t cap = (buf->cap + len + 1) * 2;
+		char *data = realloc(buf->data, cap);
+		if (!data) {
+			return;
+		}
+		buf->data = data;
+		buf->cap = cap;
+	}
+}
+
+
+static void bufString(Buffer *buf, const char *str, bool csv) {
+	bufPrintf(buf, "\"");
+	for (const unsigned char *ptr = (const unsigned char *) str; *ptr; ptr++) {
+		if (csv) {
+			bufPrintf(buf, (*ptr == '"') ? "\"\"" : "%c", *ptr);
+		} else if ((*ptr == '"') || (*ptr == '\\')) {
+			bufPrintf(buf, "\\%c", *ptr);
+		} else if (*ptr < 0x20) {
+			bufPrintf(buf, "\\u%04x", *ptr);
+		} else {
+			bufPrintf(buf, "%c", *ptr);
+		}
+	}
+	bufPrintf(buf, "\"");
+}
+
+
+static const char *typeName(MOJODDS_textureType textureType) {
+	switch (textureType) {
+	case MOJODDS_TEXTURE_2D:
+		return "2D";
+	case MOJODDS_TEXTURE_CUBE:
+		return "cube";
+	case MOJODDS_TEXTURE_VOLUME:
+		return "volume";
+	}
+	return "unknown";
+}
+
+
+static bool isDDSFilename(const char *path) {
+	size_t len = strlen(path);
+	return (len >= 4) && (strcasecmp(path + len - 4, ".dds") == 0);
+}
+
+
+static void addPath(Scanner *scanner, const char *path) {
+	char **paths = realloc(scanner->paths, (scanner->numPaths + 1) * sizeof (char *));
+	char *copy = strdup(path);
+	if (!paths || !copy) {
+		free(copy);
+		return;
+	}
+	scanner->paths = paths;
+	scanner->paths[scanner->numPaths++] = copy;
+}
+
+
+// files named on the command line are always scanned, files found in
+// directories only if they end in .dds
+static void walk(Scanner *scanner, const char *path, bool named) {
+	struct stat statbuf;
+	if ((named ? stat(path, &statbuf) : lstat(path, &statbuf)) != 0) {
+		if (named) {
+			addPath(scanner, path);  // so the error shows up in the output
+		}
+		return;
+	}
+
+	if (!S_ISDIR(statbuf.st_mode)) {
+		if (named || isDDSFilename(path)) {
+			addPath(scanner, path);
+		}
+		return;
+	}
+
+	DIR *dir = opendir(path);
+	if (!dir) {
+		return;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		if ((strcmp(ent->d_name, ".") == 0) || (strcmp(ent->d_name, "..") == 0)) {
+			continue;
+		}
+
+		char *child = NULL;
+		if (asprintf(&child, "%s/%s", path, ent->d_name) < 0) {
+			continue;
+		}
+		walk(scanner, child, false);
+		free(child);
+	}
+
+	closedir(dir);
+}
+
+
+static void countFormat(ScanStats *stats, unsigned int glfmt, uint64_t count) {
+	for (unsigned int i = 0; i < stats->numFormats; i++) {
+		if (stats->formats[i].glfmt == glfmt) {
+			stats->formats[i].count += count;
+			return;
+		}
+	}
+
+	if (stats->numFormats < MAX_FORMATS) {
+		stats->formats[stats->numFormats].glfmt = glfmt;
+		stats->formats[stats->numFormats].count = count;
+		stats->numFormats++;
+	}
+}
+
+
+static void printFailure(Buffer *out, const ScanOptions *options, const char *path, const char *status, const char *reason) {
+	if (options->csv) {
+		bufString(out, path, true);
+		bufPrintf(out, ",%s,", status);
+		bufString(out, reason, true);
+		bufPrintf(out, options->mips ? ",,,,,,,,,,,\n" : ",,,,,,,,,,\n");
+	} else {
+		bufPrintf(out, "{\"path\":");
+		bufString(out, path, false);
+		bufPrintf(out, ",\"status\":\"%s\",\"reason\":", status);
+		bufString(out, reason, false);
+		bufPrintf(out, "}\n");
+	}
+}
+
+
+static void printLayout(Buffer *out, const ScanOptions *options, const char *path, const MOJODDS_Layout *layout, bool npot) {
+	if (options->csv) {
+		bufString(out, path, true);
+		bufPrintf(out, ",ok,,0x%04x,%s,%u,%u,%u,%u,%u,%u,%lu,%d",
+		          layout->glfmt, typeName(layout->textureType), layout->w, layout->h, layout->depth,
+		          layout->miplevels, layout->arraySize, layout->faces, layout->texlen, npot ? 1 : 0);
+		if (options->mips) {
+			bufPrintf(out, ",");
+			for (unsigned int i = 0; i < layout->miplevels; i++) {
+				const MOJODDS_MipLevel *mip = &layout->mips[i];
+				bufPrintf(out, "%s%ux%ux%u@%lu+%lu", i ? ";" : "", mip->w, mip->h, mip->d, layout->dataoffset + mip->offset, mip->len);
+			}
+		}
+		bufPrintf(out, "\n");
+		return;
+	}
+
+	bufPrintf(out, "{\"path\":");
+	bufString(out, path, false);
+	bufPrintf(out, ",\"status\":\"ok\",\"glfmt\":\"0x%04x\",\"type\":\"%s\",\"width\":%u,\"height\":%u,\"depth\":%u,"
+	               "\"miplevels\":%u,\"arraySize\":%u,\"faces\":%u,\"bytes\":%lu,\"npot\":%s",
+	          layout->glfmt, typeName(layout->textureType), layout->w, layout->h, layout->depth,
+	          layout->miplevels, layout->arraySize, layout->faces, layout->texlen, npot ? "true" : "false");
+	if (options->mips) {
+		// offsets are for the first face; the rest follow every facelen bytes
+		bufPrintf(out, ",\"facelen\":%lu,\"mips\":[", layout->facelen);
+		for (unsigned int i = 0; i < layout->miplevels; i++) {
+			const MOJODDS_MipLevel *mip = &layout->mips[i];
+			bufPrintf(out, "%s{\"w\":%u,\"h\":%u,\"d\":%u,\"offset\":%lu,\"len\":%lu}", i ? "," : "",
+			          mip->w, mip->h, mip->d, layout->dataoffset + mip->offset, mip->len);
+		}
+		bufPrintf(out, "]");
+	}
+	bufPrintf(out, "}\n");
+}
+
+
+// headers only: all MOJODDS_validate needs to check the rest is the file size
+static MOJODDS_error scanHeader(const char *path, MOJODDS_Layout *layout, int *_errno) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		*_errno = errno;
+		return MOJODDS_ERR_NONE;
+	}
+
+	struct stat statbuf;
+	unsigned char header[MOJODDS_HEADER_MAXLEN];
+	ssize_t len = -1;
+	if (fstat(fd, &statbuf) == 0) {
+		len = pread(fd, header, sizeof (header), 0);
+	}
+	*_errno = (len < 0) ? errno : 0;
+	close(fd);
+
+	if (len < 0) {
+		return MOJODDS_ERR_NONE;
+	}
+	return MOJODDS_validate(header, (unsigned long) len, (unsigned long) statbuf.st_size, layout);
+}
+
+
+// mip details: map the whole file so the layout is checked against real data
+static MOJODDS_error scanMapped(const char *path, MOJODDS_Layout *layout, int *_errno) {
+	MOJODDS_File *file = MOJODDS_openFile(path);
+	if (!file) {
+		*_errno = errno;
+		return MOJODDS_ERR_NONE;
+	}
+	*_errno = 0;
+
+	unsigned long len = 0;
+	const void *data = MOJODDS_getFileData(file, &len);
+	MOJODDS_error err = MOJODDS_validate(data, len, len, layout);
+	MOJODDS_close(file);
+	return err;
+}
+
+
+static void scanFile(Scanner *scanner, const char *path, Buffer *out, ScanStats *stats) {
+	const ScanOptions *options = scanner->options;
+	MOJODDS_Layout layout;
+	int err = 0;
+	MOJODDS_error ddserr = options->mips ? scanMapped(path, &layout, &err) : scanHeader(path, &layout, &err);
+
+	stats->files++;
+	if (err != 0) {
+		stats->unreadable++;
+		printFailure(out, options, path, "error", strerror(err));
+	} else if (ddserr != MOJODDS_ERR_NONE) {
+		stats->rejected[ddserr]++;
+		printFailure(out, options, path, "rejected", MOJODDS_errorString(ddserr));
+	} else {
+		bool npot = !isPow2(layout.w) || !isPow2(layout.h) || !isPow2(layout.depth);
+		stats->ok++;
+		stats->npot += npot ? 1 : 0;
+		stats->gpuBytes += layout.texlen;
+		countFormat(stats, layout.glfmt, 1);
+		printLayout(out, options, path, &layout, npot);
+	}
+}
+
+
+static void mergeStats(ScanStats *total, const ScanStats *stats) {
+	total->files += stats->files;
+	total->ok += stats->ok;
+	total->unreadable += stats->unreadable;
+	total->npot += stats->npot;
+	total->gpuBytes += stats->gpuBytes;
+	for (unsigned int i = 0; i < NUM_ERRORS; i++) {
+		total->rejected[i] += stats->rejected[i];
+	}
+	for (unsigned int i = 0; i < stats->numFormats; i++) {
+		countFormat(total, stats->formats[i].glfmt, stats->formats[i].count);
+	}
+}
+
+
+static void *scanThread(void *data) {
+	Scanner *scanner = (Scanner *) data;
+	ScanStats stats;
+	Buffer out = { NULL, 0, 0 };
+	memset(&stats, 0, sizeof (stats));
+
+	for (;;) {
+		pthread_mutex_lock(&scanner->lock);
+		// write out what we have in between files, in one piece per line
+		if (out.len) {
+			fwrite(out.data, 1, out.len, stdout);
+			out.len = 0;
+		}
+		if (scanner->nextPath == scanner->numPaths) {
+			mergeStats(&scanner->stats, &stats);
+			pthread_mutex_unlock(&scanner->lock);
+			break;
+		}
+		const char *path = scanner->paths[scanner->nextPath++];
+		pthread_mutex_unlock(&scanner->lock);
+
+		scanFile(scanner, path, &out, &stats);
+	}
+
+	free(out.data);
+	return NULL;
+}
+
+
+static void printStats(const ScanStats *stats, double seconds, unsigned int threads) {
+	fprintf(stderr, "scanned %llu files in %.3f seconds (%.1f files/sec), %u threads\n",
+	        (unsigned long long) stats->files, seconds, (seconds > 0.0) ? (stats->files / seconds) : 0.0, threads);
+	fprintf(stderr, "ok: %llu\n", (unsigned long long) stats->ok);
+	fprintf(stderr, "unreadable: %llu\n", (unsigned long long) stats->unreadable);
+	uint64_t rejected = 0;
+	for (unsigned int i = 0; i < NUM_ERRORS; i++) {
+		rejected += stats->rejected[i];
+	}
+	fprintf(stderr, "rejected: %llu\n", (unsigned long long) rejected);
+	for (unsigned int i = 0; i < NUM_ERRORS; i++) {
+		if (stats->rejected[i]) {
+			fprintf(stderr, "    %s: %llu\n", MOJODDS_errorString((MOJODDS_error) i), (unsigned long long) stats->rejected[i]);
+		}
+	}
+	fprintf(stderr, "NPOT: %llu\n", (unsigned long long) stats->npot);
+	fprintf(stderr, "GPU bytes: %llu\n", (unsigned long long) stats->gpuBytes);
+	fprintf(stderr, "formats:\n");
+	for (unsigned int i = 0; i < stats->numFormats; i++) {
+		fprintf(stderr, "    0x%04x: %llu\n", stats->formats[i].glfmt, (unsigned long long) stats->formats[i].count);
+	}
+}
+
+
+static int scan(const ScanOptions *options, int argc, char *argv[]) {
+	Scanner scanner;
+	memset(&scanner, 0, sizeof (scanner));
+	scanner.options = options;
+	pthread_mutex_init(&scanner.lock, NULL);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < argc; i++) {
+		walk(&scanner, argv[i], true);
+	}
+
+	if (options->csv) {
+		printf("path,status,reason,glfmt,type,width,height,depth,miplevels,arraySize,faces,bytes,npot%s\n", options->mips ? ",mips" : "");
+	}
+
+	unsigned int threads = options->threads;
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? (unsigned int) cpus : 1;
+	}
+
+	// the main thread is one of the workers
+	pthread_t *workers = calloc(threads, sizeof (pthread_t));
+	unsigned int started = 0;
+	while (workers && (started < threads - 1)) {
+		if (pthread_create(&workers[started], NULL, scanThread, &scanner) != 0) {
+			break;
+		}
+		started++;
+	}
+	scanThread(&scanner);
+	for (unsigned int i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+	printStats(&scanner.stats, seconds, started + 1);
+
+	for (size_t i = 0; i < scanner.numPaths; i++) {
+		free(scanner.paths[i]);
+	}
+	free(scanner.paths);
+	pthread_mutex_destroy(&scanner.lock);
+
+	return ((scanner.stats.ok == scanner.stats.files) ? 0 : 1);
+}
+
+
 int main(int argc, char *argv[]) {
 	if (argc < 2) {
 		printf("Usage: %s DDS-file ...\n", argv[0]);
+		printf("       %s --scan [--csv] [--mips] [--threads=N] file-or-dir ...\n", argv[0]);
 		return 0;
 	}
 
+	if (strcmp(argv[1], "--scan") == 0) {
+		ScanOptions options;
+		memset(&options, 0, sizeof (options));
+		int i;
+		for (i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "--csv") == 0) {
+				options.csv = true;
+			} else if (strcmp(argv[i], "--json") == 0) {
+				options.csv = false;
+			} else if (strcmp(argv[i], "--mips") == 0) {
+				options.mips = true;
+			} else if (strncmp(argv[i], "--threads=", 10) == 0) {
+				options.threads = (unsigned int) strtoul(argv[i] + 10, NULL, 10);
+			} else if (strcmp(argv[i], "--") == 0) {
+				i++;
+				break;
+			} else {
+				break;
+			}
+		}
+		return scan(&options, argc - i, argv + i);
+	}
+
 	for (int i = 1; i < argc; i++) {
 		ddsinfo(argv[i]);
 	}
@@ -0,0 +1,285 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "mojodds.h"
+
+
+// builds a texture pack out of DDS files, or lists what's in one, as JSON
+// on stdout
+
+
+typedef struct Output {
+	FILE *io;
+	unsigned long long len;
+} Output;
+
+
+static double seconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double) count.QuadPart / (double) freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+#endif
+}
+
+
+static int writeFile(void *userdata, const void *data, unsigned long len) {
+	Output *out = (Output *) userdata;
+	if (fwrite(data, 1, len, out->io) != len) {
+		return 0;
+	}
+	out->len += len;
+	return 1;
+}
+
+
+static void printJsonString(const char *str) {
+	putchar('"');
+	for (const unsigned char *ptr = (const unsigned char *) str; *ptr; ptr++) {
+		if ((*ptr == '"') || (*ptr == '\\')) {
+			printf("\\%c", *ptr);
+		} else if (*ptr < 0x20) {
+			printf("\\u%04x", *ptr);
+		} else {
+			putchar(*ptr);
+		}
+	}
+	putchar('"');
+}
+
+
+static void closeFiles(MOJODDS_File **files, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		if (files[i]) {
+			MOJODDS_close(files[i]);
+		}
+	}
+	free(files);
+}
+
+
+static void printEntry(const MOJODDS_Pack *pack, unsigned int index, bool verify, bool last) {
+	MOJODDS_PackEntry entry;
+	MOJODDS_getPackEntry(pack, index, &entry);
+
+	printf("{\"name\": ");
+	printJsonString(entry.name);
+	printf(", \"len\": %lu, \"hash\": \"%016llx\", \"glfmt\": \"0x%04x\", \"type\": %d, \"width\": %u, \"height\": %u, \"depth\": %u, \"miplevels\": %u, \"faces\": %u",
+	       entry.len, entry.hash, entry.layout.glfmt, (int) entry.layout.textureType,
+	       entry.layout.w, entry.layout.h, entry.layout.depth, entry.layout.miplevels, entry.layout.faces);
+	if (verify) {
+		printf(", \"ok\": %s", MOJODDS_checkPackEntry(pack, index) ? "true" : "false");
+	}
+	printf("}%s\n", last ? "" : ",");
+}
+
+
+static int listPack(const char *path, char **names, unsigned int numNames, bool verify) {
+	double start = seconds();
+	MOJODDS_Pack *pack = MOJODDS_openPack(path);
+	double openTime = seconds() - start;
+	if (!pack) {
+		fprintf(stderr, "Error opening %s: not a readable pack\n", path);
+		return 3;
+	}
+
+	unsigned int count = MOJODDS_getPackCount(pack);
+	int retval = 0;
+
+	printf("{\n\"pack\": ");
+	printJsonString(path);
+	printf(",\n\"count\": %u,\n\"alignment\": %u,\n\"open_ms\": %.3f,\n\"entries\": [\n",
+	       count, MOJODDS_getPackAlignment(pack), openTime * 1000.0);
+
+	if (numNames == 0) {
+		for (unsigned int i = 0; i < count; i++) {
+			printEntry(pack, i, verify, i + 1 == count);
+		}
+	} else {
+		unsigned int *found = calloc(numNames, sizeof (unsigned int));
+		unsigned int numFound = 0;
+		if (found == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			MOJODDS_closePack(pack);
+			return 2;
+		}
+
+		for (unsigned int i = 0; i < numNames; i++) {
+			if (MOJODDS_findPackEntry(pack, names[i], &found[numFound])) {
+				numFound++;
+			} else {
+				fprintf(stderr, "%s: no entry named %s\n", path, names[i]);
+				retval = 4;
+			}
+		}
+
+		for (unsigned int i = 0; i < numFound; i++) {
+			printEntry(pack, found[i], verify, i + 1 == numFound);
+		}
+		free(found);
+	}
+
+	printf("]\n}\n");
+	MOJODDS_closePack(pack);
+	return retval;
+}
+
+
+static void usage(const char *argv0) {
+	printf("Usage: %s [--align N] -o out.pack DDS-file ...\n", argv0);
+	printf("       %s --list [--verify] in.pack [name ...]\n", argv0);
+	printf("Entries are named by the paths as given. Each file's pixel data starts\n");
+	printf("on a multiple of --align bytes (4096 by default). --list prints every\n");
+	printf("entry, or looks up the named ones; --verify checks their hashes.\n");
+}
+
+
+int main(int argc, char *argv[]) {
+	const char *outPath = NULL;
+	unsigned int alignment = 4096;
+	bool list = false;
+	bool verify = false;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+			outPath = argv[++i];
+		} else if ((strcmp(argv[i], "--align") == 0) && (i + 1 < argc)) {
+			alignment = (unsigned int) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--list") == 0) {
+			list = true;
+		} else if (strcmp(argv[i], "--verify") == 0) {
+			verify = true;
+		} else if (strcmp(argv[i], "--help") == 0) {
+			usage(argv[0]);
+			return 0;
+		} else {
+			break;
+		}
+	}
+
+	unsigned int count = (unsigned int) (argc - i);
+	if (list) {
+		if (count == 0) {
+			usage(argv[0]);
+			return 1;
+		}
+		return listPack(argv[i], &argv[i + 1], count - 1, verify);
+	} else if ((outPath == NULL) || (count == 0)) {
+		usage(argv[0]);
+		return 1;
+	} else if ((alignment == 0) || ((alignment & (alignment - 1)) != 0)) {
+		fprintf(stderr, "--align must be a power of two\n");
+		return 1;
+	}
+
+	MOJODDS_File **files = calloc(count, sizeof (MOJODDS_File *));
+	MOJODDS_PackInput *inputs = calloc(count, sizeof (MOJODDS_PackInput));
+	if ((files == NULL) || (inputs == NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		return 2;
+	}
+
+	unsigned long long inputBytes = 0;
+	for (unsigned int n = 0; n < count; n++) {
+		MOJODDS_PackInput *input = &inputs[n];
+		input->name = argv[i + n];
+		files[n] = MOJODDS_openFile(input->name);
+		if (!files[n]) {
+			fprintf(stderr, "Error opening %s: %s (%d)\n", input->name, strerror(errno), errno);
+			closeFiles(files, count);
+			free(inputs);
+			return 3;
+		}
+
+		input->data = MOJODDS_getFileData(files[n], &input->len);
+		MOJODDS_Layout layout;
+		MOJODDS_error err = MOJODDS_validate(input->data, input->len, input->len, &layout);
+		if (err != MOJODDS_ERR_NONE) {
+			fprintf(stderr, "%s: %s\n", input->name, MOJODDS_errorString(err));
+			closeFiles(files, count);
+			free(inputs);
+			return 3;
+		}
+		inputBytes += input->len;
+	}
+
+	Output out = { fopen(outPath, "wb"), 0 };
+	if (!out.io) {
+		fprintf(stderr, "Error creating %s: %s (%d)\n", outPath, strerror(errno), errno);
+		closeFiles(files, count);
+		free(inputs);
+		return 7;
+	}
+
+	double start = seconds();
+	int written = MOJODDS_writePack(inputs, count, alignment, writeFile, &out);
+	written = (fclose(out.io) == 0) && written;
+	double buildTime = seconds() - start;
+	closeFiles(files, count);
+	free(inputs);
+	if (!written) {
+		// the only thing validate() doesn't catch up front
+		fprintf(stderr, "Error writing %s (are two inputs named the same?)\n", outPath);
+		remove(outPath);
+		return 7;
+	}
+
+	// read it back, which checks it and tells us what sharing saved
+	MOJODDS_Pack *pack = MOJODDS_openPack(outPath);
+	if (!pack) {
+		fprintf(stderr, "Error reading back %s\n", outPath);
+		return 8;
+	}
+
+	unsigned long long storedBytes = 0, packBytes = out.len;
+	unsigned int unique = 0, aligned = 0;
+	const unsigned char *lastData = NULL;
+	for (unsigned int n = 0; n < count; n++) {
+		MOJODDS_PackEntry entry;
+		MOJODDS_getPackEntry(pack, n, &entry);
+		// the data is stored in name order, and a shared copy is stored with
+		// the first name that has it, so anything not past the last one is
+		// shared
+		if ((const unsigned char *) entry.data > lastData) {
+			unique++;
+			storedBytes += entry.len;
+			lastData = (const unsigned char *) entry.data;
+			if (((uintptr_t) entry.layout.tex % alignment) == 0) {
+				aligned++;
+			}
+		}
+	}
+	MOJODDS_closePack(pack);
+
+	printf("{\n\"pack\": ");
+	printJsonString(outPath);
+	printf(",\n\"entries\": %u,\n\"unique\": %u,\n\"aligned\": %u,\n\"alignment\": %u,\n", count, unique, aligned, alignment);
+	printf("\"input_bytes\": %llu,\n\"stored_bytes\": %llu,\n\"pack_bytes\": %llu,\n\"build_ms\": %.3f\n}\n",
+	       inputBytes, storedBytes, packBytes, buildTime * 1000.0);
+	return 0;
+}
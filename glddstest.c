@@ -56,32 +56,128 @@ static void pumpGLErrors(const char *format, ...) {
 }
 
 
+// array layers are stored element by element, each with its whole mip
+// chain, so allocate every level first and then fill it all in one pass
+static void uploadArray(GLuint texId, const MOJODDS_Layout *layout, bool isCompressed, GLenum internalFormat, GLenum glformat, GLenum gltype) {
+	const bool isCube = (layout->textureType == MOJODDS_TEXTURE_CUBE);
+	const GLenum target = isCube ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_2D_ARRAY;
+	const unsigned int facesPerElement = layout->faces / layout->arraySize;
+
+	glBindTexture(target, texId);
+
+	for (unsigned int miplevel = 0; miplevel < layout->miplevels; miplevel++) {
+		const MOJODDS_MipLevel *mip = &layout->mips[miplevel];
+		if (isCompressed) {
+			glCompressedTexImage3D(target, miplevel, layout->glfmt, mip->w, mip->h, layout->faces, 0, mip->len * layout->faces, NULL);
+			pumpGLErrors("glCompressedTexImage3D %u 0x%04x %ux%ux%u", miplevel, layout->glfmt, mip->w, mip->h, layout->faces);
+		} else {
+			glTexImage3D(target, miplevel, internalFormat, mip->w, mip->h, layout->faces, 0, glformat, gltype, NULL);
+			pumpGLErrors("glTexImage3D %u 0x%04x %ux%ux%u 0x%04x", miplevel, internalFormat, mip->w, mip->h, layout->faces, glformat);
+		}
+	}
+
+	for (unsigned int element = 0; element < layout->arraySize; element++) {
+		for (unsigned int face = 0; face < facesPerElement; face++) {
+			const unsigned int layer = element * facesPerElement + face;
+			for (unsigned int miplevel = 0; miplevel < layout->miplevels; miplevel++) {
+				const void *miptex = NULL;
+				unsigned long miptexlen = 0;
+				unsigned int mipW = 0, mipH = 0;
+				if (!MOJODDS_getArraySubresource(layout, element, face, miplevel, &miptex, &miptexlen, &mipW, &mipH)) {
+					printf("MOJODDS_getArraySubresource(%u, %u, %u) failed\n", element, face, miplevel);
+					continue;
+				}
+
+				if (isCompressed) {
+					glCompressedTexSubImage3D(target, miplevel, 0, 0, layer, mipW, mipH, 1, layout->glfmt, miptexlen, miptex);
+					pumpGLErrors("glCompressedTexSubImage3D %u %u %ux%u 0x%04x %lu", miplevel, layer, mipW, mipH, layout->glfmt, miptexlen);
+				} else {
+					glTexSubImage3D(target, miplevel, 0, 0, layer, mipW, mipH, 1, glformat, gltype, miptex);
+					pumpGLErrors("glTexSubImage3D %u %u %ux%u 0x%04x", miplevel, layer, mipW, mipH, glformat);
+				}
+			}
+		}
+	}
+
+	glBindTexture(target, 0);
+}
+
+
+// GL has no packed format for some legacy RGB masks. Unpack those to RGBA8
+// and point the layout at the copy; with one byte per channel it's the same
+// shape, just 4 / blockSize times bigger.
+static unsigned char *unpackMasked(MOJODDS_Layout *layout) {
+	const unsigned int bytes = layout->blockSize;
+	unsigned char *rgba = malloc(layout->texlen / bytes * 4);
+	if (rgba == NULL) {
+		return NULL;
+	}
+
+	for (unsigned int face = 0; face < layout->faces; face++) {
+		for (unsigned int miplevel = 0; miplevel < layout->miplevels; miplevel++) {
+			const MOJODDS_MipLevel *mip = &layout->mips[miplevel];
+			unsigned long offset = face * layout->facelen + mip->offset;
+			// volume slices are back to back, so they unpack as extra rows.
+			MOJODDS_unpackMasked(layout->bitCount, layout->masks, (const unsigned char *) layout->tex + offset, mip->len,
+			                     mip->w, mip->h * mip->d, rgba + offset / bytes * 4, mip->w * 4, NULL);
+		}
+	}
+
+	for (unsigned int miplevel = 0; miplevel < layout->miplevels; miplevel++) {
+		layout->mips[miplevel].offset = layout->mips[miplevel].offset / bytes * 4;
+		layout->mips[miplevel].len = layout->mips[miplevel].len / bytes * 4;
+		layout->mips[miplevel].slicelen = layout->mips[miplevel].slicelen / bytes * 4;
+	}
+	layout->tex = rgba;
+	layout->texlen = layout->texlen / bytes * 4;
+	layout->facelen = layout->facelen / bytes * 4;
+	layout->glfmt = GL_RGBA8;
+	layout->blockSize = 4;
+	return rgba;
+}
+
+
+// Nor is there one for A4L4, so widen it to L8A8 the same way.
+static unsigned char *expandA4L4(MOJODDS_Layout *layout) {
+	const unsigned char *src = (const unsigned char *) layout->tex;
+	unsigned char *la = malloc(layout->texlen * 2);
+	if (la == NULL) {
+		return NULL;
+	}
+
+	for (unsigned long i = 0; i < layout->texlen; i++) {
+		la[i * 2] = (src[i] & 0x0F) * 17;
+		la[(i * 2) + 1] = (src[i] >> 4) * 17;
+	}
+
+	for (unsigned int miplevel = 0; miplevel < layout->miplevels; miplevel++) {
+		layout->mips[miplevel].offset *= 2;
+		layout->mips[miplevel].len *= 2;
+		layout->mips[miplevel].slicelen *= 2;
+	}
+	layout->tex = la;
+	layout->texlen *= 2;
+	layout->facelen *= 2;
+	layout->glfmt = GL_LUMINANCE_ALPHA;
+	layout->blockSize = 2;
+	return la;
+}
+
+
 static int glddstest(const char *filename) {
 	printf("%s\n", filename);
 	if (GLEW_GREMEDY_string_marker) {
 		glStringMarkerGREMEDY(0, filename);
 	}
 
-	FILE *f = fopen(filename, "rb");
-	if (!f) {
+	MOJODDS_File *file = MOJODDS_openFile(filename);
+	if (!file) {
 		printf("Error opening %s: %s (%d)\n", filename, strerror(errno), errno);
 		return 1;
 	}
 
-	fseek(f, 0, SEEK_END);
-	long size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-
-	char *contents = malloc(size);
-	size_t readbytes = fread(contents, 1, size, f);
-	if (readbytes != size) {
-		printf("Only got %u of %ld bytes: %s\n", (unsigned int) readbytes, size, strerror(errno));
-		free(contents);
-		fclose(f);
-		return 2;
-	}
-
-	fclose(f);
+	unsigned long size = 0;
+	const char *contents = MOJODDS_getFileData(file, &size);
 
 	int isDDS = MOJODDS_isDDS(contents, size);
 	printf("isDDS: %d\n", isDDS);
@@ -94,32 +190,70 @@ static int glddstest(const char *filename) {
 		int retval = MOJODDS_getTexture(contents, size, &tex, &texlen, &glfmt, &w, &h, &miplevels, &cubemapfacelen, &textureType);
 		if (!retval) {
 			printf("MOJODDS_getTexture failed\n");
-			free(contents);
+			MOJODDS_close(file);
 			return 3;
 		}
 
+		// same parse as MOJODDS_getTexture, so it can't fail now.
+		MOJODDS_Layout layout;
+		MOJODDS_getLayout(contents, size, &layout);
+
 		GLint maxTexSize = 0;
 		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize);
 		if (w > maxTexSize || h > maxTexSize) {
 			printf("Texture too large: %ux%u vs %d\n", w, h, maxTexSize);
+			MOJODDS_close(file);
 			return 4;
 		}
 
-		bool isCompressed = true;
-		GLenum internalFormat = glfmt;
-		if (glfmt == GL_BGRA || glfmt == GL_BGR || glfmt == GL_LUMINANCE_ALPHA) {
-			isCompressed = false;
-			if (glfmt == GL_BGR) {
-				internalFormat = GL_RGB8;
-			} else {
-				internalFormat = GL_RGBA8;
+		unsigned int blockDim = 0, glinternal = 0, glformat = 0, gltype = 0;
+		if (!MOJODDS_getFormatInfo(glfmt, &blockDim, NULL, &glinternal, &glformat, &gltype)) {
+			printf("MOJODDS_getFormatInfo(0x%04x) failed\n", glfmt);
+			MOJODDS_close(file);
+			return 5;
+		}
+
+		unsigned char *unpacked = NULL;
+		if (glfmt == GL_LUMINANCE4_ALPHA4) {
+			printf("A4L4, expanding to L8A8\n");
+			unpacked = expandA4L4(&layout);
+			if (unpacked == NULL) {
+				printf("Out of memory expanding %s\n", filename);
+				MOJODDS_close(file);
+				return 6;
 			}
+			tex = layout.tex;
+			glfmt = layout.glfmt;
+			cubemapfacelen = layout.facelen;
+			MOJODDS_getFormatInfo(glfmt, NULL, NULL, &glinternal, &glformat, &gltype);
+		} else if ((blockDim == 1) && (gltype == 0)) {
+			printf("masks %08x %08x %08x %08x, unpacking to RGBA8\n", layout.masks[0], layout.masks[1], layout.masks[2], layout.masks[3]);
+			unpacked = unpackMasked(&layout);
+			if (unpacked == NULL) {
+				printf("Out of memory unpacking %s\n", filename);
+				MOJODDS_close(file);
+				return 6;
+			}
+			tex = layout.tex;
+			glfmt = layout.glfmt;
+			cubemapfacelen = layout.facelen;
+			MOJODDS_getFormatInfo(glfmt, NULL, NULL, &glinternal, &glformat, &gltype);
 		}
 
+		bool isCompressed = (gltype == 0);
+		GLenum internalFormat = glinternal;
+
 		GLuint texId = 0;
 		// we leak this but don't care
 		glGenTextures(1, &texId);
 
+		if (layout.arraySize > 1) {
+			uploadArray(texId, &layout, isCompressed, internalFormat, glformat, gltype);
+			free(unpacked);
+			MOJODDS_close(file);
+			return 0;
+		}
+
 		switch (textureType) {
 		case MOJODDS_TEXTURE_2D:
 		glBindTexture(GL_TEXTURE_2D, texId);
@@ -138,8 +272,8 @@ static int glddstest(const char *filename) {
 				glCompressedTexImage2D(GL_TEXTURE_2D, miplevel, glfmt, mipW, mipH, 0, miptexlen, miptex);
 				pumpGLErrors("glCompressedTexImage2D %u 0x%04x %ux%u %u", miplevel, glfmt, mipW, mipH, miptexlen);
 			} else {
-				glTexImage2D(GL_TEXTURE_2D, miplevel, internalFormat, mipW, mipH, 0, glfmt, GL_UNSIGNED_BYTE, miptex);
-				pumpGLErrors("glTexImage2D %u 0x%04x %ux%u 0x%04x", miplevel, internalFormat, mipW, mipH, glfmt);
+				glTexImage2D(GL_TEXTURE_2D, miplevel, internalFormat, mipW, mipH, 0, glformat, gltype, miptex);
+				pumpGLErrors("glTexImage2D %u 0x%04x %ux%u 0x%04x", miplevel, internalFormat, mipW, mipH, glformat);
 			}
 		}
 
@@ -164,7 +298,7 @@ static int glddstest(const char *filename) {
 					glCompressedTexSubImage2D(GL_TEXTURE_2D, miplevel, 0, 0, mipW, mipH, glfmt, miptexlen, miptex);
 					pumpGLErrors("glCompressedTexSubImage2D %u %ux%u 0x%04x %u", miplevel, mipW, mipH, glfmt, miptexlen);
 				} else {
-					glTexSubImage2D(GL_TEXTURE_2D, miplevel, 0, 0, mipW, mipH, glfmt, GL_UNSIGNED_BYTE, miptex);
+					glTexSubImage2D(GL_TEXTURE_2D, miplevel, 0, 0, mipW, mipH, glformat, gltype, miptex);
 					pumpGLErrors("glTexSubImage2D %u %ux%u 0x%04x", miplevel, mipW, mipH, glfmt);
 				}
 			}
@@ -190,8 +324,8 @@ static int glddstest(const char *filename) {
 						glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeFace, miplevel, glfmt, mipW, mipH, 0, miptexlen, miptex);
 						pumpGLErrors("glCompressedTexImage2D %u 0x%04x %ux%u %u", miplevel, glfmt, mipW, mipH, miptexlen);
 					} else {
-						glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeFace, miplevel, internalFormat, mipW, mipH, 0, glfmt, GL_UNSIGNED_BYTE, miptex);
-						pumpGLErrors("glTexImage2D %u 0x%04x %ux%u 0x%04x", miplevel, internalFormat, mipW, mipH, glfmt);
+						glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeFace, miplevel, internalFormat, mipW, mipH, 0, glformat, gltype, miptex);
+						pumpGLErrors("glTexImage2D %u 0x%04x %ux%u 0x%04x", miplevel, internalFormat, mipW, mipH, glformat);
 					}
 				}
 			}
@@ -218,7 +352,7 @@ static int glddstest(const char *filename) {
 							glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeFace, miplevel, 0, 0, mipW, mipH, glfmt, miptexlen, miptex);
 							pumpGLErrors("glCompressedTexSubImage2D %u %ux%u 0x%04x %u", miplevel, mipW, mipH, glfmt, miptexlen);
 						} else {
-							glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeFace, miplevel, 0, 0, mipW, mipH, glfmt, GL_UNSIGNED_BYTE, miptex);
+							glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeFace, miplevel, 0, 0, mipW, mipH, glformat, gltype, miptex);
 							pumpGLErrors("glTexSubImage2D %u %ux%u 0x%04x", miplevel, mipW, mipH, glfmt);
 						}
 					}
@@ -228,13 +362,38 @@ static int glddstest(const char *filename) {
 			break;
 
 		case MOJODDS_TEXTURE_VOLUME:
-			// TODO: do something with the data
+			// levels hold their slices back to back, so each one goes up
+			//  straight from the file data.
+			glBindTexture(GL_TEXTURE_3D, texId);
+
+			for (unsigned int miplevel = 0; miplevel < layout.miplevels; miplevel++) {
+				const void *miptex = NULL;
+				unsigned long miptexlen = 0;
+				unsigned int mipW = 0, mipH = 0;
+				retval = MOJODDS_getSubresource(&layout, 0, miplevel, &miptex, &miptexlen, &mipW, &mipH);
+				if (!retval) {
+					printf("MOJODDS_getSubresource(0, %u) error: %d\n", miplevel, retval);
+					continue;
+				}
+
+				unsigned int mipD = layout.mips[miplevel].d;
+				if (isCompressed) {
+					glCompressedTexImage3D(GL_TEXTURE_3D, miplevel, glfmt, mipW, mipH, mipD, 0, miptexlen, miptex);
+					pumpGLErrors("glCompressedTexImage3D %u 0x%04x %ux%ux%u %u", miplevel, glfmt, mipW, mipH, mipD, miptexlen);
+				} else {
+					glTexImage3D(GL_TEXTURE_3D, miplevel, internalFormat, mipW, mipH, mipD, 0, glformat, gltype, miptex);
+					pumpGLErrors("glTexImage3D %u 0x%04x %ux%ux%u 0x%04x", miplevel, internalFormat, mipW, mipH, mipD, glformat);
+				}
+			}
+			glBindTexture(GL_TEXTURE_3D, 0);
 			break;
 
 		}
+
+		free(unpacked);
 	}
 
-	free(contents);
+	MOJODDS_close(file);
 
 	return 0;
 }
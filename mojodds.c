@@ -11,22 +11,8 @@
 #include <stdlib.h>
 #include <assert.h>
 
-#ifdef _MSC_VER
-typedef unsigned __int8 uint8;
-typedef unsigned __int32 uint32;
-#else
-#include <stdint.h>
-typedef uint8_t uint8;
-typedef uint32_t uint32;
-#endif
-
-#ifndef UINT32_MAX
-#define UINT32_MAX 0xFFFFFFFF
-#endif
-
 #include "mojodds.h"
-
-#define STATICARRAYLEN(x) ( (sizeof ((x))) / (sizeof ((x)[0])) )
+#include "mojodds_internal.h"
 
 #define DDS_MAGIC 0x20534444  // 'DDS ' in littleendian.
 #define DDS_HEADERSIZE 124
@@ -65,15 +51,63 @@ typedef uint32_t uint32;
 #define FOURCC_DXT4 0x34545844
 #define FOURCC_DXT5 0x35545844
 #define FOURCC_DX10 0x30315844
-
-#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
-#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
-#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
-#define GL_BGR 0x80E0
-#define GL_BGRA 0x80E1
-#define GL_LUMINANCE_ALPHA 0x190A
-
-#define MAX( a, b ) ((a) > (b) ? (a) : (b))
+#define FOURCC_ATI1 0x31495441
+#define FOURCC_ATI2 0x32495441
+#define FOURCC_BC4U 0x55344342
+#define FOURCC_BC4S 0x53344342
+#define FOURCC_BC5U 0x55354342
+#define FOURCC_BC5S 0x53354342
+
+// Older writers put a D3DFORMAT number in the FourCC for these.
+#define D3DFMT_A16B16G16R16 36
+#define D3DFMT_R16F 111
+#define D3DFMT_G16R16F 112
+#define D3DFMT_A16B16G16R16F 113
+#define D3DFMT_R32F 114
+#define D3DFMT_G32R32F 115
+#define D3DFMT_A32B32G32R32F 116
+
+#define DDS_HEADERSIZE_DXT10 20
+#define DDS_DIMENSION_TEXTURE1D 2
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_DIMENSION_TEXTURE3D 4
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+#define DDS_ALPHA_MODE_MASK 0x7
+#define DDS_ALPHA_MODE_PREMULTIPLIED 0x2
+
+#define DXGI_FORMAT_R32G32B32A32_FLOAT 2
+#define DXGI_FORMAT_R16G16B16A16_FLOAT 10
+#define DXGI_FORMAT_R16G16B16A16_UNORM 11
+#define DXGI_FORMAT_R32G32_FLOAT 16
+#define DXGI_FORMAT_R10G10B10A2_UNORM 24
+#define DXGI_FORMAT_R11G11B10_FLOAT 26
+#define DXGI_FORMAT_R8G8B8A8_UNORM 28
+#define DXGI_FORMAT_R8G8B8A8_UNORM_SRGB 29
+#define DXGI_FORMAT_R16G16_FLOAT 34
+#define DXGI_FORMAT_R32_FLOAT 41
+#define DXGI_FORMAT_R8G8_UNORM 49
+#define DXGI_FORMAT_R16_FLOAT 54
+#define DXGI_FORMAT_R8_UNORM 61
+#define DXGI_FORMAT_A8_UNORM 65
+#define DXGI_FORMAT_BC1_UNORM 71
+#define DXGI_FORMAT_BC1_UNORM_SRGB 72
+#define DXGI_FORMAT_BC2_UNORM 74
+#define DXGI_FORMAT_BC2_UNORM_SRGB 75
+#define DXGI_FORMAT_BC3_UNORM 77
+#define DXGI_FORMAT_BC3_UNORM_SRGB 78
+#define DXGI_FORMAT_BC4_UNORM 80
+#define DXGI_FORMAT_BC4_SNORM 81
+#define DXGI_FORMAT_BC5_UNORM 83
+#define DXGI_FORMAT_BC5_SNORM 84
+#define DXGI_FORMAT_B5G6R5_UNORM 85
+#define DXGI_FORMAT_B5G5R5A1_UNORM 86
+#define DXGI_FORMAT_B8G8R8A8_UNORM 87
+#define DXGI_FORMAT_B8G8R8X8_UNORM 88
+#define DXGI_FORMAT_BC6H_UF16 95
+#define DXGI_FORMAT_BC6H_SF16 96
+#define DXGI_FORMAT_BC7_UNORM 98
+#define DXGI_FORMAT_BC7_UNORM_SRGB 99
+#define DXGI_FORMAT_B4G4R4A4_UNORM 115
 
 typedef struct
 {
@@ -105,6 +139,199 @@ typedef struct
     uint32 dwReserved2;
 } MOJODDS_Header;
 
+typedef struct
+{
+    uint32 dxgiFormat;
+    uint32 resourceDimension;
+    uint32 miscFlag;
+    uint32 arraySize;
+    uint32 miscFlags2;
+} MOJODDS_HeaderDXT10;
+
+typedef struct
+{
+    uint32 glfmt;  // what we report to the app; unique per entry.
+    uint32 dxgiFormat;  // zero if only legacy headers can name it.
+    uint32 blockDim;
+    uint32 blockSize;
+    uint32 glinternal;
+    uint32 glformat;  // zero if compressed.
+    uint32 gltype;  // zero if compressed.
+} MOJODDS_FormatInfo;
+
+// Everything we know how to lay out. Legacy FourCCs and pixel formats are
+//  mapped onto these entries by glfmt, DX10 headers by dxgiFormat.
+static const MOJODDS_FormatInfo FormatInfo[] =
+{
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, DXGI_FORMAT_BC1_UNORM, 4, 8, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, DXGI_FORMAT_BC1_UNORM_SRGB, 4, 8, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, DXGI_FORMAT_BC2_UNORM, 4, 16, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, DXGI_FORMAT_BC2_UNORM_SRGB, 4, 16, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, DXGI_FORMAT_BC3_UNORM, 4, 16, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, DXGI_FORMAT_BC3_UNORM_SRGB, 4, 16, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0 },
+    { GL_COMPRESSED_RED_RGTC1, DXGI_FORMAT_BC4_UNORM, 4, 8, GL_COMPRESSED_RED_RGTC1, 0, 0 },
+    { GL_COMPRESSED_SIGNED_RED_RGTC1, DXGI_FORMAT_BC4_SNORM, 4, 8, GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0 },
+    { GL_COMPRESSED_RG_RGTC2, DXGI_FORMAT_BC5_UNORM, 4, 16, GL_COMPRESSED_RG_RGTC2, 0, 0 },
+    { GL_COMPRESSED_SIGNED_RG_RGTC2, DXGI_FORMAT_BC5_SNORM, 4, 16, GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0 },
+    { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, DXGI_FORMAT_BC6H_UF16, 4, 16, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 0 },
+    { GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, DXGI_FORMAT_BC6H_SF16, 4, 16, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 0, 0 },
+    { GL_COMPRESSED_RGBA_BPTC_UNORM, DXGI_FORMAT_BC7_UNORM, 4, 16, GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0 },
+    { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, DXGI_FORMAT_BC7_UNORM_SRGB, 4, 16, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0 },
+    { GL_R8, DXGI_FORMAT_R8_UNORM, 1, 1, GL_R8, GL_RED, GL_UNSIGNED_BYTE },
+    { GL_RG8, DXGI_FORMAT_R8G8_UNORM, 1, 2, GL_RG8, GL_RG, GL_UNSIGNED_BYTE },
+    { GL_RGBA8, DXGI_FORMAT_R8G8B8A8_UNORM, 1, 4, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+    { GL_SRGB8_ALPHA8, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 1, 4, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE },
+    { GL_BGRA, DXGI_FORMAT_B8G8R8A8_UNORM, 1, 4, GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE },
+    { GL_BGR, 0, 1, 3, GL_RGB8, GL_BGR, GL_UNSIGNED_BYTE },
+    { GL_RGB8, DXGI_FORMAT_B8G8R8X8_UNORM, 1, 4, GL_RGB8, GL_BGRA, GL_UNSIGNED_BYTE },
+    { GL_RGB565, DXGI_FORMAT_B5G6R5_UNORM, 1, 2, GL_RGB565, GL_RGB, GL_UNSIGNED_SHORT_5_6_5 },
+    { GL_RGB5_A1, DXGI_FORMAT_B5G5R5A1_UNORM, 1, 2, GL_RGB5_A1, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV },
+    { GL_RGB5, 0, 1, 2, GL_RGB5, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV },
+    { GL_RGBA4, DXGI_FORMAT_B4G4R4A4_UNORM, 1, 2, GL_RGBA4, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4_REV },
+    { GL_RGB4, 0, 1, 2, GL_RGB4, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4_REV },
+    { GL_LUMINANCE8, 0, 1, 1, GL_LUMINANCE8, GL_LUMINANCE, GL_UNSIGNED_BYTE },
+    { GL_LUMINANCE16, 0, 1, 2, GL_LUMINANCE16, GL_LUMINANCE, GL_UNSIGNED_SHORT },
+    { GL_LUMINANCE4_ALPHA4, 0, 1, 1, GL_LUMINANCE4_ALPHA4, 0, 0 },  // no client format to upload it with.
+    { GL_LUMINANCE_ALPHA, 0, 1, 2, GL_LUMINANCE8_ALPHA8, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE },
+    { GL_ALPHA8, DXGI_FORMAT_A8_UNORM, 1, 1, GL_ALPHA8, GL_ALPHA, GL_UNSIGNED_BYTE },
+    { GL_RGB10_A2, DXGI_FORMAT_R10G10B10A2_UNORM, 1, 4, GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV },
+    { GL_RGBA16, DXGI_FORMAT_R16G16B16A16_UNORM, 1, 8, GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT },
+    { GL_R11F_G11F_B10F, DXGI_FORMAT_R11G11B10_FLOAT, 1, 4, GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV },
+    { GL_R16F, DXGI_FORMAT_R16_FLOAT, 1, 2, GL_R16F, GL_RED, GL_HALF_FLOAT },
+    { GL_RG16F, DXGI_FORMAT_R16G16_FLOAT, 1, 4, GL_RG16F, GL_RG, GL_HALF_FLOAT },
+    { GL_RGBA16F, DXGI_FORMAT_R16G16B16A16_FLOAT, 1, 8, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
+    { GL_R32F, DXGI_FORMAT_R32_FLOAT, 1, 4, GL_R32F, GL_RED, GL_FLOAT },
+    { GL_RG32F, DXGI_FORMAT_R32G32_FLOAT, 1, 8, GL_RG32F, GL_RG, GL_FLOAT },
+    { GL_RGBA32F, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, GL_RGBA32F, GL_RGBA, GL_FLOAT },
+    { MOJODDS_FORMAT_MASKED8, 0, 1, 1, 0, 0, 0 },
+    { MOJODDS_FORMAT_MASKED16, 0, 1, 2, 0, 0, 0 },
+    { MOJODDS_FORMAT_MASKED24, 0, 1, 3, 0, 0, 0 },
+    { MOJODDS_FORMAT_MASKED32, 0, 1, 4, 0, 0, 0 }
+};
+
+typedef struct
+{
+    uint32 glfmt;
+    uint32 bitCount;
+    uint32 masks[4];  // R, G, B, A; no alpha if zero.
+} MOJODDS_MaskedFormat;
+
+// Legacy DDPF_RGB layouts that map onto a FormatInfo entry. Anything else
+//  with sane masks gets one of the MOJODDS_FORMAT_MASKED* formats.
+static const MOJODDS_MaskedFormat MaskedFormats[] =
+{
+    { GL_BGRA, 32, { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 } },
+    { GL_RGB8, 32, { 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000 } },
+    { GL_RGBA8, 32, { 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 } },
+    { GL_RGB10_A2, 32, { 0x000003FF, 0x000FFC00, 0x3FF00000, 0xC0000000 } },
+    { GL_BGR, 24, { 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000 } },
+    { GL_RGB565, 16, { 0xF800, 0x07E0, 0x001F, 0x0000 } },
+    { GL_RGB5_A1, 16, { 0x7C00, 0x03E0, 0x001F, 0x8000 } },
+    { GL_RGB5, 16, { 0x7C00, 0x03E0, 0x001F, 0x0000 } },
+    { GL_RGBA4, 16, { 0x0F00, 0x00F0, 0x000F, 0xF000 } },
+    { GL_RGB4, 16, { 0x0F00, 0x00F0, 0x000F, 0x0000 } }
+};
+
+typedef struct
+{
+    uint32 glfmt;
+    uint32 bitCount;
+    uint32 luminanceMask;  // in the red mask; zero for alpha-only.
+    uint32 alphaMask;
+} MOJODDS_LuminanceFormat;
+
+// Legacy DDPF_LUMINANCE and DDPF_ALPHA layouts, each at its real size.
+static const MOJODDS_LuminanceFormat LuminanceFormats[] =
+{
+    { GL_LUMINANCE8, 8, 0xFF, 0 },
+    { GL_LUMINANCE16, 16, 0xFFFF, 0 },
+    { GL_LUMINANCE4_ALPHA4, 8, 0x0F, 0xF0 },
+    { GL_LUMINANCE_ALPHA, 16, 0x00FF, 0xFF00 },
+    { GL_ALPHA8, 8, 0, 0xFF }
+};
+
+static const MOJODDS_FormatInfo *find_format(const uint32 glfmt)
+{
+    int i;
+    for (i = 0; i < STATICARRAYLEN(FormatInfo); i++) {
+        if (FormatInfo[i].glfmt == glfmt) {
+            return &FormatInfo[i];
+        }
+    }
+    return NULL;
+}
+
+static const MOJODDS_FormatInfo *find_dxgi_format(const uint32 dxgiFormat)
+{
+    int i;
+    if (dxgiFormat == 0) {
+        return NULL;  // DXGI_FORMAT_UNKNOWN; also our "no DXGI name" marker.
+    }
+    for (i = 0; i < STATICARRAYLEN(FormatInfo); i++) {
+        if (FormatInfo[i].dxgiFormat == dxgiFormat) {
+            return &FormatInfo[i];
+        }
+    }
+    return NULL;
+}
+
+
+static const MOJODDS_MaskedFormat *find_masked_format(const uint32 bitCount,
+                                                      const uint32 *masks)
+{
+    int i;
+    for (i = 0; i < STATICARRAYLEN(MaskedFormats); i++) {
+        const MOJODDS_MaskedFormat *masked = &MaskedFormats[i];
+        if ((masked->bitCount == bitCount) &&
+            (memcmp(masked->masks, masks, sizeof (masked->masks)) == 0)) {
+            return masked;
+        }
+    }
+    return NULL;
+}
+
+static const MOJODDS_LuminanceFormat *find_luminance_format(const uint32 bitCount,
+                                                            const uint32 luminanceMask,
+                                                            const uint32 alphaMask)
+{
+    int i;
+    for (i = 0; i < STATICARRAYLEN(LuminanceFormats); i++) {
+        const MOJODDS_LuminanceFormat *luminance = &LuminanceFormats[i];
+        if ((luminance->bitCount == bitCount) &&
+            (luminance->luminanceMask == luminanceMask) &&
+            (luminance->alphaMask == alphaMask)) {
+            return luminance;
+        }
+    }
+    return NULL;
+}
+
+int mojodds_check_masks(uint32 bitCount, const uint32 *masks)
+{
+    uint32 allowed;
+    uint32 seen = 0;
+    int i;
+
+    if ((bitCount != 8) && (bitCount != 16) && (bitCount != 24) && (bitCount != 32)) {
+        return 0;
+    } else if ((masks[0] | masks[1] | masks[2]) == 0) {
+        return 0;  // alpha-only files aren't DDPF_RGB.
+    }
+
+    allowed = (bitCount == 32) ? 0xFFFFFFFF : ((1u << bitCount) - 1);
+
+    for (i = 0; i < 4; i++) {
+        const uint32 mask = masks[i];
+        if ((mask & ~allowed) || (mask & seen)) {
+            return 0;  // doesn't fit, or overlaps another channel.
+        } else if (((mask + (mask & (~mask + 1))) & mask) != 0) {
+            return 0;  // bits aren't contiguous.
+        }
+        seen |= mask;
+    }
+    return 1;
+}
+
 
 // https://graphics.stanford.edu/~seander/bithacks.html#IntegerLogDeBruijn
 static const uint32 MultiplyDeBruijnBitPosition[32] =
@@ -141,24 +368,86 @@ static uint32 readui32(const uint8 **_ptr, size_t *_len)
     return retval;
 }
 
-static int parse_dds(MOJODDS_Header *header, const uint8 **ptr, size_t *len,
-                     unsigned int *_glfmt, unsigned int *_miplevels,
-                     unsigned int *_cubemapfacelen,
-                     MOJODDS_textureType *_textureType)
+// Fill in the per-mip offsets, sizes and dimensions of one face's mip chain.
+//  Volume levels halve in depth too, and hold all their slices back to back.
+//  Returns zero if the chain wouldn't fit in 32 bits.
+int mojodds_calc_mips(MOJODDS_Layout *layout)
+{
+    uint32 wd = layout->w;
+    uint32 ht = layout->h;
+    uint32 dp = layout->depth;
+    uint64 offset = 0;
+    unsigned int i;
+
+    assert(layout->blockDim != 0);
+    assert(layout->blockSize != 0);
+    assert(layout->miplevels <= MOJODDS_MAX_MIPLEVELS);
+
+    for (i = 0; i < layout->miplevels; i++) {
+        const uint64 blocksw = MAX((wd + layout->blockDim - 1) / layout->blockDim, 1);
+        const uint64 blocksh = MAX((ht + layout->blockDim - 1) / layout->blockDim, 1);
+        const uint64 sliceLen = blocksw * blocksh * layout->blockSize;
+        const uint64 slices = MAX(dp, 1);
+        uint64 mipLen;
+        if (sliceLen > UINT32_MAX) {
+            return 0;  // data size would overflow 32-bit uint, invalid file
+        }
+        mipLen = sliceLen * slices;
+        if (offset + mipLen > UINT32_MAX) {
+            // data size would overflow 32-bit uint, invalid file
+            return 0;
+        }
+        layout->mips[i].offset = (unsigned long) offset;
+        layout->mips[i].len = (unsigned long) mipLen;
+        layout->mips[i].slicelen = (unsigned long) sliceLen;
+        layout->mips[i].w = MAX(wd, 1);
+        layout->mips[i].h = MAX(ht, 1);
+        layout->mips[i].d = (unsigned int) slices;
+        offset += mipLen;
+        wd >>= 1;
+        ht >>= 1;
+        dp >>= 1;
+    }
+
+    layout->facelen = (unsigned long) offset;
+    return 1;
+}
+
+#define BAIL(e) do { *_err = (e); return 0; } while (0)
+
+// Everything that can be checked from the headers alone. On success, *ptr
+//  points at the pixel data and *_calcSize is what the header's pitch or
+//  linear size should be; see data_needed() for how much data must follow.
+//  On failure, *_err says why.
+static int parse_header(MOJODDS_Header *header, MOJODDS_HeaderDXT10 *dx10,
+                        const uint8 **ptr, size_t *len, MOJODDS_Layout *layout,
+                        uint32 *_calcSize, MOJODDS_error *_err)
 {
     const uint32 pitchAndLinear = (DDSD_PITCH | DDSD_LINEARSIZE);
     uint32 width = 0;
     uint32 height = 0;
+    uint32 depth = 1;
+    uint32 arraySize = 1;
     uint32 calcSize = 0;
+    uint64 calcSize64 = 0;
     uint32 calcSizeFlag = DDSD_LINEARSIZE;
     uint32 blockDim = 1;
     uint32 blockSize = 0;
+    const MOJODDS_FormatInfo *fmt = NULL;
+    int isDX10 = 0;
+    unsigned int glfmt = 0;
+    unsigned int miplevels = 0;
+    MOJODDS_textureType textureType = MOJODDS_TEXTURE_2D;
+    const uint8 *start = *ptr;
     int i;
 
+    memset(dx10, '\0', sizeof (*dx10));
+    memset(layout, '\0', sizeof (*layout));
+
     if (readui32(ptr, len) != DDS_MAGIC) {  // Files start with magic value...
-        return 0;  // not a DDS file.
+        BAIL(MOJODDS_ERR_NOT_DDS);
     } else if (*len < DDS_HEADERSIZE) {  // Then comes the DDS header...
-        return 0;
+        BAIL(MOJODDS_ERR_TRUNCATED_HEADER);
     }
 
     header->dwSize = readui32(ptr, len);
@@ -189,124 +478,205 @@ static int parse_dds(MOJODDS_Header *header, const uint8 **ptr, size_t *len,
     height = header->dwHeight;
 
     if (width == 0 || height == 0) {
-        return 0;
+        BAIL(MOJODDS_ERR_BAD_DIMENSIONS);
     }
 
     // check for overflow in width * height
     if (height > 0xFFFFFFFFU / width) {
-        return 0;
+        BAIL(MOJODDS_ERR_TOO_BIG);
     }
 
     header->dwCaps &= ~DDSCAPS_ALPHA;  // we'll get this from the pixel format.
 
     if (header->dwSize != DDS_HEADERSIZE) {   // header size must be 124.
-        return 0;
+        BAIL(MOJODDS_ERR_BAD_HEADER);
     } else if (header->ddspf.dwSize != DDS_PIXFMTSIZE) {   // size must be 32.
-        return 0;
+        BAIL(MOJODDS_ERR_BAD_HEADER);
     } else if ((header->dwFlags & DDSD_REQ) != DDSD_REQ) {  // must have these bits.
-        return 0;
+        BAIL(MOJODDS_ERR_BAD_HEADER);
     } else if ((header->dwCaps & DDSCAPS_TEXTURE) == 0) {
-        return 0;
+        BAIL(MOJODDS_ERR_BAD_HEADER);
     } else if ((header->dwFlags & pitchAndLinear) == pitchAndLinear) {
-        return 0;  // can't specify both.
-    }
-
-    *_miplevels = (header->dwCaps & DDSCAPS_MIPMAP) ? header->dwMipMapCount : 1;
-
-    unsigned int calculatedMipLevels = uintLog2(MAX(width, height)) + 1;
-    if (*_miplevels == 0) {  // invalid, calculate it ourselves from size
-        *_miplevels = calculatedMipLevels;
-    } else if (*_miplevels > calculatedMipLevels) {  // too many mip levels, several would be 1x1
-        return 0;  // file is corrupted
+        BAIL(MOJODDS_ERR_BAD_HEADER);  // can't specify both.
     }
 
     if (header->ddspf.dwFlags & DDPF_FOURCC) {
         switch (header->ddspf.dwFourCC) {
             case FOURCC_DXT1:
-                *_glfmt = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-                calcSize = ((width ? ((width + 3) / 4) : 1) * 8) *
-                           (height ? ((height + 3) / 4) : 1);
-                blockDim = 4;
-                blockSize = 8;
+                fmt = find_format(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
                 break;
+            case FOURCC_DXT2:  // DXT3 with premultiplied alpha.
+                layout->premultiplied = 1;
+                // fall through
             case FOURCC_DXT3:
-                *_glfmt = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
-                calcSize = ((width ? ((width + 3) / 4) : 1) * 16) *
-                           (height ? ((height + 3) / 4) : 1);
-                blockDim = 4;
-                blockSize = 16;
+                fmt = find_format(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT);
                 break;
+            case FOURCC_DXT4:  // DXT5 with premultiplied alpha.
+                layout->premultiplied = 1;
+                // fall through
             case FOURCC_DXT5:
-                *_glfmt = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-                calcSize = ((width ? ((width + 3) / 4) : 1) * 16) *
-                           (height ? ((height + 3) / 4) : 1);
-                blockDim = 4;
-                blockSize = 16;
+                fmt = find_format(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+                break;
+
+            case FOURCC_ATI1:  // what BC4 was called before DirectX 10...
+            case FOURCC_BC4U:
+                fmt = find_format(GL_COMPRESSED_RED_RGTC1);
+                break;
+            case FOURCC_BC4S:
+                fmt = find_format(GL_COMPRESSED_SIGNED_RED_RGTC1);
+                break;
+            case FOURCC_ATI2:  // ...and BC5, also known as 3Dc.
+            case FOURCC_BC5U:
+                fmt = find_format(GL_COMPRESSED_RG_RGTC2);
+                break;
+            case FOURCC_BC5S:
+                fmt = find_format(GL_COMPRESSED_SIGNED_RG_RGTC2);
+                break;
+
+            case D3DFMT_A16B16G16R16:
+                fmt = find_format(GL_RGBA16);
+                break;
+            case D3DFMT_R16F:
+                fmt = find_format(GL_R16F);
+                break;
+            case D3DFMT_G16R16F:
+                fmt = find_format(GL_RG16F);
+                break;
+            case D3DFMT_A16B16G16R16F:
+                fmt = find_format(GL_RGBA16F);
+                break;
+            case D3DFMT_R32F:
+                fmt = find_format(GL_R32F);
+                break;
+            case D3DFMT_G32R32F:
+                fmt = find_format(GL_RG32F);
+                break;
+            case D3DFMT_A32B32G32R32F:
+                fmt = find_format(GL_RGBA32F);
                 break;
 
-            // !!! FIXME: DX10 is an extended header, introduced by DirectX 10.
-            //case FOURCC_DX10: do_something(); break;
+            case FOURCC_DX10:  // extended header, introduced by DirectX 10.
+                if (*len < DDS_HEADERSIZE_DXT10) {
+                    BAIL(MOJODDS_ERR_TRUNCATED_HEADER);
+                }
+                dx10->dxgiFormat = readui32(ptr, len);
+                dx10->resourceDimension = readui32(ptr, len);
+                dx10->miscFlag = readui32(ptr, len);
+                dx10->arraySize = readui32(ptr, len);
+                dx10->miscFlags2 = readui32(ptr, len);
+                isDX10 = 1;
+
+                fmt = find_dxgi_format(dx10->dxgiFormat);
+                arraySize = dx10->arraySize;
+                if ((dx10->miscFlags2 & DDS_ALPHA_MODE_MASK) == DDS_ALPHA_MODE_PREMULTIPLIED) {
+                    layout->premultiplied = 1;
+                }
+                if (arraySize == 0) {
+                    BAIL(MOJODDS_ERR_BAD_DIMENSIONS);  // an array with no elements.
+                }
+                break;
 
-            //case FOURCC_DXT2:  // premultiplied alpha unsupported.
-            //case FOURCC_DXT4:  // premultiplied alpha unsupported.
             default:
-                return 0;  // unsupported data format.
+                BAIL(MOJODDS_ERR_UNSUPPORTED_FORMAT);
+        }
+
+        if (fmt == NULL) {
+            BAIL(MOJODDS_ERR_UNSUPPORTED_FORMAT);
+        }
+
+        if (fmt->blockDim == 1) {
+            calcSizeFlag = DDSD_PITCH;
+            calcSize64 = ((uint64) width) * fmt->blockSize;
+        } else {
+            calcSize64 = ((uint64) ((width + fmt->blockDim - 1) / fmt->blockDim)) *
+                         ((height + fmt->blockDim - 1) / fmt->blockDim) *
+                         fmt->blockSize;
         }
 
+        if (calcSize64 > UINT32_MAX) {
+            BAIL(MOJODDS_ERR_TOO_BIG);  // data size would overflow 32-bit uint, invalid file
+        }
+        calcSize = (uint32) calcSize64;
+
     } else if (header->ddspf.dwFlags & DDPF_RGB) {  // no FourCC...uncompressed data.
-        if ( (header->ddspf.dwRBitMask != 0x00FF0000) ||
-             (header->ddspf.dwGBitMask != 0x0000FF00) ||
-             (header->ddspf.dwBBitMask != 0x000000FF) ) {
-            return 0;  // !!! FIXME: deal with this.
+        const uint32 bitCount = header->ddspf.dwRGBBitCount;
+        const MOJODDS_MaskedFormat *masked;
+        uint32 masks[4];
+
+        masks[0] = header->ddspf.dwRBitMask;
+        masks[1] = header->ddspf.dwGBitMask;
+        masks[2] = header->ddspf.dwBBitMask;
+        masks[3] = (header->ddspf.dwFlags & DDPF_ALPHAPIXELS) ? header->ddspf.dwABitMask : 0;
+        if (!mojodds_check_masks(bitCount, masks)) {
+            BAIL(MOJODDS_ERR_UNSUPPORTED_FORMAT);
         }
 
-        if (header->ddspf.dwFlags & DDPF_ALPHAPIXELS) {
-            if ( (header->ddspf.dwRGBBitCount != 32) ||
-                 (header->ddspf.dwABitMask != 0xFF000000) ) {
-                return 0;  // unsupported.
-            }
-            *_glfmt = GL_BGRA;
-            blockSize = 4;
+        masked = find_masked_format(bitCount, masks);
+        if (masked != NULL) {
+            fmt = find_format(masked->glfmt);
         } else {
-            if (header->ddspf.dwRGBBitCount != 24) {
-                return 0;  // unsupported.
+            switch (bitCount) {
+                case 8: fmt = find_format(MOJODDS_FORMAT_MASKED8); break;
+                case 16: fmt = find_format(MOJODDS_FORMAT_MASKED16); break;
+                case 24: fmt = find_format(MOJODDS_FORMAT_MASKED24); break;
+                default: fmt = find_format(MOJODDS_FORMAT_MASKED32); break;
             }
-            *_glfmt = GL_BGR;
-            blockSize = 3;
         }
 
+        layout->bitCount = bitCount;
+        memcpy(layout->masks, masks, sizeof (layout->masks));
+
         calcSizeFlag = DDSD_PITCH;
         calcSize = ((width * header->ddspf.dwRGBBitCount) + 7) / 8;
 
     } else if (header->ddspf.dwFlags & (DDPF_LUMINANCE | DDPF_ALPHA) ) {
-        *_glfmt = GL_LUMINANCE_ALPHA;
+        const uint32 flags = header->ddspf.dwFlags;
+        const uint32 luminanceMask = (flags & DDPF_LUMINANCE) ? header->ddspf.dwRBitMask : 0;
+        const uint32 alphaMask = (flags & (DDPF_ALPHA | DDPF_ALPHAPIXELS)) ? header->ddspf.dwABitMask : 0;
+        const MOJODDS_LuminanceFormat *luminance;
+
+        luminance = find_luminance_format(header->ddspf.dwRGBBitCount, luminanceMask, alphaMask);
+        if (luminance == NULL) {
+            BAIL(MOJODDS_ERR_UNSUPPORTED_FORMAT);
+        }
+        fmt = find_format(luminance->glfmt);
         calcSizeFlag = DDSD_PITCH;
-        blockSize = 2;
         calcSize = ((width * header->ddspf.dwRGBBitCount) + 7) / 8;
     }
 
-    //else if (header->ddspf.dwFlags & DDPF_LUMINANCE)  // !!! FIXME
     //else if (header->ddspf.dwFlags & DDPF_YUV)  // !!! FIXME
-    //else if (header->ddspf.dwFlags & DDPF_ALPHA)  // !!! FIXME
 
     else {
-        return 0;  // unsupported data format.
+        BAIL(MOJODDS_ERR_UNSUPPORTED_FORMAT);
     }
 
+    assert(fmt != NULL);
+    glfmt = fmt->glfmt;
+    blockDim = fmt->blockDim;
+    blockSize = fmt->blockSize;
+
     // no pitch or linear size? Calculate it.
     if ((header->dwFlags & pitchAndLinear) == 0) {
         if (!calcSizeFlag) {
             assert(0 && "should have caught this up above");
-            return 0;  // uh oh.
+            BAIL(MOJODDS_ERR_BAD_HEADER);  // uh oh.
         }
 
         header->dwPitchOrLinearSize = calcSize;
         header->dwFlags |= calcSizeFlag;
     }
 
-    *_textureType = MOJODDS_TEXTURE_2D;
     // figure out texture type.
-    if ( (header->dwCaps & DDSCAPS_COMPLEX) &&
+    if (isDX10) {
+        if (dx10->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) {
+            textureType = MOJODDS_TEXTURE_CUBE;
+        } else if (dx10->resourceDimension == DDS_DIMENSION_TEXTURE3D) {
+            textureType = MOJODDS_TEXTURE_VOLUME;
+        } else if ( (dx10->resourceDimension != DDS_DIMENSION_TEXTURE2D) &&
+                    (dx10->resourceDimension != DDS_DIMENSION_TEXTURE1D) ) {
+            BAIL(MOJODDS_ERR_UNSUPPORTED_TYPE);  // buffers and unknown dimensions aren't textures.
+        }
+    } else if ( (header->dwCaps & DDSCAPS_COMPLEX) &&
          (header->dwCaps2 & DDSCAPS2_CUBEMAP) &&
          (header->dwCaps2 & DDSCAPS2_CUBEMAP_POSITIVEX) &&
          (header->dwCaps2 & DDSCAPS2_CUBEMAP_NEGATIVEX) &&
@@ -314,69 +684,91 @@ static int parse_dds(MOJODDS_Header *header, const uint8 **ptr, size_t *len,
          (header->dwCaps2 & DDSCAPS2_CUBEMAP_NEGATIVEY) &&
          (header->dwCaps2 & DDSCAPS2_CUBEMAP_POSITIVEZ) &&
          (header->dwCaps2 & DDSCAPS2_CUBEMAP_NEGATIVEZ) ) {
-        *_textureType = MOJODDS_TEXTURE_CUBE;
+        textureType = MOJODDS_TEXTURE_CUBE;
     } else if (header->dwCaps2 & DDSCAPS2_VOLUME) {
-        *_textureType = MOJODDS_TEXTURE_VOLUME;
+        textureType = MOJODDS_TEXTURE_VOLUME;
     }
 
-    // figure out how much memory makes up a single face mip chain.
-    if (*_textureType == MOJODDS_TEXTURE_CUBE) {
-        uint32 wd = header->dwWidth;
-        uint32 ht = header->dwHeight;
-        if (wd != ht) {
-            return 0;  // cube maps must be square
-        }
-
-        *_cubemapfacelen = 0;
-
-        for (i = 0; i < (int)*_miplevels; i++) {
-            const uint32 mipLen = MAX((wd + blockDim - 1) / blockDim, 1) * MAX((ht + blockDim - 1) / blockDim, 1) * blockSize;
-            if (UINT32_MAX - mipLen < *_cubemapfacelen) {
-                // data size would overflow 32-bit uint, invalid file
-                return 0;
-            }
-            *_cubemapfacelen += mipLen;
-            wd >>= 1;
-            ht >>= 1;
-        }
-
-        if (*len < (*_cubemapfacelen) * 6) {  // 6 because cube faces
-            return 0;
+    if (textureType == MOJODDS_TEXTURE_VOLUME) {
+        depth = header->dwDepth;
+        if (depth == 0) {
+            BAIL(MOJODDS_ERR_BAD_DIMENSIONS);  // a volume with no slices.
+        } else if (arraySize != 1) {
+            BAIL(MOJODDS_ERR_BAD_DIMENSIONS);  // there's no such thing as a volume array.
         }
+    }
 
-    } else if (*_textureType == MOJODDS_TEXTURE_2D) {
-        // check that file contains enough data like the header says
-        // TODO: also do this for other texture types
-        uint32 wd = header->dwWidth;
-        uint32 ht = header->dwHeight;
-        uint32 dataLen = 0;
-        for (i = 0; i < (int)*_miplevels; i++) {
-            const uint32 mipLen = MAX((wd + blockDim - 1) / blockDim, 1) * MAX((ht + blockDim - 1) / blockDim, 1) * blockSize;
-            if (UINT32_MAX - mipLen < dataLen) {
-                // data size would overflow 32-bit uint, invalid file
-                return 0;
-            }
-            dataLen += mipLen;
-            wd >>= 1;
-            ht >>= 1;
-        }
+    miplevels = (header->dwCaps & DDSCAPS_MIPMAP) ? header->dwMipMapCount : 1;
 
-        if (*len < dataLen) {
-            return 0;
-        }
+    // volume mips keep going until all three dimensions are down to 1.
+    unsigned int calculatedMipLevels = uintLog2(MAX(MAX(width, height), depth)) + 1;
+    if (miplevels == 0) {  // invalid, calculate it ourselves from size
+        miplevels = calculatedMipLevels;
+    } else if (miplevels > calculatedMipLevels) {  // too many mip levels, several would be 1x1
+        BAIL(MOJODDS_ERR_BAD_MIPCOUNT);  // file is corrupted
     }
 
-    if (header->dwPitchOrLinearSize > *len) {
-        return 0;   // dwPitchOrLinearSize is incorrect
+    layout->tex = (const void *) *ptr;
+    layout->dataoffset = (unsigned long) (*ptr - start);
+    layout->glfmt = glfmt;
+    layout->textureType = textureType;
+    layout->w = width;
+    layout->h = height;
+    layout->depth = depth;
+    layout->miplevels = miplevels;
+    layout->arraySize = arraySize;
+    layout->faces = (textureType == MOJODDS_TEXTURE_CUBE) ? 6 : 1;
+    layout->blockDim = blockDim;
+    layout->blockSize = blockSize;
+
+    // every face of every array element has its own whole mip chain.
+    if (layout->faces > UINT32_MAX / arraySize) {
+        BAIL(MOJODDS_ERR_TOO_BIG);
     }
+    layout->faces *= arraySize;
 
-    if (calcSize > *len) { // there's not enough data to contain the advertised images
-        return 0;  // trying to read mips would fail
+    // figure out how much memory makes up a single face mip chain.
+    if ((textureType == MOJODDS_TEXTURE_CUBE) && (width != height)) {
+        BAIL(MOJODDS_ERR_BAD_DIMENSIONS);  // cube maps must be square
+    } else if (!mojodds_calc_mips(layout)) {
+        BAIL(MOJODDS_ERR_TOO_BIG);
+    } else if (layout->facelen > UINT32_MAX / layout->faces) {
+        BAIL(MOJODDS_ERR_TOO_BIG);  // all the faces would overflow 32-bit uint, invalid file
     }
 
+    layout->texlen = layout->facelen * layout->faces;
+
+    *_calcSize = calcSize;
+    return 1;
+}
+
+// How many bytes of pixel data the headers promise. Usually just texlen, but
+//  files whose pitch or linear size claims more than that have always been
+//  held to it, too.
+static size_t data_needed(const MOJODDS_Header *header,
+                          const MOJODDS_Layout *layout, const uint32 calcSize)
+{
+    size_t retval = (size_t) layout->texlen;
+    retval = MAX(retval, (size_t) header->dwPitchOrLinearSize);
+    retval = MAX(retval, (size_t) calcSize);
+    return retval;
+}
+
+static int parse_dds(MOJODDS_Header *header, MOJODDS_HeaderDXT10 *dx10,
+                     const uint8 **ptr, size_t *len, MOJODDS_Layout *layout)
+{
+    uint32 calcSize = 0;
+    MOJODDS_error err;
+    if (!parse_header(header, dx10, ptr, len, layout, &calcSize, &err)) {
+        return 0;
+    } else if (*len < data_needed(header, layout, calcSize)) {
+        return 0;  // not enough data to contain the advertised images.
+    }
     return 1;
 }
 
+#undef BAIL
+
 
 // !!! FIXME: improve the crap out of this API later.
 int MOJODDS_isDDS(const void *_ptr, const unsigned long _len)
@@ -396,10 +788,19 @@ int MOJODDS_getTexture(const void *_ptr, const unsigned long _len,
     size_t len = (size_t) _len;
     const uint8 *ptr = (const uint8 *) _ptr;
     MOJODDS_Header header;
-    if (!parse_dds(&header, &ptr, &len, _glfmt, _miplevels, _cubemapfacelen, _textureType)) {
+    MOJODDS_HeaderDXT10 dx10;
+    MOJODDS_Layout layout;
+    if (!parse_dds(&header, &dx10, &ptr, &len, &layout)) {
         return 0;
     }
 
+    *_glfmt = layout.glfmt;
+    *_miplevels = layout.miplevels;
+    *_textureType = layout.textureType;
+    if (layout.textureType == MOJODDS_TEXTURE_CUBE) {
+        *_cubemapfacelen = (unsigned int) layout.facelen;
+    }
+
     *_tex = (const void *) ptr;
     *_w = (unsigned int) header.dwWidth;
     *_h = (unsigned int) header.dwHeight;
@@ -412,6 +813,374 @@ int MOJODDS_getTexture(const void *_ptr, const unsigned long _len,
     return 1;
 }
 
+int MOJODDS_getFormatInfo(unsigned int glfmt, unsigned int *_blockDim,
+                          unsigned int *_blockSize, unsigned int *_glinternal,
+                          unsigned int *_glformat, unsigned int *_gltype)
+{
+    const MOJODDS_FormatInfo *fmt = find_format(glfmt);
+    if (fmt == NULL) {
+        return 0;
+    }
+
+    if (_blockDim) { *_blockDim = fmt->blockDim; }
+    if (_blockSize) { *_blockSize = fmt->blockSize; }
+    if (_glinternal) { *_glinternal = fmt->glinternal; }
+    if (_glformat) { *_glformat = fmt->glformat; }
+    if (_gltype) { *_gltype = fmt->gltype; }
+    return 1;
+}
+
+int MOJODDS_getLayout(const void *_ptr, const unsigned long _len,
+                      MOJODDS_Layout *_layout)
+{
+    size_t len = (size_t) _len;
+    const uint8 *ptr = (const uint8 *) _ptr;
+    MOJODDS_Header header;
+    MOJODDS_HeaderDXT10 dx10;
+    return parse_dds(&header, &dx10, &ptr, &len, _layout);
+}
+
+int MOJODDS_getSubresource(const MOJODDS_Layout *_layout, unsigned int face,
+                           unsigned int miplevel, const void **_tex,
+                           unsigned long *_texlen, unsigned int *_texw,
+                           unsigned int *_texh)
+{
+    const MOJODDS_MipLevel *mip;
+
+    if ((face >= _layout->faces) || (miplevel >= _layout->miplevels)) {
+        return 0;
+    }
+
+    mip = &_layout->mips[miplevel];
+    *_tex = ((const char *) _layout->tex) + (face * _layout->facelen) + mip->offset;
+    if (_texlen) {
+        *_texlen = mip->len;
+    }
+    *_texw = mip->w;
+    *_texh = mip->h;
+
+    return 1;
+}
+
+int MOJODDS_getHeaderLayout(const void *_ptr, const unsigned long _len,
+                            MOJODDS_Layout *_layout)
+{
+    size_t len = (size_t) _len;
+    const uint8 *ptr = (const uint8 *) _ptr;
+    MOJODDS_Header header;
+    MOJODDS_HeaderDXT10 dx10;
+    uint32 calcSize = 0;
+    MOJODDS_error err;
+    if (!parse_header(&header, &dx10, &ptr, &len, _layout, &calcSize, &err)) {
+        return 0;
+    }
+    _layout->tex = NULL;  // we haven't seen the pixels.
+    return 1;
+}
+
+int MOJODDS_planMipLoad(const MOJODDS_Layout *_layout, unsigned int maxdim,
+                        unsigned long budget, MOJODDS_ByteRange *_ranges,
+                        unsigned int maxranges, unsigned int *_rangecount,
+                        MOJODDS_Layout *_planned)
+{
+    const MOJODDS_MipLevel *first = NULL;
+    unsigned long facelen = 0;
+    unsigned int rangecount = 0;
+    unsigned int firstmip;
+    unsigned int face;
+    unsigned int i;
+
+    // Pick the biggest level that satisfies both limits; everything after
+    //  it in the chain comes along.
+    for (firstmip = 0; firstmip < _layout->miplevels; firstmip++) {
+        first = &_layout->mips[firstmip];
+        facelen = _layout->facelen - first->offset;
+        if ((maxdim != 0) && (MAX(MAX(first->w, first->h), first->d) > maxdim)) {
+            continue;
+        } else if ((budget != 0) && ((uint64) facelen * _layout->faces > budget)) {
+            continue;
+        }
+        break;
+    }
+
+    if (firstmip == _layout->miplevels) {
+        return 0;  // even the smallest level won't do.
+    }
+
+    // One range per face, each running from the first wanted level to the
+    //  end of the face's chain. If that's the whole chain, consecutive faces
+    //  touch, so merge them.
+    for (face = 0; face < _layout->faces; face++) {
+        const unsigned long offset = _layout->dataoffset + (face * _layout->facelen) + first->offset;
+        if ((rangecount > 0) && (_ranges[rangecount-1].offset + _ranges[rangecount-1].len == offset)) {
+            _ranges[rangecount-1].len += facelen;
+        } else if (rangecount == maxranges) {
+            return 0;  // caller didn't give us enough room.
+        } else {
+            _ranges[rangecount].offset = offset;
+            _ranges[rangecount].len = facelen;
+            rangecount++;
+        }
+    }
+    *_rangecount = rangecount;
+
+    // The ranges read back to back are a texture of their own, whose base
+    //  level is the first one we kept.
+    memcpy(_planned, _layout, sizeof (*_planned));
+    _planned->tex = NULL;
+    _planned->dataoffset = 0;
+    _planned->w = first->w;
+    _planned->h = first->h;
+    _planned->depth = first->d;
+    _planned->miplevels = _layout->miplevels - firstmip;
+    _planned->facelen = facelen;
+    _planned->texlen = facelen * _layout->faces;
+    memset(_planned->mips, '\0', sizeof (_planned->mips));
+    for (i = 0; i < _planned->miplevels; i++) {
+        _planned->mips[i] = _layout->mips[firstmip + i];
+        _planned->mips[i].offset -= first->offset;
+    }
+
+    return 1;
+}
+
+MOJODDS_error MOJODDS_validate(const void *_ptr, const unsigned long _len,
+                               const unsigned long _filelen,
+                               MOJODDS_Layout *_layout)
+{
+    size_t len = (size_t) _len;
+    const uint8 *ptr = (const uint8 *) _ptr;
+    MOJODDS_Header header;
+    MOJODDS_HeaderDXT10 dx10;
+    uint32 calcSize = 0;
+    MOJODDS_error err = MOJODDS_ERR_NONE;
+    size_t needed;
+
+    assert(_filelen >= _len);
+    if (!parse_header(&header, &dx10, &ptr, &len, _layout, &calcSize, &err)) {
+        return err;
+    }
+
+    needed = data_needed(&header, _layout, calcSize);
+    if ((_filelen - _layout->dataoffset) < needed) {
+        return MOJODDS_ERR_TRUNCATED_DATA;
+    } else if (len < needed) {
+        _layout->tex = NULL;  // we haven't got the pixels.
+    }
+    return MOJODDS_ERR_NONE;
+}
+
+const char *MOJODDS_errorString(MOJODDS_error err)
+{
+    switch (err) {
+        case MOJODDS_ERR_NONE: return "no error";
+        case MOJODDS_ERR_NOT_DDS: return "not a DDS file";
+        case MOJODDS_ERR_TRUNCATED_HEADER: return "truncated header";
+        case MOJODDS_ERR_BAD_HEADER: return "corrupt header";
+        case MOJODDS_ERR_BAD_DIMENSIONS: return "bad dimensions";
+        case MOJODDS_ERR_BAD_MIPCOUNT: return "bad mipmap count";
+        case MOJODDS_ERR_UNSUPPORTED_FORMAT: return "unsupported pixel format";
+        case MOJODDS_ERR_UNSUPPORTED_TYPE: return "unsupported resource type";
+        case MOJODDS_ERR_TOO_BIG: return "texture too big";
+        case MOJODDS_ERR_TRUNCATED_DATA: return "truncated pixel data";
+        case MOJODDS_ERR_IO: return "i/o error";
+        case MOJODDS_ERR_NO_BUFFER: return "no room to load into";
+        case MOJODDS_ERR_CORRUPT: return "corrupt compressed data";
+        case MOJODDS_ERR_NO_CODEC: return "codec not built in";
+    }
+    return "unknown error";
+}
+
+int MOJODDS_getArraySubresource(const MOJODDS_Layout *_layout,
+                                unsigned int element, unsigned int face,
+                                unsigned int miplevel, const void **_tex,
+                                unsigned long *_texlen, unsigned int *_texw,
+                                unsigned int *_texh)
+{
+    const unsigned int facesPerElement = _layout->faces / _layout->arraySize;
+    if ((element >= _layout->arraySize) || (face >= facesPerElement)) {
+        return 0;
+    }
+    return MOJODDS_getSubresource(_layout, (element * facesPerElement) + face,
+                                  miplevel, _tex, _texlen, _texw, _texh);
+}
+
+int MOJODDS_getVolumeSlice(const MOJODDS_Layout *_layout, unsigned int miplevel,
+                           unsigned int slice, const void **_tex,
+                           unsigned long *_texlen, unsigned int *_texw,
+                           unsigned int *_texh)
+{
+    const MOJODDS_MipLevel *mip;
+
+    if ((miplevel >= _layout->miplevels) || (slice >= _layout->mips[miplevel].d)) {
+        return 0;
+    }
+
+    mip = &_layout->mips[miplevel];
+    *_tex = ((const char *) _layout->tex) + mip->offset + (slice * mip->slicelen);
+    if (_texlen) {
+        *_texlen = mip->slicelen;
+    }
+    *_texw = mip->w;
+    *_texh = mip->h;
+
+    return 1;
+}
+
+// Incremental parsing: headers are collected in a small buffer, then the
+//  pixel data goes into one allocation sized from the layout.
+#define DDS_MAXFILEHEADERSIZE (4 + DDS_HEADERSIZE + DDS_HEADERSIZE_DXT10)
+
+struct MOJODDS_Stream
+{
+    MOJODDS_StreamLayoutFn layoutfn;
+    MOJODDS_StreamSubresourceFn subresourcefn;
+    void *userdata;
+    uint8 header[DDS_MAXFILEHEADERSIZE];
+    size_t headerlen;
+    size_t headerneeded;  // grows if there's a DX10 header.
+    int failed;
+    int haveLayout;
+    MOJODDS_Layout layout;
+    uint8 *data;
+    size_t datalen;
+    size_t needed;  // file is complete at this many bytes of data.
+    unsigned int nextface;  // next subresource to report.
+    unsigned int nextmip;
+};
+
+MOJODDS_Stream *MOJODDS_createStream(MOJODDS_StreamLayoutFn layoutfn,
+                                     MOJODDS_StreamSubresourceFn subresourcefn,
+                                     void *userdata)
+{
+    MOJODDS_Stream *stream = (MOJODDS_Stream *) calloc(1, sizeof (*stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+    stream->layoutfn = layoutfn;
+    stream->subresourcefn = subresourcefn;
+    stream->userdata = userdata;
+    stream->headerneeded = 4 + DDS_HEADERSIZE;
+    return stream;
+}
+
+void MOJODDS_destroyStream(MOJODDS_Stream *stream)
+{
+    if (stream != NULL) {
+        free(stream->data);
+        free(stream);
+    }
+}
+
+// Once the main header is in, see if a DX10 header follows it.
+static int stream_has_dx10_header(const MOJODDS_Stream *stream)
+{
+    const uint8 *ptr = stream->header + 80;  // ddspf.dwFlags
+    size_t len = stream->headerlen - 80;
+    const uint32 flags = readui32(&ptr, &len);
+    return ((flags & DDPF_FOURCC) && (readui32(&ptr, &len) == FOURCC_DX10));
+}
+
+static int stream_parse_header(MOJODDS_Stream *stream)
+{
+    const uint8 *ptr = stream->header;
+    size_t len = stream->headerlen;
+    MOJODDS_Header header;
+    MOJODDS_HeaderDXT10 dx10;
+    uint32 calcSize = 0;
+    MOJODDS_error err;
+
+    if (!parse_header(&header, &dx10, &ptr, &len, &stream->layout, &calcSize, &err)) {
+        return 0;
+    }
+
+    stream->needed = data_needed(&header, &stream->layout, calcSize);
+    stream->data = (uint8 *) malloc(stream->needed);
+    if (stream->data == NULL) {
+        return 0;
+    }
+
+    stream->layout.tex = stream->data;
+    stream->haveLayout = 1;
+    if (stream->layoutfn) {
+        stream->layoutfn(stream->userdata, &stream->layout);
+    }
+    return 1;
+}
+
+// Report every subresource that's fully arrived. They land in file order:
+//  each face's whole mip chain, one face after another.
+static void stream_report_ready(MOJODDS_Stream *stream)
+{
+    const MOJODDS_Layout *layout = &stream->layout;
+    while (stream->nextface < layout->faces) {
+        const MOJODDS_MipLevel *mip = &layout->mips[stream->nextmip];
+        const size_t end = (stream->nextface * layout->facelen) + mip->offset + mip->len;
+        if (stream->datalen < end) {
+            break;
+        }
+
+        if (stream->subresourcefn) {
+            stream->subresourcefn(stream->userdata, layout, stream->nextface, stream->nextmip);
+        }
+
+        if (++stream->nextmip == layout->miplevels) {
+            stream->nextmip = 0;
+            stream->nextface++;
+        }
+    }
+}
+
+int MOJODDS_streamData(MOJODDS_Stream *stream, const void *_data,
+                       unsigned long _len)
+{
+    const uint8 *data = (const uint8 *) _data;
+    size_t len = (size_t) _len;
+    size_t cpy;
+
+    if (stream->failed) {
+        return 0;
+    }
+
+    while ((!stream->haveLayout) && (len > 0)) {
+        cpy = MIN(len, stream->headerneeded - stream->headerlen);
+        memcpy(stream->header + stream->headerlen, data, cpy);
+        stream->headerlen += cpy;
+        data += cpy;
+        len -= cpy;
+
+        if (stream->headerlen < stream->headerneeded) {
+            return 1;  // wait for more.
+        } else if ((stream->headerneeded == 4 + DDS_HEADERSIZE) && stream_has_dx10_header(stream)) {
+            stream->headerneeded += DDS_HEADERSIZE_DXT10;
+        } else if (!stream_parse_header(stream)) {
+            stream->failed = 1;
+            return 0;
+        }
+    }
+
+    if (stream->haveLayout) {
+        // anything past what the headers promised is ignored, like
+        //  MOJODDS_getLayout() does.
+        cpy = MIN(len, stream->needed - stream->datalen);
+        memcpy(stream->data + stream->datalen, data, cpy);
+        stream->datalen += cpy;
+        stream_report_ready(stream);
+    }
+
+    return 1;
+}
+
+const MOJODDS_Layout *MOJODDS_getStreamLayout(const MOJODDS_Stream *stream)
+{
+    return stream->haveLayout ? &stream->layout : NULL;
+}
+
+int MOJODDS_streamComplete(const MOJODDS_Stream *stream)
+{
+    return stream->haveLayout && (stream->datalen == stream->needed);
+}
+
 int MOJODDS_getMipMapTexture(unsigned int miplevel, unsigned int glfmt,
                              const void *_basetex,
                              unsigned int w, unsigned h,
@@ -423,38 +1192,17 @@ int MOJODDS_getMipMapTexture(unsigned int miplevel, unsigned int glfmt,
     unsigned long newtexlen;
     unsigned int neww;
     unsigned int newh;
-    uint32 blockDim = 1;
-    uint32 blockSize = 0;
-
-    switch (glfmt) {
-        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-            blockDim = 4;
-            blockSize = 8;
-            break;
-
-        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-            blockDim = 4;
-            blockSize = 16;
-            break;
-
-        case GL_BGR:
-            blockSize = 3;
-            break;
-
-        case GL_BGRA:
-            blockSize = 4;
-            break;
-
-        case GL_LUMINANCE_ALPHA:
-            blockSize = 2;
-            break;
+    const MOJODDS_FormatInfo *fmt = find_format(glfmt);
+    uint32 blockDim;
+    uint32 blockSize;
 
-        default:
-            //assert(!"unsupported GL format");
-            return 0;
+    if (fmt == NULL) {
+        //assert(!"unsupported GL format");
+        return 0;
     }
 
+    blockDim = fmt->blockDim;
+    blockSize = fmt->blockSize;
     assert(blockSize != 0);
 
     newtex = _basetex;
@@ -498,5 +1246,273 @@ int MOJODDS_getCubeFace(MOJODDS_cubeFace cubeFace, unsigned int miplevel,
     return MOJODDS_getMipMapTexture(miplevel, glfmt, faceBaseTex, w, h, _tex, _texlen, _texw, _texh);
 }
 
+// Writing. Headers are built in the same structs parse_header() reads, then
+//  run back through it, so the sizes follow the same rules and anything we
+//  write is something we can load.
+
+static void writeui32(uint8 **_ptr, const uint32 val)
+{
+    uint8 *ptr = *_ptr;
+    ptr[0] = (uint8) (val & 0xFF);
+    ptr[1] = (uint8) ((val >> 8) & 0xFF);
+    ptr[2] = (uint8) ((val >> 16) & 0xFF);
+    ptr[3] = (uint8) ((val >> 24) & 0xFF);
+    *_ptr = ptr + 4;
+}
+
+static size_t serialize_header(const MOJODDS_Header *header,
+                               const MOJODDS_HeaderDXT10 *dx10,
+                               const int isDX10, uint8 *buf)
+{
+    uint8 *ptr = buf;
+    int i;
+
+    writeui32(&ptr, DDS_MAGIC);
+    writeui32(&ptr, header->dwSize);
+    writeui32(&ptr, header->dwFlags);
+    writeui32(&ptr, header->dwHeight);
+    writeui32(&ptr, header->dwWidth);
+    writeui32(&ptr, header->dwPitchOrLinearSize);
+    writeui32(&ptr, header->dwDepth);
+    writeui32(&ptr, header->dwMipMapCount);
+    for (i = 0; i < STATICARRAYLEN(header->dwReserved1); i++) {
+        writeui32(&ptr, header->dwReserved1[i]);
+    }
+    writeui32(&ptr, header->ddspf.dwSize);
+    writeui32(&ptr, header->ddspf.dwFlags);
+    writeui32(&ptr, header->ddspf.dwFourCC);
+    writeui32(&ptr, header->ddspf.dwRGBBitCount);
+    writeui32(&ptr, header->ddspf.dwRBitMask);
+    writeui32(&ptr, header->ddspf.dwGBitMask);
+    writeui32(&ptr, header->ddspf.dwBBitMask);
+    writeui32(&ptr, header->ddspf.dwABitMask);
+    writeui32(&ptr, header->dwCaps);
+    writeui32(&ptr, header->dwCaps2);
+    writeui32(&ptr, header->dwCaps3);
+    writeui32(&ptr, header->dwCaps4);
+    writeui32(&ptr, header->dwReserved2);
+
+    if (isDX10) {
+        writeui32(&ptr, dx10->dxgiFormat);
+        writeui32(&ptr, dx10->resourceDimension);
+        writeui32(&ptr, dx10->miscFlag);
+        writeui32(&ptr, dx10->arraySize);
+        writeui32(&ptr, dx10->miscFlags2);
+    }
+
+    return (size_t) (ptr - buf);
+}
+
+// The pre-DX10 way to say glfmt, if there is one. Only the DXT2 and DXT4
+//  FourCCs can say the alpha is premultiplied.
+static int legacy_pixel_format(const uint32 glfmt, const int premultiplied,
+                               MOJODDS_PixelFormat *pf)
+{
+    int i;
+
+    memset(pf, '\0', sizeof (*pf));
+    pf->dwSize = DDS_PIXFMTSIZE;
+    if (premultiplied) {
+        pf->dwFlags = DDPF_FOURCC;
+        if (glfmt == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT) {
+            pf->dwFourCC = FOURCC_DXT2;
+            return 1;
+        } else if (glfmt == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+            pf->dwFourCC = FOURCC_DXT4;
+            return 1;
+        }
+        return 0;
+    }
+
+    switch (glfmt) {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            pf->dwFlags = DDPF_FOURCC;
+            pf->dwFourCC = FOURCC_DXT1;
+            return 1;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+            pf->dwFlags = DDPF_FOURCC;
+            pf->dwFourCC = FOURCC_DXT3;
+            return 1;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            pf->dwFlags = DDPF_FOURCC;
+            pf->dwFourCC = FOURCC_DXT5;
+            return 1;
+        case GL_RGBA8:
+        case GL_RGB10_A2:
+            // old writers disagreed on which way round these masks go, so
+            //  readers guess. A DX10 header can't be misread.
+            return 0;
+        default:
+            break;
+    }
+
+    for (i = 0; i < STATICARRAYLEN(LuminanceFormats); i++) {
+        const MOJODDS_LuminanceFormat *luminance = &LuminanceFormats[i];
+        if (luminance->glfmt == glfmt) {
+            if (luminance->luminanceMask == 0) {
+                pf->dwFlags = DDPF_ALPHA;
+            } else {
+                pf->dwFlags = DDPF_LUMINANCE | (luminance->alphaMask ? DDPF_ALPHAPIXELS : 0);
+            }
+            pf->dwRGBBitCount = luminance->bitCount;
+            pf->dwRBitMask = luminance->luminanceMask;
+            pf->dwABitMask = luminance->alphaMask;
+            return 1;
+        }
+    }
+
+    for (i = 0; i < STATICARRAYLEN(MaskedFormats); i++) {
+        const MOJODDS_MaskedFormat *masked = &MaskedFormats[i];
+        if (masked->glfmt == glfmt) {
+            pf->dwFlags = DDPF_RGB | (masked->masks[3] ? DDPF_ALPHAPIXELS : 0);
+            pf->dwRGBBitCount = masked->bitCount;
+            pf->dwRBitMask = masked->masks[0];
+            pf->dwGBitMask = masked->masks[1];
+            pf->dwBBitMask = masked->masks[2];
+            pf->dwABitMask = masked->masks[3];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int write_padding(MOJODDS_WriteFn writefn, void *userdata, size_t len)
+{
+    static const uint8 zeros[256] = { 0 };
+    while (len > 0) {
+        const size_t cpy = MIN(len, sizeof (zeros));
+        if (!writefn(userdata, zeros, (unsigned long) cpy)) {
+            return 0;
+        }
+        len -= cpy;
+    }
+    return 1;
+}
+
+int MOJODDS_write(const MOJODDS_WriteDesc *desc,
+                  const void * const *subresources,
+                  MOJODDS_WriteFn writefn, void *userdata)
+{
+    const MOJODDS_FormatInfo *fmt = find_format(desc->glfmt);
+    const uint32 arraySize = (desc->arraySize == 0) ? 1 : desc->arraySize;
+    const uint32 depth = (desc->textureType == MOJODDS_TEXTURE_VOLUME) ? desc->depth : 1;
+    const int premultiplied = desc->premultiplied ? 1 : 0;
+    uint8 buf[4 + DDS_HEADERSIZE + DDS_HEADERSIZE_DXT10];
+    MOJODDS_Header header;
+    MOJODDS_HeaderDXT10 dx10;
+    MOJODDS_Header parsed;
+    MOJODDS_HeaderDXT10 parseddx10;
+    MOJODDS_Layout layout;
+    MOJODDS_error err;
+    const uint8 *ptr;
+    uint32 miplevels = desc->miplevels;
+    uint32 calcSize = 0;
+    size_t headerlen;
+    size_t len;
+    size_t total;
+    unsigned int face;
+    unsigned int mip;
+    int isDX10;
+
+    if (fmt == NULL) {
+        return 0;
+    } else if ((desc->w == 0) || (desc->h == 0) || (depth == 0)) {
+        return 0;
+    } else if (miplevels == 0) {  // whole chain, down to 1x1(x1).
+        miplevels = uintLog2(MAX(MAX(desc->w, desc->h), depth)) + 1;
+    }
+
+    memset(&header, '\0', sizeof (header));
+    memset(&dx10, '\0', sizeof (dx10));
+
+    isDX10 = desc->dx10 || (arraySize != 1) || !legacy_pixel_format(fmt->glfmt, premultiplied, &header.ddspf);
+    if (isDX10) {
+        if (fmt->dxgiFormat == 0) {
+            return 0;  // only a legacy header can name this one.
+        }
+        header.ddspf.dwSize = DDS_PIXFMTSIZE;
+        header.ddspf.dwFlags = DDPF_FOURCC;
+        header.ddspf.dwFourCC = FOURCC_DX10;
+        dx10.dxgiFormat = fmt->dxgiFormat;
+        dx10.resourceDimension = (desc->textureType == MOJODDS_TEXTURE_VOLUME) ? DDS_DIMENSION_TEXTURE3D : DDS_DIMENSION_TEXTURE2D;
+        dx10.miscFlag = (desc->textureType == MOJODDS_TEXTURE_CUBE) ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+        dx10.arraySize = arraySize;
+        dx10.miscFlags2 = premultiplied ? DDS_ALPHA_MODE_PREMULTIPLIED : 0;
+    }
+
+    header.dwSize = DDS_HEADERSIZE;
+    header.dwFlags = DDSD_REQ | DDSD_MIPMAPCOUNT;
+    header.dwHeight = desc->h;
+    header.dwWidth = desc->w;
+    header.dwMipMapCount = miplevels;
+    header.dwCaps = DDSCAPS_TEXTURE;
+    if (miplevels > 1) {
+        header.dwCaps |= DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+    }
+
+    if (desc->textureType == MOJODDS_TEXTURE_CUBE) {
+        header.dwCaps |= DDSCAPS_COMPLEX;
+        header.dwCaps2 = DDSCAPS2_CUBEMAP |
+                         DDSCAPS2_CUBEMAP_POSITIVEX | DDSCAPS2_CUBEMAP_NEGATIVEX |
+                         DDSCAPS2_CUBEMAP_POSITIVEY | DDSCAPS2_CUBEMAP_NEGATIVEY |
+                         DDSCAPS2_CUBEMAP_POSITIVEZ | DDSCAPS2_CUBEMAP_NEGATIVEZ;
+    } else if (desc->textureType == MOJODDS_TEXTURE_VOLUME) {
+        header.dwFlags |= DDSD_DEPTH;
+        header.dwDepth = depth;
+        header.dwCaps |= DDSCAPS_COMPLEX;
+        header.dwCaps2 = DDSCAPS2_VOLUME;
+    }
+
+    // parse_header() fills in the pitch or linear size we left out, and
+    //  rejects anything it wouldn't load.
+    headerlen = serialize_header(&header, &dx10, isDX10, buf);
+    ptr = buf;
+    len = headerlen;
+    if (!parse_header(&parsed, &parseddx10, &ptr, &len, &layout, &calcSize, &err)) {
+        return 0;
+    } else if ((layout.glfmt != desc->glfmt) || (layout.textureType != desc->textureType)) {
+        return 0;  // not what was asked for; shouldn't happen.
+    } else if ((layout.miplevels != miplevels) || (layout.arraySize != arraySize)) {
+        return 0;
+    } else if (layout.premultiplied != premultiplied) {
+        return 0;
+    }
+
+    header.dwFlags |= parsed.dwFlags & (DDSD_PITCH | DDSD_LINEARSIZE);
+    header.dwPitchOrLinearSize = parsed.dwPitchOrLinearSize;
+    headerlen = serialize_header(&header, &dx10, isDX10, buf);
+    assert(data_needed(&header, &layout, calcSize) == layout.texlen);
+
+    for (face = 0; face < layout.faces * layout.miplevels; face++) {
+        if (subresources[face] == NULL) {
+            return 0;
+        }
+    }
+
+    if (!writefn(userdata, buf, (unsigned long) headerlen)) {
+        return 0;
+    }
+
+    for (face = 0; face < layout.faces; face++) {
+        for (mip = 0; mip < layout.miplevels; mip++) {
+            const void *data = subresources[(face * layout.miplevels) + mip];
+            if (!writefn(userdata, data, layout.mips[mip].len)) {
+                return 0;
+            }
+        }
+    }
+
+    // DDS has no data offset field, so the only padding a reader won't
+    //  trip over is at the end of the file.
+    total = headerlen + layout.texlen;
+    if ((desc->alignment > 1) && ((total % desc->alignment) != 0)) {
+        if (!write_padding(writefn, userdata, desc->alignment - (total % desc->alignment))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 // end of mojodds.c ...
 
@@ -33,6 +33,45 @@ typedef enum MOJODDS_cubeFace
 } MOJODDS_cubeFace;
 
 
+/* Largest mip chain a file can have: one level per bit of a 32-bit dimension. */
+#define MOJODDS_MAX_MIPLEVELS 32
+
+typedef struct MOJODDS_MipLevel
+{
+    unsigned long offset;  /* bytes from the start of the face's mip chain. */
+    unsigned long len;  /* the whole level; all of a volume's slices. */
+    unsigned long slicelen;  /* bytes in one 2D slice; len unless a volume. */
+    unsigned int w;
+    unsigned int h;
+    unsigned int d;  /* slices in this level; 1 unless a volume. */
+} MOJODDS_MipLevel;
+
+/* Everything needed to find any (face, mip) subresource without re-walking
+   the mip chain. Filled in once by MOJODDS_getLayout(). */
+typedef struct MOJODDS_Layout
+{
+    const void *tex;  /* first byte of pixel data (face 0, mip 0). */
+    unsigned long dataoffset;  /* offset of tex from the start of the file. */
+    unsigned long texlen;  /* bytes of pixel data, all faces. */
+    unsigned int glfmt;
+    MOJODDS_textureType textureType;
+    unsigned int w;
+    unsigned int h;
+    unsigned int depth;  /* 1 unless a volume. */
+    unsigned int miplevels;
+    unsigned int arraySize;  /* 1 unless a texture array. */
+    unsigned int faces;  /* arraySize, or 6 * arraySize for cubes. */
+    unsigned long facelen;  /* bytes in one face's whole mip chain. */
+    unsigned int blockDim;  /* pixels per block edge; 1 if uncompressed. */
+    unsigned int blockSize;  /* bytes per block (or per pixel). */
+    unsigned int bitCount;  /* legacy RGB files: bits per pixel... */
+    unsigned int masks[4];  /* ...and the R, G, B, A masks. Zero otherwise. */
+    int premultiplied;  /* color is already multiplied by alpha: DXT2 and
+                           DXT4 files, or a DX10 header that says so. */
+    MOJODDS_MipLevel mips[MOJODDS_MAX_MIPLEVELS];
+} MOJODDS_Layout;
+
+
 int MOJODDS_isDDS(const void *_ptr, const unsigned long _len);
 int MOJODDS_getTexture(const void *_ptr, const unsigned long _len,
                        const void **_tex, unsigned long *_texlen,
@@ -40,6 +79,314 @@ int MOJODDS_getTexture(const void *_ptr, const unsigned long _len,
                        unsigned int *_h, unsigned int *_miplevels,
                        unsigned int *_cubemapfacelen,
                        MOJODDS_textureType *_textureType);
+/* glfmt for legacy RGB files whose masks OpenGL has no packed format for,
+   by bytes per pixel. Unpack them with MOJODDS_unpackMasked(). */
+#define MOJODDS_FORMAT_MASKED8 0x4D440001
+#define MOJODDS_FORMAT_MASKED16 0x4D440002
+#define MOJODDS_FORMAT_MASKED24 0x4D440003
+#define MOJODDS_FORMAT_MASKED32 0x4D440004
+
+/* Block geometry and OpenGL upload parameters for a glfmt reported by this
+   library. _glformat and _gltype are zero for compressed formats; upload
+   those with glCompressedTexImage*() and _glinternal. They're zero for the
+   MOJODDS_FORMAT_MASKED* formats too, along with _glinternal, but those have
+   a _blockDim of 1. Any pointer may be NULL. */
+int MOJODDS_getFormatInfo(unsigned int glfmt, unsigned int *_blockDim,
+                          unsigned int *_blockSize, unsigned int *_glinternal,
+                          unsigned int *_glformat, unsigned int *_gltype);
+int MOJODDS_getLayout(const void *_ptr, const unsigned long _len,
+                      MOJODDS_Layout *_layout);
+/* For a volume this is the whole level, its d slices back to back, which
+   is what glTexImage3D() wants. */
+int MOJODDS_getSubresource(const MOJODDS_Layout *_layout, unsigned int face,
+                           unsigned int miplevel, const void **_tex,
+                           unsigned long *_texlen, unsigned int *_texw,
+                           unsigned int *_texh);
+/* Why a file was rejected. MOJODDS_validate() does what MOJODDS_getLayout()
+   does, but says why it failed, and _ptr only needs to hold the headers:
+   _filelen is the size of the whole file (at least _len), which is what the
+   pixel data is checked against. The layout's tex is NULL unless _len
+   covers the pixel data. */
+typedef enum MOJODDS_error
+{
+    MOJODDS_ERR_NONE,
+    MOJODDS_ERR_NOT_DDS,
+    MOJODDS_ERR_TRUNCATED_HEADER,
+    MOJODDS_ERR_BAD_HEADER,
+    MOJODDS_ERR_BAD_DIMENSIONS,
+    MOJODDS_ERR_BAD_MIPCOUNT,
+    MOJODDS_ERR_UNSUPPORTED_FORMAT,
+    MOJODDS_ERR_UNSUPPORTED_TYPE,
+    MOJODDS_ERR_TOO_BIG,
+    MOJODDS_ERR_TRUNCATED_DATA,
+    MOJODDS_ERR_IO,  /* couldn't open or read it; not from validate(). */
+    MOJODDS_ERR_NO_BUFFER,  /* no staging buffer, or too small. */
+    MOJODDS_ERR_CORRUPT,  /* supercompressed data doesn't decompress. */
+    MOJODDS_ERR_NO_CODEC  /* ...or needs a codec this build doesn't have. */
+} MOJODDS_error;
+MOJODDS_error MOJODDS_validate(const void *_ptr, const unsigned long _len,
+                               const unsigned long _filelen,
+                               MOJODDS_Layout *_layout);
+/* A short English description of err; never NULL. */
+const char *MOJODDS_errorString(MOJODDS_error err);
+
+/* Texture arrays are stored element by element, each element's faces in
+   MOJODDS_cubeFace order; this finds a face of one element without making
+   you do that math. face is always 0 for arrays of 2D textures. The layout
+   was already checked against the file's length, so anything this returns
+   is in bounds. */
+int MOJODDS_getArraySubresource(const MOJODDS_Layout *_layout,
+                                unsigned int element, unsigned int face,
+                                unsigned int miplevel, const void **_tex,
+                                unsigned long *_texlen, unsigned int *_texw,
+                                unsigned int *_texh);
+/* One 2D slice of a volume's mip level; slice counts from 0 to the level's
+   d. Other textures have just slice 0 (of face 0). */
+int MOJODDS_getVolumeSlice(const MOJODDS_Layout *_layout, unsigned int miplevel,
+                           unsigned int slice, const void **_tex,
+                           unsigned long *_texlen, unsigned int *_texw,
+                           unsigned int *_texh);
+
+/* Partial loading, say for quality tiers: read only mips N..last. Give
+   MOJODDS_getHeaderLayout() just the start of the file (MOJODDS_HEADER_MAXLEN
+   bytes covers the headers); the layout it returns has a NULL tex.
+   MOJODDS_planMipLoad() then picks the biggest level no larger than maxdim
+   pixels on a side (or deep), whose chain fits in budget bytes (over all
+   faces); zero means no limit. It fills in the file byte ranges to read, in
+   order, and _planned, which describes those ranges read back to back into
+   one buffer with the chosen level as level 0: point its tex at that buffer
+   and use it with MOJODDS_getSubresource(). Adjacent ranges are merged;
+   room for layout->faces of them is always enough. Returns zero if no level
+   fits, or more than maxranges would be needed. */
+#define MOJODDS_HEADER_MAXLEN 148
+typedef struct MOJODDS_ByteRange
+{
+    unsigned long offset;  /* bytes from the start of the file. */
+    unsigned long len;
+} MOJODDS_ByteRange;
+int MOJODDS_getHeaderLayout(const void *_ptr, const unsigned long _len,
+                            MOJODDS_Layout *_layout);
+int MOJODDS_planMipLoad(const MOJODDS_Layout *_layout, unsigned int maxdim,
+                        unsigned long budget, MOJODDS_ByteRange *_ranges,
+                        unsigned int maxranges, unsigned int *_rangecount,
+                        MOJODDS_Layout *_planned);
+
+/* Incremental parsing, for when the file is still arriving. Feed it chunks
+   of any size, in order, with MOJODDS_streamData(). The layout callback fires
+   once the headers are in (128 bytes, or 148 with a DX10 header); its tex
+   points at a buffer the stream owns, which fills in as data arrives. The
+   subresource callback fires as each (face, mip) becomes complete; pass
+   them to MOJODDS_getSubresource(). Either callback may be NULL.
+   MOJODDS_streamData() returns zero once the file is known to be bad (or
+   out of memory); the layout and data stay valid until the stream is
+   destroyed. */
+typedef struct MOJODDS_Stream MOJODDS_Stream;
+typedef void (*MOJODDS_StreamLayoutFn)(void *userdata,
+                                       const MOJODDS_Layout *layout);
+typedef void (*MOJODDS_StreamSubresourceFn)(void *userdata,
+                                            const MOJODDS_Layout *layout,
+                                            unsigned int face,
+                                            unsigned int miplevel);
+MOJODDS_Stream *MOJODDS_createStream(MOJODDS_StreamLayoutFn layoutfn,
+                                     MOJODDS_StreamSubresourceFn subresourcefn,
+                                     void *userdata);
+int MOJODDS_streamData(MOJODDS_Stream *stream, const void *_data,
+                       unsigned long _len);
+/* NULL until the headers have been parsed. */
+const MOJODDS_Layout *MOJODDS_getStreamLayout(const MOJODDS_Stream *stream);
+/* Nonzero once every subresource has arrived. */
+int MOJODDS_streamComplete(const MOJODDS_Stream *stream);
+void MOJODDS_destroyStream(MOJODDS_Stream *stream);
+
+/* Memory-mapped files. MOJODDS_openFile() maps the whole file read-only and
+   returns NULL on failure (errno says why, except on Windows). Hand the
+   bytes from MOJODDS_getFileData() to MOJODDS_getLayout() and the
+   subresource pointers it gives you point straight into the mapping; they're
+   valid until MOJODDS_close(). The prefetch/release calls are hints to the
+   OS for mips [firstmip, firstmip+mipcount) of one face of that layout: warm
+   the levels you're about to upload, drop the ones you're done with. They
+   return zero if the range isn't in the layout, or the layout isn't of this
+   file. */
+typedef struct MOJODDS_File MOJODDS_File;
+MOJODDS_File *MOJODDS_openFile(const char *path);
+const void *MOJODDS_getFileData(const MOJODDS_File *file, unsigned long *_len);
+int MOJODDS_prefetchMips(const MOJODDS_File *file,
+                         const MOJODDS_Layout *layout, unsigned int face,
+                         unsigned int firstmip, unsigned int mipcount);
+int MOJODDS_releaseMips(const MOJODDS_File *file,
+                        const MOJODDS_Layout *layout, unsigned int face,
+                        unsigned int firstmip, unsigned int mipcount);
+void MOJODDS_close(MOJODDS_File *file);
+
+/* Asynchronous loading, so a cold read doesn't stall the thread that wants
+   the texture. Submit a file by path or open fd, or just the byte range of
+   one that a DDS file sits in (say, inside a pack), with MOJODDS_load().
+   The loader reads the headers, plans the read as MOJODDS_planMipLoad()
+   would for levels firstmip and down (the last level if there aren't that
+   many), reads them into a staging buffer and calls back with the planned
+   layout, its tex pointing into that buffer. The buffer is the request's
+   if it has one; otherwise bufferfn is asked for len bytes once the layout
+   is known, and may return NULL to give up. Either way it's handed back to
+   the callback, which gets a NULL layout and the reason on failure.
+
+   Requests wait in order of firstmip, highest first, so the small levels of
+   everything arrive before the big levels of anything; ties go in the order
+   they were submitted. On Linux, reads go through io_uring with up to
+   queuedepth in flight on one loader thread, when the kernel allows it;
+   elsewhere, or with MOJODDS_LOADER_PREAD, threads workers each read one
+   request at a time with pread(). Pass 0 for either for a default (32, and
+   one thread per CPU). Callbacks run on loader threads, so keep them short;
+   they may submit more requests. MOJODDS_load() copies the request and
+   returns zero if it's malformed or out of memory, in which case there's no
+   callback. MOJODDS_waitLoader() returns once every request submitted so
+   far has called back; don't call it from a callback.
+   MOJODDS_destroyLoader() waits the same way first. */
+#define MOJODDS_LOADER_PREAD (1 << 0)
+typedef struct MOJODDS_Loader MOJODDS_Loader;
+typedef void *(*MOJODDS_LoadBufferFn)(void *userdata,
+                                      const MOJODDS_Layout *layout,
+                                      unsigned long len);
+typedef void (*MOJODDS_LoadFn)(void *userdata, MOJODDS_error err,
+                               const MOJODDS_Layout *layout, void *buffer);
+typedef struct MOJODDS_LoadRequest
+{
+    const char *path;  /* file to open, or NULL to read fd. */
+    int fd;  /* must stay open until the callback. */
+    unsigned long offset;  /* where the DDS file starts in it. */
+    unsigned long len;  /* its length; 0 for the rest of the file. */
+    unsigned int firstmip;  /* skip this many of the biggest levels. */
+    void *buffer;  /* caller's staging buffer, or NULL to use bufferfn. */
+    unsigned long bufferlen;
+    MOJODDS_LoadBufferFn bufferfn;
+    MOJODDS_LoadFn callback;
+    void *userdata;
+} MOJODDS_LoadRequest;
+MOJODDS_Loader *MOJODDS_createLoader(unsigned int threads,
+                                     unsigned int queuedepth,
+                                     unsigned int flags);
+/* "io_uring" or "pread". */
+const char *MOJODDS_getLoaderBackend(const MOJODDS_Loader *loader);
+int MOJODDS_load(MOJODDS_Loader *loader, const MOJODDS_LoadRequest *req);
+void MOJODDS_waitLoader(MOJODDS_Loader *loader);
+void MOJODDS_destroyLoader(MOJODDS_Loader *loader);
+
+/* Caching parsed layouts, for code that looks at the same files again and
+   again. MOJODDS_getCachedLayout() is MOJODDS_validate() for a whole file
+   in memory, keyed on its headers and length, so the same bytes anywhere
+   hit. MOJODDS_getCachedFileLayout() is keyed on the path, size and
+   modification time, so a hit is one stat() and a changed file misses; it
+   reads just the headers on a miss, and the layout's tex is NULL, as with
+   MOJODDS_getHeaderLayout(). Failures are cached as well; MOJODDS_ERR_IO
+   means the file couldn't be read. The cache takes up about budget bytes,
+   allocated up front, and when full evicts roughly the least recently used
+   entry. Lookups from any number of threads don't take a lock. */
+typedef struct MOJODDS_LayoutCache MOJODDS_LayoutCache;
+typedef struct MOJODDS_LayoutCacheStats
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long entries;
+    unsigned long bytes;  /* used by those entries. */
+} MOJODDS_LayoutCacheStats;
+MOJODDS_LayoutCache *MOJODDS_createLayoutCache(unsigned long budget);
+MOJODDS_error MOJODDS_getCachedLayout(MOJODDS_LayoutCache *cache,
+                                      const void *_ptr,
+                                      const unsigned long _len,
+                                      MOJODDS_Layout *_layout);
+MOJODDS_error MOJODDS_getCachedFileLayout(MOJODDS_LayoutCache *cache,
+                                          const char *path,
+                                          MOJODDS_Layout *_layout);
+void MOJODDS_getLayoutCacheStats(MOJODDS_LayoutCache *cache,
+                                 MOJODDS_LayoutCacheStats *stats);
+void MOJODDS_destroyLayoutCache(MOJODDS_LayoutCache *cache);
+
+/* Writing files. Describe the texture and hand over one pointer per
+   subresource, in file order: each face's (or array element's) whole mip
+   chain, one face after another, so subresources[face * miplevels + mip].
+   Each holds exactly the bytes MOJODDS_getSubresource() would report for
+   it. Set miplevels to 0 for a full chain and arraySize to 0 or 1 for a
+   single texture. Formats that a pre-DX10 header can describe get one
+   unless dx10 is nonzero; arrays always get a DX10 header. If alignment is
+   more than 1, the end of the file is padded with zeros to a multiple of it,
+   for reading the whole thing with O_DIRECT; DDS has nowhere to put padding
+   before the pixel data, which always starts 128 or 148 bytes in.
+   premultiplied marks the color as multiplied by alpha: BC2 and BC3 become
+   DXT2 and DXT4, and anything else needs a DX10 header to say so. The
+   callback returns zero to abort. MOJODDS_write*() return zero if the
+   description isn't something MOJODDS_getLayout() would accept, or on write
+   failure. */
+typedef struct MOJODDS_WriteDesc
+{
+    unsigned int glfmt;
+    MOJODDS_textureType textureType;
+    unsigned int w;
+    unsigned int h;
+    unsigned int depth;  /* volumes only. */
+    unsigned int miplevels;
+    unsigned int arraySize;
+    int dx10;
+    unsigned int alignment;
+    int premultiplied;
+} MOJODDS_WriteDesc;
+typedef int (*MOJODDS_WriteFn)(void *userdata, const void *data,
+                               unsigned long len);
+int MOJODDS_write(const MOJODDS_WriteDesc *desc,
+                  const void * const *subresources,
+                  MOJODDS_WriteFn writefn, void *userdata);
+/* Same, to a file descriptor (from open(), or _open() on Windows). */
+int MOJODDS_writeFd(const MOJODDS_WriteDesc *desc,
+                    const void * const *subresources, int fd);
+
+/* Texture packs: lots of DDS files in one, so loading a level is one open()
+   and one mapping instead of thousands. MOJODDS_writePack() stores each
+   file whole, placed so its pixel data starts on a multiple of alignment (a
+   power of two; 4096 puts every texture on its own pages), with an index
+   sorted by name that holds each file's layout and an XXH64 hash of its
+   bytes. Files with identical bytes are stored once. It returns zero if any
+   file isn't one MOJODDS_getLayout() accepts, two share a name, or on write
+   failure.
+
+   MOJODDS_openPack() maps a pack and checks its index, and returns NULL if
+   it can't be read or isn't a well-formed pack. MOJODDS_findPackEntry()
+   binary searches the names; entries are numbered from zero in name order.
+   MOJODDS_getPackEntry() fills in the layout without touching the file's own
+   pages, its tex pointing into the mapping, so MOJODDS_getSubresource()
+   works on it as on any other; data and len are the whole DDS file, for
+   MOJODDS_getTexture() and friends. Everything stays valid until
+   MOJODDS_closePack(). MOJODDS_checkPackEntry() hashes an entry's bytes and
+   returns nonzero if they match the index. */
+typedef struct MOJODDS_Pack MOJODDS_Pack;
+typedef struct MOJODDS_PackInput
+{
+    const char *name;
+    const void *data;  /* the whole .dds file. */
+    unsigned long len;
+} MOJODDS_PackInput;
+typedef struct MOJODDS_PackEntry
+{
+    const char *name;
+    const void *data;
+    unsigned long len;
+    unsigned long long hash;
+    MOJODDS_Layout layout;
+} MOJODDS_PackEntry;
+int MOJODDS_writePack(const MOJODDS_PackInput *inputs, unsigned int count,
+                      unsigned int alignment, MOJODDS_WriteFn writefn,
+                      void *userdata);
+/* Same, to a file descriptor. */
+int MOJODDS_writePackFd(const MOJODDS_PackInput *inputs, unsigned int count,
+                        unsigned int alignment, int fd);
+MOJODDS_Pack *MOJODDS_openPack(const char *path);
+unsigned int MOJODDS_getPackCount(const MOJODDS_Pack *pack);
+unsigned int MOJODDS_getPackAlignment(const MOJODDS_Pack *pack);
+int MOJODDS_findPackEntry(const MOJODDS_Pack *pack, const char *name,
+                          unsigned int *_index);
+int MOJODDS_getPackEntry(const MOJODDS_Pack *pack, unsigned int index,
+                         MOJODDS_PackEntry *_entry);
+int MOJODDS_checkPackEntry(const MOJODDS_Pack *pack, unsigned int index);
+void MOJODDS_closePack(MOJODDS_Pack *pack);
+
 int MOJODDS_getMipMapTexture(unsigned int miplevel, unsigned int glfmt,
                              const void *_basetex,
                              unsigned int w, unsigned h,
@@ -52,6 +399,230 @@ int MOJODDS_getCubeFace(MOJODDS_cubeFace cubeFace, unsigned int miplevel,
                         const void **_tex, unsigned long *_texlen,
                         unsigned int *_texw, unsigned int *_texh);
 
+
+/* A rectangle of a mip level to copy out, in pixels. x and y must be
+   multiples of the format's blockDim, and so must w and h unless the rect
+   runs to the level's right or bottom edge. dst gets one row of blocks (or
+   pixels) every dstpitch bytes, compressed data copied as-is. */
+typedef struct MOJODDS_CopyRect
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int w;
+    unsigned int h;
+    void *dst;
+    unsigned long dstpitch;
+} MOJODDS_CopyRect;
+
+/* Copy rect out of a w*h level (say, from MOJODDS_getMipMapTexture) without
+   decoding it. Returns zero if the rect is misaligned, off the edge or
+   dstpitch is too small, or if _srclen is too small. */
+int MOJODDS_copyRect(unsigned int glfmt, const void *_src,
+                     unsigned long _srclen, unsigned int w, unsigned int h,
+                     const MOJODDS_CopyRect *rect);
+/* The same for count rects at once, say every virtual texture page of a
+   level, in one pass down the source. All the rects are checked before
+   anything is copied. Also returns zero if out of memory. */
+int MOJODDS_copyRects(unsigned int glfmt, const void *_src,
+                      unsigned long _srclen, unsigned int w, unsigned int h,
+                      const MOJODDS_CopyRect *rects, unsigned int count);
+
+/* Atlas packing: put count rects of the given w and h somewhere in a w*h
+   area without overlapping, and fill in their x and y. Positions are
+   multiples of align, a power of two, and each rect takes up its size
+   rounded up to align; pass blockDim << (miplevels - 1) and every mip level
+   of every rect stays on block boundaries, so MOJODDS_copyRect() can fill
+   the atlas in without decoding anything. Returns zero if they don't all
+   fit (some x and y may have been set anyway), or if out of memory. */
+typedef struct MOJODDS_PackRect
+{
+    unsigned int w;
+    unsigned int h;
+    unsigned int x;
+    unsigned int y;
+} MOJODDS_PackRect;
+int MOJODDS_packRects(MOJODDS_PackRect *rects, unsigned int count,
+                      unsigned int w, unsigned int h, unsigned int align);
+
+/* DDS rows go top to bottom, but OpenGL's texture origin is the bottom
+   left; flip a w*h level (say, from MOJODDS_getMipMapTexture, cast away the
+   const) upside down in place to make them agree. Block-compressed levels
+   are flipped without decoding them, which works for BC1 through BC5 when h
+   is a multiple of 4 or less than 4. Returns zero for other heights, for
+   BC6H and BC7, or if _texlen is too small. Do a volume one slice at a time. */
+int MOJODDS_flipVertical(unsigned int glfmt, void *_tex, unsigned long _texlen,
+                         unsigned int w, unsigned int h);
+
+
+/* Software decoding, for when the GPU can't take the data as-is. */
+typedef enum MOJODDS_decodeFormat
+{
+    MOJODDS_DECODE_RGBA8,   /* 4 bytes per pixel: R, G, B, A. */
+    MOJODDS_DECODE_RGBA16F, /* 8 bytes per pixel: half floats, A is 1.0. */
+    MOJODDS_DECODE_RGBA32F, /* 16 bytes per pixel: floats, A is 1.0. */
+    MOJODDS_DECODE_NORMAL8  /* 4 bytes per pixel: X, Y, rebuilt Z, 255. */
+} MOJODDS_decodeFormat;
+
+/* Worker threads for the functions that can split their work up. Pass 0
+   threads for one per CPU. Every function that takes a pool accepts NULL,
+   which does all the work on the calling thread. */
+typedef struct MOJODDS_ThreadPool MOJODDS_ThreadPool;
+MOJODDS_ThreadPool *MOJODDS_createThreadPool(unsigned int threads);
+void MOJODDS_destroyThreadPool(MOJODDS_ThreadPool *pool);
+
+/* SSE2/AVX2/NEON paths are used when the CPU has them; pass zero to force
+   the scalar reference code. Returns the previous setting. Not thread safe;
+   set it before decoding or encoding anything. */
+int MOJODDS_useSIMD(int enable);
+
+/* Decode one w*h mip level (say, from MOJODDS_getMipMapTexture) to dstfmt.
+   Rows are written _dstpitch bytes apart. BC1/BC2/BC3 (DXT) and BC7 decode
+   to RGBA8, sRGB variants included (no conversion is done); BC6H decodes to
+   RGBA16F or RGBA32F. Unsigned BC4 decodes to RGBA8 as (r, 0, 0, 255) and
+   unsigned BC5 as (r, g, 0, 255), or to NORMAL8, which fills in blue with
+   the Z of a unit normal. Returns zero for anything else. */
+int MOJODDS_decode(unsigned int glfmt, const void *_src, unsigned long _srclen,
+                   unsigned int w, unsigned int h,
+                   MOJODDS_decodeFormat dstfmt, void *_dst,
+                   unsigned long _dstpitch, MOJODDS_ThreadPool *pool);
+
+/* Convert a decoded w*h RGBA8 or RGBA32F image, rows _pitch bytes apart,
+   between straight and premultiplied alpha in place; say, DXT2 and DXT4
+   files (a layout with premultiplied set) for a pipeline that blends the
+   other way. RGBA8 rounds to nearest and clamps at 255; color with zero
+   alpha becomes zero when unpremultiplied. Alpha itself isn't touched.
+   Returns zero for RGBA16F, or if _pitch is too small. */
+int MOJODDS_premultiplyAlpha(MOJODDS_decodeFormat fmt, void *_pixels,
+                             unsigned int w, unsigned int h,
+                             unsigned long _pitch, MOJODDS_ThreadPool *pool);
+int MOJODDS_unpremultiplyAlpha(MOJODDS_decodeFormat fmt, void *_pixels,
+                               unsigned int w, unsigned int h,
+                               unsigned long _pitch, MOJODDS_ThreadPool *pool);
+
+/* Convert count IEEE half floats at _src to floats at _dst, or back; say,
+   between RGBA16F and RGBA32F pixels (count is four per pixel). Floats
+   round to the nearest half, ties to even, the way F16C and NEON do it:
+   too big becomes infinity and NaNs stay NaN. _src and _dst mustn't
+   overlap. Returns zero if count is zero. */
+int MOJODDS_halfToFloat(const void *_src, void *_dst, unsigned long count,
+                        MOJODDS_ThreadPool *pool);
+int MOJODDS_floatToHalf(const void *_src, void *_dst, unsigned long count,
+                        MOJODDS_ThreadPool *pool);
+
+/* Pack count RGBA32F pixels at _src into 4 bytes each at _dst, dropping
+   alpha, to keep HDR images (say, environment probes) at a quarter of the
+   size. RGBE is Radiance's: R, G and B bytes sharing an exponent byte.
+   R11G11B10F is GL_R11F_G11F_B10F (DXGI_FORMAT_R11G11B10_FLOAT), so it can
+   be uploaded or written back out with MOJODDS_write(); it rounds to
+   nearest even. Neither has a sign bit, so negatives and NaNs become zero,
+   and anything too big becomes the biggest value they can hold. _src and
+   _dst mustn't overlap. Returns zero if count is zero. */
+int MOJODDS_floatToRGBE(const void *_src, void *_dst, unsigned long count,
+                        MOJODDS_ThreadPool *pool);
+int MOJODDS_floatToR11G11B10F(const void *_src, void *_dst, unsigned long count,
+                              MOJODDS_ThreadPool *pool);
+
+/* Unpack a w*h image of a legacy RGB file (a MOJODDS_Layout's bitCount and
+   masks) to RGBA8, rows _dstpitch bytes apart. Source rows are packed, as
+   MOJODDS_getMipMapTexture() returns them. Channels are scaled to 0-255 with
+   rounding; a missing color channel is 0 and missing alpha is 255. Returns
+   zero for masks a DDS file can't have, or if _srclen is too small. */
+int MOJODDS_unpackMasked(unsigned int bitCount, const unsigned int *masks,
+                         const void *_src, unsigned long _srclen,
+                         unsigned int w, unsigned int h, void *_dst,
+                         unsigned long _dstpitch, MOJODDS_ThreadPool *pool);
+
+/* Block compression, for baking textures in your own tools. FAST takes each
+   block's endpoints from its bounding box; HIGH does a cluster fit and is
+   much slower. */
+typedef enum MOJODDS_encodeQuality
+{
+    MOJODDS_ENCODE_FAST,
+    MOJODDS_ENCODE_HIGH
+} MOJODDS_encodeQuality;
+
+/* Compress one w*h RGBA8 image, rows _srcpitch bytes apart, to BC1 or BC3
+   (DXT1 or DXT5, sRGB variants included; no conversion is done). _dst gets
+   the level's blocks in the same order MOJODDS_getMipMapTexture() and
+   friends expect, so it can point straight into a mip chain you're laying
+   out for MOJODDS_write(). BC1 makes pixels with alpha under 128 transparent.
+   Returns zero for other formats, or if _dstlen is too small. */
+int MOJODDS_encode(unsigned int glfmt, const void *_src,
+                   unsigned long _srcpitch, unsigned int w, unsigned int h,
+                   MOJODDS_encodeQuality quality, void *_dst,
+                   unsigned long _dstlen, MOJODDS_ThreadPool *pool);
+
+/* Bytes taken by the first miplevels levels of a w*h texture, packed the way
+   MOJODDS_getMipMapTexture() walks them. Pass 0 miplevels for the full chain
+   down to 1x1. Returns zero for unknown formats. */
+unsigned long MOJODDS_getMipChainSize(unsigned int glfmt, unsigned int w,
+                                      unsigned int h, unsigned int miplevels);
+
+/* Mipmap generation, for files that ship with only the top level. BOX
+   averages the pixels each output pixel covers; KAISER and LANCZOS are
+   windowed sincs that keep more detail but can ring a little. */
+typedef enum MOJODDS_mipFilter
+{
+    MOJODDS_MIPFILTER_BOX,
+    MOJODDS_MIPFILTER_KAISER,
+    MOJODDS_MIPFILTER_LANCZOS
+} MOJODDS_mipFilter;
+
+typedef struct MOJODDS_MipDesc
+{
+    MOJODDS_mipFilter filter;
+    int srgb;        /* nonzero if color is sRGB; filters in linear light. */
+    float alphaRef;  /* if > 0, scale each level's alpha so as many pixels
+                        reach alphaRef (0 to 1) as in the top level, which
+                        keeps alpha-tested edges from thinning out. */
+} MOJODDS_MipDesc;
+
+/* Build the full mip chain for a w*h GL_BGRA, GL_BGR, GL_LUMINANCE_ALPHA,
+   GL_LUMINANCE8 or GL_ALPHA8 image at _tex into _dst, laid out as
+   MOJODDS_getMipMapTexture() expects, top level included. _dst needs
+   MOJODDS_getMipChainSize(glfmt, w, h, 0) bytes, and may be _tex itself if
+   it's that big. *_miplevels gets the number of levels. Returns zero for
+   other formats, a short buffer or if out of memory. */
+int MOJODDS_generateMips(unsigned int glfmt, const void *_tex,
+                         unsigned int w, unsigned int h,
+                         const MOJODDS_MipDesc *desc, void *_dst,
+                         unsigned long _dstlen, unsigned int *_miplevels,
+                         MOJODDS_ThreadPool *pool);
+
+/* Supercompression: a DDS file with its pixel data further squeezed by a
+   general-purpose codec, for install size and cold-load I/O. Every level of
+   every face is compressed on its own, in chunks, so MOJODDS_decompress()
+   can unpack just levels firstmip and down (the last level if there aren't
+   that many), spread over pool's threads, straight into _dst. They land as
+   MOJODDS_planMipLoad() lays them out: call
+   MOJODDS_getSupercompressedLayout() first for that layout, whose texlen is
+   how big _dst must be. The layout MOJODDS_decompress() fills in has its
+   tex at _dst, for MOJODDS_getSubresource() and friends.
+
+   LZ4 is built in; zstd needs libzstd and MOJODDS_HAVE_ZSTD defined when
+   building. level is zstd's (0 for its default); LZ4 ignores it.
+   MOJODDS_writeSupercompressed() takes a whole .dds file and returns zero
+   if it isn't one MOJODDS_validate() accepts, for a codec this build
+   doesn't have, or on write failure. Chunks that don't shrink are stored. */
+#define MOJODDS_CODEC_STORED 0
+#define MOJODDS_CODEC_LZ4 1
+#define MOJODDS_CODEC_ZSTD 2
+int MOJODDS_haveCodec(unsigned int codec);
+int MOJODDS_writeSupercompressed(const void *_ptr, const unsigned long _len,
+                                 unsigned int codec, int level,
+                                 MOJODDS_ThreadPool *pool,
+                                 MOJODDS_WriteFn writefn, void *userdata);
+int MOJODDS_isSupercompressed(const void *_ptr, const unsigned long _len);
+MOJODDS_error MOJODDS_getSupercompressedLayout(const void *_ptr,
+                                               const unsigned long _len,
+                                               unsigned int firstmip,
+                                               MOJODDS_Layout *_layout);
+MOJODDS_error MOJODDS_decompress(const void *_ptr, const unsigned long _len,
+                                 unsigned int firstmip, void *_dst,
+                                 unsigned long _dstlen,
+                                 MOJODDS_ThreadPool *pool,
+                                 MOJODDS_Layout *_layout);
+
 #ifdef __cplusplus
 }
 #endif
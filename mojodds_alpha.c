@@ -0,0 +1,431 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Converting decoded images between straight and premultiplied alpha, and
+//  the MOJODDS_premultiplyAlpha() and MOJODDS_unpremultiplyAlpha() entry
+//  points.
+//
+// This happens after decoding rather than on the blocks: a BC2 or BC3 block
+//  has one pair of color endpoints for sixteen pixels with sixteen different
+//  alphas, so there's no block that decodes to the converted pixels.
+//
+// RGBA8 premultiplies to round(c * a / 255), which ((t + (t >> 8)) >> 8)
+//  with t = c * a + 128 gets exactly for every input. Unpremultiplying is
+//  round(c * 255 / a), clamped to 255; the SIMD kernels do that division in
+//  single precision, which gives the same answer as the integer division for
+//  every c and a (checked exhaustively), since c * 255 is exact and the
+//  quotient is nowhere near a rounding boundary it could cross. Alpha is
+//  left alone, and color with zero alpha becomes zero.
+
+#include <string.h>
+#include <assert.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#include <immintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*alpha_fn)(uint8 *row, unsigned int pixels);
+
+
+// Scalar reference kernels...
+
+static void premultiply_rgba8_scalar(uint8 *row, unsigned int pixels)
+{
+    for (; pixels > 0; pixels--, row += 4) {
+        const uint32 a = row[3];
+        int i;
+        for (i = 0; i < 3; i++) {
+            const uint32 t = (row[i] * a) + 128;
+            row[i] = (uint8) ((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+static void unpremultiply_rgba8_scalar(uint8 *row, unsigned int pixels)
+{
+    for (; pixels > 0; pixels--, row += 4) {
+        const uint32 a = row[3];
+        int i;
+        for (i = 0; i < 3; i++) {
+            const uint32 c = (a == 0) ? 0 : (((row[i] * 255) + (a / 2)) / a);
+            row[i] = (uint8) MIN(c, 255);
+        }
+    }
+}
+
+static void premultiply_rgba32f_scalar(uint8 *row, unsigned int pixels)
+{
+    for (; pixels > 0; pixels--, row += 16) {
+        float px[4];
+        int i;
+        memcpy(px, row, sizeof (px));
+        for (i = 0; i < 3; i++) {
+            px[i] *= px[3];
+        }
+        memcpy(row, px, sizeof (px));
+    }
+}
+
+static void unpremultiply_rgba32f_scalar(uint8 *row, unsigned int pixels)
+{
+    for (; pixels > 0; pixels--, row += 16) {
+        float px[4];
+        int i;
+        memcpy(px, row, sizeof (px));
+        for (i = 0; i < 3; i++) {
+            px[i] = (px[3] == 0.0f) ? 0.0f : (px[i] / px[3]);
+        }
+        memcpy(row, px, sizeof (px));
+    }
+}
+
+
+#ifdef MOJODDS_HAVE_X86
+
+// Two pixels in 16-bit lanes, each multiplied by its own alpha and divided
+//  by 255 with rounding. The alpha lanes come out wrong; callers put the
+//  original alpha back.
+static MOJODDS_TARGET("sse2") __m128i sse2_premultiply2(const __m128i px)
+{
+    const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i t = _mm_add_epi16(_mm_mullo_epi16(px, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static MOJODDS_TARGET("sse2") void premultiply_rgba8_sse2(uint8 *row, unsigned int pixels)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphamask = _mm_set1_epi32((int) 0xFF000000);
+
+    for (; pixels >= 4; pixels -= 4, row += 16) {
+        const __m128i px = _mm_loadu_si128((const __m128i *) row);
+        const __m128i lo = sse2_premultiply2(_mm_unpacklo_epi8(px, zero));
+        const __m128i hi = sse2_premultiply2(_mm_unpackhi_epi8(px, zero));
+        const __m128i rgb = _mm_andnot_si128(alphamask, _mm_packus_epi16(lo, hi));
+        _mm_storeu_si128((__m128i *) row, _mm_or_si128(rgb, _mm_and_si128(px, alphamask)));
+    }
+
+    premultiply_rgba8_scalar(row, pixels);
+}
+
+// One pixel in 32-bit lanes, divided by its alpha. Zero alpha gives zero;
+//  anything over 255 saturates when the caller packs it.
+static MOJODDS_TARGET("sse2") __m128i sse2_unpremultiply1(const __m128i px)
+{
+    const __m128 f = _mm_cvtepi32_ps(px);
+    const __m128 a = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128 q = _mm_div_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f)), a);
+    const __m128i c = _mm_cvttps_epi32(_mm_add_ps(q, _mm_set1_ps(0.5f)));
+    return _mm_and_si128(c, _mm_castps_si128(_mm_cmpneq_ps(a, _mm_setzero_ps())));
+}
+
+static MOJODDS_TARGET("sse2") void unpremultiply_rgba8_sse2(uint8 *row, unsigned int pixels)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphamask = _mm_set1_epi32((int) 0xFF000000);
+
+    for (; pixels >= 4; pixels -= 4, row += 16) {
+        const __m128i px = _mm_loadu_si128((const __m128i *) row);
+        const __m128i lo = _mm_unpacklo_epi8(px, zero);
+        const __m128i hi = _mm_unpackhi_epi8(px, zero);
+        const __m128i p01 = _mm_packs_epi32(sse2_unpremultiply1(_mm_unpacklo_epi16(lo, zero)),
+                                            sse2_unpremultiply1(_mm_unpackhi_epi16(lo, zero)));
+        const __m128i p23 = _mm_packs_epi32(sse2_unpremultiply1(_mm_unpacklo_epi16(hi, zero)),
+                                            sse2_unpremultiply1(_mm_unpackhi_epi16(hi, zero)));
+        const __m128i rgb = _mm_andnot_si128(alphamask, _mm_packus_epi16(p01, p23));
+        _mm_storeu_si128((__m128i *) row, _mm_or_si128(rgb, _mm_and_si128(px, alphamask)));
+    }
+
+    unpremultiply_rgba8_scalar(row, pixels);
+}
+
+static MOJODDS_TARGET("sse2") void premultiply_rgba32f_sse2(uint8 *row, unsigned int pixels)
+{
+    const __m128 alphamask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+    for (; pixels > 0; pixels--, row += 16) {
+        const __m128 px = _mm_loadu_ps((const float *) row);
+        const __m128 a = _mm_shuffle_ps(px, px, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 rgb = _mm_andnot_ps(alphamask, _mm_mul_ps(px, a));
+        _mm_storeu_ps((float *) row, _mm_or_ps(rgb, _mm_and_ps(px, alphamask)));
+    }
+}
+
+static MOJODDS_TARGET("sse2") void unpremultiply_rgba32f_sse2(uint8 *row, unsigned int pixels)
+{
+    const __m128 alphamask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+    for (; pixels > 0; pixels--, row += 16) {
+        const __m128 px = _mm_loadu_ps((const float *) row);
+        const __m128 a = _mm_shuffle_ps(px, px, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 nonzero = _mm_cmpneq_ps(a, _mm_setzero_ps());
+        const __m128 rgb = _mm_andnot_ps(alphamask, _mm_and_ps(_mm_div_ps(px, a), nonzero));
+        _mm_storeu_ps((float *) row, _mm_or_ps(rgb, _mm_and_ps(px, alphamask)));
+    }
+}
+
+
+static MOJODDS_TARGET("avx2") __m256i avx2_premultiply4(const __m256i px)
+{
+    const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px, a), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// Unpacking and packing within each 128-bit half puts every pixel back
+//  where it came from.
+static MOJODDS_TARGET("avx2") void premultiply_rgba8_avx2(uint8 *row, unsigned int pixels)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphamask = _mm256_set1_epi32((int) 0xFF000000);
+
+    for (; pixels >= 8; pixels -= 8, row += 32) {
+        const __m256i px = _mm256_loadu_si256((const __m256i *) row);
+        const __m256i lo = avx2_premultiply4(_mm256_unpacklo_epi8(px, zero));
+        const __m256i hi = avx2_premultiply4(_mm256_unpackhi_epi8(px, zero));
+        const __m256i rgb = _mm256_andnot_si256(alphamask, _mm256_packus_epi16(lo, hi));
+        _mm256_storeu_si256((__m256i *) row, _mm256_or_si256(rgb, _mm256_and_si256(px, alphamask)));
+    }
+
+    premultiply_rgba8_sse2(row, pixels);
+}
+
+// Eight pixels at once, one channel per vector: the divide is the slow part,
+//  so do it on whole vectors of color.
+static MOJODDS_TARGET("avx2") void unpremultiply_rgba8_avx2(uint8 *row, unsigned int pixels)
+{
+    const __m256i bytemask = _mm256_set1_epi32(0xFF);
+    const __m256i alphamask = _mm256_set1_epi32((int) 0xFF000000);
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (; pixels >= 8; pixels -= 8, row += 32) {
+        const __m256i px = _mm256_loadu_si256((const __m256i *) row);
+        const __m256 a = _mm256_cvtepi32_ps(_mm256_srli_epi32(px, 24));
+        const __m256 nonzero = _mm256_cmp_ps(a, zero, _CMP_NEQ_OQ);
+        __m256i out = _mm256_and_si256(px, alphamask);
+        int i;
+
+        for (i = 0; i < 3; i++) {
+            const __m256i c = _mm256_and_si256(_mm256_srli_epi32(px, i * 8), bytemask);
+            const __m256 q = _mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c), scale), a);
+            __m256i v = _mm256_cvttps_epi32(_mm256_add_ps(q, half));
+            v = _mm256_and_si256(v, _mm256_castps_si256(nonzero));
+            v = _mm256_min_epi32(v, bytemask);
+            out = _mm256_or_si256(out, _mm256_slli_epi32(v, i * 8));
+        }
+        _mm256_storeu_si256((__m256i *) row, out);
+    }
+
+    unpremultiply_rgba8_sse2(row, pixels);
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+
+#ifdef MOJODDS_HAVE_NEON
+
+static void premultiply_rgba8_neon(uint8 *row, unsigned int pixels)
+{
+    for (; pixels >= 8; pixels -= 8, row += 32) {
+        uint8x8x4_t px = vld4_u8(row);
+        int i;
+        for (i = 0; i < 3; i++) {
+            // (t + ((t + 128) >> 8) + 128) >> 8, with t = c * a.
+            const uint16x8_t t = vmull_u8(px.val[i], px.val[3]);
+            px.val[i] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+        }
+        vst4_u8(row, px);
+    }
+
+    premultiply_rgba8_scalar(row, pixels);
+}
+
+// Four pixels' worth of one channel, as floats.
+static float32x4_t neon_channel_f32(const uint16x4_t c)
+{
+    return vcvtq_f32_u32(vmovl_u16(c));
+}
+
+static void unpremultiply_rgba8_neon(uint8 *row, unsigned int pixels)
+{
+    const float32x4_t scale = vdupq_n_f32(255.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    for (; pixels >= 8; pixels -= 8, row += 32) {
+        uint8x8x4_t px = vld4_u8(row);
+        const uint16x8_t a16 = vmovl_u8(px.val[3]);
+        const float32x4_t alo = neon_channel_f32(vget_low_u16(a16));
+        const float32x4_t ahi = neon_channel_f32(vget_high_u16(a16));
+        const uint32x4_t nzlo = vmvnq_u32(vceqq_f32(alo, vdupq_n_f32(0.0f)));
+        const uint32x4_t nzhi = vmvnq_u32(vceqq_f32(ahi, vdupq_n_f32(0.0f)));
+        int i;
+
+        for (i = 0; i < 3; i++) {
+            const uint16x8_t c16 = vmovl_u8(px.val[i]);
+            const float32x4_t qlo = vdivq_f32(vmulq_f32(neon_channel_f32(vget_low_u16(c16)), scale), alo);
+            const float32x4_t qhi = vdivq_f32(vmulq_f32(neon_channel_f32(vget_high_u16(c16)), scale), ahi);
+            const uint32x4_t lo = vandq_u32(vcvtq_u32_f32(vaddq_f32(qlo, half)), nzlo);
+            const uint32x4_t hi = vandq_u32(vcvtq_u32_f32(vaddq_f32(qhi, half)), nzhi);
+            px.val[i] = vqmovn_u16(vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+        }
+        vst4_u8(row, px);
+    }
+
+    unpremultiply_rgba8_scalar(row, pixels);
+}
+
+static void premultiply_rgba32f_neon(uint8 *row, unsigned int pixels)
+{
+    for (; pixels > 0; pixels--, row += 16) {
+        const float32x4_t px = vld1q_f32((const float *) row);
+        const float32x4_t out = vmulq_laneq_f32(px, px, 3);
+        vst1q_f32((float *) row, vsetq_lane_f32(vgetq_lane_f32(px, 3), out, 3));
+    }
+}
+
+static void unpremultiply_rgba32f_neon(uint8 *row, unsigned int pixels)
+{
+    for (; pixels > 0; pixels--, row += 16) {
+        const float32x4_t px = vld1q_f32((const float *) row);
+        const float a = vgetq_lane_f32(px, 3);
+        float32x4_t out = vdupq_n_f32(0.0f);
+        if (a != 0.0f) {
+            out = vdivq_f32(px, vdupq_n_f32(a));
+        }
+        vst1q_f32((float *) row, vsetq_lane_f32(a, out, 3));
+    }
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+#ifdef MOJODDS_HAVE_X86
+#define SSE2_KERNEL(fn) fn
+#define AVX2_KERNEL(fn) fn
+#else
+#define SSE2_KERNEL(fn) NULL
+#define AVX2_KERNEL(fn) NULL
+#endif
+#ifdef MOJODDS_HAVE_NEON
+#define NEON_KERNEL(fn) fn
+#else
+#define NEON_KERNEL(fn) NULL
+#endif
+
+typedef struct
+{
+    MOJODDS_decodeFormat fmt;
+    int premultiply;
+    alpha_fn scalar;
+    alpha_fn sse2;
+    alpha_fn avx2;
+    alpha_fn neon;
+} AlphaKernel;
+
+static const AlphaKernel AlphaKernels[] =
+{
+    { MOJODDS_DECODE_RGBA8, 1, premultiply_rgba8_scalar, SSE2_KERNEL(premultiply_rgba8_sse2), AVX2_KERNEL(premultiply_rgba8_avx2), NEON_KERNEL(premultiply_rgba8_neon) },
+    { MOJODDS_DECODE_RGBA8, 0, unpremultiply_rgba8_scalar, SSE2_KERNEL(unpremultiply_rgba8_sse2), AVX2_KERNEL(unpremultiply_rgba8_avx2), NEON_KERNEL(unpremultiply_rgba8_neon) },
+    { MOJODDS_DECODE_RGBA32F, 1, premultiply_rgba32f_scalar, SSE2_KERNEL(premultiply_rgba32f_sse2), NULL, NEON_KERNEL(premultiply_rgba32f_neon) },
+    { MOJODDS_DECODE_RGBA32F, 0, unpremultiply_rgba32f_scalar, SSE2_KERNEL(unpremultiply_rgba32f_sse2), NULL, NEON_KERNEL(unpremultiply_rgba32f_neon) }
+};
+
+static alpha_fn find_kernel(const MOJODDS_decodeFormat fmt,
+                            const int premultiply)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    int i;
+    for (i = 0; i < STATICARRAYLEN(AlphaKernels); i++) {
+        const AlphaKernel *kernel = &AlphaKernels[i];
+        if ((kernel->fmt == fmt) && (kernel->premultiply == premultiply)) {
+            if ((cpu & MOJODDS_CPU_AVX2) && (kernel->avx2 != NULL)) {
+                return kernel->avx2;
+            } else if ((cpu & MOJODDS_CPU_SSE2) && (kernel->sse2 != NULL)) {
+                return kernel->sse2;
+            } else if ((cpu & MOJODDS_CPU_NEON) && (kernel->neon != NULL)) {
+                return kernel->neon;
+            }
+            return kernel->scalar;
+        }
+    }
+    return NULL;
+}
+
+
+typedef struct
+{
+    alpha_fn fn;
+    uint8 *pixels;
+    size_t pitch;
+    unsigned int w;
+    unsigned int h;
+    unsigned int rowsPerBand;
+} AlphaJob;
+
+static void alpha_band(void *data, unsigned int band)
+{
+    const AlphaJob *job = (const AlphaJob *) data;
+    const unsigned int end = MIN((band + 1) * job->rowsPerBand, job->h);
+    unsigned int y;
+
+    for (y = band * job->rowsPerBand; y < end; y++) {
+        job->fn(job->pixels + (y * job->pitch), job->w);
+    }
+}
+
+static int convert_alpha(const int premultiply, MOJODDS_decodeFormat fmt,
+                         void *_pixels, unsigned int w, unsigned int h,
+                         unsigned long _pitch, MOJODDS_ThreadPool *pool)
+{
+    const unsigned int pixelSize = (fmt == MOJODDS_DECODE_RGBA8) ? 4 : 16;
+    AlphaJob job;
+    unsigned int bands;
+
+    memset(&job, '\0', sizeof (job));
+    job.fn = find_kernel(fmt, premultiply);
+    if (job.fn == NULL) {
+        return 0;  // unsupported format.
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    } else if (((uint64) w) * pixelSize > _pitch) {
+        return 0;  // rows would overlap.
+    }
+
+    job.pixels = (uint8 *) _pixels;
+    job.pitch = (size_t) _pitch;
+    job.w = w;
+    job.h = h;
+
+    // Bands of roughly 64k pixels, like MOJODDS_decode().
+    job.rowsPerBand = MAX(65536 / w, 1);
+    bands = (h + job.rowsPerBand - 1) / job.rowsPerBand;
+    mojodds_parallel_for(pool, bands, alpha_band, &job);
+    return 1;
+}
+
+int MOJODDS_premultiplyAlpha(MOJODDS_decodeFormat fmt, void *_pixels,
+                             unsigned int w, unsigned int h,
+                             unsigned long _pitch, MOJODDS_ThreadPool *pool)
+{
+    return convert_alpha(1, fmt, _pixels, w, h, _pitch, pool);
+}
+
+int MOJODDS_unpremultiplyAlpha(MOJODDS_decodeFormat fmt, void *_pixels,
+                               unsigned int w, unsigned int h,
+                               unsigned long _pitch, MOJODDS_ThreadPool *pool)
+{
+    return convert_alpha(0, fmt, _pixels, w, h, _pitch, pool);
+}
+
+// end of mojodds_alpha.c ...
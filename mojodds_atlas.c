@@ -0,0 +1,193 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Rectangle packing for texture atlases, and the MOJODDS_packRects() entry
+//  point.
+//
+// This is the skyline bottom-left packer: the top edge of everything placed
+//  so far is kept as a list of horizontal segments, and each rect, tallest
+//  first, goes wherever its top edge ends up lowest, leftmost on a tie.
+//  Space trapped under an overhang is given up, which costs a little
+//  occupancy but keeps placement linear in the length of the skyline.
+//  Every size is rounded up to the alignment first, so every segment, and
+//  so every position, lands on a multiple of it.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+typedef struct
+{
+    uint32 x;
+    uint32 y;
+    uint32 w;
+} SkylineNode;
+
+typedef struct
+{
+    uint32 w;  // rounded up to the alignment.
+    uint32 h;
+    unsigned int index;
+} PackItem;
+
+static int compare_items(const void *_a, const void *_b)
+{
+    const PackItem *a = (const PackItem *) _a;
+    const PackItem *b = (const PackItem *) _b;
+    if (a->h != b->h) {
+        return (a->h > b->h) ? -1 : 1;
+    } else if (a->w != b->w) {
+        return (a->w > b->w) ? -1 : 1;
+    }
+    return (a->index < b->index) ? -1 : 1;  // keep it deterministic.
+}
+
+// Where a rect w wide would sit if its left edge were at nodes[i]: on top of
+//  the highest segment it spans. Returns zero if it runs off the right.
+static int skyline_fit(const SkylineNode *nodes, const unsigned int numNodes,
+                       unsigned int i, const uint32 w, const uint32 binw,
+                       uint32 *_y)
+{
+    const uint32 x = nodes[i].x;
+    uint32 covered = 0;
+    uint32 y = 0;
+
+    if (w > binw - x) {
+        return 0;
+    }
+
+    for (; (i < numNodes) && (covered < w); i++) {
+        y = MAX(y, nodes[i].y);
+        covered += nodes[i].w;
+    }
+
+    *_y = y;
+    return 1;
+}
+
+static void skyline_add(SkylineNode *nodes, unsigned int *_numNodes,
+                        const unsigned int i, const uint32 x, const uint32 y,
+                        const uint32 w)
+{
+    unsigned int numNodes = *_numNodes;
+    const uint32 right = x + w;
+    unsigned int j;
+
+    memmove(&nodes[i + 1], &nodes[i], sizeof (SkylineNode) * (numNodes - i));
+    nodes[i].x = x;
+    nodes[i].y = y;
+    nodes[i].w = w;
+    numNodes++;
+
+    // drop or trim the segments the new one covers.
+    j = i + 1;
+    while ((j < numNodes) && (nodes[j].x < right)) {
+        const uint32 end = nodes[j].x + nodes[j].w;
+        if (end <= right) {
+            memmove(&nodes[j], &nodes[j + 1], sizeof (SkylineNode) * (numNodes - j - 1));
+            numNodes--;
+        } else {
+            nodes[j].w = end - right;
+            nodes[j].x = right;
+            break;
+        }
+    }
+
+    // merge neighbours at the same height.
+    for (j = 0; j + 1 < numNodes; ) {
+        if (nodes[j].y == nodes[j + 1].y) {
+            nodes[j].w += nodes[j + 1].w;
+            memmove(&nodes[j + 1], &nodes[j + 2], sizeof (SkylineNode) * (numNodes - j - 2));
+            numNodes--;
+        } else {
+            j++;
+        }
+    }
+
+    *_numNodes = numNodes;
+}
+
+int MOJODDS_packRects(MOJODDS_PackRect *rects, unsigned int count,
+                      unsigned int w, unsigned int h, unsigned int align)
+{
+    PackItem *items = NULL;
+    SkylineNode *nodes = NULL;
+    unsigned int numNodes = 1;
+    unsigned int i;
+    int retval = 1;
+
+    if ((w == 0) || (h == 0) || (align == 0) || ((align & (align - 1)) != 0)) {
+        return 0;  // align must be a power of two.
+    } else if ((rects == NULL) && (count > 0)) {
+        return 0;
+    } else if (count == 0) {
+        return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if ((rects[i].w == 0) || (rects[i].h == 0) ||
+            (rects[i].w > w) || (rects[i].h > h)) {
+            return 0;
+        }
+    }
+
+    items = (PackItem *) malloc(sizeof (PackItem) * count);
+    nodes = (SkylineNode *) malloc(sizeof (SkylineNode) * (count + 1));
+    if ((items == NULL) || (nodes == NULL)) {
+        free(items);
+        free(nodes);
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        items[i].w = (uint32) ((((uint64) rects[i].w) + align - 1) & ~((uint64) align - 1));
+        items[i].h = (uint32) ((((uint64) rects[i].h) + align - 1) & ~((uint64) align - 1));
+        items[i].index = i;
+    }
+    qsort(items, count, sizeof (PackItem), compare_items);
+
+    nodes[0].x = 0;
+    nodes[0].y = 0;
+    nodes[0].w = w;
+
+    for (i = 0; i < count; i++) {
+        const PackItem *item = &items[i];
+        uint32 bestTop = 0;
+        uint32 bestY = 0;
+        unsigned int best = numNodes;
+        unsigned int j;
+
+        for (j = 0; j < numNodes; j++) {
+            uint32 y = 0;
+            if (!skyline_fit(nodes, numNodes, j, item->w, w, &y)) {
+                break;  // nodes are left to right; the rest are further off.
+            } else if (item->h > h - y) {
+                continue;  // off the bottom.
+            } else if ((best == numNodes) || (y + item->h < bestTop)) {
+                best = j;
+                bestY = y;
+                bestTop = y + item->h;
+            }
+        }
+
+        if (best == numNodes) {
+            retval = 0;  // doesn't fit anywhere.
+            break;
+        }
+
+        rects[item->index].x = nodes[best].x;
+        rects[item->index].y = bestY;
+        skyline_add(nodes, &numNodes, best, nodes[best].x, bestTop, item->w);
+    }
+
+    free(nodes);
+    free(items);
+    return retval;
+}
+
+// end of mojodds_atlas.c ...
@@ -0,0 +1,744 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Software decoders for the BPTC formats: BC7 (RGBA8) and BC6H (half float
+//  RGB, signed or unsigned).
+//
+// Both pack their fields into a 128-bit block at odd bit offsets, so the
+//  unpacking is scalar everywhere. The SIMD BC7 paths take over the
+//  interpolation, and use a dedicated unpacker for mode 6, which is what
+//  encoders pick for most smooth RGBA content. Like mojodds_decode.c, they
+//  must match the scalar reference bit for bit.
+
+#include <string.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef struct
+{
+    uint64 lo;
+    uint64 hi;
+} BlockBits;
+
+static void load_bits(const uint8 *src, BlockBits *bits)
+{
+    int i;
+    bits->lo = bits->hi = 0;
+    for (i = 7; i >= 0; i--) {
+        bits->lo = (bits->lo << 8) | src[i];
+        bits->hi = (bits->hi << 8) | src[i + 8];
+    }
+}
+
+// Pull the next (count) bits, zero to 32 of them, off the front of the block.
+static uint32 take_bits(BlockBits *bits, const uint32 count)
+{
+    uint32 retval;
+    if (count == 0) {
+        return 0;
+    }
+    retval = (uint32) (bits->lo & ((((uint64) 1) << count) - 1));
+    bits->lo = (bits->lo >> count) | (bits->hi << (64 - count));
+    bits->hi >>= count;
+    return retval;
+}
+
+static const uint8 Weights2[4] = { 0, 21, 43, 64 };
+static const uint8 Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8 Weights4[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+static const uint8 *const Weights[5] = { NULL, NULL, Weights2, Weights3, Weights4 };
+
+// Which subset each pixel is in; bit (i) of a two-subset partition, bits
+//  (i*2) and (i*2+1) of a three-subset one. BC6H uses the first 32 of the
+//  two-subset partitions.
+static const uint16 Partitions2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+static const uint32 Partitions3[64] = {
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+};
+
+// Pixel 0 is always the anchor of subset 0; these are the others. Anchor
+//  indices are stored with their top bit dropped (it's always zero).
+static const uint8 Anchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+static const uint8 Anchors3a[64] = {
+     3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+     3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+     8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+     3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+
+static const uint8 Anchors3b[64] = {
+    15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+    15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+    15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+    15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+static int is_anchor(const uint32 subsets, const uint32 partition,
+                     const uint32 i)
+{
+    if (i == 0) {
+        return 1;
+    } else if (subsets == 2) {
+        return (i == Anchors2[partition]);
+    } else if (subsets == 3) {
+        return ((i == Anchors3a[partition]) || (i == Anchors3b[partition]));
+    }
+    return 0;
+}
+
+static uint32 interpolate(const uint32 e0, const uint32 e1, const uint32 w)
+{
+    return (((64 - w) * e0) + (w * e1) + 32) >> 6;
+}
+
+
+// BC7...
+
+typedef struct
+{
+    uint8 subsets;
+    uint8 partitionBits;
+    uint8 rotationBits;
+    uint8 indexSelectionBits;
+    uint8 colorBits;
+    uint8 alphaBits;
+    uint8 endpointPBits;  // one p-bit per endpoint...
+    uint8 sharedPBits;  // ...or one per subset.
+    uint8 indexBits;
+    uint8 indexBits2;  // second index set, for modes 4 and 5.
+} Bc7Mode;
+
+static const Bc7Mode Bc7Modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+// A block with everything but the interpolation done. Rotation (modes 4
+//  and 5) is already applied, by swapping endpoint channels and weights, so
+//  every pixel is just interpolate(endpoint 0, endpoint 1, weight) per
+//  channel.
+typedef struct
+{
+    uint8 endpoints[3][2][4];  // [subset][endpoint][channel], 8 bits each.
+    uint8 subset[16];
+    uint8 weights[16][4];
+} Bc7Block;
+
+// Returns zero for the reserved mode, which decodes to transparent black.
+static int bc7_unpack(const uint8 *src, Bc7Block *blk)
+{
+    uint32 raw[3][2][4];
+    uint8 indices[2][16];
+    uint8 indexBits[2];
+    const Bc7Mode *mode;
+    BlockBits bits;
+    uint32 modenum, partition, rotation, isb, pbits;
+    uint32 s, e, c, i;
+
+    if (src[0] == 0) {
+        return 0;
+    }
+
+    for (modenum = 0; (src[0] & (1 << modenum)) == 0; modenum++) { /* spin */ }
+    mode = &Bc7Modes[modenum];
+
+    load_bits(src, &bits);
+    take_bits(&bits, modenum + 1);
+    partition = take_bits(&bits, mode->partitionBits);
+    rotation = take_bits(&bits, mode->rotationBits);
+    isb = take_bits(&bits, mode->indexSelectionBits);
+
+    // All the reds, then all the greens, etc.
+    memset(raw, '\0', sizeof (raw));
+    for (c = 0; c < 4; c++) {
+        const uint32 prec = (c < 3) ? mode->colorBits : mode->alphaBits;
+        for (s = 0; s < mode->subsets; s++) {
+            for (e = 0; e < 2; e++) {
+                raw[s][e][c] = take_bits(&bits, prec);
+            }
+        }
+    }
+
+    pbits = mode->endpointPBits | mode->sharedPBits;
+    for (s = 0; s < mode->subsets; s++) {
+        uint32 p = mode->sharedPBits ? take_bits(&bits, 1) : 0;
+        for (e = 0; e < 2; e++) {
+            if (mode->endpointPBits) {
+                p = take_bits(&bits, 1);
+            }
+            for (c = 0; c < 4; c++) {
+                const uint32 prec = ((c < 3) ? mode->colorBits : mode->alphaBits);
+                uint32 v = 0xFF;
+                if (prec != 0) {
+                    const uint32 total = prec + pbits;
+                    v = pbits ? ((raw[s][e][c] << 1) | p) : raw[s][e][c];
+                    v <<= (8 - total);
+                    v |= v >> total;
+                }
+                blk->endpoints[s][e][c] = (uint8) v;
+            }
+        }
+    }
+
+    for (i = 0; i < 16; i++) {
+        if (mode->subsets == 2) {
+            blk->subset[i] = (uint8) ((Partitions2[partition] >> i) & 1);
+        } else if (mode->subsets == 3) {
+            blk->subset[i] = (uint8) ((Partitions3[partition] >> (i * 2)) & 3);
+        } else {
+            blk->subset[i] = 0;
+        }
+    }
+
+    for (i = 0; i < 16; i++) {
+        const uint32 anchor = is_anchor(mode->subsets, partition, i);
+        indices[0][i] = (uint8) take_bits(&bits, mode->indexBits - anchor);
+    }
+
+    // Modes 4 and 5 have a second set, for a single subset; pixel 0 is
+    //  the only anchor. Without one, alpha uses the first set.
+    if (mode->indexBits2 == 0) {
+        memcpy(indices[1], indices[0], sizeof (indices[0]));
+        indexBits[0] = indexBits[1] = mode->indexBits;
+    } else {
+        for (i = 0; i < 16; i++) {
+            indices[1][i] = (uint8) take_bits(&bits, mode->indexBits2 - (i == 0));
+        }
+        indexBits[0] = mode->indexBits;
+        indexBits[1] = mode->indexBits2;
+    }
+
+    // The index selection bit swaps which set drives color and alpha.
+    for (i = 0; i < 16; i++) {
+        const uint8 cw = Weights[indexBits[isb]][indices[isb][i]];
+        const uint8 aw = Weights[indexBits[isb ^ 1]][indices[isb ^ 1][i]];
+        blk->weights[i][0] = blk->weights[i][1] = blk->weights[i][2] = cw;
+        blk->weights[i][3] = aw;
+        if (rotation) {
+            blk->weights[i][rotation - 1] = aw;
+            blk->weights[i][3] = cw;
+        }
+    }
+
+    if (rotation) {
+        for (e = 0; e < 2; e++) {
+            const uint8 tmp = blk->endpoints[0][e][rotation - 1];
+            blk->endpoints[0][e][rotation - 1] = blk->endpoints[0][e][3];
+            blk->endpoints[0][e][3] = tmp;
+        }
+    }
+
+    return 1;
+}
+
+static void bc7_invalid_block(uint8 *dst, const size_t pitch)
+{
+    int y;
+    for (y = 0; y < 4; y++) {
+        memset(dst + (y * pitch), '\0', 16);
+    }
+}
+
+void mojodds_decode_bc7_scalar(const uint8 *src, unsigned int blocks,
+                               uint8 *dst, size_t pitch)
+{
+    Bc7Block blk;
+    int x, y, c;
+
+    for (; blocks > 0; blocks--, src += 16, dst += 16) {
+        if (!bc7_unpack(src, &blk)) {
+            bc7_invalid_block(dst, pitch);
+            continue;
+        }
+
+        for (y = 0; y < 4; y++) {
+            uint8 *row = dst + (y * pitch);
+            for (x = 0; x < 4; x++) {
+                const int i = (y * 4) + x;
+                const uint8 *ep0 = blk.endpoints[blk.subset[i]][0];
+                const uint8 *ep1 = blk.endpoints[blk.subset[i]][1];
+                for (c = 0; c < 4; c++) {
+                    row[(x * 4) + c] = (uint8) interpolate(ep0[c], ep1[c], blk.weights[i][c]);
+                }
+            }
+        }
+    }
+}
+
+#if defined(MOJODDS_HAVE_X86) || defined(MOJODDS_HAVE_NEON)
+
+// Mode 6 is one subset, 7777.1 endpoints and 4-bit indices, all at fixed
+//  offsets, so it doesn't need the general unpacker's loops.
+static void bc7_unpack_mode6(const uint8 *src, Bc7Block *blk)
+{
+    BlockBits bits;
+    uint32 p0, p1, c, i;
+    uint64 indices;
+
+    load_bits(src, &bits);
+    p0 = (uint32) (bits.lo >> 63);
+    p1 = (uint32) (bits.hi & 1);
+    for (c = 0; c < 4; c++) {
+        blk->endpoints[0][0][c] = (uint8) ((((bits.lo >> (7 + (c * 14))) & 0x7F) << 1) | p0);
+        blk->endpoints[0][1][c] = (uint8) ((((bits.lo >> (14 + (c * 14))) & 0x7F) << 1) | p1);
+    }
+
+    memset(blk->subset, '\0', sizeof (blk->subset));
+    indices = bits.hi >> 1;
+    memset(blk->weights[0], Weights4[indices & 0x7], 4);
+    indices >>= 3;
+    for (i = 1; i < 16; i++, indices >>= 4) {
+        memset(blk->weights[i], Weights4[indices & 0xF], 4);
+    }
+}
+
+static int bc7_unpack_fast(const uint8 *src, Bc7Block *blk)
+{
+    if ((src[0] & 0x7F) == 0x40) {
+        bc7_unpack_mode6(src, blk);
+        return 1;
+    }
+    return bc7_unpack(src, blk);
+}
+
+// Endpoints for one row of pixels, packed RGBA.
+static void bc7_row_endpoints(const Bc7Block *blk, const int y,
+                              uint32 e0[4], uint32 e1[4])
+{
+    int x;
+    for (x = 0; x < 4; x++) {
+        const uint8 (*ep)[4] = blk->endpoints[blk->subset[(y * 4) + x]];
+        memcpy(&e0[x], ep[0], 4);
+        memcpy(&e1[x], ep[1], 4);
+    }
+}
+
+#endif
+
+#ifdef MOJODDS_HAVE_X86
+
+// A row of four pixels at a time, 16-bit lanes; the products top out
+//  at 255 * 64, so mullo is enough.
+static MOJODDS_TARGET("sse2") void sse2_bc7_interpolate(const Bc7Block *blk,
+                                                        uint8 *dst,
+                                                        const size_t pitch)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sixtyfour = _mm_set1_epi16(64);
+    const __m128i round = _mm_set1_epi16(32);
+    uint32 e0[4], e1[4];
+    int y;
+
+    for (y = 0; y < 4; y++) {
+        const __m128i w = _mm_loadu_si128((const __m128i *) blk->weights[y * 4]);
+        __m128i a, b, wlo, whi, lo, hi;
+        bc7_row_endpoints(blk, y, e0, e1);
+        a = _mm_loadu_si128((const __m128i *) e0);
+        b = _mm_loadu_si128((const __m128i *) e1);
+        wlo = _mm_unpacklo_epi8(w, zero);
+        whi = _mm_unpackhi_epi8(w, zero);
+        #define SSE2_INTERP(ww, ea, eb) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(sixtyfour, ww), ea), _mm_mullo_epi16(ww, eb)), round), 6)
+        lo = SSE2_INTERP(wlo, _mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        hi = SSE2_INTERP(whi, _mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        #undef SSE2_INTERP
+        _mm_storeu_si128((__m128i *) (dst + (y * pitch)), _mm_packus_epi16(lo, hi));
+    }
+}
+
+MOJODDS_TARGET("sse2") void mojodds_decode_bc7_sse2(const uint8 *src,
+                                                    unsigned int blocks,
+                                                    uint8 *dst, size_t pitch)
+{
+    Bc7Block blk;
+    for (; blocks > 0; blocks--, src += 16, dst += 16) {
+        if (!bc7_unpack_fast(src, &blk)) {
+            bc7_invalid_block(dst, pitch);
+        } else {
+            sse2_bc7_interpolate(&blk, dst, pitch);
+        }
+    }
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+#ifdef MOJODDS_HAVE_NEON
+
+// The rounding narrowing shift does the +32 and >>6 in one go.
+static void neon_bc7_interpolate(const Bc7Block *blk, uint8 *dst,
+                                 const size_t pitch)
+{
+    const uint8x16_t sixtyfour = vdupq_n_u8(64);
+    uint32 e0[4], e1[4];
+    int y;
+
+    for (y = 0; y < 4; y++) {
+        const uint8x16_t w = vld1q_u8(blk->weights[y * 4]);
+        const uint8x16_t iw = vsubq_u8(sixtyfour, w);
+        uint8x16_t a, b;
+        uint16x8_t lo, hi;
+        bc7_row_endpoints(blk, y, e0, e1);
+        a = vreinterpretq_u8_u32(vld1q_u32(e0));
+        b = vreinterpretq_u8_u32(vld1q_u32(e1));
+        lo = vmlal_u8(vmull_u8(vget_low_u8(a), vget_low_u8(iw)), vget_low_u8(b), vget_low_u8(w));
+        hi = vmlal_u8(vmull_u8(vget_high_u8(a), vget_high_u8(iw)), vget_high_u8(b), vget_high_u8(w));
+        vst1q_u8(dst + (y * pitch), vcombine_u8(vrshrn_n_u16(lo, 6), vrshrn_n_u16(hi, 6)));
+    }
+}
+
+void mojodds_decode_bc7_neon(const uint8 *src, unsigned int blocks,
+                             uint8 *dst, size_t pitch)
+{
+    Bc7Block blk;
+    for (; blocks > 0; blocks--, src += 16, dst += 16) {
+        if (!bc7_unpack_fast(src, &blk)) {
+            bc7_invalid_block(dst, pitch);
+        } else {
+            neon_bc7_interpolate(&blk, dst, pitch);
+        }
+    }
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+// BC6H...
+
+typedef struct
+{
+    uint8 id;  // the mode bits, as read.
+    uint8 modeBits;
+    uint8 regions;
+    uint8 transformed;  // endpoints past the first are deltas from it.
+    uint8 endpointBits;
+    uint8 deltaBits[3];
+    // Where the endpoint bits are, in stream order: which value (channel * 4
+    //  + endpoint), which bit of it the run starts at, and how many bits.
+    //  Ends at the first zero count.
+    uint8 fields[25][3];
+} Bc6hMode;
+
+static const Bc6hMode Bc6hModes[14] = {
+    {   // 00
+        0x00, 2, 2, 1, 10, { 5, 5, 5 }, {
+            { 6, 4, 1 }, { 10, 4, 1 }, { 11, 4, 1 }, { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 },
+            { 1, 0, 5 }, { 7, 4, 1 }, { 6, 0, 4 }, { 5, 0, 5 }, { 11, 0, 1 }, { 7, 0, 4 },
+            { 9, 0, 5 }, { 11, 1, 1 }, { 10, 0, 4 }, { 2, 0, 5 }, { 11, 2, 1 }, { 3, 0, 5 },
+            { 11, 3, 1 },
+        }
+    },
+    {   // 01
+        0x01, 2, 2, 1, 7, { 6, 6, 6 }, {
+            { 6, 5, 1 }, { 7, 4, 1 }, { 7, 5, 1 }, { 0, 0, 7 }, { 11, 0, 1 }, { 11, 1, 1 },
+            { 10, 4, 1 }, { 4, 0, 7 }, { 10, 5, 1 }, { 11, 2, 1 }, { 6, 4, 1 }, { 8, 0, 7 },
+            { 11, 3, 1 }, { 11, 5, 1 }, { 11, 4, 1 }, { 1, 0, 6 }, { 6, 0, 4 }, { 5, 0, 6 },
+            { 7, 0, 4 }, { 9, 0, 6 }, { 10, 0, 4 }, { 2, 0, 6 }, { 3, 0, 6 },
+        }
+    },
+    {   // 00010
+        0x02, 5, 2, 1, 11, { 5, 4, 4 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 5 }, { 0, 10, 1 }, { 6, 0, 4 },
+            { 5, 0, 4 }, { 4, 10, 1 }, { 11, 0, 1 }, { 7, 0, 4 }, { 9, 0, 4 }, { 8, 10, 1 },
+            { 11, 1, 1 }, { 10, 0, 4 }, { 2, 0, 5 }, { 11, 2, 1 }, { 3, 0, 5 }, { 11, 3, 1 },
+        }
+    },
+    {   // 00110
+        0x06, 5, 2, 1, 11, { 4, 5, 4 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 4 }, { 0, 10, 1 }, { 7, 4, 1 },
+            { 6, 0, 4 }, { 5, 0, 5 }, { 4, 10, 1 }, { 7, 0, 4 }, { 9, 0, 4 }, { 8, 10, 1 },
+            { 11, 1, 1 }, { 10, 0, 4 }, { 2, 0, 4 }, { 11, 0, 1 }, { 11, 2, 1 }, { 3, 0, 4 },
+            { 6, 4, 1 }, { 11, 3, 1 },
+        }
+    },
+    {   // 01010
+        0x0A, 5, 2, 1, 11, { 4, 4, 5 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 4 }, { 0, 10, 1 }, { 10, 4, 1 },
+            { 6, 0, 4 }, { 5, 0, 4 }, { 4, 10, 1 }, { 11, 0, 1 }, { 7, 0, 4 }, { 9, 0, 5 },
+            { 8, 10, 1 }, { 10, 0, 4 }, { 2, 0, 4 }, { 11, 1, 1 }, { 11, 2, 1 }, { 3, 0, 4 },
+            { 11, 4, 1 }, { 11, 3, 1 },
+        }
+    },
+    {   // 01110
+        0x0E, 5, 2, 1, 9, { 5, 5, 5 }, {
+            { 0, 0, 9 }, { 10, 4, 1 }, { 4, 0, 9 }, { 6, 4, 1 }, { 8, 0, 9 }, { 11, 4, 1 },
+            { 1, 0, 5 }, { 7, 4, 1 }, { 6, 0, 4 }, { 5, 0, 5 }, { 11, 0, 1 }, { 7, 0, 4 },
+            { 9, 0, 5 }, { 11, 1, 1 }, { 10, 0, 4 }, { 2, 0, 5 }, { 11, 2, 1 }, { 3, 0, 5 },
+            { 11, 3, 1 },
+        }
+    },
+    {   // 10010
+        0x12, 5, 2, 1, 8, { 6, 5, 5 }, {
+            { 0, 0, 8 }, { 7, 4, 1 }, { 10, 4, 1 }, { 4, 0, 8 }, { 11, 2, 1 }, { 6, 4, 1 },
+            { 8, 0, 8 }, { 11, 3, 1 }, { 11, 4, 1 }, { 1, 0, 6 }, { 6, 0, 4 }, { 5, 0, 5 },
+            { 11, 0, 1 }, { 7, 0, 4 }, { 9, 0, 5 }, { 11, 1, 1 }, { 10, 0, 4 }, { 2, 0, 6 },
+            { 3, 0, 6 },
+        }
+    },
+    {   // 10110
+        0x16, 5, 2, 1, 8, { 5, 6, 5 }, {
+            { 0, 0, 8 }, { 11, 0, 1 }, { 10, 4, 1 }, { 4, 0, 8 }, { 6, 5, 1 }, { 6, 4, 1 },
+            { 8, 0, 8 }, { 7, 5, 1 }, { 11, 4, 1 }, { 1, 0, 5 }, { 7, 4, 1 }, { 6, 0, 4 },
+            { 5, 0, 6 }, { 7, 0, 4 }, { 9, 0, 5 }, { 11, 1, 1 }, { 10, 0, 4 }, { 2, 0, 5 },
+            { 11, 2, 1 }, { 3, 0, 5 }, { 11, 3, 1 },
+        }
+    },
+    {   // 11010
+        0x1A, 5, 2, 1, 8, { 5, 5, 6 }, {
+            { 0, 0, 8 }, { 11, 1, 1 }, { 10, 4, 1 }, { 4, 0, 8 }, { 10, 5, 1 }, { 6, 4, 1 },
+            { 8, 0, 8 }, { 11, 5, 1 }, { 11, 4, 1 }, { 1, 0, 5 }, { 7, 4, 1 }, { 6, 0, 4 },
+            { 5, 0, 5 }, { 11, 0, 1 }, { 7, 0, 4 }, { 9, 0, 6 }, { 10, 0, 4 }, { 2, 0, 5 },
+            { 11, 2, 1 }, { 3, 0, 5 }, { 11, 3, 1 },
+        }
+    },
+    {   // 11110
+        0x1E, 5, 2, 0, 6, { 6, 6, 6 }, {
+            { 0, 0, 6 }, { 7, 4, 1 }, { 11, 0, 1 }, { 11, 1, 1 }, { 10, 4, 1 }, { 4, 0, 6 },
+            { 6, 5, 1 }, { 10, 5, 1 }, { 11, 2, 1 }, { 6, 4, 1 }, { 8, 0, 6 }, { 7, 5, 1 },
+            { 11, 3, 1 }, { 11, 5, 1 }, { 11, 4, 1 }, { 1, 0, 6 }, { 6, 0, 4 }, { 5, 0, 6 },
+            { 7, 0, 4 }, { 9, 0, 6 }, { 10, 0, 4 }, { 2, 0, 6 }, { 3, 0, 6 },
+        }
+    },
+    {   // 00011
+        0x03, 5, 1, 0, 10, { 10, 10, 10 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 10 }, { 5, 0, 10 }, { 9, 0, 10 },
+        }
+    },
+    {   // 00111
+        0x07, 5, 1, 1, 11, { 9, 9, 9 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 9 }, { 0, 10, 1 }, { 5, 0, 9 },
+            { 4, 10, 1 }, { 9, 0, 9 }, { 8, 10, 1 },
+        }
+    },
+    {   // 01011
+        0x0B, 5, 1, 1, 12, { 8, 8, 8 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 8 }, { 0, 11, 1 }, { 0, 10, 1 },
+            { 5, 0, 8 }, { 4, 11, 1 }, { 4, 10, 1 }, { 9, 0, 8 }, { 8, 11, 1 }, { 8, 10, 1 },
+        }
+    },
+    {   // 01111
+        0x0F, 5, 1, 1, 16, { 4, 4, 4 }, {
+            { 0, 0, 10 }, { 4, 0, 10 }, { 8, 0, 10 }, { 1, 0, 4 }, { 0, 15, 1 }, { 0, 14, 1 },
+            { 0, 13, 1 }, { 0, 12, 1 }, { 0, 11, 1 }, { 0, 10, 1 }, { 5, 0, 4 }, { 4, 15, 1 },
+            { 4, 14, 1 }, { 4, 13, 1 }, { 4, 12, 1 }, { 4, 11, 1 }, { 4, 10, 1 }, { 9, 0, 4 },
+            { 8, 15, 1 }, { 8, 14, 1 }, { 8, 13, 1 }, { 8, 12, 1 }, { 8, 11, 1 }, { 8, 10, 1 },
+        }
+    },
+};
+
+static const Bc6hMode *find_bc6h_mode(const uint8 *src)
+{
+    const uint32 id = ((src[0] & 0x3) < 2) ? (src[0] & 0x3) : (src[0] & 0x1F);
+    int i;
+    for (i = 0; i < STATICARRAYLEN(Bc6hModes); i++) {
+        if (Bc6hModes[i].id == id) {
+            return &Bc6hModes[i];
+        }
+    }
+    return NULL;  // one of the reserved modes.
+}
+
+static sint32 sign_extend(const uint32 x, const uint32 bits)
+{
+    const uint32 sign = ((uint32) 1) << (bits - 1);
+    return ((sint32) ((x & ((sign << 1) - 1)) ^ sign)) - ((sint32) sign);
+}
+
+// Endpoints get scaled up to 16 bits (or 15 plus sign)...
+static sint32 bc6h_unquantize(sint32 x, const uint32 prec, const int issigned)
+{
+    if (!issigned) {
+        if (prec >= 15) {
+            return x;
+        } else if (x == 0) {
+            return 0;
+        } else if (x == ((1 << prec) - 1)) {
+            return 0xFFFF;
+        }
+        return ((x << 15) + 0x4000) >> (prec - 1);
+    } else if (prec < 16) {
+        const int negative = (x < 0);
+        sint32 retval;
+        if (negative) {
+            x = -x;
+        }
+
+        if (x == 0) {
+            retval = 0;
+        } else if (x >= ((1 << (prec - 1)) - 1)) {
+            retval = 0x7FFF;
+        } else {
+            retval = ((x << 15) + 0x4000) >> (prec - 1);
+        }
+        return negative ? -retval : retval;
+    }
+    return x;
+}
+
+// ...and interpolated results get scaled back down to half float bits.
+static uint16 bc6h_finish(const sint32 x, const int issigned)
+{
+    if (!issigned) {
+        return (uint16) ((x * 31) >> 6);
+    } else if (x < 0) {
+        return (uint16) (0x8000 | (((-x) * 31) >> 5));
+    }
+    return (uint16) ((x * 31) >> 5);
+}
+
+// Unpacks one block to 16 pixels of RGB half floats. The reserved modes
+//  decode to black.
+static void bc6h_block(const uint8 *src, const int issigned, uint16 rgb[16][3])
+{
+    const Bc6hMode *mode = find_bc6h_mode(src);
+    const uint8 (*field)[3];
+    uint32 raw[12];
+    sint32 endpoints[4][3];  // [region * 2 + endpoint][channel]
+    uint8 indices[16];
+    uint32 partition, indexBits, c, e, i;
+    const uint8 *weights;
+    BlockBits bits;
+
+    if (mode == NULL) {
+        memset(rgb, '\0', sizeof (uint16) * 16 * 3);
+        return;
+    }
+
+    load_bits(src, &bits);
+    take_bits(&bits, mode->modeBits);
+
+    memset(raw, '\0', sizeof (raw));
+    for (field = mode->fields; (*field)[2] != 0; field++) {
+        raw[(*field)[0]] |= take_bits(&bits, (*field)[2]) << (*field)[1];
+    }
+
+    partition = (mode->regions == 2) ? take_bits(&bits, 5) : 0;
+    indexBits = (mode->regions == 2) ? 3 : 4;
+    weights = Weights[indexBits];
+    for (i = 0; i < 16; i++) {
+        indices[i] = (uint8) take_bits(&bits, indexBits - is_anchor(mode->regions, partition, i));
+    }
+
+    for (c = 0; c < 3; c++) {
+        const uint32 prec = mode->endpointBits;
+        const uint32 mask = (((uint32) 1) << prec) - 1;
+        const sint32 e0 = issigned ? sign_extend(raw[c * 4], prec) : (sint32) raw[c * 4];
+        for (e = 1; e < (uint32) (mode->regions * 2); e++) {
+            sint32 v = (sint32) raw[(c * 4) + e];
+            if (mode->transformed) {
+                v = (sint32) ((((uint32) e0) + ((uint32) sign_extend((uint32) v, mode->deltaBits[c]))) & mask);
+            }
+            if (issigned) {
+                v = sign_extend((uint32) v, prec);
+            }
+            endpoints[e][c] = bc6h_unquantize(v, prec, issigned);
+        }
+        endpoints[0][c] = bc6h_unquantize(e0, prec, issigned);
+    }
+
+    for (i = 0; i < 16; i++) {
+        const uint32 region = (Partitions2[partition] >> i) & (mode->regions - 1);
+        const sint32 w = weights[indices[i]];
+        const sint32 *e0 = endpoints[region * 2];
+        const sint32 *e1 = endpoints[(region * 2) + 1];
+        for (c = 0; c < 3; c++) {
+            rgb[i][c] = bc6h_finish((((64 - w) * e0[c]) + (w * e1[c]) + 32) >> 6, issigned);
+        }
+    }
+}
+
+static void decode_bc6h(const uint8 *src, unsigned int blocks, uint8 *dst,
+                        const size_t pitch, const int issigned,
+                        const int tofloat)
+{
+    const size_t pixelSize = tofloat ? 16 : 8;
+    uint16 rgb[16][3];
+    int x, y, c;
+
+    for (; blocks > 0; blocks--, src += 16, dst += pixelSize * 4) {
+        bc6h_block(src, issigned, rgb);
+        for (y = 0; y < 4; y++) {
+            uint8 *row = dst + (y * pitch);
+            for (x = 0; x < 4; x++) {
+                const uint16 *px = rgb[(y * 4) + x];
+                if (tofloat) {
+                    float f[4];
+                    for (c = 0; c < 3; c++) {
+                        f[c] = mojodds_half_to_float(px[c]);
+                    }
+                    f[3] = 1.0f;
+                    memcpy(row + (x * 16), f, sizeof (f));
+                } else {
+                    const uint16 h[4] = { px[0], px[1], px[2], 0x3C00 };
+                    memcpy(row + (x * 8), h, sizeof (h));
+                }
+            }
+        }
+    }
+}
+
+void mojodds_decode_bc6h_uf16_half(const uint8 *src, unsigned int blocks,
+                                   uint8 *dst, size_t pitch)
+{
+    decode_bc6h(src, blocks, dst, pitch, 0, 0);
+}
+
+void mojodds_decode_bc6h_sf16_half(const uint8 *src, unsigned int blocks,
+                                   uint8 *dst, size_t pitch)
+{
+    decode_bc6h(src, blocks, dst, pitch, 1, 0);
+}
+
+void mojodds_decode_bc6h_uf16_float(const uint8 *src, unsigned int blocks,
+                                    uint8 *dst, size_t pitch)
+{
+    decode_bc6h(src, blocks, dst, pitch, 0, 1);
+}
+
+void mojodds_decode_bc6h_sf16_float(const uint8 *src, unsigned int blocks,
+                                    uint8 *dst, size_t pitch)
+{
+    decode_bc6h(src, blocks, dst, pitch, 1, 1);
+}
+
+// end of mojodds_bptc.c ...
+
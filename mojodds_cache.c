@@ -0,0 +1,498 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Caching parsed layouts, and the MOJODDS_*LayoutCache() and
+//  MOJODDS_getCached*Layout() entry points.
+//
+// A layout only depends on the first MOJODDS_HEADER_MAXLEN bytes of a file
+//  and its length, so those are the key when we're handed the file's bytes;
+//  for a path it's the path, size and modification time, which is one
+//  stat() on a hit. Failures are cached too, so a bad file doesn't get
+//  parsed over and over.
+//
+// Entries are fixed size, allocated up front, and never freed until the
+//  cache is, so a lookup can walk the hash table without a lock: it notes
+//  the sequence number, copies out what it found and checks the sequence
+//  number didn't change underneath it (a seqlock). Inserts and evictions
+//  take the mutex and bump the sequence number around their changes. A hit
+//  sets its entry's referenced flag, and eviction is CLOCK: sweep round the
+//  entries, clearing flags, until finding one that wasn't used since the
+//  last sweep. That's about as good as strict LRU without lookups having to
+//  write to a shared list.
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+#include "mojodds_thread.h"
+
+// Room for the headers, or a path and its mtime. Longer paths aren't cached.
+#define KEY_MAX 512
+
+// Lookups that keep racing with writers give up and take the lock.
+#define MAX_OPTIMISTIC_TRIES 4
+
+typedef enum
+{
+    KEY_CONTENT,
+    KEY_PATH
+} KeyKind;
+
+typedef struct
+{
+    uint64 hash;
+    uint32 next;  // index + 1 of the next entry in the bucket; 0 ends it.
+    uint64 filelen;
+    uint32 keylen;
+    uint32 kind;  // a KeyKind.
+    uint32 referenced;  // set by hits, cleared by the eviction sweep.
+    MOJODDS_error err;
+    MOJODDS_Layout layout;  // with a NULL tex.
+    uint8 key[KEY_MAX];
+} CacheEntry;
+
+typedef struct
+{
+    KeyKind kind;
+    uint64 hash;
+    uint64 filelen;
+    const uint8 *bytes;  // the caller's headers, or storage.
+    uint32 len;
+    uint8 storage[KEY_MAX];
+} CacheKey;
+
+struct MOJODDS_LayoutCache
+{
+    Mutex lock;  // held by writers.
+    uint32 seq;  // odd while a writer is changing things.
+    uint32 *buckets;  // index + 1 of the first entry; 0 if empty.
+    uint32 bucketmask;
+    CacheEntry *entries;
+    uint32 capacity;
+    uint32 used;
+    uint32 hand;  // where the eviction sweep picks up.
+    uint64 hits;
+    uint64 misses;
+    uint64 evictions;
+};
+
+
+#if defined(_MSC_VER) && !defined(__clang__)
+static uint32 load_acquire(const uint32 *ptr)
+{
+    const uint32 retval = *((const volatile uint32 *) ptr);
+    MemoryBarrier();
+    return retval;
+}
+#define load_relaxed(ptr) (*((const volatile uint32 *) (ptr)))
+#define store_relaxed(ptr, val) (*((volatile uint32 *) (ptr)) = (val))
+#define store_release(ptr, val) do { MemoryBarrier(); store_relaxed(ptr, val); } while (0)
+#define fence_acquire() MemoryBarrier()
+#define fence_release() MemoryBarrier()
+#define counter_add(ptr) InterlockedIncrement64((volatile LONG64 *) (ptr))
+#define counter_load(ptr) ((uint64) InterlockedCompareExchange64((volatile LONG64 *) (ptr), 0, 0))
+#else
+#define load_acquire(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define load_relaxed(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define store_relaxed(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define store_release(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define fence_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define counter_add(ptr) __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED)
+#define counter_load(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#endif
+
+
+// Eight bytes at a time, multiply and fold, which is plenty for keys that
+//  get compared in full anyhow; a byte-at-a-time hash costs more than
+//  parsing the headers would.
+static uint64 hash_bytes(const uint8 *ptr, const uint32 len)
+{
+    const uint64 k = 0x9E3779B97F4A7C15ULL;
+    uint64 hash = len * k;
+    uint32 i;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        uint64 word;
+        memcpy(&word, ptr + i, sizeof (word));
+        hash = (hash ^ word) * k;
+        hash ^= hash >> 29;
+    }
+
+    if (i < len) {
+        uint64 word = 0;
+        memcpy(&word, ptr + i, len - i);
+        hash = (hash ^ word) * k;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+static void key_finish(CacheKey *key, const KeyKind kind,
+                       const uint8 *bytes, const uint32 len,
+                       const uint64 filelen)
+{
+    key->kind = kind;
+    key->bytes = bytes;
+    key->len = len;
+    key->filelen = filelen;
+    key->hash = hash_bytes(bytes, len) ^ (filelen * 0xFF51AFD7ED558CCDULL) ^ kind;
+}
+
+static int key_matches(const CacheEntry *entry, const CacheKey *key)
+{
+    return (entry->hash == key->hash) && (entry->filelen == key->filelen) &&
+           (entry->kind == key->kind) && (entry->keylen == key->len) &&
+           (memcmp(entry->key, key->bytes, key->len) == 0);
+}
+
+// Walk the bucket for key. Entries can be reused under a lookup that
+//  doesn't hold the lock, so the walk is bounded and indices are checked;
+//  the seqlock throws out anything found that way.
+static CacheEntry *find_entry(const MOJODDS_LayoutCache *cache,
+                              const CacheKey *key)
+{
+    uint32 index = load_relaxed(&cache->buckets[key->hash & cache->bucketmask]);
+    uint32 steps;
+    for (steps = 0; (steps < cache->capacity) && (index != 0); steps++) {
+        CacheEntry *entry;
+        if (index > cache->capacity) {
+            return NULL;  // torn read; the caller will retry.
+        }
+        entry = &cache->entries[index - 1];
+        if (key_matches(entry, key)) {
+            return entry;
+        }
+        index = load_relaxed(&entry->next);
+    }
+    return NULL;
+}
+
+// Nonzero and fills in err and layout if key is cached.
+static int lookup(MOJODDS_LayoutCache *cache, const CacheKey *key,
+                  MOJODDS_error *_err, MOJODDS_Layout *_layout)
+{
+    CacheEntry *entry = NULL;
+    int tries;
+
+    for (tries = 0; tries < MAX_OPTIMISTIC_TRIES; tries++) {
+        const uint32 seq = load_acquire(&cache->seq);
+        if (seq & 1) {
+            continue;  // a writer's in there.
+        }
+
+        entry = find_entry(cache, key);
+        if (entry != NULL) {
+            *_err = entry->err;
+            memcpy(_layout, &entry->layout, sizeof (*_layout));
+        }
+
+        fence_acquire();
+        if (load_relaxed(&cache->seq) == seq) {
+            break;  // nothing changed while we looked.
+        }
+    }
+
+    if (tries == MAX_OPTIMISTIC_TRIES) {
+        mutex_lock(&cache->lock);
+        entry = find_entry(cache, key);
+        if (entry != NULL) {
+            *_err = entry->err;
+            memcpy(_layout, &entry->layout, sizeof (*_layout));
+        }
+        mutex_unlock(&cache->lock);
+    }
+
+    if (entry == NULL) {
+        counter_add(&cache->misses);
+        return 0;
+    }
+
+    // a hit on an entry that was just replaced marks the new one; harmless.
+    store_relaxed(&entry->referenced, 1);
+    counter_add(&cache->hits);
+    return 1;
+}
+
+static void unlink_entry(MOJODDS_LayoutCache *cache, const uint32 index)
+{
+    CacheEntry *entry = &cache->entries[index - 1];
+    uint32 *link = &cache->buckets[entry->hash & cache->bucketmask];
+    while (*link != index) {
+        link = &cache->entries[*link - 1].next;
+    }
+    store_relaxed(link, entry->next);
+}
+
+// Call with the lock held and the sequence number odd.
+static uint32 evict_one(MOJODDS_LayoutCache *cache)
+{
+    while (1) {
+        CacheEntry *entry = &cache->entries[cache->hand];
+        const uint32 index = ++cache->hand;
+        if (cache->hand == cache->capacity) {
+            cache->hand = 0;
+        }
+
+        if (load_relaxed(&entry->referenced)) {
+            store_relaxed(&entry->referenced, 0);  // second chance.
+        } else {
+            unlink_entry(cache, index);
+            cache->evictions++;
+            return index;
+        }
+    }
+}
+
+static void insert(MOJODDS_LayoutCache *cache, const CacheKey *key,
+                   const MOJODDS_error err, const MOJODDS_Layout *layout)
+{
+    CacheEntry *entry;
+    uint32 *bucket;
+    uint32 index;
+
+    mutex_lock(&cache->lock);
+    if (find_entry(cache, key) != NULL) {
+        mutex_unlock(&cache->lock);
+        return;  // someone else missed on it at the same time.
+    }
+
+    store_relaxed(&cache->seq, cache->seq + 1);
+    fence_release();
+
+    if (cache->used < cache->capacity) {
+        index = ++cache->used;
+    } else {
+        index = evict_one(cache);
+    }
+
+    entry = &cache->entries[index - 1];
+    entry->hash = key->hash;
+    entry->kind = (uint32) key->kind;
+    entry->filelen = key->filelen;
+    entry->keylen = key->len;
+    entry->err = err;
+    memcpy(entry->key, key->bytes, key->len);
+    memcpy(&entry->layout, layout, sizeof (*layout));
+    entry->layout.tex = NULL;
+    store_relaxed(&entry->referenced, 0);
+
+    bucket = &cache->buckets[key->hash & cache->bucketmask];
+    entry->next = *bucket;
+    store_relaxed(bucket, index);
+
+    store_release(&cache->seq, cache->seq + 1);
+    mutex_unlock(&cache->lock);
+}
+
+
+MOJODDS_LayoutCache *MOJODDS_createLayoutCache(unsigned long budget)
+{
+    MOJODDS_LayoutCache *cache = (MOJODDS_LayoutCache *) calloc(1, sizeof (*cache));
+    uint32 buckets = 1;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->capacity = (uint32) MIN(budget / sizeof (CacheEntry), (unsigned long) 0x40000000);
+    cache->capacity = MAX(cache->capacity, 1);
+    while (buckets < cache->capacity) {
+        buckets *= 2;
+    }
+
+    cache->bucketmask = buckets - 1;
+    cache->buckets = (uint32 *) calloc(buckets, sizeof (uint32));
+    cache->entries = (CacheEntry *) calloc(cache->capacity, sizeof (CacheEntry));
+    if ((cache->buckets == NULL) || (cache->entries == NULL)) {
+        free(cache->buckets);
+        free(cache->entries);
+        free(cache);
+        return NULL;
+    }
+
+    mutex_init(&cache->lock);
+    return cache;
+}
+
+void MOJODDS_destroyLayoutCache(MOJODDS_LayoutCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->entries);
+    free(cache);
+}
+
+MOJODDS_error MOJODDS_getCachedLayout(MOJODDS_LayoutCache *cache,
+                                      const void *_ptr,
+                                      const unsigned long _len,
+                                      MOJODDS_Layout *_layout)
+{
+    const uint32 hdrlen = (uint32) MIN(_len, (unsigned long) MOJODDS_HEADER_MAXLEN);
+    MOJODDS_error err = MOJODDS_ERR_NONE;
+    CacheKey key;
+
+    key_finish(&key, KEY_CONTENT, (const uint8 *) _ptr, hdrlen, (uint64) _len);
+
+    if (!lookup(cache, &key, &err, _layout)) {
+        err = MOJODDS_validate(_ptr, _len, _len, _layout);
+        insert(cache, &key, err, _layout);
+    }
+
+    if (err != MOJODDS_ERR_NONE) {
+        return err;
+    }
+
+    // we had the whole file, so the pixels are all there.
+    _layout->tex = ((const uint8 *) _ptr) + _layout->dataoffset;
+    return MOJODDS_ERR_NONE;
+}
+
+
+#ifdef _WIN32
+typedef struct _stati64 StatBuf;
+#define stat_path(path, buf) _stati64(path, buf)
+#define stat_fd(fd, buf) _fstati64(fd, buf)
+#define open_fd(path) _open(path, _O_RDONLY | _O_BINARY)
+#define read_fd(fd, ptr, len) _read(fd, ptr, len)
+#define close_fd(fd) _close(fd)
+#else
+typedef struct stat StatBuf;
+#define stat_path(path, buf) stat(path, buf)
+#define stat_fd(fd, buf) fstat(fd, buf)
+#define open_fd(path) open(path, O_RDONLY)
+#define read_fd(fd, ptr, len) read(fd, ptr, len)
+#define close_fd(fd) close(fd)
+#endif
+
+static uint64 mtime_nsec(const StatBuf *statbuf)
+{
+#if defined(__linux__)
+    return (uint64) statbuf->st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return (uint64) statbuf->st_mtimespec.tv_nsec;
+#else
+    (void) statbuf;
+    return 0;  // seconds will have to do.
+#endif
+}
+
+static int path_key(CacheKey *key, const char *path, const StatBuf *statbuf)
+{
+    const size_t pathlen = strlen(path);
+    const uint64 mtime[2] = { (uint64) statbuf->st_mtime, mtime_nsec(statbuf) };
+    if (pathlen > KEY_MAX - sizeof (mtime)) {
+        return 0;
+    }
+    memcpy(key->storage, mtime, sizeof (mtime));
+    memcpy(key->storage + sizeof (mtime), path, pathlen);
+    key_finish(key, KEY_PATH, key->storage, (uint32) (sizeof (mtime) + pathlen),
+               (uint64) statbuf->st_size);
+    return 1;
+}
+
+// Read the headers of an open file; how many bytes we got, or -1.
+static long read_header(const int fd, uint8 *buf)
+{
+    long total = 0;
+    while (total < MOJODDS_HEADER_MAXLEN) {
+        const long rc = (long) read_fd(fd, buf + total, MOJODDS_HEADER_MAXLEN - total);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        } else if (rc == 0) {
+            break;  // short file; MOJODDS_validate() will say so.
+        }
+        total += rc;
+    }
+    return total;
+}
+
+MOJODDS_error MOJODDS_getCachedFileLayout(MOJODDS_LayoutCache *cache,
+                                          const char *path,
+                                          MOJODDS_Layout *_layout)
+{
+    uint8 header[MOJODDS_HEADER_MAXLEN];
+    MOJODDS_error err = MOJODDS_ERR_NONE;
+    StatBuf statbuf;
+    CacheKey key;
+    int cacheable;
+    long len;
+    int fd;
+
+    if (stat_path(path, &statbuf) == -1) {
+        return MOJODDS_ERR_IO;
+    }
+
+    cacheable = path_key(&key, path, &statbuf);
+    if (cacheable && lookup(cache, &key, &err, _layout)) {
+        return err;
+    }
+
+    fd = open_fd(path);
+    if (fd == -1) {
+        return MOJODDS_ERR_IO;
+    } else if (stat_fd(fd, &statbuf) == -1) {
+        close_fd(fd);
+        return MOJODDS_ERR_IO;
+    }
+
+    // key it on what we actually read, in case it changed since the stat().
+    cacheable = path_key(&key, path, &statbuf);
+    len = read_header(fd, header);
+    close_fd(fd);
+    if ((len < 0) || (((uint64) statbuf.st_size) > ULONG_MAX) ||
+        (((uint64) len) > (uint64) statbuf.st_size)) {
+        return MOJODDS_ERR_IO;
+    }
+
+    err = MOJODDS_validate(header, (unsigned long) len, (unsigned long) statbuf.st_size, _layout);
+    if (cacheable) {
+        insert(cache, &key, err, _layout);
+    }
+    _layout->tex = NULL;  // we haven't read the pixels.
+    return err;
+}
+
+void MOJODDS_getLayoutCacheStats(MOJODDS_LayoutCache *cache,
+                                 MOJODDS_LayoutCacheStats *stats)
+{
+    mutex_lock(&cache->lock);
+    stats->hits = (unsigned long) counter_load(&cache->hits);
+    stats->misses = (unsigned long) counter_load(&cache->misses);
+    stats->evictions = (unsigned long) cache->evictions;
+    stats->entries = (unsigned long) cache->used;
+    stats->bytes = (unsigned long) (cache->used * sizeof (CacheEntry));
+    mutex_unlock(&cache->lock);
+}
+
+// end of mojodds_cache.c ...
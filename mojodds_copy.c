@@ -0,0 +1,206 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Copying block-aligned rectangles out of a mip level, compressed bytes and
+//  all, and the MOJODDS_copyRect() and MOJODDS_copyRects() entry points.
+//
+// The batched version walks the source one block row at a time, top to
+//  bottom, and hands each row's bytes to every rectangle that covers it
+//  before moving on, so a mip is read once no matter how many pages are cut
+//  from it.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+typedef struct
+{
+    uint32 top;  // first and last-plus-one block rows.
+    uint32 bottom;
+    uint32 left;  // first block column.
+    size_t len;  // bytes per block row.
+    uint8 *dst;
+    size_t dstpitch;
+} CopySpan;
+
+static int check_source(const uint32 glfmt, const unsigned long srclen,
+                        const uint32 w, const uint32 h, unsigned int *_blockDim,
+                        unsigned int *_blockSize, size_t *_srcpitch)
+{
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    size_t srcpitch;
+
+    if (!MOJODDS_getFormatInfo(glfmt, &blockDim, &blockSize, NULL, NULL, NULL)) {
+        return 0;
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    }
+
+    srcpitch = ((size_t) ((w + blockDim - 1) / blockDim)) * blockSize;
+    if (((uint64) srcpitch) * ((h + blockDim - 1) / blockDim) > srclen) {
+        return 0;  // not enough source data.
+    }
+
+    *_blockDim = blockDim;
+    *_blockSize = blockSize;
+    *_srcpitch = srcpitch;
+    return 1;
+}
+
+static int check_rect(const MOJODDS_CopyRect *rect, const uint32 srcw,
+                      const uint32 srch, const uint32 blockDim,
+                      const uint32 blockSize)
+{
+    if ((rect->dst == NULL) || (rect->w == 0) || (rect->h == 0)) {
+        return 0;
+    } else if ((rect->x > srcw) || (rect->w > srcw - rect->x)) {
+        return 0;
+    } else if ((rect->y > srch) || (rect->h > srch - rect->y)) {
+        return 0;
+    } else if (((rect->x % blockDim) != 0) || ((rect->y % blockDim) != 0)) {
+        return 0;  // doesn't start on a block.
+    } else if (((rect->w % blockDim) != 0) && (rect->x + rect->w != srcw)) {
+        return 0;  // would end partway through a block.
+    } else if (((rect->h % blockDim) != 0) && (rect->y + rect->h != srch)) {
+        return 0;
+    } else if (((uint64) ((rect->w + blockDim - 1) / blockDim)) * blockSize > rect->dstpitch) {
+        return 0;  // rows would overlap.
+    }
+    return 1;
+}
+
+static int compare_spans(const void *_a, const void *_b)
+{
+    const CopySpan *a = (const CopySpan *) _a;
+    const CopySpan *b = (const CopySpan *) _b;
+    if (a->top != b->top) {
+        return (a->top < b->top) ? -1 : 1;
+    } else if (a->left != b->left) {
+        return (a->left < b->left) ? -1 : 1;
+    }
+    return 0;
+}
+
+int MOJODDS_copyRects(unsigned int glfmt, const void *_src,
+                      unsigned long _srclen, unsigned int w, unsigned int h,
+                      const MOJODDS_CopyRect *rects, unsigned int count)
+{
+    const uint8 *src = (const uint8 *) _src;
+    CopySpan *spans = NULL;
+    CopySpan **active = NULL;
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    unsigned int numActive = 0;
+    unsigned int next = 0;
+    size_t srcpitch;
+    uint32 blocksh;
+    uint32 by;
+    unsigned int i;
+
+    if (!check_source(glfmt, _srclen, w, h, &blockDim, &blockSize, &srcpitch)) {
+        return 0;
+    } else if ((rects == NULL) && (count > 0)) {
+        return 0;
+    }
+
+    blocksh = (h + blockDim - 1) / blockDim;
+
+    // check everything up front, so a bad rect doesn't leave a partial copy.
+    for (i = 0; i < count; i++) {
+        if (!check_rect(&rects[i], w, h, blockDim, blockSize)) {
+            return 0;
+        }
+    }
+
+    if (count == 0) {
+        return 1;
+    }
+
+    spans = (CopySpan *) malloc(sizeof (CopySpan) * count);
+    active = (CopySpan **) malloc(sizeof (CopySpan *) * count);
+    if ((spans == NULL) || (active == NULL)) {
+        free(spans);
+        free(active);
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        const MOJODDS_CopyRect *rect = &rects[i];
+        CopySpan *span = &spans[i];
+        span->top = rect->y / blockDim;
+        span->bottom = span->top + ((rect->h + blockDim - 1) / blockDim);
+        span->left = rect->x / blockDim;
+        span->len = ((size_t) ((rect->w + blockDim - 1) / blockDim)) * blockSize;
+        span->dst = (uint8 *) rect->dst;
+        span->dstpitch = (size_t) rect->dstpitch;
+    }
+
+    // by starting row, then left to right, so each source row is read in
+    //  order as long as the rects don't overlap.
+    qsort(spans, count, sizeof (CopySpan), compare_spans);
+
+    for (by = 0; by < blocksh; by++) {
+        const uint8 *row = src + (by * srcpitch);
+        unsigned int kept = 0;
+
+        while ((next < count) && (spans[next].top == by)) {
+            active[numActive++] = &spans[next++];
+        }
+
+        for (i = 0; i < numActive; i++) {
+            CopySpan *span = active[i];
+            memcpy(span->dst, row + (((size_t) span->left) * blockSize), span->len);
+            span->dst += span->dstpitch;
+            if (by + 1 < span->bottom) {
+                active[kept++] = span;
+            }
+        }
+        numActive = kept;
+
+        if ((numActive == 0) && (next == count)) {
+            break;  // nothing left below here.
+        }
+    }
+
+    free(active);
+    free(spans);
+    return 1;
+}
+
+int MOJODDS_copyRect(unsigned int glfmt, const void *_src,
+                     unsigned long _srclen, unsigned int w, unsigned int h,
+                     const MOJODDS_CopyRect *rect)
+{
+    const uint8 *src;
+    uint8 *dst;
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    size_t srcpitch;
+    size_t len;
+    uint32 by;
+    uint32 bottom;
+
+    if (!check_source(glfmt, _srclen, w, h, &blockDim, &blockSize, &srcpitch)) {
+        return 0;
+    } else if ((rect == NULL) || !check_rect(rect, w, h, blockDim, blockSize)) {
+        return 0;
+    }
+
+    src = ((const uint8 *) _src) + (((size_t) (rect->x / blockDim)) * blockSize);
+    dst = (uint8 *) rect->dst;
+    len = ((size_t) ((rect->w + blockDim - 1) / blockDim)) * blockSize;
+    bottom = (rect->y / blockDim) + ((rect->h + blockDim - 1) / blockDim);
+    for (by = rect->y / blockDim; by < bottom; by++) {
+        memcpy(dst, src + (by * srcpitch), len);
+        dst += rect->dstpitch;
+    }
+    return 1;
+}
+
+// end of mojodds_copy.c ...
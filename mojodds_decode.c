@@ -0,0 +1,1168 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Software decoders for the block-compressed formats (BPTC lives in
+//  mojodds_bptc.c), and the MOJODDS_decode() entry point.
+//
+// Every format has a scalar reference decoder; the SIMD versions must match
+//  it bit for bit, so keep any rounding changes in sync between them.
+
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#include <immintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+static uint32 read32(const uint8 *ptr)
+{
+    return (((uint32) ptr[0]) <<  0) | (((uint32) ptr[1]) <<  8) |
+           (((uint32) ptr[2]) << 16) | (((uint32) ptr[3]) << 24) ;
+}
+
+static uint32 read24(const uint8 *ptr)
+{
+    return (((uint32) ptr[0]) << 0) | (((uint32) ptr[1]) << 8) |
+           (((uint32) ptr[2]) << 16);
+}
+
+
+// Scalar reference decoders...
+
+static void expand565(const uint32 c, uint8 *rgba)
+{
+    const uint32 r = (c >> 11) & 0x1F;
+    const uint32 g = (c >> 5) & 0x3F;
+    const uint32 b = c & 0x1F;
+    rgba[0] = (uint8) ((r << 3) | (r >> 2));
+    rgba[1] = (uint8) ((g << 2) | (g >> 4));
+    rgba[2] = (uint8) ((b << 3) | (b >> 2));
+    rgba[3] = 0xFF;
+}
+
+// BC1 blocks with c0 <= c1 use three colors plus transparent black; BC2 and
+//  BC3 color blocks always use four colors.
+static void bc1_palette(const uint8 *src, uint8 pal[4][4], const int punchthrough)
+{
+    const uint32 c0 = ((uint32) src[0]) | (((uint32) src[1]) << 8);
+    const uint32 c1 = ((uint32) src[2]) | (((uint32) src[3]) << 8);
+    int i;
+
+    expand565(c0, pal[0]);
+    expand565(c1, pal[1]);
+
+    if ((c0 > c1) || (!punchthrough)) {
+        for (i = 0; i < 3; i++) {
+            pal[2][i] = (uint8) ((2 * pal[0][i] + pal[1][i] + 1) / 3);
+            pal[3][i] = (uint8) ((pal[0][i] + 2 * pal[1][i] + 1) / 3);
+        }
+        pal[2][3] = pal[3][3] = 0xFF;
+    } else {
+        for (i = 0; i < 3; i++) {
+            pal[2][i] = (uint8) ((pal[0][i] + pal[1][i] + 1) / 2);
+            pal[3][i] = 0;
+        }
+        pal[2][3] = 0xFF;
+        pal[3][3] = 0;  // transparent black.
+    }
+}
+
+static void bc1_colors(const uint8 *src, uint8 *dst, const size_t pitch,
+                       const int punchthrough)
+{
+    uint8 pal[4][4];
+    uint32 indices = read32(src + 4);
+    int x, y;
+
+    bc1_palette(src, pal, punchthrough);
+    for (y = 0; y < 4; y++) {
+        uint8 *row = dst + (y * pitch);
+        for (x = 0; x < 4; x++, indices >>= 2) {
+            memcpy(row + (x * 4), pal[indices & 3], 4);
+        }
+    }
+}
+
+// Alpha for one block, as (a << 24) for each of its 16 pixels, so the SIMD
+//  paths can OR it straight into packed RGBA.
+static void bc2_alpha_words(const uint8 *src, uint32 *alpha)
+{
+    int i;
+    for (i = 0; i < 16; i++) {
+        const uint32 a = (src[i / 2] >> ((i & 1) * 4)) & 0xF;
+        alpha[i] = (a * 17) << 24;
+    }
+}
+
+static void bc3_alpha_palette(const uint8 *src, uint32 pal[8])
+{
+    const uint32 a0 = src[0];
+    const uint32 a1 = src[1];
+    uint32 i;
+
+    pal[0] = a0;
+    pal[1] = a1;
+    if (a0 > a1) {
+        for (i = 2; i < 8; i++) {
+            pal[i] = (((8 - i) * a0) + ((i - 1) * a1) + 3) / 7;
+        }
+    } else {
+        for (i = 2; i < 6; i++) {
+            pal[i] = (((6 - i) * a0) + ((i - 1) * a1) + 2) / 5;
+        }
+        pal[6] = 0;
+        pal[7] = 0xFF;
+    }
+}
+
+static void bc3_alpha_words(const uint8 *src, uint32 *alpha)
+{
+    uint32 pal[8];
+    uint32 indices = read24(src + 2);
+    int i;
+
+    bc3_alpha_palette(src, pal);
+    for (i = 0; i < 16; i++, indices >>= 3) {
+        if (i == 8) {
+            indices = read24(src + 5);
+        }
+        alpha[i] = pal[indices & 7] << 24;
+    }
+}
+
+static void apply_alpha(const uint32 *alpha, uint8 *dst, const size_t pitch)
+{
+    int x, y;
+    for (y = 0; y < 4; y++) {
+        for (x = 0; x < 4; x++) {
+            dst[(y * pitch) + (x * 4) + 3] = (uint8) (alpha[(y * 4) + x] >> 24);
+        }
+    }
+}
+
+static void decode_bc1_scalar(const uint8 *src, unsigned int blocks,
+                              uint8 *dst, size_t pitch)
+{
+    for (; blocks > 0; blocks--, src += 8, dst += 16) {
+        bc1_colors(src, dst, pitch, 1);
+    }
+}
+
+static void decode_bc2_scalar(const uint8 *src, unsigned int blocks,
+                              uint8 *dst, size_t pitch)
+{
+    uint32 alpha[16];
+    for (; blocks > 0; blocks--, src += 16, dst += 16) {
+        bc1_colors(src + 8, dst, pitch, 0);
+        bc2_alpha_words(src, alpha);
+        apply_alpha(alpha, dst, pitch);
+    }
+}
+
+static void decode_bc3_scalar(const uint8 *src, unsigned int blocks,
+                              uint8 *dst, size_t pitch)
+{
+    uint32 alpha[16];
+    for (; blocks > 0; blocks--, src += 16, dst += 16) {
+        bc1_colors(src + 8, dst, pitch, 0);
+        bc3_alpha_words(src, alpha);
+        apply_alpha(alpha, dst, pitch);
+    }
+}
+
+// Z of a unit normal from its X and Y, 0..255 mapping to -1..1, rounded to
+//  nearest. 255*z is sqrt(65025 - dx*dx - dy*dy) with dx = 2x - 255; sqrt
+//  is correctly rounded on every path, so the SIMD versions match this.
+static uint8 normal_z(const uint32 x, const uint32 y)
+{
+    const int dx = ((int) x * 2) - 255;
+    const int dy = ((int) y * 2) - 255;
+    const int s = MAX(65025 - (dx * dx) - (dy * dy), 0);
+    return (uint8) ((256.0f + sqrtf((float) s)) * 0.5f);
+}
+
+// BC4 and BC5 channels are each laid out like a BC3 alpha block, so they
+//  come in as (value << 24) words. BC4 decodes to (r, 0, 0, 255) and BC5 to
+//  (r, g, 0, 255), the way GL samples red and red-green textures; with
+//  normal set, BC5's blue is the rebuilt Z instead.
+static void decode_rg_scalar(const uint8 *src, unsigned int blocks,
+                             uint8 *dst, size_t pitch,
+                             const int channels, const int normal)
+{
+    uint32 red[16], green[16];
+    int x, y;
+
+    memset(green, '\0', sizeof (green));
+    for (; blocks > 0; blocks--, src += channels * 8, dst += 16) {
+        bc3_alpha_words(src, red);
+        if (channels == 2) {
+            bc3_alpha_words(src + 8, green);
+        }
+        for (y = 0; y < 4; y++) {
+            for (x = 0; x < 4; x++) {
+                const uint32 r = red[(y * 4) + x] >> 24;
+                const uint32 g = green[(y * 4) + x] >> 24;
+                uint8 *px = dst + (y * pitch) + (x * 4);
+                px[0] = (uint8) r;
+                px[1] = (uint8) g;
+                px[2] = normal ? normal_z(r, g) : 0;
+                px[3] = 0xFF;
+            }
+        }
+    }
+}
+
+static void decode_bc4_scalar(const uint8 *src, unsigned int blocks,
+                              uint8 *dst, size_t pitch)
+{
+    decode_rg_scalar(src, blocks, dst, pitch, 1, 0);
+}
+
+static void decode_bc5_scalar(const uint8 *src, unsigned int blocks,
+                              uint8 *dst, size_t pitch)
+{
+    decode_rg_scalar(src, blocks, dst, pitch, 2, 0);
+}
+
+static void decode_bc5_normal_scalar(const uint8 *src, unsigned int blocks,
+                                     uint8 *dst, size_t pitch)
+{
+    decode_rg_scalar(src, blocks, dst, pitch, 2, 1);
+}
+
+
+#ifdef MOJODDS_HAVE_X86
+
+// The x86 kernels build palettes for several blocks at once, one block per
+//  32-bit lane, then expand each block's indices against its own palette.
+
+static MOJODDS_TARGET("sse2") __m128i sse2_select(const __m128i mask,
+                                                  const __m128i a,
+                                                  const __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// (colors) holds (c0 | (c1 << 16)) for four blocks. pal[i] gets palette
+//  entry i of each block, as packed RGBA8.
+static MOJODDS_TARGET("sse2") void sse2_bc1_palettes(const __m128i colors,
+                                                     const int punchthrough,
+                                                     __m128i pal[4])
+{
+    const __m128i mask5 = _mm_set1_epi32(0x1F);
+    const __m128i mask6 = _mm_set1_epi32(0x3F);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i third = _mm_set1_epi16((short) 0xAAAB);  // 2^17 / 3
+    const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+    const __m128i c0 = _mm_and_si128(colors, _mm_set1_epi32(0xFFFF));
+    const __m128i c1 = _mm_srli_epi32(colors, 16);
+    __m128i r0 = _mm_srli_epi32(c0, 11);
+    __m128i g0 = _mm_and_si128(_mm_srli_epi32(c0, 5), mask6);
+    __m128i b0 = _mm_and_si128(c0, mask5);
+    __m128i r1 = _mm_srli_epi32(c1, 11);
+    __m128i g1 = _mm_and_si128(_mm_srli_epi32(c1, 5), mask6);
+    __m128i b1 = _mm_and_si128(c1, mask5);
+    __m128i r2, g2, b2, r3, g3, b3;
+    __m128i alpha3 = opaque;
+
+    r0 = _mm_or_si128(_mm_slli_epi32(r0, 3), _mm_srli_epi32(r0, 2));
+    g0 = _mm_or_si128(_mm_slli_epi32(g0, 2), _mm_srli_epi32(g0, 4));
+    b0 = _mm_or_si128(_mm_slli_epi32(b0, 3), _mm_srli_epi32(b0, 2));
+    r1 = _mm_or_si128(_mm_slli_epi32(r1, 3), _mm_srli_epi32(r1, 2));
+    g1 = _mm_or_si128(_mm_slli_epi32(g1, 2), _mm_srli_epi32(g1, 4));
+    b1 = _mm_or_si128(_mm_slli_epi32(b1, 3), _mm_srli_epi32(b1, 2));
+
+    // x / 3 == (x * 0xAAAB) >> 17 for every x we can see here.
+    #define SSE2_THIRD(a, b) _mm_srli_epi32(_mm_mulhi_epu16(_mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(a, 1), b), one), third), 1)
+    r2 = SSE2_THIRD(r0, r1);
+    g2 = SSE2_THIRD(g0, g1);
+    b2 = SSE2_THIRD(b0, b1);
+    r3 = SSE2_THIRD(r1, r0);
+    g3 = SSE2_THIRD(g1, g0);
+    b3 = SSE2_THIRD(b1, b0);
+    #undef SSE2_THIRD
+
+    if (punchthrough) {
+        const __m128i four = _mm_cmpgt_epi32(c0, c1);
+        #define SSE2_HALF(a, b) _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(a, b), one), 1)
+        r2 = sse2_select(four, r2, SSE2_HALF(r0, r1));
+        g2 = sse2_select(four, g2, SSE2_HALF(g0, g1));
+        b2 = sse2_select(four, b2, SSE2_HALF(b0, b1));
+        #undef SSE2_HALF
+        r3 = _mm_and_si128(four, r3);
+        g3 = _mm_and_si128(four, g3);
+        b3 = _mm_and_si128(four, b3);
+        alpha3 = _mm_and_si128(four, opaque);
+    }
+
+    #define SSE2_PACK(r, g, b, a) _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), a))
+    pal[0] = SSE2_PACK(r0, g0, b0, opaque);
+    pal[1] = SSE2_PACK(r1, g1, b1, opaque);
+    pal[2] = SSE2_PACK(r2, g2, b2, opaque);
+    pal[3] = SSE2_PACK(r3, g3, b3, alpha3);
+    #undef SSE2_PACK
+}
+
+// Four blocks: colors/indices have one block per lane, alpha is NULL or
+//  16 alpha words per block.
+static MOJODDS_TARGET("sse2") void sse2_decode4(const __m128i colors,
+                                                const __m128i indices,
+                                                const int punchthrough,
+                                                const uint32 alpha[4][16],
+                                                uint8 *dst, const size_t pitch)
+{
+    const __m128i bit0 = _mm_setr_epi32(0x01, 0x04, 0x10, 0x40);
+    const __m128i bit1 = _mm_setr_epi32(0x02, 0x08, 0x20, 0x80);
+    const __m128i rgbmask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i pal[4];
+    uint32 palbuf[4][4];
+    uint32 idxbuf[4];
+    int i, y;
+
+    sse2_bc1_palettes(colors, punchthrough, pal);
+    for (i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i *) palbuf[i], pal[i]);
+    }
+    _mm_storeu_si128((__m128i *) idxbuf, indices);
+
+    for (i = 0; i < 4; i++, dst += 16) {
+        const __m128i p0 = _mm_set1_epi32((int) palbuf[0][i]);
+        const __m128i p1 = _mm_set1_epi32((int) palbuf[1][i]);
+        const __m128i p2 = _mm_set1_epi32((int) palbuf[2][i]);
+        const __m128i p3 = _mm_set1_epi32((int) palbuf[3][i]);
+        __m128i ix = _mm_set1_epi32((int) idxbuf[i]);
+        for (y = 0; y < 4; y++) {
+            const __m128i lo = _mm_cmpeq_epi32(_mm_and_si128(ix, bit0), bit0);
+            const __m128i hi = _mm_cmpeq_epi32(_mm_and_si128(ix, bit1), bit1);
+            __m128i px = sse2_select(hi, sse2_select(lo, p3, p2),
+                                         sse2_select(lo, p1, p0));
+            if (alpha) {
+                const __m128i a = _mm_loadu_si128((const __m128i *) &alpha[i][y * 4]);
+                px = _mm_or_si128(_mm_and_si128(px, rgbmask), a);
+            }
+            _mm_storeu_si128((__m128i *) (dst + (y * pitch)), px);
+            ix = _mm_srli_epi32(ix, 8);
+        }
+    }
+}
+
+// Pull the color words and index words out of four BC1 blocks...
+static MOJODDS_TARGET("sse2") void sse2_split_bc1(const uint8 *src,
+                                                  __m128i *colors,
+                                                  __m128i *indices)
+{
+    const __m128i lo = _mm_loadu_si128((const __m128i *) src);
+    const __m128i hi = _mm_loadu_si128((const __m128i *) (src + 16));
+    const __m128i a = _mm_unpacklo_epi32(lo, hi);  // c0 c2 i0 i2
+    const __m128i b = _mm_unpackhi_epi32(lo, hi);  // c1 c3 i1 i3
+    *colors = _mm_unpacklo_epi32(a, b);
+    *indices = _mm_unpackhi_epi32(a, b);
+}
+
+// ...or out of the color halves of four BC2/BC3 blocks.
+static MOJODDS_TARGET("sse2") void sse2_split_bc3(const uint8 *src,
+                                                  __m128i *colors,
+                                                  __m128i *indices)
+{
+    const __m128i b0 = _mm_loadu_si128((const __m128i *) src);
+    const __m128i b1 = _mm_loadu_si128((const __m128i *) (src + 16));
+    const __m128i b2 = _mm_loadu_si128((const __m128i *) (src + 32));
+    const __m128i b3 = _mm_loadu_si128((const __m128i *) (src + 48));
+    const __m128i a = _mm_unpackhi_epi32(b0, b1);  // c0 c1 i0 i1
+    const __m128i b = _mm_unpackhi_epi32(b2, b3);  // c2 c3 i2 i3
+    *colors = _mm_unpacklo_epi64(a, b);
+    *indices = _mm_unpackhi_epi64(a, b);
+}
+
+static MOJODDS_TARGET("sse2") void decode_bc1_sse2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    __m128i colors, indices;
+    for (; blocks >= 4; blocks -= 4, src += 32, dst += 64) {
+        sse2_split_bc1(src, &colors, &indices);
+        sse2_decode4(colors, indices, 1, NULL, dst, pitch);
+    }
+    decode_bc1_scalar(src, blocks, dst, pitch);
+}
+
+static MOJODDS_TARGET("sse2") void decode_bc2_sse2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    uint32 alpha[4][16];
+    __m128i colors, indices;
+    int i;
+    for (; blocks >= 4; blocks -= 4, src += 64, dst += 64) {
+        for (i = 0; i < 4; i++) {
+            bc2_alpha_words(src + (i * 16), alpha[i]);
+        }
+        sse2_split_bc3(src, &colors, &indices);
+        sse2_decode4(colors, indices, 0, (const uint32 (*)[16]) alpha, dst, pitch);
+    }
+    decode_bc2_scalar(src, blocks, dst, pitch);
+}
+
+static MOJODDS_TARGET("sse2") void decode_bc3_sse2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    uint32 alpha[4][16];
+    __m128i colors, indices;
+    int i;
+    for (; blocks >= 4; blocks -= 4, src += 64, dst += 64) {
+        for (i = 0; i < 4; i++) {
+            bc3_alpha_words(src + (i * 16), alpha[i]);
+        }
+        sse2_split_bc3(src, &colors, &indices);
+        sse2_decode4(colors, indices, 0, (const uint32 (*)[16]) alpha, dst, pitch);
+    }
+    decode_bc3_scalar(src, blocks, dst, pitch);
+}
+
+// BC4/BC5 palettes stay scalar here; what SSE2 buys is packing four pixels
+//  at a time and doing the normal's square roots four at once.
+static MOJODDS_TARGET("sse2") __m128i sse2_normal_z(const __m128i r, const __m128i g)
+{
+    // dx and dy side by side as 16-bit values, so one madd squares and sums.
+    const __m128i xy = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+    const __m128i d = _mm_sub_epi16(_mm_add_epi16(xy, xy), _mm_set1_epi16(255));
+    const __m128i s = _mm_sub_epi32(_mm_set1_epi32(65025), _mm_madd_epi16(d, d));
+    const __m128 root = _mm_sqrt_ps(_mm_max_ps(_mm_cvtepi32_ps(s), _mm_setzero_ps()));
+    return _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(root, _mm_set1_ps(256.0f)), _mm_set1_ps(0.5f)));
+}
+
+static MOJODDS_TARGET("sse2") void decode_rg_sse2(const uint8 *src,
+                                                  unsigned int blocks,
+                                                  uint8 *dst, size_t pitch,
+                                                  const int channels,
+                                                  const int normal)
+{
+    const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+    uint32 red[16], green[16];
+    int y;
+
+    memset(green, '\0', sizeof (green));
+    for (; blocks > 0; blocks--, src += channels * 8, dst += 16) {
+        bc3_alpha_words(src, red);
+        if (channels == 2) {
+            bc3_alpha_words(src + 8, green);
+        }
+        for (y = 0; y < 4; y++) {
+            const __m128i r = _mm_srli_epi32(_mm_loadu_si128((const __m128i *) &red[y * 4]), 24);
+            const __m128i g = _mm_srli_epi32(_mm_loadu_si128((const __m128i *) &green[y * 4]), 24);
+            __m128i rgba = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), opaque);
+            if (normal) {
+                rgba = _mm_or_si128(rgba, _mm_slli_epi32(sse2_normal_z(r, g), 16));
+            }
+            _mm_storeu_si128((__m128i *) (dst + (y * pitch)), rgba);
+        }
+    }
+}
+
+static MOJODDS_TARGET("sse2") void decode_bc4_sse2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    decode_rg_sse2(src, blocks, dst, pitch, 1, 0);
+}
+
+static MOJODDS_TARGET("sse2") void decode_bc5_sse2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    decode_rg_sse2(src, blocks, dst, pitch, 2, 0);
+}
+
+static MOJODDS_TARGET("sse2") void decode_bc5_normal_sse2(const uint8 *src,
+                                                          unsigned int blocks,
+                                                          uint8 *dst, size_t pitch)
+{
+    decode_rg_sse2(src, blocks, dst, pitch, 2, 1);
+}
+
+
+// AVX2 does eight blocks per pass, and with variable shifts plus a lane
+//  permute it can look palette entries up directly instead of masking.
+
+static MOJODDS_TARGET("avx2") __m256i avx2_select(const __m256i mask,
+                                                  const __m256i a,
+                                                  const __m256i b)
+{
+    return _mm256_blendv_epi8(b, a, mask);
+}
+
+static MOJODDS_TARGET("avx2") void avx2_bc1_palettes(const __m256i colors,
+                                                     const int punchthrough,
+                                                     __m256i pal[4])
+{
+    const __m256i mask5 = _mm256_set1_epi32(0x1F);
+    const __m256i mask6 = _mm256_set1_epi32(0x3F);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i third = _mm256_set1_epi16((short) 0xAAAB);
+    const __m256i opaque = _mm256_set1_epi32((int) 0xFF000000);
+    const __m256i c0 = _mm256_and_si256(colors, _mm256_set1_epi32(0xFFFF));
+    const __m256i c1 = _mm256_srli_epi32(colors, 16);
+    __m256i r0 = _mm256_srli_epi32(c0, 11);
+    __m256i g0 = _mm256_and_si256(_mm256_srli_epi32(c0, 5), mask6);
+    __m256i b0 = _mm256_and_si256(c0, mask5);
+    __m256i r1 = _mm256_srli_epi32(c1, 11);
+    __m256i g1 = _mm256_and_si256(_mm256_srli_epi32(c1, 5), mask6);
+    __m256i b1 = _mm256_and_si256(c1, mask5);
+    __m256i r2, g2, b2, r3, g3, b3;
+    __m256i alpha3 = opaque;
+
+    r0 = _mm256_or_si256(_mm256_slli_epi32(r0, 3), _mm256_srli_epi32(r0, 2));
+    g0 = _mm256_or_si256(_mm256_slli_epi32(g0, 2), _mm256_srli_epi32(g0, 4));
+    b0 = _mm256_or_si256(_mm256_slli_epi32(b0, 3), _mm256_srli_epi32(b0, 2));
+    r1 = _mm256_or_si256(_mm256_slli_epi32(r1, 3), _mm256_srli_epi32(r1, 2));
+    g1 = _mm256_or_si256(_mm256_slli_epi32(g1, 2), _mm256_srli_epi32(g1, 4));
+    b1 = _mm256_or_si256(_mm256_slli_epi32(b1, 3), _mm256_srli_epi32(b1, 2));
+
+    #define AVX2_THIRD(a, b) _mm256_srli_epi32(_mm256_mulhi_epu16(_mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(a, 1), b), one), third), 1)
+    r2 = AVX2_THIRD(r0, r1);
+    g2 = AVX2_THIRD(g0, g1);
+    b2 = AVX2_THIRD(b0, b1);
+    r3 = AVX2_THIRD(r1, r0);
+    g3 = AVX2_THIRD(g1, g0);
+    b3 = AVX2_THIRD(b1, b0);
+    #undef AVX2_THIRD
+
+    if (punchthrough) {
+        const __m256i four = _mm256_cmpgt_epi32(c0, c1);
+        #define AVX2_HALF(a, b) _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(a, b), one), 1)
+        r2 = avx2_select(four, r2, AVX2_HALF(r0, r1));
+        g2 = avx2_select(four, g2, AVX2_HALF(g0, g1));
+        b2 = avx2_select(four, b2, AVX2_HALF(b0, b1));
+        #undef AVX2_HALF
+        r3 = _mm256_and_si256(four, r3);
+        g3 = _mm256_and_si256(four, g3);
+        b3 = _mm256_and_si256(four, b3);
+        alpha3 = _mm256_and_si256(four, opaque);
+    }
+
+    #define AVX2_PACK(r, g, b, a) _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(b, 16), a))
+    pal[0] = AVX2_PACK(r0, g0, b0, opaque);
+    pal[1] = AVX2_PACK(r1, g1, b1, opaque);
+    pal[2] = AVX2_PACK(r2, g2, b2, opaque);
+    pal[3] = AVX2_PACK(r3, g3, b3, alpha3);
+    #undef AVX2_PACK
+}
+
+static MOJODDS_TARGET("avx2") void avx2_bc2_alpha(const uint8 *src, __m256i alpha[2])
+{
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256i nibble = _mm256_set1_epi32(0xF);
+    int i;
+    for (i = 0; i < 2; i++) {
+        const __m256i ix = _mm256_set1_epi32((int) read32(src + (i * 4)));
+        const __m256i a = _mm256_and_si256(_mm256_srlv_epi32(ix, shifts), nibble);
+        alpha[i] = _mm256_slli_epi32(_mm256_or_si256(a, _mm256_slli_epi32(a, 4)), 24);
+    }
+}
+
+static MOJODDS_TARGET("avx2") void avx2_bc3_alpha(const uint8 *src, __m256i alpha[2])
+{
+    const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i a0 = _mm256_set1_epi32(src[0]);
+    const __m256i a1 = _mm256_set1_epi32(src[1]);
+    __m256i pal;
+
+    // Same weights as bc3_alpha_palette(), all eight entries at once;
+    //  x / 7 == (x * 9363) >> 16 and x / 5 == (x * 13108) >> 16 here.
+    if (src[0] > src[1]) {
+        const __m256i w0 = _mm256_setr_epi32(7, 0, 6, 5, 4, 3, 2, 1);
+        const __m256i w1 = _mm256_setr_epi32(0, 7, 1, 2, 3, 4, 5, 6);
+        const __m256i x = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(w0, a0), _mm256_mullo_epi32(w1, a1)), _mm256_set1_epi32(3));
+        pal = _mm256_mulhi_epu16(x, _mm256_set1_epi16(9363));
+    } else {
+        const __m256i w0 = _mm256_setr_epi32(5, 0, 4, 3, 2, 1, 0, 0);
+        const __m256i w1 = _mm256_setr_epi32(0, 5, 1, 2, 3, 4, 0, 0);
+        const __m256i x = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(w0, a0), _mm256_mullo_epi32(w1, a1)), _mm256_set1_epi32(2));
+        pal = _mm256_mulhi_epu16(x, _mm256_set1_epi16(13108));
+        pal = _mm256_blend_epi32(pal, _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0xFF), 0xC0);
+    }
+
+    // permutevar only looks at the low three bits, so no masking needed.
+    alpha[0] = _mm256_slli_epi32(_mm256_permutevar8x32_epi32(pal, _mm256_srlv_epi32(_mm256_set1_epi32((int) read24(src + 2)), shifts)), 24);
+    alpha[1] = _mm256_slli_epi32(_mm256_permutevar8x32_epi32(pal, _mm256_srlv_epi32(_mm256_set1_epi32((int) read24(src + 5)), shifts)), 24);
+}
+
+// Eight blocks; block i's colors/indices are in lane i. alphasrc is NULL
+//  for BC1, otherwise the first of eight 16-byte BC2/BC3 blocks.
+static MOJODDS_TARGET("avx2") void avx2_decode8(const __m256i colors,
+                                                const __m256i indices,
+                                                const int punchthrough,
+                                                const uint8 *alphasrc,
+                                                const uint32 glfmt,
+                                                uint8 *dst, const size_t pitch)
+{
+    const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i shifts2 = _mm256_add_epi32(shifts, _mm256_set1_epi32(16));
+    const __m256i rgbmask = _mm256_set1_epi32(0x00FFFFFF);
+    __m256i pal[4];
+    __m256i blockpal[4];
+    uint32 idxbuf[8];
+    int i;
+
+    avx2_bc1_palettes(colors, punchthrough, pal);
+    _mm256_storeu_si256((__m256i *) idxbuf, indices);
+
+    // Transpose so each 128-bit half holds one block's four colors:
+    //  blockpal[i] is block i in the low half, block i+4 in the high half.
+    {
+        const __m256i t0 = _mm256_unpacklo_epi32(pal[0], pal[1]);
+        const __m256i t1 = _mm256_unpacklo_epi32(pal[2], pal[3]);
+        const __m256i t2 = _mm256_unpackhi_epi32(pal[0], pal[1]);
+        const __m256i t3 = _mm256_unpackhi_epi32(pal[2], pal[3]);
+        blockpal[0] = _mm256_unpacklo_epi64(t0, t1);
+        blockpal[1] = _mm256_unpackhi_epi64(t0, t1);
+        blockpal[2] = _mm256_unpacklo_epi64(t2, t3);
+        blockpal[3] = _mm256_unpackhi_epi64(t2, t3);
+    }
+
+    for (i = 0; i < 8; i++) {
+        const __m256i p = (i < 4) ? _mm256_permute2x128_si256(blockpal[i], blockpal[i], 0x00)
+                                  : _mm256_permute2x128_si256(blockpal[i - 4], blockpal[i - 4], 0x11);
+        const __m256i ix = _mm256_set1_epi32((int) idxbuf[i]);
+        __m256i top = _mm256_permutevar8x32_epi32(p, _mm256_srlv_epi32(ix, shifts));
+        __m256i bottom = _mm256_permutevar8x32_epi32(p, _mm256_srlv_epi32(ix, shifts2));
+        uint8 *out = dst + (i * 16);
+
+        if (alphasrc) {
+            __m256i alpha[2];
+            if (glfmt == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT || glfmt == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT) {
+                avx2_bc2_alpha(alphasrc + (i * 16), alpha);
+            } else {
+                avx2_bc3_alpha(alphasrc + (i * 16), alpha);
+            }
+            top = _mm256_or_si256(_mm256_and_si256(top, rgbmask), alpha[0]);
+            bottom = _mm256_or_si256(_mm256_and_si256(bottom, rgbmask), alpha[1]);
+        }
+
+        _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(top));
+        _mm_storeu_si128((__m128i *) (out + pitch), _mm256_extracti128_si256(top, 1));
+        _mm_storeu_si128((__m128i *) (out + (pitch * 2)), _mm256_castsi256_si128(bottom));
+        _mm_storeu_si128((__m128i *) (out + (pitch * 3)), _mm256_extracti128_si256(bottom, 1));
+    }
+}
+
+static MOJODDS_TARGET("avx2") __m256i avx2_combine(const __m128i lo, const __m128i hi)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static MOJODDS_TARGET("avx2") void decode_bc1_avx2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    __m128i c0, i0, c1, i1;
+    for (; blocks >= 8; blocks -= 8, src += 64, dst += 128) {
+        sse2_split_bc1(src, &c0, &i0);
+        sse2_split_bc1(src + 32, &c1, &i1);
+        avx2_decode8(avx2_combine(c0, c1), avx2_combine(i0, i1), 1, NULL, 0, dst, pitch);
+    }
+    decode_bc1_sse2(src, blocks, dst, pitch);
+}
+
+static MOJODDS_TARGET("avx2") void decode_bc2_avx2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    __m128i c0, i0, c1, i1;
+    for (; blocks >= 8; blocks -= 8, src += 128, dst += 128) {
+        sse2_split_bc3(src, &c0, &i0);
+        sse2_split_bc3(src + 64, &c1, &i1);
+        avx2_decode8(avx2_combine(c0, c1), avx2_combine(i0, i1), 0, src, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, dst, pitch);
+    }
+    decode_bc2_sse2(src, blocks, dst, pitch);
+}
+
+static MOJODDS_TARGET("avx2") void decode_bc3_avx2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    __m128i c0, i0, c1, i1;
+    for (; blocks >= 8; blocks -= 8, src += 128, dst += 128) {
+        sse2_split_bc3(src, &c0, &i0);
+        sse2_split_bc3(src + 64, &c1, &i1);
+        avx2_decode8(avx2_combine(c0, c1), avx2_combine(i0, i1), 0, src, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, dst, pitch);
+    }
+    decode_bc3_sse2(src, blocks, dst, pitch);
+}
+
+// BC4/BC5 get the whole palette lookup from avx2_bc3_alpha(), two rows of
+//  a channel per register.
+static MOJODDS_TARGET("avx2") __m256i avx2_normal_z(const __m256i r, const __m256i g)
+{
+    const __m256i xy = _mm256_or_si256(r, _mm256_slli_epi32(g, 16));
+    const __m256i d = _mm256_sub_epi16(_mm256_add_epi16(xy, xy), _mm256_set1_epi16(255));
+    const __m256i s = _mm256_max_epi32(_mm256_sub_epi32(_mm256_set1_epi32(65025), _mm256_madd_epi16(d, d)), _mm256_setzero_si256());
+    const __m256 root = _mm256_sqrt_ps(_mm256_cvtepi32_ps(s));
+    return _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(root, _mm256_set1_ps(256.0f)), _mm256_set1_ps(0.5f)));
+}
+
+static MOJODDS_TARGET("avx2") void decode_rg_avx2(const uint8 *src,
+                                                  unsigned int blocks,
+                                                  uint8 *dst, size_t pitch,
+                                                  const int channels,
+                                                  const int normal)
+{
+    const __m256i opaque = _mm256_set1_epi32((int) 0xFF000000);
+    __m256i red[2], green[2];
+    int i;
+
+    green[0] = green[1] = _mm256_setzero_si256();
+    for (; blocks > 0; blocks--, src += channels * 8, dst += 16) {
+        avx2_bc3_alpha(src, red);
+        if (channels == 2) {
+            avx2_bc3_alpha(src + 8, green);
+        }
+        for (i = 0; i < 2; i++) {  // rows 0 and 1, then rows 2 and 3.
+            const __m256i r = _mm256_srli_epi32(red[i], 24);
+            const __m256i g = _mm256_srli_epi32(green[i], 24);
+            __m256i rgba = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), opaque);
+            if (normal) {
+                rgba = _mm256_or_si256(rgba, _mm256_slli_epi32(avx2_normal_z(r, g), 16));
+            }
+            _mm_storeu_si128((__m128i *) (dst + (i * 2 * pitch)), _mm256_castsi256_si128(rgba));
+            _mm_storeu_si128((__m128i *) (dst + (((i * 2) + 1) * pitch)), _mm256_extracti128_si256(rgba, 1));
+        }
+    }
+}
+
+static MOJODDS_TARGET("avx2") void decode_bc4_avx2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    decode_rg_avx2(src, blocks, dst, pitch, 1, 0);
+}
+
+static MOJODDS_TARGET("avx2") void decode_bc5_avx2(const uint8 *src,
+                                                   unsigned int blocks,
+                                                   uint8 *dst, size_t pitch)
+{
+    decode_rg_avx2(src, blocks, dst, pitch, 2, 0);
+}
+
+static MOJODDS_TARGET("avx2") void decode_bc5_normal_avx2(const uint8 *src,
+                                                          unsigned int blocks,
+                                                          uint8 *dst, size_t pitch)
+{
+    decode_rg_avx2(src, blocks, dst, pitch, 2, 1);
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+
+#ifdef MOJODDS_HAVE_NEON
+
+// NEON does four blocks per pass, same approach as SSE2, but has real
+//  32-bit multiplies and bit tests.
+
+static void neon_bc1_palettes(const uint32x4_t colors, const int punchthrough,
+                              uint32x4_t pal[4])
+{
+    const uint32x4_t mask5 = vdupq_n_u32(0x1F);
+    const uint32x4_t mask6 = vdupq_n_u32(0x3F);
+    const uint32x4_t one = vdupq_n_u32(1);
+    const uint32x4_t third = vdupq_n_u32(0xAAAB);  // 2^17 / 3
+    const uint32x4_t opaque = vdupq_n_u32(0xFF000000);
+    const uint32x4_t c0 = vandq_u32(colors, vdupq_n_u32(0xFFFF));
+    const uint32x4_t c1 = vshrq_n_u32(colors, 16);
+    uint32x4_t r0 = vshrq_n_u32(c0, 11);
+    uint32x4_t g0 = vandq_u32(vshrq_n_u32(c0, 5), mask6);
+    uint32x4_t b0 = vandq_u32(c0, mask5);
+    uint32x4_t r1 = vshrq_n_u32(c1, 11);
+    uint32x4_t g1 = vandq_u32(vshrq_n_u32(c1, 5), mask6);
+    uint32x4_t b1 = vandq_u32(c1, mask5);
+    uint32x4_t r2, g2, b2, r3, g3, b3;
+    uint32x4_t alpha3 = opaque;
+
+    r0 = vorrq_u32(vshlq_n_u32(r0, 3), vshrq_n_u32(r0, 2));
+    g0 = vorrq_u32(vshlq_n_u32(g0, 2), vshrq_n_u32(g0, 4));
+    b0 = vorrq_u32(vshlq_n_u32(b0, 3), vshrq_n_u32(b0, 2));
+    r1 = vorrq_u32(vshlq_n_u32(r1, 3), vshrq_n_u32(r1, 2));
+    g1 = vorrq_u32(vshlq_n_u32(g1, 2), vshrq_n_u32(g1, 4));
+    b1 = vorrq_u32(vshlq_n_u32(b1, 3), vshrq_n_u32(b1, 2));
+
+    #define NEON_THIRD(a, b) vshrq_n_u32(vmulq_u32(vaddq_u32(vaddq_u32(vshlq_n_u32(a, 1), b), one), third), 17)
+    r2 = NEON_THIRD(r0, r1);
+    g2 = NEON_THIRD(g0, g1);
+    b2 = NEON_THIRD(b0, b1);
+    r3 = NEON_THIRD(r1, r0);
+    g3 = NEON_THIRD(g1, g0);
+    b3 = NEON_THIRD(b1, b0);
+    #undef NEON_THIRD
+
+    if (punchthrough) {
+        const uint32x4_t four = vcgtq_u32(c0, c1);
+        #define NEON_HALF(a, b) vshrq_n_u32(vaddq_u32(vaddq_u32(a, b), one), 1)
+        r2 = vbslq_u32(four, r2, NEON_HALF(r0, r1));
+        g2 = vbslq_u32(four, g2, NEON_HALF(g0, g1));
+        b2 = vbslq_u32(four, b2, NEON_HALF(b0, b1));
+        #undef NEON_HALF
+        r3 = vandq_u32(four, r3);
+        g3 = vandq_u32(four, g3);
+        b3 = vandq_u32(four, b3);
+        alpha3 = vandq_u32(four, opaque);
+    }
+
+    #define NEON_PACK(r, g, b, a) vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 8)), vorrq_u32(vshlq_n_u32(b, 16), a))
+    pal[0] = NEON_PACK(r0, g0, b0, opaque);
+    pal[1] = NEON_PACK(r1, g1, b1, opaque);
+    pal[2] = NEON_PACK(r2, g2, b2, opaque);
+    pal[3] = NEON_PACK(r3, g3, b3, alpha3);
+    #undef NEON_PACK
+}
+
+static void neon_decode4(const uint32x4_t colors, const uint32x4_t indices,
+                         const int punchthrough, const uint32 alpha[4][16],
+                         uint8 *dst, const size_t pitch)
+{
+    static const uint32 bits0[4] = { 0x01, 0x04, 0x10, 0x40 };
+    static const uint32 bits1[4] = { 0x02, 0x08, 0x20, 0x80 };
+    const uint32x4_t bit0 = vld1q_u32(bits0);
+    const uint32x4_t bit1 = vld1q_u32(bits1);
+    const uint32x4_t rgbmask = vdupq_n_u32(0x00FFFFFF);
+    uint32x4_t pal[4];
+    uint32 palbuf[4][4];
+    uint32 idxbuf[4];
+    int i, y;
+
+    neon_bc1_palettes(colors, punchthrough, pal);
+    for (i = 0; i < 4; i++) {
+        vst1q_u32(palbuf[i], pal[i]);
+    }
+    vst1q_u32(idxbuf, indices);
+
+    for (i = 0; i < 4; i++, dst += 16) {
+        const uint32x4_t p0 = vdupq_n_u32(palbuf[0][i]);
+        const uint32x4_t p1 = vdupq_n_u32(palbuf[1][i]);
+        const uint32x4_t p2 = vdupq_n_u32(palbuf[2][i]);
+        const uint32x4_t p3 = vdupq_n_u32(palbuf[3][i]);
+        uint32x4_t ix = vdupq_n_u32(idxbuf[i]);
+        for (y = 0; y < 4; y++) {
+            const uint32x4_t lo = vtstq_u32(ix, bit0);
+            const uint32x4_t hi = vtstq_u32(ix, bit1);
+            uint32x4_t px = vbslq_u32(hi, vbslq_u32(lo, p3, p2),
+                                          vbslq_u32(lo, p1, p0));
+            if (alpha) {
+                px = vorrq_u32(vandq_u32(px, rgbmask), vld1q_u32(&alpha[i][y * 4]));
+            }
+            vst1q_u8(dst + (y * pitch), vreinterpretq_u8_u32(px));
+            ix = vshrq_n_u32(ix, 8);
+        }
+    }
+}
+
+static void decode_bc1_neon(const uint8 *src, unsigned int blocks,
+                            uint8 *dst, size_t pitch)
+{
+    uint32 words[8];
+    for (; blocks >= 4; blocks -= 4, src += 32, dst += 64) {
+        uint32x4x2_t split;
+        memcpy(words, src, sizeof (words));
+        split = vld2q_u32(words);  // colors in val[0], indices in val[1].
+        neon_decode4(split.val[0], split.val[1], 1, NULL, dst, pitch);
+    }
+    decode_bc1_scalar(src, blocks, dst, pitch);
+}
+
+static void decode_bc2_neon(const uint8 *src, unsigned int blocks,
+                            uint8 *dst, size_t pitch)
+{
+    uint32 alpha[4][16];
+    uint32 words[16];
+    int i;
+    for (; blocks >= 4; blocks -= 4, src += 64, dst += 64) {
+        uint32x4x4_t split;
+        for (i = 0; i < 4; i++) {
+            bc2_alpha_words(src + (i * 16), alpha[i]);
+        }
+        memcpy(words, src, sizeof (words));
+        split = vld4q_u32(words);  // colors in val[2], indices in val[3].
+        neon_decode4(split.val[2], split.val[3], 0, (const uint32 (*)[16]) alpha, dst, pitch);
+    }
+    decode_bc2_scalar(src, blocks, dst, pitch);
+}
+
+static void decode_bc3_neon(const uint8 *src, unsigned int blocks,
+                            uint8 *dst, size_t pitch)
+{
+    uint32 alpha[4][16];
+    uint32 words[16];
+    int i;
+    for (; blocks >= 4; blocks -= 4, src += 64, dst += 64) {
+        uint32x4x4_t split;
+        for (i = 0; i < 4; i++) {
+            bc3_alpha_words(src + (i * 16), alpha[i]);
+        }
+        memcpy(words, src, sizeof (words));
+        split = vld4q_u32(words);
+        neon_decode4(split.val[2], split.val[3], 0, (const uint32 (*)[16]) alpha, dst, pitch);
+    }
+    decode_bc3_scalar(src, blocks, dst, pitch);
+}
+
+// Same split as SSE2: scalar palettes, vector packing and square roots.
+static uint32x4_t neon_normal_z(const uint32x4_t r, const uint32x4_t g)
+{
+    const int32x4_t dx = vsubq_s32(vreinterpretq_s32_u32(vshlq_n_u32(r, 1)), vdupq_n_s32(255));
+    const int32x4_t dy = vsubq_s32(vreinterpretq_s32_u32(vshlq_n_u32(g, 1)), vdupq_n_s32(255));
+    const int32x4_t s = vmlsq_s32(vmlsq_s32(vdupq_n_s32(65025), dx, dx), dy, dy);
+    const float32x4_t root = vsqrtq_f32(vcvtq_f32_s32(vmaxq_s32(s, vdupq_n_s32(0))));
+    return vcvtq_u32_f32(vmulq_f32(vaddq_f32(root, vdupq_n_f32(256.0f)), vdupq_n_f32(0.5f)));
+}
+
+static void decode_rg_neon(const uint8 *src, unsigned int blocks,
+                           uint8 *dst, size_t pitch,
+                           const int channels, const int normal)
+{
+    const uint32x4_t opaque = vdupq_n_u32(0xFF000000);
+    uint32 red[16], green[16];
+    int y;
+
+    memset(green, '\0', sizeof (green));
+    for (; blocks > 0; blocks--, src += channels * 8, dst += 16) {
+        bc3_alpha_words(src, red);
+        if (channels == 2) {
+            bc3_alpha_words(src + 8, green);
+        }
+        for (y = 0; y < 4; y++) {
+            const uint32x4_t r = vshrq_n_u32(vld1q_u32(&red[y * 4]), 24);
+            const uint32x4_t g = vshrq_n_u32(vld1q_u32(&green[y * 4]), 24);
+            uint32x4_t rgba = vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 8)), opaque);
+            if (normal) {
+                rgba = vorrq_u32(rgba, vshlq_n_u32(neon_normal_z(r, g), 16));
+            }
+            vst1q_u8(dst + (y * pitch), vreinterpretq_u8_u32(rgba));
+        }
+    }
+}
+
+static void decode_bc4_neon(const uint8 *src, unsigned int blocks,
+                            uint8 *dst, size_t pitch)
+{
+    decode_rg_neon(src, blocks, dst, pitch, 1, 0);
+}
+
+static void decode_bc5_neon(const uint8 *src, unsigned int blocks,
+                            uint8 *dst, size_t pitch)
+{
+    decode_rg_neon(src, blocks, dst, pitch, 2, 0);
+}
+
+static void decode_bc5_normal_neon(const uint8 *src, unsigned int blocks,
+                                   uint8 *dst, size_t pitch)
+{
+    decode_rg_neon(src, blocks, dst, pitch, 2, 1);
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+#ifdef MOJODDS_HAVE_X86
+#define SSE2_DECODER(fn) fn
+#define AVX2_DECODER(fn) fn
+#else
+#define SSE2_DECODER(fn) NULL
+#define AVX2_DECODER(fn) NULL
+#endif
+#ifdef MOJODDS_HAVE_NEON
+#define NEON_DECODER(fn) fn
+#else
+#define NEON_DECODER(fn) NULL
+#endif
+
+typedef struct
+{
+    uint32 glfmt;
+    MOJODDS_decodeFormat dstfmt;
+    mojodds_decode_fn scalar;
+    mojodds_decode_fn sse2;
+    mojodds_decode_fn avx2;
+    mojodds_decode_fn neon;
+} Decoder;
+
+static const Decoder Decoders[] =
+{
+    #define BC1_DECODERS decode_bc1_scalar, SSE2_DECODER(decode_bc1_sse2), AVX2_DECODER(decode_bc1_avx2), NEON_DECODER(decode_bc1_neon)
+    #define BC2_DECODERS decode_bc2_scalar, SSE2_DECODER(decode_bc2_sse2), AVX2_DECODER(decode_bc2_avx2), NEON_DECODER(decode_bc2_neon)
+    #define BC3_DECODERS decode_bc3_scalar, SSE2_DECODER(decode_bc3_sse2), AVX2_DECODER(decode_bc3_avx2), NEON_DECODER(decode_bc3_neon)
+    #define BC4_DECODERS decode_bc4_scalar, SSE2_DECODER(decode_bc4_sse2), AVX2_DECODER(decode_bc4_avx2), NEON_DECODER(decode_bc4_neon)
+    #define BC5_DECODERS decode_bc5_scalar, SSE2_DECODER(decode_bc5_sse2), AVX2_DECODER(decode_bc5_avx2), NEON_DECODER(decode_bc5_neon)
+    #define BC5_NORMAL_DECODERS decode_bc5_normal_scalar, SSE2_DECODER(decode_bc5_normal_sse2), AVX2_DECODER(decode_bc5_normal_avx2), NEON_DECODER(decode_bc5_normal_neon)
+    #define BC7_DECODERS mojodds_decode_bc7_scalar, SSE2_DECODER(mojodds_decode_bc7_sse2), NULL, NEON_DECODER(mojodds_decode_bc7_neon)
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, MOJODDS_DECODE_RGBA8, BC1_DECODERS },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, MOJODDS_DECODE_RGBA8, BC1_DECODERS },
+    { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, MOJODDS_DECODE_RGBA8, BC2_DECODERS },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, MOJODDS_DECODE_RGBA8, BC2_DECODERS },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, MOJODDS_DECODE_RGBA8, BC3_DECODERS },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, MOJODDS_DECODE_RGBA8, BC3_DECODERS },
+    { GL_COMPRESSED_RED_RGTC1, MOJODDS_DECODE_RGBA8, BC4_DECODERS },
+    { GL_COMPRESSED_RG_RGTC2, MOJODDS_DECODE_RGBA8, BC5_DECODERS },
+    { GL_COMPRESSED_RG_RGTC2, MOJODDS_DECODE_NORMAL8, BC5_NORMAL_DECODERS },
+    { GL_COMPRESSED_RGBA_BPTC_UNORM, MOJODDS_DECODE_RGBA8, BC7_DECODERS },
+    { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, MOJODDS_DECODE_RGBA8, BC7_DECODERS },
+    { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, MOJODDS_DECODE_RGBA16F, mojodds_decode_bc6h_uf16_half, NULL, NULL, NULL },
+    { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, MOJODDS_DECODE_RGBA32F, mojodds_decode_bc6h_uf16_float, NULL, NULL, NULL },
+    { GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, MOJODDS_DECODE_RGBA16F, mojodds_decode_bc6h_sf16_half, NULL, NULL, NULL },
+    { GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, MOJODDS_DECODE_RGBA32F, mojodds_decode_bc6h_sf16_float, NULL, NULL, NULL },
+    #undef BC1_DECODERS
+    #undef BC2_DECODERS
+    #undef BC3_DECODERS
+    #undef BC4_DECODERS
+    #undef BC5_DECODERS
+    #undef BC5_NORMAL_DECODERS
+    #undef BC7_DECODERS
+};
+
+static mojodds_decode_fn find_decoder(const uint32 glfmt,
+                                      const MOJODDS_decodeFormat dstfmt)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    int i;
+    for (i = 0; i < STATICARRAYLEN(Decoders); i++) {
+        const Decoder *decoder = &Decoders[i];
+        if ((decoder->glfmt == glfmt) && (decoder->dstfmt == dstfmt)) {
+            if ((cpu & MOJODDS_CPU_AVX2) && (decoder->avx2 != NULL)) {
+                return decoder->avx2;
+            } else if ((cpu & MOJODDS_CPU_SSE2) && (decoder->sse2 != NULL)) {
+                return decoder->sse2;
+            } else if ((cpu & MOJODDS_CPU_NEON) && (decoder->neon != NULL)) {
+                return decoder->neon;
+            }
+            return decoder->scalar;
+        }
+    }
+    return NULL;
+}
+
+static unsigned int decoded_pixel_size(const MOJODDS_decodeFormat dstfmt)
+{
+    switch (dstfmt) {
+        case MOJODDS_DECODE_RGBA8: return 4;
+        case MOJODDS_DECODE_RGBA16F: return 8;
+        case MOJODDS_DECODE_RGBA32F: return 16;
+        case MOJODDS_DECODE_NORMAL8: return 4;
+    }
+    return 0;
+}
+
+
+typedef struct
+{
+    mojodds_decode_fn fn;
+    const uint8 *src;
+    uint8 *dst;
+    size_t dstpitch;
+    unsigned int w;
+    unsigned int h;
+    unsigned int blocksw;
+    unsigned int blocksh;
+    unsigned int blockSize;
+    unsigned int pixelSize;
+    unsigned int rowsPerBand;
+} DecodeJob;
+
+// Blocks hanging off the right or bottom edge go through a scratch block.
+static void decode_partial_block(const DecodeJob *job, const uint8 *src,
+                                 uint8 *dst, const unsigned int pw,
+                                 const unsigned int ph)
+{
+    uint8 scratch[4 * 4 * 16];  // enough for a 4x4 block of RGBA32F.
+    const size_t scratchpitch = 4 * job->pixelSize;
+    unsigned int y;
+
+    assert(job->pixelSize <= 16);
+    job->fn(src, 1, scratch, scratchpitch);
+    for (y = 0; y < ph; y++) {
+        memcpy(dst + (y * job->dstpitch), scratch + (y * scratchpitch), pw * job->pixelSize);
+    }
+}
+
+static void decode_band(void *data, unsigned int band)
+{
+    const DecodeJob *job = (const DecodeJob *) data;
+    const size_t srcpitch = ((size_t) job->blocksw) * job->blockSize;
+    const unsigned int fullw = job->w / 4;
+    const unsigned int end = MIN((band + 1) * job->rowsPerBand, job->blocksh);
+    unsigned int by;
+
+    for (by = band * job->rowsPerBand; by < end; by++) {
+        const uint8 *src = job->src + (by * srcpitch);
+        uint8 *dst = job->dst + (((size_t) by) * 4 * job->dstpitch);
+        const unsigned int ph = MIN(4, job->h - (by * 4));
+        unsigned int bx = 0;
+
+        if ((ph == 4) && (fullw > 0)) {
+            job->fn(src, fullw, dst, job->dstpitch);
+            bx = fullw;
+        }
+
+        for (; bx < job->blocksw; bx++) {
+            decode_partial_block(job, src + (bx * job->blockSize),
+                                 dst + (((size_t) bx) * 4 * job->pixelSize),
+                                 MIN(4, job->w - (bx * 4)), ph);
+        }
+    }
+}
+
+int MOJODDS_decode(unsigned int glfmt, const void *_src, unsigned long _srclen,
+                   unsigned int w, unsigned int h,
+                   MOJODDS_decodeFormat dstfmt, void *_dst,
+                   unsigned long _dstpitch, MOJODDS_ThreadPool *pool)
+{
+    DecodeJob job;
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    unsigned int bands;
+
+    memset(&job, '\0', sizeof (job));
+    job.fn = find_decoder(glfmt, dstfmt);
+    if (job.fn == NULL) {
+        return 0;  // unsupported format.
+    } else if (!MOJODDS_getFormatInfo(glfmt, &blockDim, &blockSize, NULL, NULL, NULL)) {
+        return 0;
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    }
+
+    assert(blockDim == 4);
+    job.src = (const uint8 *) _src;
+    job.dst = (uint8 *) _dst;
+    job.dstpitch = (size_t) _dstpitch;
+    job.w = w;
+    job.h = h;
+    job.blocksw = (w + 3) / 4;
+    job.blocksh = (h + 3) / 4;
+    job.blockSize = blockSize;
+    job.pixelSize = decoded_pixel_size(dstfmt);
+
+    if (((uint64) job.blocksw) * job.blocksh * blockSize > _srclen) {
+        return 0;  // not enough source data.
+    } else if (((uint64) w) * job.pixelSize > _dstpitch) {
+        return 0;  // rows would overlap.
+    }
+
+    // Bands of roughly 64k pixels; small enough to spread an 8K mip over a
+    //  lot of cores, big enough that scheduling them is noise.
+    job.rowsPerBand = MAX(4096 / job.blocksw, 1);
+    bands = (job.blocksh + job.rowsPerBand - 1) / job.rowsPerBand;
+    mojodds_parallel_for(pool, bands, decode_band, &job);
+    return 1;
+}
+
+// end of mojodds_decode.c ...
+
@@ -0,0 +1,1031 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// BC1 and BC3 (DXT1 and DXT5) block encoders, and the MOJODDS_encode()
+//  entry point.
+//
+// The fast mode takes each block's endpoints from its bounding box, pulled
+//  in a little, like most real-time DXT encoders. The SIMD versions only
+//  replace the per-pixel work (bounds and picking indices), and must pick
+//  the same indices as the scalar code. The high-quality mode does a cluster
+//  fit along the block's principal axis and keeps the better of that and
+//  the fast result; it's scalar only, but spreads across the thread pool
+//  like everything else.
+
+#include <string.h>
+#include <assert.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+// Encode the 4x4 block of RGBA8 pixels at src, rows (pitch) bytes apart.
+typedef void (*encode_fn)(const uint8 *src, size_t pitch, uint8 *dst);
+
+static void write16(uint8 *ptr, const uint32 val)
+{
+    ptr[0] = (uint8) (val >> 0);
+    ptr[1] = (uint8) (val >> 8);
+}
+
+static void write32(uint8 *ptr, const uint32 val)
+{
+    ptr[0] = (uint8) (val >> 0);
+    ptr[1] = (uint8) (val >> 8);
+    ptr[2] = (uint8) (val >> 16);
+    ptr[3] = (uint8) (val >> 24);
+}
+
+
+// Pieces shared by every kernel...
+
+static void block_bounds(const uint8 *src, const size_t pitch,
+                         uint8 lo[4], uint8 hi[4])
+{
+    int x, y, i;
+
+    memset(lo, 0xFF, 4);
+    memset(hi, 0x00, 4);
+    for (y = 0; y < 4; y++) {
+        const uint8 *px = src + (y * pitch);
+        for (x = 0; x < 4; x++, px += 4) {
+            for (i = 0; i < 4; i++) {
+                lo[i] = MIN(lo[i], px[i]);
+                hi[i] = MAX(hi[i], px[i]);
+            }
+        }
+    }
+}
+
+// round(v * 31 / 255) and round(v * 63 / 255) without dividing.
+static uint32 quantize565(const uint32 r, const uint32 g, const uint32 b)
+{
+    const uint32 r5 = (r * 31) + 128;
+    const uint32 g6 = (g * 63) + 128;
+    const uint32 b5 = (b * 31) + 128;
+    return (((r5 + (r5 >> 8)) >> 8) << 11) |
+           (((g6 + (g6 >> 8)) >> 8) << 5) |
+           ((b5 + (b5 >> 8)) >> 8);
+}
+
+static void expand565(const uint32 c, uint8 *rgba)
+{
+    const uint32 r = (c >> 11) & 0x1F;
+    const uint32 g = (c >> 5) & 0x3F;
+    const uint32 b = c & 0x1F;
+    rgba[0] = (uint8) ((r << 3) | (r >> 2));
+    rgba[1] = (uint8) ((g << 2) | (g >> 4));
+    rgba[2] = (uint8) ((b << 3) | (b >> 2));
+    rgba[3] = 0xFF;
+}
+
+// The same palettes mojodds_decode.c builds; keep the rounding in sync.
+static void bc1_palette(const uint32 c0, const uint32 c1, const int four,
+                        uint8 pal[4][4])
+{
+    int i;
+
+    expand565(c0, pal[0]);
+    expand565(c1, pal[1]);
+    for (i = 0; i < 3; i++) {
+        if (four) {
+            pal[2][i] = (uint8) ((2 * pal[0][i] + pal[1][i] + 1) / 3);
+            pal[3][i] = (uint8) ((pal[0][i] + 2 * pal[1][i] + 1) / 3);
+        } else {
+            pal[2][i] = (uint8) ((pal[0][i] + pal[1][i] + 1) / 2);
+            pal[3][i] = 0;
+        }
+    }
+    pal[2][3] = 0xFF;
+    pal[3][3] = four ? 0xFF : 0;
+}
+
+static void bc3_alpha_palette(const uint32 a0, const uint32 a1, uint8 pal[8])
+{
+    uint32 i;
+
+    pal[0] = (uint8) a0;
+    pal[1] = (uint8) a1;
+    if (a0 > a1) {
+        for (i = 2; i < 8; i++) {
+            pal[i] = (uint8) ((((8 - i) * a0) + ((i - 1) * a1) + 3) / 7);
+        }
+    } else {
+        for (i = 2; i < 6; i++) {
+            pal[i] = (uint8) ((((6 - i) * a0) + ((i - 1) * a1) + 2) / 5);
+        }
+        pal[6] = 0;
+        pal[7] = 0xFF;
+    }
+}
+
+static uint32 color_distance(const uint8 *a, const uint8 *b)
+{
+    const int dr = ((int) a[0]) - ((int) b[0]);
+    const int dg = ((int) a[1]) - ((int) b[1]);
+    const int db = ((int) a[2]) - ((int) b[2]);
+    return (uint32) ((dr * dr) + (dg * dg) + (db * db));
+}
+
+// The endpoints the fast mode uses: the bounding box, inset by 1/16th of
+//  its size on each side so the extremes don't dominate. Quantizing is
+//  monotonic per channel, so c0 >= c1 always comes out.
+static void bc1_fast_endpoints(const uint8 lo[4], const uint8 hi[4],
+                               uint32 *_c0, uint32 *_c1)
+{
+    uint32 minc[3], maxc[3];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        const uint32 inset = ((uint32) (hi[i] - lo[i])) >> 4;
+        minc[i] = lo[i] + inset;
+        maxc[i] = hi[i] - inset;
+    }
+    *_c0 = quantize565(maxc[0], maxc[1], maxc[2]);
+    *_c1 = quantize565(minc[0], minc[1], minc[2]);
+}
+
+static void write_bc1_block(uint8 *dst, const uint32 c0, const uint32 c1,
+                            const uint32 indices)
+{
+    write16(dst, c0);
+    write16(dst + 2, c1);
+    write32(dst + 4, indices);
+}
+
+static void write_bc3_alpha_block(uint8 *dst, const uint32 a0,
+                                  const uint32 a1, const uint8 idx[16])
+{
+    uint32 bits = 0;
+    int i;
+
+    dst[0] = (uint8) a0;
+    dst[1] = (uint8) a1;
+    for (i = 0; i < 8; i++) {
+        bits |= ((uint32) idx[i]) << (i * 3);
+    }
+    dst[2] = (uint8) bits;
+    dst[3] = (uint8) (bits >> 8);
+    dst[4] = (uint8) (bits >> 16);
+    bits = 0;
+    for (i = 0; i < 8; i++) {
+        bits |= ((uint32) idx[i + 8]) << (i * 3);
+    }
+    dst[5] = (uint8) bits;
+    dst[6] = (uint8) (bits >> 8);
+    dst[7] = (uint8) (bits >> 16);
+}
+
+
+// Scalar reference encoders...
+
+// Write a color block with endpoints c0 and c1, in four-color mode, or in
+//  BC1's three-color mode (pixels with alpha under 128 go transparent).
+//  Swaps the endpoints to get the mode asked for. Returns the squared error
+//  over the opaque pixels.
+static uint32 bc1_block(const uint8 *src, const size_t pitch, uint32 c0,
+                        uint32 c1, const int colors, uint8 *dst)
+{
+    uint8 pal[4][4];
+    uint32 indices = 0;
+    uint32 err = 0;
+    int x, y, i;
+
+    if ((colors == 4) ? (c0 < c1) : (c0 > c1)) {
+        const uint32 tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+    }
+
+    bc1_palette(c0, c1, colors == 4, pal);
+    for (y = 0; y < 4; y++) {
+        const uint8 *px = src + (y * pitch);
+        for (x = 0; x < 4; x++, px += 4) {
+            const int shift = ((y * 4) + x) * 2;
+            uint32 best, besti = 0;
+            if ((colors == 3) && (px[3] < 128)) {
+                indices |= 3u << shift;
+                continue;
+            }
+
+            best = color_distance(px, pal[0]);
+            // equal 565 endpoints in four-color mode would decode as BC1's
+            //  three-color mode, so only index 0 is safe there.
+            if ((colors == 3) || (c0 != c1)) {
+                for (i = 1; i < colors; i++) {
+                    const uint32 dist = color_distance(px, pal[i]);
+                    if (dist < best) {
+                        best = dist;
+                        besti = i;
+                    }
+                }
+            }
+            indices |= besti << shift;
+            err += best;
+        }
+    }
+
+    write_bc1_block(dst, c0, c1, indices);
+    return err;
+}
+
+// Write an alpha block with endpoints a0 and a1 (eight values if a0 > a1,
+//  else six plus 0 and 255). Returns the squared error.
+static uint32 bc3_alpha_block(const uint8 *src, const size_t pitch,
+                              const uint32 a0, const uint32 a1, uint8 *dst)
+{
+    uint8 pal[8];
+    uint8 idx[16];
+    uint32 err = 0;
+    int x, y, i;
+
+    bc3_alpha_palette(a0, a1, pal);
+    for (y = 0; y < 4; y++) {
+        const uint8 *px = src + (y * pitch);
+        for (x = 0; x < 4; x++, px += 4) {
+            const int a = px[3];
+            int best = (a > pal[0]) ? (a - pal[0]) : (pal[0] - a);
+            int besti = 0;
+            for (i = 1; i < 8; i++) {
+                const int dist = (a > pal[i]) ? (a - pal[i]) : (pal[i] - a);
+                if (dist < best) {
+                    best = dist;
+                    besti = i;
+                }
+            }
+            idx[(y * 4) + x] = (uint8) besti;
+            err += (uint32) (best * best);
+        }
+    }
+
+    write_bc3_alpha_block(dst, a0, a1, idx);
+    return err;
+}
+
+// Principal-axis cluster fit: sort the points along the axis they spread
+//  out the most on, try every way of splitting that order into (clusters)
+//  runs, one per palette entry, and solve for the endpoints that fit each
+//  split best by least squares.
+static void cluster_fit(float pts[16][3], const int n, const int clusters,
+                        uint32 *_c0, uint32 *_c1)
+{
+    static const float fourweights[4] = { 1.0f, 2.0f / 3.0f, 1.0f / 3.0f, 0.0f };
+    static const float threeweights[4] = { 1.0f, 0.5f, 0.0f, 0.0f };
+    const float *weights = (clusters == 4) ? fourweights : threeweights;
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    float cov[3][3];
+    float axis[3];
+    float dots[16];
+    float sums[17][3];
+    float besta[3], bestb[3];
+    float besterr = 1e30f;
+    int order[16];
+    int i, j, k, c, iter;
+
+    assert(n > 0);
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < 3; c++) {
+            mean[c] += pts[i][c];
+        }
+    }
+    for (c = 0; c < 3; c++) {
+        mean[c] /= (float) n;
+    }
+    memcpy(besta, mean, sizeof (besta));  // in case no split works.
+    memcpy(bestb, mean, sizeof (bestb));
+
+    memset(cov, '\0', sizeof (cov));
+    for (i = 0; i < n; i++) {
+        const float d[3] = { pts[i][0] - mean[0], pts[i][1] - mean[1], pts[i][2] - mean[2] };
+        for (j = 0; j < 3; j++) {
+            for (k = 0; k < 3; k++) {
+                cov[j][k] += d[j] * d[k];
+            }
+        }
+    }
+
+    // Power iteration, starting from the row with the biggest variance.
+    j = 0;
+    for (c = 1; c < 3; c++) {
+        if (cov[c][c] > cov[j][j]) {
+            j = c;
+        }
+    }
+    memcpy(axis, cov[j], sizeof (axis));
+    for (iter = 0; iter < 8; iter++) {
+        float next[3], biggest = 0.0f;
+        for (c = 0; c < 3; c++) {
+            next[c] = (cov[c][0] * axis[0]) + (cov[c][1] * axis[1]) + (cov[c][2] * axis[2]);
+            biggest = MAX(biggest, (next[c] < 0.0f) ? -next[c] : next[c]);
+        }
+        if (biggest == 0.0f) {
+            break;  // flat block; any order will do.
+        }
+        for (c = 0; c < 3; c++) {
+            axis[c] = next[c] / biggest;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        const float dot = (pts[i][0] * axis[0]) + (pts[i][1] * axis[1]) + (pts[i][2] * axis[2]);
+        for (j = i; (j > 0) && (dots[j - 1] > dot); j--) {
+            dots[j] = dots[j - 1];
+            order[j] = order[j - 1];
+        }
+        dots[j] = dot;
+        order[j] = i;
+    }
+
+    memset(sums[0], '\0', sizeof (sums[0]));
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < 3; c++) {
+            sums[i + 1][c] = sums[i][c] + pts[order[i]][c];
+        }
+    }
+
+    // Runs are [0,i), [i,j), [j,k) and [k,n); three clusters leave the last
+    //  one empty. The first two runs' share of the sums only changes in the
+    //  outer loops.
+    for (i = 0; i <= n; i++) {
+        for (j = i; j <= n; j++) {
+            const float n0 = (float) i;
+            const float n1 = (float) (j - i);
+            const float part2[3] = {
+                (weights[0] * weights[0] * n0) + (weights[1] * weights[1] * n1),
+                ((1.0f - weights[0]) * (1.0f - weights[0]) * n0) + ((1.0f - weights[1]) * (1.0f - weights[1]) * n1),
+                (weights[0] * (1.0f - weights[0]) * n0) + (weights[1] * (1.0f - weights[1]) * n1)
+            };
+            float partx[3];
+
+            for (c = 0; c < 3; c++) {
+                partx[c] = (weights[0] * sums[i][c]) + (weights[1] * (sums[j][c] - sums[i][c]));
+            }
+
+            for (k = (clusters == 4) ? j : n; k <= n; k++) {
+                const float n2 = (float) (k - j);
+                const float n3 = (float) (n - k);
+                const float alpha2 = part2[0] + (weights[2] * weights[2] * n2) + (weights[3] * weights[3] * n3);
+                const float beta2 = part2[1] + ((1.0f - weights[2]) * (1.0f - weights[2]) * n2) + ((1.0f - weights[3]) * (1.0f - weights[3]) * n3);
+                const float alphabeta = part2[2] + (weights[2] * (1.0f - weights[2]) * n2) + (weights[3] * (1.0f - weights[3]) * n3);
+                const float det = (alpha2 * beta2) - (alphabeta * alphabeta);
+                float alphax, betax, a[3], b[3];
+                float scale, err = 0.0f;
+
+                if (det < 1e-6f) {
+                    continue;  // everything in one run; no unique answer.
+                }
+
+                scale = 1.0f / det;
+                for (c = 0; c < 3; c++) {
+                    alphax = partx[c] + (weights[2] * (sums[k][c] - sums[j][c])) + (weights[3] * (sums[n][c] - sums[k][c]));
+                    betax = sums[n][c] - alphax;
+                    a[c] = ((alphax * beta2) - (betax * alphabeta)) * scale;
+                    b[c] = ((betax * alpha2) - (alphax * alphabeta)) * scale;
+                    a[c] = MIN(MAX(a[c], 0.0f), 255.0f);
+                    b[c] = MIN(MAX(b[c], 0.0f), 255.0f);
+                    // squared error, less the sum of x*x, which is the same
+                    //  for every split.
+                    err += (a[c] * a[c] * alpha2) + (b[c] * b[c] * beta2) +
+                           (2.0f * ((a[c] * b[c] * alphabeta) - (a[c] * alphax) - (b[c] * betax)));
+                }
+
+                if (err < besterr) {
+                    besterr = err;
+                    memcpy(besta, a, sizeof (besta));
+                    memcpy(bestb, b, sizeof (bestb));
+                }
+            }
+        }
+    }
+
+    *_c0 = quantize565((uint32) (besta[0] + 0.5f), (uint32) (besta[1] + 0.5f), (uint32) (besta[2] + 0.5f));
+    *_c1 = quantize565((uint32) (bestb[0] + 0.5f), (uint32) (bestb[1] + 0.5f), (uint32) (bestb[2] + 0.5f));
+}
+
+// BC1 blocks with any pixel under half alpha use three-color mode, fit to
+//  the opaque pixels only.
+static void bc1_punchthrough(const uint8 *src, const size_t pitch,
+                             const int high, uint8 *dst)
+{
+    float pts[16][3];
+    uint8 lo[3] = { 0xFF, 0xFF, 0xFF };
+    uint8 hi[3] = { 0x00, 0x00, 0x00 };
+    int n = 0;
+    int x, y, i;
+
+    for (y = 0; y < 4; y++) {
+        const uint8 *px = src + (y * pitch);
+        for (x = 0; x < 4; x++, px += 4) {
+            if (px[3] >= 128) {
+                for (i = 0; i < 3; i++) {
+                    lo[i] = MIN(lo[i], px[i]);
+                    hi[i] = MAX(hi[i], px[i]);
+                    pts[n][i] = (float) px[i];
+                }
+                n++;
+            }
+        }
+    }
+
+    if (n == 0) {
+        write_bc1_block(dst, 0, 0, 0xFFFFFFFF);  // all transparent.
+        return;
+    }
+
+    if (!high) {
+        bc1_block(src, pitch, quantize565(lo[0], lo[1], lo[2]),
+                  quantize565(hi[0], hi[1], hi[2]), 3, dst);
+    } else {
+        uint8 fit[8];
+        uint32 c0, c1, err;
+        err = bc1_block(src, pitch, quantize565(lo[0], lo[1], lo[2]),
+                        quantize565(hi[0], hi[1], hi[2]), 3, dst);
+        cluster_fit(pts, n, 3, &c0, &c1);
+        if (bc1_block(src, pitch, c0, c1, 3, fit) < err) {
+            memcpy(dst, fit, sizeof (fit));
+        }
+    }
+}
+
+static void bc1_colors_high(const uint8 *src, const size_t pitch,
+                            const uint8 lo[4], const uint8 hi[4], uint8 *dst)
+{
+    float pts[16][3];
+    uint8 fit[8];
+    uint32 c0, c1, err;
+    int x, y, i;
+
+    bc1_fast_endpoints(lo, hi, &c0, &c1);
+    err = bc1_block(src, pitch, c0, c1, 4, dst);
+    if (err == 0) {
+        return;
+    }
+
+    for (y = 0; y < 4; y++) {
+        for (x = 0; x < 4; x++) {
+            for (i = 0; i < 3; i++) {
+                pts[(y * 4) + x][i] = (float) src[(y * pitch) + (x * 4) + i];
+            }
+        }
+    }
+    cluster_fit(pts, 16, 4, &c0, &c1);
+    if (bc1_block(src, pitch, c0, c1, 4, fit) < err) {
+        memcpy(dst, fit, sizeof (fit));
+    }
+}
+
+// Tries the bounds pulled in a step or two, and six-value mode with 0 and
+//  255 taken out, which wins for cutouts with a soft edge.
+static void bc3_alpha_high(const uint8 *src, const size_t pitch,
+                           const uint8 lo[4], const uint8 hi[4], uint8 *dst)
+{
+    uint8 trial[8];
+    uint32 lo6 = 0xFF, hi6 = 0x00;
+    uint32 a0, a1, err;
+    int x, y;
+
+    err = bc3_alpha_block(src, pitch, hi[3], lo[3], dst);
+    for (a0 = hi[3]; (err > 0) && (a0 + 2 >= hi[3]) && (a0 > lo[3]); a0--) {
+        for (a1 = lo[3]; (a1 <= lo[3] + 2u) && (a1 < a0); a1++) {
+            const uint32 trialerr = bc3_alpha_block(src, pitch, a0, a1, trial);
+            if (trialerr < err) {
+                err = trialerr;
+                memcpy(dst, trial, sizeof (trial));
+            }
+        }
+    }
+
+    for (y = 0; y < 4; y++) {
+        for (x = 0; x < 4; x++) {
+            const uint32 a = src[(y * pitch) + (x * 4) + 3];
+            if ((a != 0) && (a != 0xFF)) {
+                lo6 = MIN(lo6, a);
+                hi6 = MAX(hi6, a);
+            }
+        }
+    }
+    if ((err > 0) && (lo6 <= hi6)) {
+        if (bc3_alpha_block(src, pitch, lo6, hi6, trial) < err) {
+            memcpy(dst, trial, sizeof (trial));
+        }
+    }
+}
+
+static void encode_bc1_scalar(const uint8 *src, size_t pitch, uint8 *dst)
+{
+    uint8 lo[4], hi[4];
+    uint32 c0, c1;
+
+    block_bounds(src, pitch, lo, hi);
+    if (lo[3] < 128) {
+        bc1_punchthrough(src, pitch, 0, dst);
+    } else {
+        bc1_fast_endpoints(lo, hi, &c0, &c1);
+        bc1_block(src, pitch, c0, c1, 4, dst);
+    }
+}
+
+static void encode_bc3_scalar(const uint8 *src, size_t pitch, uint8 *dst)
+{
+    uint8 lo[4], hi[4];
+    uint32 c0, c1;
+
+    block_bounds(src, pitch, lo, hi);
+    bc3_alpha_block(src, pitch, hi[3], lo[3], dst);
+    bc1_fast_endpoints(lo, hi, &c0, &c1);
+    bc1_block(src, pitch, c0, c1, 4, dst + 8);
+}
+
+static void encode_bc1_high(const uint8 *src, size_t pitch, uint8 *dst)
+{
+    uint8 lo[4], hi[4];
+
+    block_bounds(src, pitch, lo, hi);
+    if (lo[3] < 128) {
+        bc1_punchthrough(src, pitch, 1, dst);
+    } else {
+        bc1_colors_high(src, pitch, lo, hi, dst);
+    }
+}
+
+static void encode_bc3_high(const uint8 *src, size_t pitch, uint8 *dst)
+{
+    uint8 lo[4], hi[4];
+
+    block_bounds(src, pitch, lo, hi);
+    bc3_alpha_high(src, pitch, lo, hi, dst);
+    bc1_colors_high(src, pitch, lo, hi, dst + 8);
+}
+
+
+#ifdef MOJODDS_HAVE_X86
+
+// The x86 kernels hold a block as four rows of four pixels and do the
+//  distance math for a whole row at a time in 16-bit lanes.
+
+static MOJODDS_TARGET("sse2") void sse2_load_block(const uint8 *src,
+                                                   const size_t pitch,
+                                                   __m128i px[4])
+{
+    int y;
+    for (y = 0; y < 4; y++) {
+        px[y] = _mm_loadu_si128((const __m128i *) (src + (y * pitch)));
+    }
+}
+
+static MOJODDS_TARGET("sse2") void sse2_block_bounds(const __m128i px[4],
+                                                     uint8 lo[4], uint8 hi[4])
+{
+    __m128i mn = _mm_min_epu8(_mm_min_epu8(px[0], px[1]), _mm_min_epu8(px[2], px[3]));
+    __m128i mx = _mm_max_epu8(_mm_max_epu8(px[0], px[1]), _mm_max_epu8(px[2], px[3]));
+    uint32 val;
+
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+    val = (uint32) _mm_cvtsi128_si32(mn);
+    write32(lo, val);
+    val = (uint32) _mm_cvtsi128_si32(mx);
+    write32(hi, val);
+}
+
+static MOJODDS_TARGET("sse2") __m128i sse2_select(const __m128i mask,
+                                                  const __m128i a,
+                                                  const __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Four-color indices; same choices as bc1_block().
+static MOJODDS_TARGET("sse2") uint32 sse2_bc1_indices(const __m128i px[4],
+                                                      uint8 pal[4][4])
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgbmask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i shifts = _mm_set_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    __m128i entries[4];
+    uint32 indices = 0;
+    int i, y;
+
+    for (i = 0; i < 4; i++) {
+        const int rgb = pal[i][0] | (pal[i][1] << 8) | (pal[i][2] << 16);
+        entries[i] = _mm_unpacklo_epi8(_mm_set1_epi32(rgb), zero);
+    }
+
+    for (y = 0; y < 4; y++) {
+        const __m128i row = _mm_and_si128(px[y], rgbmask);
+        const __m128i lo = _mm_unpacklo_epi8(row, zero);  // pixels 0 and 1
+        const __m128i hi = _mm_unpackhi_epi8(row, zero);  // pixels 2 and 3
+        __m128i best = zero;
+        __m128i besti = zero;
+        __m128i packed;
+
+        for (i = 0; i < 4; i++) {
+            const __m128i dlo = _mm_sub_epi16(lo, entries[i]);
+            const __m128i dhi = _mm_sub_epi16(hi, entries[i]);
+            // (r*r + g*g, b*b) for each pixel, then add the pairs.
+            const __m128 sqlo = _mm_castsi128_ps(_mm_madd_epi16(dlo, dlo));
+            const __m128 sqhi = _mm_castsi128_ps(_mm_madd_epi16(dhi, dhi));
+            const __m128i dist = _mm_add_epi32(
+                _mm_castps_si128(_mm_shuffle_ps(sqlo, sqhi, _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(sqlo, sqhi, _MM_SHUFFLE(3, 1, 3, 1))));
+            if (i == 0) {
+                best = dist;
+            } else {
+                const __m128i closer = _mm_cmplt_epi32(dist, best);
+                best = sse2_select(closer, dist, best);
+                besti = sse2_select(closer, _mm_set1_epi32(i), besti);
+            }
+        }
+
+        // the four 2-bit indices of this row into one byte.
+        packed = _mm_madd_epi16(_mm_packs_epi32(besti, besti), shifts);
+        indices |= ((uint32) (_mm_cvtsi128_si32(packed) +
+                              _mm_cvtsi128_si32(_mm_srli_si128(packed, 4)))) << (y * 8);
+    }
+    return indices;
+}
+
+// Alpha indices; same choices as bc3_alpha_block().
+static MOJODDS_TARGET("sse2") void sse2_bc3_alpha_indices(const __m128i px[4],
+                                                          const uint8 pal[8],
+                                                          uint8 idx[16])
+{
+    const __m128i alpha = _mm_packus_epi16(
+        _mm_packs_epi32(_mm_srli_epi32(px[0], 24), _mm_srli_epi32(px[1], 24)),
+        _mm_packs_epi32(_mm_srli_epi32(px[2], 24), _mm_srli_epi32(px[3], 24)));
+    __m128i best = _mm_setzero_si128();
+    __m128i besti = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        const __m128i entry = _mm_set1_epi8((char) pal[i]);
+        const __m128i dist = _mm_or_si128(_mm_subs_epu8(alpha, entry),
+                                          _mm_subs_epu8(entry, alpha));
+        if (i == 0) {
+            best = dist;
+        } else {
+            const __m128i nearer = _mm_min_epu8(dist, best);
+            const __m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(dist, best),
+                                                    _mm_cmpeq_epi8(nearer, dist));
+            best = nearer;
+            besti = sse2_select(closer, _mm_set1_epi8((char) i), besti);
+        }
+    }
+    _mm_storeu_si128((__m128i *) idx, besti);
+}
+
+static MOJODDS_TARGET("sse2") void sse2_bc1_colors(const __m128i px[4],
+                                                   const uint8 lo[4],
+                                                   const uint8 hi[4],
+                                                   uint8 *dst)
+{
+    uint8 pal[4][4];
+    uint32 c0, c1;
+
+    bc1_fast_endpoints(lo, hi, &c0, &c1);
+    bc1_palette(c0, c1, 1, pal);
+    write_bc1_block(dst, c0, c1, (c0 == c1) ? 0 : sse2_bc1_indices(px, pal));
+}
+
+static MOJODDS_TARGET("sse2") void encode_bc1_sse2(const uint8 *src,
+                                                   size_t pitch, uint8 *dst)
+{
+    __m128i px[4];
+    uint8 lo[4], hi[4];
+
+    sse2_load_block(src, pitch, px);
+    sse2_block_bounds(px, lo, hi);
+    if (lo[3] < 128) {
+        bc1_punchthrough(src, pitch, 0, dst);
+    } else {
+        sse2_bc1_colors(px, lo, hi, dst);
+    }
+}
+
+static MOJODDS_TARGET("sse2") void encode_bc3_sse2(const uint8 *src,
+                                                   size_t pitch, uint8 *dst)
+{
+    __m128i px[4];
+    uint8 lo[4], hi[4];
+    uint8 pal[8];
+    uint8 idx[16];
+
+    sse2_load_block(src, pitch, px);
+    sse2_block_bounds(px, lo, hi);
+    bc3_alpha_palette(hi[3], lo[3], pal);
+    sse2_bc3_alpha_indices(px, pal, idx);
+    write_bc3_alpha_block(dst, hi[3], lo[3], idx);
+    sse2_bc1_colors(px, lo, hi, dst + 8);
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+
+#ifdef MOJODDS_HAVE_NEON
+
+// Same shape as the SSE2 kernels; NEON has absolute differences and
+//  horizontal adds, so there's less shuffling.
+
+static void neon_load_block(const uint8 *src, const size_t pitch,
+                            uint8x16_t px[4])
+{
+    int y;
+    for (y = 0; y < 4; y++) {
+        px[y] = vld1q_u8(src + (y * pitch));
+    }
+}
+
+static void neon_block_bounds(const uint8x16_t px[4], uint8 lo[4], uint8 hi[4])
+{
+    uint8x16_t mn = vminq_u8(vminq_u8(px[0], px[1]), vminq_u8(px[2], px[3]));
+    uint8x16_t mx = vmaxq_u8(vmaxq_u8(px[0], px[1]), vmaxq_u8(px[2], px[3]));
+    uint8 buf[16];
+
+    mn = vminq_u8(mn, vextq_u8(mn, mn, 8));
+    mn = vminq_u8(mn, vextq_u8(mn, mn, 4));
+    mx = vmaxq_u8(mx, vextq_u8(mx, mx, 8));
+    mx = vmaxq_u8(mx, vextq_u8(mx, mx, 4));
+    vst1q_u8(buf, mn);
+    memcpy(lo, buf, 4);
+    vst1q_u8(buf, mx);
+    memcpy(hi, buf, 4);
+}
+
+static uint32 neon_bc1_indices(const uint8x16_t px[4], uint8 pal[4][4])
+{
+    static const uint32 shiftvals[4] = { 1, 4, 16, 64 };
+    const uint32x4_t shifts = vld1q_u32(shiftvals);
+    const uint8x16_t rgbmask = vreinterpretq_u8_u32(vdupq_n_u32(0x00FFFFFF));
+    uint8x16_t entries[4];
+    uint32 indices = 0;
+    int i, y;
+
+    for (i = 0; i < 4; i++) {
+        const uint32 rgb = pal[i][0] | (pal[i][1] << 8) | (pal[i][2] << 16);
+        entries[i] = vreinterpretq_u8_u32(vdupq_n_u32(rgb));
+    }
+
+    for (y = 0; y < 4; y++) {
+        const uint8x16_t row = vandq_u8(px[y], rgbmask);
+        uint32x4_t best = vdupq_n_u32(0);
+        uint32x4_t besti = vdupq_n_u32(0);
+
+        for (i = 0; i < 4; i++) {
+            const uint8x16_t diff = vabdq_u8(row, entries[i]);
+            const uint16x8_t sqlo = vmull_u8(vget_low_u8(diff), vget_low_u8(diff));
+            const uint16x8_t sqhi = vmull_u8(vget_high_u8(diff), vget_high_u8(diff));
+            const uint32x4_t dist = vpaddq_u32(vpaddlq_u16(sqlo), vpaddlq_u16(sqhi));
+            if (i == 0) {
+                best = dist;
+            } else {
+                const uint32x4_t closer = vcltq_u32(dist, best);
+                best = vminq_u32(dist, best);
+                besti = vbslq_u32(closer, vdupq_n_u32(i), besti);
+            }
+        }
+        indices |= vaddvq_u32(vmulq_u32(besti, shifts)) << (y * 8);
+    }
+    return indices;
+}
+
+static void neon_bc3_alpha_indices(const uint8x16_t px[4], const uint8 pal[8],
+                                   uint8 idx[16])
+{
+    static const uint8 gather[4][16] = {
+        { 3, 7, 11, 15, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+        { 0xFF, 0xFF, 0xFF, 0xFF, 3, 7, 11, 15, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+        { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 3, 7, 11, 15, 0xFF, 0xFF, 0xFF, 0xFF },
+        { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 3, 7, 11, 15 }
+    };
+    uint8x16_t alpha = vqtbl1q_u8(px[0], vld1q_u8(gather[0]));
+    uint8x16_t best = vdupq_n_u8(0);
+    uint8x16_t besti = vdupq_n_u8(0);
+    int i;
+
+    for (i = 1; i < 4; i++) {
+        alpha = vorrq_u8(alpha, vqtbl1q_u8(px[i], vld1q_u8(gather[i])));
+    }
+
+    for (i = 0; i < 8; i++) {
+        const uint8x16_t dist = vabdq_u8(alpha, vdupq_n_u8(pal[i]));
+        if (i == 0) {
+            best = dist;
+        } else {
+            const uint8x16_t closer = vcltq_u8(dist, best);
+            best = vminq_u8(dist, best);
+            besti = vbslq_u8(closer, vdupq_n_u8((uint8) i), besti);
+        }
+    }
+    vst1q_u8(idx, besti);
+}
+
+static void neon_bc1_colors(const uint8x16_t px[4], const uint8 lo[4],
+                            const uint8 hi[4], uint8 *dst)
+{
+    uint8 pal[4][4];
+    uint32 c0, c1;
+
+    bc1_fast_endpoints(lo, hi, &c0, &c1);
+    bc1_palette(c0, c1, 1, pal);
+    write_bc1_block(dst, c0, c1, (c0 == c1) ? 0 : neon_bc1_indices(px, pal));
+}
+
+static void encode_bc1_neon(const uint8 *src, size_t pitch, uint8 *dst)
+{
+    uint8x16_t px[4];
+    uint8 lo[4], hi[4];
+
+    neon_load_block(src, pitch, px);
+    neon_block_bounds(px, lo, hi);
+    if (lo[3] < 128) {
+        bc1_punchthrough(src, pitch, 0, dst);
+    } else {
+        neon_bc1_colors(px, lo, hi, dst);
+    }
+}
+
+static void encode_bc3_neon(const uint8 *src, size_t pitch, uint8 *dst)
+{
+    uint8x16_t px[4];
+    uint8 lo[4], hi[4];
+    uint8 pal[8];
+    uint8 idx[16];
+
+    neon_load_block(src, pitch, px);
+    neon_block_bounds(px, lo, hi);
+    bc3_alpha_palette(hi[3], lo[3], pal);
+    neon_bc3_alpha_indices(px, pal, idx);
+    write_bc3_alpha_block(dst, hi[3], lo[3], idx);
+    neon_bc1_colors(px, lo, hi, dst + 8);
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+#ifdef MOJODDS_HAVE_X86
+#define SSE2_ENCODER(fn) fn
+#else
+#define SSE2_ENCODER(fn) NULL
+#endif
+#ifdef MOJODDS_HAVE_NEON
+#define NEON_ENCODER(fn) fn
+#else
+#define NEON_ENCODER(fn) NULL
+#endif
+
+typedef struct
+{
+    uint32 glfmt;
+    MOJODDS_encodeQuality quality;
+    encode_fn scalar;
+    encode_fn sse2;
+    encode_fn neon;
+} Encoder;
+
+static const Encoder Encoders[] =
+{
+    #define BC1_FAST encode_bc1_scalar, SSE2_ENCODER(encode_bc1_sse2), NEON_ENCODER(encode_bc1_neon)
+    #define BC3_FAST encode_bc3_scalar, SSE2_ENCODER(encode_bc3_sse2), NEON_ENCODER(encode_bc3_neon)
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, MOJODDS_ENCODE_FAST, BC1_FAST },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, MOJODDS_ENCODE_FAST, BC1_FAST },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, MOJODDS_ENCODE_FAST, BC3_FAST },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, MOJODDS_ENCODE_FAST, BC3_FAST },
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, MOJODDS_ENCODE_HIGH, encode_bc1_high, NULL, NULL },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, MOJODDS_ENCODE_HIGH, encode_bc1_high, NULL, NULL },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, MOJODDS_ENCODE_HIGH, encode_bc3_high, NULL, NULL },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, MOJODDS_ENCODE_HIGH, encode_bc3_high, NULL, NULL },
+    #undef BC1_FAST
+    #undef BC3_FAST
+};
+
+static encode_fn find_encoder(const uint32 glfmt,
+                              const MOJODDS_encodeQuality quality)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    int i;
+    for (i = 0; i < STATICARRAYLEN(Encoders); i++) {
+        const Encoder *encoder = &Encoders[i];
+        if ((encoder->glfmt == glfmt) && (encoder->quality == quality)) {
+            if ((cpu & MOJODDS_CPU_SSE2) && (encoder->sse2 != NULL)) {
+                return encoder->sse2;
+            } else if ((cpu & MOJODDS_CPU_NEON) && (encoder->neon != NULL)) {
+                return encoder->neon;
+            }
+            return encoder->scalar;
+        }
+    }
+    return NULL;
+}
+
+
+typedef struct
+{
+    encode_fn fn;
+    const uint8 *src;
+    size_t srcpitch;
+    uint8 *dst;
+    unsigned int w;
+    unsigned int h;
+    unsigned int blocksw;
+    unsigned int blocksh;
+    unsigned int blockSize;
+    unsigned int rowsPerBand;
+} EncodeJob;
+
+// Blocks hanging off the right or bottom edge repeat their last row and
+//  column, which keeps the padding from pulling the endpoints around.
+static void encode_partial_block(const EncodeJob *job, const uint8 *src,
+                                 uint8 *dst, const unsigned int pw,
+                                 const unsigned int ph)
+{
+    uint8 scratch[4 * 4 * 4];
+    unsigned int x, y;
+
+    for (y = 0; y < 4; y++) {
+        const uint8 *row = src + (MIN(y, ph - 1) * job->srcpitch);
+        for (x = 0; x < 4; x++) {
+            memcpy(scratch + (y * 16) + (x * 4), row + (MIN(x, pw - 1) * 4), 4);
+        }
+    }
+    job->fn(scratch, 16, dst);
+}
+
+static void encode_band(void *data, unsigned int band)
+{
+    const EncodeJob *job = (const EncodeJob *) data;
+    const size_t dstpitch = ((size_t) job->blocksw) * job->blockSize;
+    const unsigned int end = MIN((band + 1) * job->rowsPerBand, job->blocksh);
+    unsigned int by, bx;
+
+    for (by = band * job->rowsPerBand; by < end; by++) {
+        const uint8 *src = job->src + (((size_t) by) * 4 * job->srcpitch);
+        uint8 *dst = job->dst + (by * dstpitch);
+        const unsigned int ph = MIN(4, job->h - (by * 4));
+
+        for (bx = 0; bx < job->blocksw; bx++, src += 16, dst += job->blockSize) {
+            const unsigned int pw = MIN(4, job->w - (bx * 4));
+            if ((pw == 4) && (ph == 4)) {
+                job->fn(src, job->srcpitch, dst);
+            } else {
+                encode_partial_block(job, src, dst, pw, ph);
+            }
+        }
+    }
+}
+
+int MOJODDS_encode(unsigned int glfmt, const void *_src,
+                   unsigned long _srcpitch, unsigned int w, unsigned int h,
+                   MOJODDS_encodeQuality quality, void *_dst,
+                   unsigned long _dstlen, MOJODDS_ThreadPool *pool)
+{
+    EncodeJob job;
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    unsigned int bands;
+
+    memset(&job, '\0', sizeof (job));
+    job.fn = find_encoder(glfmt, quality);
+    if (job.fn == NULL) {
+        return 0;  // unsupported format.
+    } else if (!MOJODDS_getFormatInfo(glfmt, &blockDim, &blockSize, NULL, NULL, NULL)) {
+        return 0;
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    }
+
+    assert(blockDim == 4);
+    job.src = (const uint8 *) _src;
+    job.srcpitch = (size_t) _srcpitch;
+    job.dst = (uint8 *) _dst;
+    job.w = w;
+    job.h = h;
+    job.blocksw = (w + 3) / 4;
+    job.blocksh = (h + 3) / 4;
+    job.blockSize = blockSize;
+
+    if (((uint64) job.blocksw) * job.blocksh * blockSize > _dstlen) {
+        return 0;  // not enough room for the level.
+    } else if (((uint64) w) * 4 > _srcpitch) {
+        return 0;  // rows would overlap.
+    }
+
+    // Same banding as MOJODDS_decode(). The high-quality mode costs far
+    //  more per block, but there are plenty of bands to go around anyhow.
+    job.rowsPerBand = MAX(4096 / job.blocksw, 1);
+    bands = (job.blocksh + job.rowsPerBand - 1) / job.rowsPerBand;
+    mojodds_parallel_for(pool, bands, encode_band, &job);
+    return 1;
+}
+
+// end of mojodds_encode.c ...
+
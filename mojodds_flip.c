@@ -0,0 +1,251 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Flipping mip levels upside down in place, and the MOJODDS_flipVertical()
+//  entry point.
+//
+// Uncompressed levels just swap rows. Block-compressed levels swap block
+//  rows and then reverse the pixel rows inside each block, which for the
+//  DXT/RGTC family means shuffling index bits around; endpoints stay put, so
+//  nothing is decoded and the result is exactly what you'd get from
+//  flipping the decoded image and encoding it the same way. BC6H and BC7
+//  blocks have partition shapes that don't survive a flip, so they can't be
+//  done this way.
+
+#include <string.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+// Reverse the first (rows) pixel rows of one block; the rest are padding
+//  past the bottom of a level less than four pixels tall.
+typedef void (*flip_block_fn)(uint8 *block, unsigned int rows);
+
+// Swap len bytes between a and b, which don't overlap.
+typedef void (*swap_fn)(uint8 *a, uint8 *b, size_t len);
+
+static void swap_scalar(uint8 *a, uint8 *b, size_t len)
+{
+    while (len--) {
+        const uint8 tmp = *a;
+        *(a++) = *b;
+        *(b++) = tmp;
+    }
+}
+
+#ifdef MOJODDS_HAVE_X86
+static MOJODDS_TARGET("sse2") void swap_sse2(uint8 *a, uint8 *b, size_t len)
+{
+    for (; len >= 32; len -= 32, a += 32, b += 32) {
+        const __m128i a0 = _mm_loadu_si128((const __m128i *) a);
+        const __m128i a1 = _mm_loadu_si128((const __m128i *) (a + 16));
+        const __m128i b0 = _mm_loadu_si128((const __m128i *) b);
+        const __m128i b1 = _mm_loadu_si128((const __m128i *) (b + 16));
+        _mm_storeu_si128((__m128i *) a, b0);
+        _mm_storeu_si128((__m128i *) (a + 16), b1);
+        _mm_storeu_si128((__m128i *) b, a0);
+        _mm_storeu_si128((__m128i *) (b + 16), a1);
+    }
+    swap_scalar(a, b, len);
+}
+#endif
+
+#ifdef MOJODDS_HAVE_NEON
+static void swap_neon(uint8 *a, uint8 *b, size_t len)
+{
+    for (; len >= 32; len -= 32, a += 32, b += 32) {
+        const uint8x16_t a0 = vld1q_u8(a);
+        const uint8x16_t a1 = vld1q_u8(a + 16);
+        const uint8x16_t b0 = vld1q_u8(b);
+        const uint8x16_t b1 = vld1q_u8(b + 16);
+        vst1q_u8(a, b0);
+        vst1q_u8(a + 16, b1);
+        vst1q_u8(b, a0);
+        vst1q_u8(b + 16, a1);
+    }
+    swap_scalar(a, b, len);
+}
+#endif
+
+static swap_fn find_swap(void)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    #if defined(MOJODDS_HAVE_X86)
+    if (cpu & MOJODDS_CPU_SSE2) {
+        return swap_sse2;
+    }
+    #elif defined(MOJODDS_HAVE_NEON)
+    if (cpu & MOJODDS_CPU_NEON) {
+        return swap_neon;
+    }
+    #endif
+    (void) cpu;
+    return swap_scalar;
+}
+
+
+// BC1 colors: two 16-bit endpoints, then one byte of 2-bit indices per row.
+static void flip_bc1(uint8 *block, unsigned int rows)
+{
+    uint8 *idx = block + 4;
+    unsigned int i;
+    for (i = 0; i < rows / 2; i++) {
+        const uint8 tmp = idx[i];
+        idx[i] = idx[rows - 1 - i];
+        idx[rows - 1 - i] = tmp;
+    }
+}
+
+// BC2 alpha: 16 bits of 4-bit alphas per row, then a BC1 color block.
+static void flip_bc2(uint8 *block, unsigned int rows)
+{
+    unsigned int i;
+    for (i = 0; i < rows / 2; i++) {
+        uint8 *a = block + (i * 2);
+        uint8 *b = block + ((rows - 1 - i) * 2);
+        const uint8 tmp0 = a[0];
+        const uint8 tmp1 = a[1];
+        a[0] = b[0];
+        a[1] = b[1];
+        b[0] = tmp0;
+        b[1] = tmp1;
+    }
+    flip_bc1(block + 8, rows);
+}
+
+// BC3 alpha, BC4 and each half of BC5: two 8-bit endpoints, then 48 bits of
+//  3-bit indices, 12 bits per row.
+static void flip_alpha3(uint8 *block, unsigned int rows)
+{
+    uint64 bits = 0;
+    uint64 flipped = 0;
+    unsigned int i;
+
+    for (i = 0; i < 6; i++) {
+        bits |= ((uint64) block[2 + i]) << (i * 8);
+    }
+
+    for (i = 0; i < 4; i++) {
+        const unsigned int src = (i < rows) ? (rows - 1 - i) : i;
+        flipped |= ((bits >> (src * 12)) & 0xFFF) << (i * 12);
+    }
+
+    for (i = 0; i < 6; i++) {
+        block[2 + i] = (uint8) (flipped >> (i * 8));
+    }
+}
+
+static void flip_bc3(uint8 *block, unsigned int rows)
+{
+    flip_alpha3(block, rows);
+    flip_bc1(block + 8, rows);
+}
+
+static void flip_bc5(uint8 *block, unsigned int rows)
+{
+    flip_alpha3(block, rows);
+    flip_alpha3(block + 8, rows);
+}
+
+typedef struct
+{
+    uint32 glfmt;
+    flip_block_fn fn;
+} BlockFlipper;
+
+static const BlockFlipper BlockFlippers[] =
+{
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, flip_bc1 },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, flip_bc1 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, flip_bc2 },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, flip_bc2 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, flip_bc3 },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, flip_bc3 },
+    { GL_COMPRESSED_RED_RGTC1, flip_alpha3 },
+    { GL_COMPRESSED_SIGNED_RED_RGTC1, flip_alpha3 },
+    { GL_COMPRESSED_RG_RGTC2, flip_bc5 },
+    { GL_COMPRESSED_SIGNED_RG_RGTC2, flip_bc5 }
+};
+
+static flip_block_fn find_block_flipper(const uint32 glfmt)
+{
+    int i;
+    for (i = 0; i < STATICARRAYLEN(BlockFlippers); i++) {
+        if (BlockFlippers[i].glfmt == glfmt) {
+            return BlockFlippers[i].fn;
+        }
+    }
+    return NULL;
+}
+
+static void flip_block_row(const flip_block_fn fn, uint8 *row,
+                           const unsigned int blocks,
+                           const unsigned int blockSize,
+                           const unsigned int rows)
+{
+    unsigned int i;
+    for (i = 0; i < blocks; i++) {
+        fn(row + (i * blockSize), rows);
+    }
+}
+
+int MOJODDS_flipVertical(unsigned int glfmt, void *_tex, unsigned long _texlen,
+                         unsigned int w, unsigned int h)
+{
+    uint8 *tex = (uint8 *) _tex;
+    const swap_fn swap = find_swap();
+    flip_block_fn fn = NULL;
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    unsigned int rows;
+    size_t pitch;
+    unsigned int y;
+
+    if (!MOJODDS_getFormatInfo(glfmt, &blockDim, &blockSize, NULL, NULL, NULL)) {
+        return 0;
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    } else if (blockDim != 1) {
+        fn = find_block_flipper(glfmt);
+        if (fn == NULL) {
+            return 0;  // BC6H/BC7.
+        } else if ((h > blockDim) && ((h % blockDim) != 0)) {
+            return 0;  // rows would move between blocks; needs a re-encode.
+        }
+    }
+
+    rows = (h + blockDim - 1) / blockDim;
+    pitch = ((size_t) ((w + blockDim - 1) / blockDim)) * blockSize;
+    if (((uint64) pitch) * rows > _texlen) {
+        return 0;
+    }
+
+    for (y = 0; y < rows / 2; y++) {
+        uint8 *a = tex + (y * pitch);
+        uint8 *b = tex + ((rows - 1 - y) * pitch);
+        swap(a, b, pitch);
+        if (fn != NULL) {
+            flip_block_row(fn, a, (unsigned int) (pitch / blockSize), blockSize, blockDim);
+            flip_block_row(fn, b, (unsigned int) (pitch / blockSize), blockSize, blockDim);
+        }
+    }
+
+    if ((fn != NULL) && (rows & 1)) {  // the middle block row flips alone.
+        flip_block_row(fn, tex + ((rows / 2) * pitch),
+                       (unsigned int) (pitch / blockSize), blockSize,
+                       MIN(h, blockDim));
+    }
+
+    return 1;
+}
+
+// end of mojodds_flip.c ...
@@ -0,0 +1,491 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Converting float pixels: half floats to floats and back, and floats to the
+//  4-byte RGBE and R11G11B10F formats for shrinking HDR images, with the
+//  MOJODDS_halfToFloat(), MOJODDS_floatToHalf(), MOJODDS_floatToRGBE() and
+//  MOJODDS_floatToR11G11B10F() entry points.
+//
+// Every conversion here is exact or rounds to nearest even, so the scalar
+//  code is written to get the same bits as F16C and NEON do in hardware
+//  (NaNs included), and the SIMD packers do the same integer steps as the
+//  scalar ones. Don't add FTZ/DAZ anywhere; denormals have to survive.
+
+#include <string.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#include <immintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+// Convert (count) values or pixels from src to dst.
+typedef void (*float_fn)(const uint8 *src, uint8 *dst, size_t count);
+
+// Unsigned 11- and 10-bit floats have 6 and 5 mantissa bits, a 5-bit
+//  exponent biased by 15, and these as their largest finite values.
+#define UFLOAT11_MAX 65024.0f
+#define UFLOAT10_MAX 64512.0f
+
+// Below this, an RGBE pixel is zero; it keeps 2^(8 - e) a normal float.
+#define RGBE_MIN 1e-32f
+
+static uint32 float_bits(const float f)
+{
+    uint32 bits;
+    memcpy(&bits, &f, sizeof (bits));
+    return bits;
+}
+
+static float bits_float(const uint32 bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof (f));
+    return f;
+}
+
+float mojodds_half_to_float(const uint16 h)
+{
+    const uint32 sign = ((uint32) (h & 0x8000)) << 16;
+    const uint32 exponent = (h >> 10) & 0x1F;
+    const uint32 mantissa = h & 0x3FF;
+    float f;
+
+    if (exponent == 0) {  // zero or denormal.
+        f = ((float) mantissa) * (1.0f / 16777216.0f);
+        return sign ? -f : f;
+    } else if (exponent == 31) {  // inf or nan; a signaling nan comes out quiet.
+        return bits_float(sign | 0x7F800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0));
+    }
+    return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint16 mojodds_float_to_half(const float f)
+{
+    const uint32 bits = float_bits(f);
+    const uint32 sign = (bits >> 16) & 0x8000;
+    uint32 a = bits & 0x7FFFFFFF;
+
+    if (a > 0x7F800000) {  // nan: keep the top of the payload, quieted.
+        return (uint16) (sign | 0x7E00 | ((a >> 13) & 0x3FF));
+    } else if (a >= (143u << 23)) {  // 65536 and up (and inf) round to inf.
+        return (uint16) (sign | 0x7C00);
+    } else if (a < (113u << 23)) {  // below 2^-14; the add rounds it.
+        const float magic = 0.5f;  // its ulp is the smallest half denormal.
+        return (uint16) (sign | (float_bits(bits_float(a) + magic) - float_bits(magic)));
+    }
+
+    // Rebias, and round the dropped 13 bits to nearest even; a carry out of
+    //  the mantissa bumps the exponent, all the way to inf if need be.
+    a += ((uint32) (15 - 127) << 23) + 0xFFF + ((a >> 13) & 1);
+    return (uint16) (sign | (a >> 13));
+}
+
+// Negatives and NaNs go to zero, and anything over max to max.
+static float clamp_unsigned(const float v, const float max)
+{
+    return (v > 0.0f) ? ((v < max) ? v : max) : 0.0f;
+}
+
+// One channel of R11G11B10F: mbits is 6 for red and green, 5 for blue.
+static uint32 pack_ufloat(const float v, const int mbits, const float max)
+{
+    const float x = clamp_unsigned(v, max);
+    const uint32 shift = 23 - mbits;
+    uint32 bits = float_bits(x);
+
+    if (bits < (113u << 23)) {  // below 2^-14, so denormal; the add rounds.
+        const float magic = bits_float((uint32) (136 - mbits) << 23);
+        return float_bits(x + magic) - float_bits(magic);
+    }
+    bits += ((uint32) (15 - 127) << 23) + (1u << (shift - 1)) - 1 + ((bits >> shift) & 1);
+    return bits >> shift;
+}
+
+// Radiance's RGBE: m = frac * 2^e is the biggest channel, with frac in
+//  [0.5, 1), and each channel is stored as floor(c * 2^(8 - e)), with e + 128
+//  in the fourth byte. 2^(8 - e) is built straight from m's exponent bits.
+static uint32 rgbe_pixel(const float *px, const float max)
+{
+    const float r = clamp_unsigned(px[0], max);
+    const float g = clamp_unsigned(px[1], max);
+    const float b = clamp_unsigned(px[2], max);
+    const float m = MAX(r, MAX(g, b));
+    uint32 exponent;
+    float scale;
+
+    if (m < RGBE_MIN) {
+        return 0;
+    }
+    exponent = float_bits(m) >> 23;  // biased; e is exponent - 126.
+    scale = bits_float((261 - exponent) << 23);
+    return ((uint32) (r * scale)) | (((uint32) (g * scale)) << 8) |
+           (((uint32) (b * scale)) << 16) | ((exponent + 2) << 24);
+}
+
+// RGBE can't hold 2^127 or more; this is the float just under it.
+static float rgbe_max(void)
+{
+    return bits_float(0x7EFFFFFF);
+}
+
+static void half_to_float_scalar(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count > 0; count--, src += 2, dst += 4) {
+        uint16 h;
+        float f;
+        memcpy(&h, src, sizeof (h));
+        f = mojodds_half_to_float(h);
+        memcpy(dst, &f, sizeof (f));
+    }
+}
+
+static void float_to_half_scalar(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count > 0; count--, src += 4, dst += 2) {
+        uint16 h;
+        float f;
+        memcpy(&f, src, sizeof (f));
+        h = mojodds_float_to_half(f);
+        memcpy(dst, &h, sizeof (h));
+    }
+}
+
+static void float_to_rgbe_scalar(const uint8 *src, uint8 *dst, size_t count)
+{
+    const float max = rgbe_max();
+    for (; count > 0; count--, src += 16, dst += 4) {
+        float px[4];
+        uint32 rgbe;
+        memcpy(px, src, sizeof (px));
+        rgbe = rgbe_pixel(px, max);
+        memcpy(dst, &rgbe, sizeof (rgbe));
+    }
+}
+
+static void float_to_r11g11b10f_scalar(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count > 0; count--, src += 16, dst += 4) {
+        float px[4];
+        uint32 packed;
+        memcpy(px, src, sizeof (px));
+        packed = pack_ufloat(px[0], 6, UFLOAT11_MAX) |
+                 (pack_ufloat(px[1], 6, UFLOAT11_MAX) << 11) |
+                 (pack_ufloat(px[2], 5, UFLOAT10_MAX) << 22);
+        memcpy(dst, &packed, sizeof (packed));
+    }
+}
+
+
+#ifdef MOJODDS_HAVE_X86
+
+// F16C converts eight at a time with the same rounding as the scalar code.
+static MOJODDS_TARGET("avx,f16c") void half_to_float_f16c(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count >= 8; count -= 8, src += 16, dst += 32) {
+        const __m128i h = _mm_loadu_si128((const __m128i *) src);
+        _mm256_storeu_ps((float *) dst, _mm256_cvtph_ps(h));
+    }
+    half_to_float_scalar(src, dst, count);
+}
+
+static MOJODDS_TARGET("avx,f16c") void float_to_half_f16c(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count >= 8; count -= 8, src += 32, dst += 16) {
+        const __m256 f = _mm256_loadu_ps((const float *) src);
+        _mm_storeu_si128((__m128i *) dst, _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+    }
+    float_to_half_scalar(src, dst, count);
+}
+
+// Four RGBA32F pixels as one vector per channel, clamped like
+//  clamp_unsigned(): cmpgt is false for NaN, so NaN goes to zero too.
+static MOJODDS_TARGET("sse2") void sse2_load_rgb(const uint8 *src, const __m128 max, __m128 rgb[3])
+{
+    __m128 r = _mm_loadu_ps((const float *) src);
+    __m128 g = _mm_loadu_ps((const float *) (src + 16));
+    __m128 b = _mm_loadu_ps((const float *) (src + 32));
+    __m128 a = _mm_loadu_ps((const float *) (src + 48));
+    int i;
+
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+    rgb[0] = r;
+    rgb[1] = g;
+    rgb[2] = b;
+    for (i = 0; i < 3; i++) {
+        rgb[i] = _mm_min_ps(_mm_and_ps(rgb[i], _mm_cmpgt_ps(rgb[i], _mm_setzero_ps())), max);
+    }
+}
+
+static MOJODDS_TARGET("sse2") void float_to_rgbe_sse2(const uint8 *src, uint8 *dst, size_t count)
+{
+    const __m128 max = _mm_castsi128_ps(_mm_set1_epi32(0x7EFFFFFF));
+    __m128 rgb[3];
+
+    for (; count >= 4; count -= 4, src += 64, dst += 16) {
+        __m128 m, scale;
+        __m128i exponent, zero, out;
+
+        sse2_load_rgb(src, max, rgb);
+        m = _mm_max_ps(rgb[0], _mm_max_ps(rgb[1], rgb[2]));
+        zero = _mm_castps_si128(_mm_cmplt_ps(m, _mm_set1_ps(RGBE_MIN)));
+        exponent = _mm_srli_epi32(_mm_castps_si128(m), 23);
+        scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(261), exponent), 23));
+
+        out = _mm_cvttps_epi32(_mm_mul_ps(rgb[0], scale));
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(rgb[1], scale)), 8));
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(rgb[2], scale)), 16));
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(2)), 24));
+        _mm_storeu_si128((__m128i *) dst, _mm_andnot_si128(zero, out));
+    }
+    float_to_rgbe_scalar(src, dst, count);
+}
+
+// pack_ufloat() on four already-clamped channels.
+static MOJODDS_TARGET("sse2") __m128i sse2_pack_ufloat(const __m128 x, const int mbits)
+{
+    const __m128i shift = _mm_cvtsi32_si128(23 - mbits);
+    const __m128i bits = _mm_castps_si128(x);
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((136 - mbits) << 23));
+    const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(x, magic)), _mm_castps_si128(magic));
+    const __m128i isdenormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+    const __m128i odd = _mm_and_si128(_mm_srl_epi32(bits, shift), _mm_set1_epi32(1));
+    __m128i normal = _mm_add_epi32(bits, _mm_set1_epi32((int) (((uint32) (15 - 127) << 23) + (1u << (22 - mbits)) - 1)));
+    normal = _mm_srl_epi32(_mm_add_epi32(normal, odd), shift);
+    return _mm_or_si128(_mm_and_si128(isdenormal, denormal), _mm_andnot_si128(isdenormal, normal));
+}
+
+static MOJODDS_TARGET("sse2") void float_to_r11g11b10f_sse2(const uint8 *src, uint8 *dst, size_t count)
+{
+    const __m128 max11 = _mm_set1_ps(UFLOAT11_MAX);
+    __m128 rgb[3];
+
+    for (; count >= 4; count -= 4, src += 64, dst += 16) {
+        __m128i out;
+        sse2_load_rgb(src, max11, rgb);
+        rgb[2] = _mm_min_ps(rgb[2], _mm_set1_ps(UFLOAT10_MAX));
+        out = sse2_pack_ufloat(rgb[0], 6);
+        out = _mm_or_si128(out, _mm_slli_epi32(sse2_pack_ufloat(rgb[1], 6), 11));
+        out = _mm_or_si128(out, _mm_slli_epi32(sse2_pack_ufloat(rgb[2], 5), 22));
+        _mm_storeu_si128((__m128i *) dst, out);
+    }
+    float_to_r11g11b10f_scalar(src, dst, count);
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+
+#ifdef MOJODDS_HAVE_NEON
+
+static void half_to_float_neon(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count >= 4; count -= 4, src += 8, dst += 16) {
+        const float16x4_t h = vreinterpret_f16_u16(vld1_u16((const uint16 *) src));
+        vst1q_f32((float *) dst, vcvt_f32_f16(h));
+    }
+    half_to_float_scalar(src, dst, count);
+}
+
+static void float_to_half_neon(const uint8 *src, uint8 *dst, size_t count)
+{
+    for (; count >= 4; count -= 4, src += 16, dst += 8) {
+        const float16x4_t h = vcvt_f16_f32(vld1q_f32((const float *) src));
+        vst1_u16((uint16 *) dst, vreinterpret_u16_f16(h));
+    }
+    float_to_half_scalar(src, dst, count);
+}
+
+// Same as sse2_load_rgb(); vld4 does the transpose. vmax would keep NaNs,
+//  so they're masked off with a compare first.
+static void neon_load_rgb(const uint8 *src, const float32x4_t max, float32x4_t rgb[3])
+{
+    const float32x4x4_t px = vld4q_f32((const float *) src);
+    int i;
+    for (i = 0; i < 3; i++) {
+        const uint32x4_t positive = vcgtq_f32(px.val[i], vdupq_n_f32(0.0f));
+        const float32x4_t v = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(px.val[i]), positive));
+        rgb[i] = vminq_f32(v, max);
+    }
+}
+
+static void float_to_rgbe_neon(const uint8 *src, uint8 *dst, size_t count)
+{
+    const float32x4_t max = vreinterpretq_f32_u32(vdupq_n_u32(0x7EFFFFFF));
+    float32x4_t rgb[3];
+
+    for (; count >= 4; count -= 4, src += 64, dst += 16) {
+        float32x4_t m, scale;
+        uint32x4_t exponent, nonzero, out;
+
+        neon_load_rgb(src, max, rgb);
+        m = vmaxq_f32(rgb[0], vmaxq_f32(rgb[1], rgb[2]));
+        nonzero = vcgeq_f32(m, vdupq_n_f32(RGBE_MIN));
+        exponent = vshrq_n_u32(vreinterpretq_u32_f32(m), 23);
+        scale = vreinterpretq_f32_u32(vshlq_n_u32(vsubq_u32(vdupq_n_u32(261), exponent), 23));
+
+        out = vcvtq_u32_f32(vmulq_f32(rgb[0], scale));
+        out = vorrq_u32(out, vshlq_n_u32(vcvtq_u32_f32(vmulq_f32(rgb[1], scale)), 8));
+        out = vorrq_u32(out, vshlq_n_u32(vcvtq_u32_f32(vmulq_f32(rgb[2], scale)), 16));
+        out = vorrq_u32(out, vshlq_n_u32(vaddq_u32(exponent, vdupq_n_u32(2)), 24));
+        vst1q_u8(dst, vreinterpretq_u8_u32(vandq_u32(out, nonzero)));
+    }
+    float_to_rgbe_scalar(src, dst, count);
+}
+
+static uint32x4_t neon_pack_ufloat(const float32x4_t x, const int mbits)
+{
+    const int32x4_t shift = vdupq_n_s32(-(23 - mbits));  // negative shifts right.
+    const uint32x4_t bits = vreinterpretq_u32_f32(x);
+    const float32x4_t magic = vreinterpretq_f32_u32(vdupq_n_u32((uint32) (136 - mbits) << 23));
+    const uint32x4_t denormal = vsubq_u32(vreinterpretq_u32_f32(vaddq_f32(x, magic)), vreinterpretq_u32_f32(magic));
+    const uint32x4_t isdenormal = vcltq_u32(bits, vdupq_n_u32(113u << 23));
+    const uint32x4_t odd = vandq_u32(vshlq_u32(bits, shift), vdupq_n_u32(1));
+    uint32x4_t normal = vaddq_u32(bits, vdupq_n_u32(((uint32) (15 - 127) << 23) + (1u << (22 - mbits)) - 1));
+    normal = vshlq_u32(vaddq_u32(normal, odd), shift);
+    return vbslq_u32(isdenormal, denormal, normal);
+}
+
+static void float_to_r11g11b10f_neon(const uint8 *src, uint8 *dst, size_t count)
+{
+    const float32x4_t max11 = vdupq_n_f32(UFLOAT11_MAX);
+    float32x4_t rgb[3];
+
+    for (; count >= 4; count -= 4, src += 64, dst += 16) {
+        uint32x4_t out;
+        neon_load_rgb(src, max11, rgb);
+        rgb[2] = vminq_f32(rgb[2], vdupq_n_f32(UFLOAT10_MAX));
+        out = neon_pack_ufloat(rgb[0], 6);
+        out = vorrq_u32(out, vshlq_n_u32(neon_pack_ufloat(rgb[1], 6), 11));
+        out = vorrq_u32(out, vshlq_n_u32(neon_pack_ufloat(rgb[2], 5), 22));
+        vst1q_u8(dst, vreinterpretq_u8_u32(out));
+    }
+    float_to_r11g11b10f_scalar(src, dst, count);
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+#ifdef MOJODDS_HAVE_X86
+#define SSE2_KERNEL(fn) fn
+#define F16C_KERNEL(fn) fn
+#else
+#define SSE2_KERNEL(fn) NULL
+#define F16C_KERNEL(fn) NULL
+#endif
+#ifdef MOJODDS_HAVE_NEON
+#define NEON_KERNEL(fn) fn
+#else
+#define NEON_KERNEL(fn) NULL
+#endif
+
+typedef struct
+{
+    size_t srcSize;  // bytes per value or pixel.
+    size_t dstSize;
+    float_fn scalar;
+    float_fn sse2;
+    float_fn f16c;
+    float_fn neon;
+} FloatKernel;
+
+enum { HALF_TO_FLOAT, FLOAT_TO_HALF, FLOAT_TO_RGBE, FLOAT_TO_R11G11B10F };
+
+static const FloatKernel FloatKernels[] =
+{
+    { 2, 4, half_to_float_scalar, NULL, F16C_KERNEL(half_to_float_f16c), NEON_KERNEL(half_to_float_neon) },
+    { 4, 2, float_to_half_scalar, NULL, F16C_KERNEL(float_to_half_f16c), NEON_KERNEL(float_to_half_neon) },
+    { 16, 4, float_to_rgbe_scalar, SSE2_KERNEL(float_to_rgbe_sse2), NULL, NEON_KERNEL(float_to_rgbe_neon) },
+    { 16, 4, float_to_r11g11b10f_scalar, SSE2_KERNEL(float_to_r11g11b10f_sse2), NULL, NEON_KERNEL(float_to_r11g11b10f_neon) }
+};
+
+static float_fn pick_kernel(const FloatKernel *kernel)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    if ((cpu & MOJODDS_CPU_F16C) && (kernel->f16c != NULL)) {
+        return kernel->f16c;
+    } else if ((cpu & MOJODDS_CPU_SSE2) && (kernel->sse2 != NULL)) {
+        return kernel->sse2;
+    } else if ((cpu & MOJODDS_CPU_NEON) && (kernel->neon != NULL)) {
+        return kernel->neon;
+    }
+    return kernel->scalar;
+}
+
+
+// Chunks of 64k values or pixels, like the bands MOJODDS_decode() uses.
+#define FLOAT_CHUNK 65536
+
+typedef struct
+{
+    float_fn fn;
+    const uint8 *src;
+    uint8 *dst;
+    size_t count;
+    size_t srcSize;
+    size_t dstSize;
+} FloatJob;
+
+static void float_chunk(void *data, unsigned int chunk)
+{
+    const FloatJob *job = (const FloatJob *) data;
+    const size_t first = ((size_t) chunk) * FLOAT_CHUNK;
+    job->fn(job->src + (first * job->srcSize), job->dst + (first * job->dstSize),
+            MIN(FLOAT_CHUNK, job->count - first));
+}
+
+static int convert_floats(const int which, const void *_src, void *_dst,
+                          unsigned long count, MOJODDS_ThreadPool *pool)
+{
+    const FloatKernel *kernel = &FloatKernels[which];
+    FloatJob job;
+
+    if ((_src == NULL) || (_dst == NULL) || (count == 0)) {
+        return 0;
+    } else if ((((uint64) count) / FLOAT_CHUNK) >= 0xFFFFFFFF) {
+        return 0;  // more chunks than we can count.
+    }
+
+    memset(&job, '\0', sizeof (job));
+    job.fn = pick_kernel(kernel);
+    job.src = (const uint8 *) _src;
+    job.dst = (uint8 *) _dst;
+    job.count = (size_t) count;
+    job.srcSize = kernel->srcSize;
+    job.dstSize = kernel->dstSize;
+    mojodds_parallel_for(pool, (unsigned int) ((job.count + FLOAT_CHUNK - 1) / FLOAT_CHUNK), float_chunk, &job);
+    return 1;
+}
+
+int MOJODDS_halfToFloat(const void *_src, void *_dst, unsigned long count,
+                        MOJODDS_ThreadPool *pool)
+{
+    return convert_floats(HALF_TO_FLOAT, _src, _dst, count, pool);
+}
+
+int MOJODDS_floatToHalf(const void *_src, void *_dst, unsigned long count,
+                        MOJODDS_ThreadPool *pool)
+{
+    return convert_floats(FLOAT_TO_HALF, _src, _dst, count, pool);
+}
+
+int MOJODDS_floatToRGBE(const void *_src, void *_dst, unsigned long count,
+                        MOJODDS_ThreadPool *pool)
+{
+    return convert_floats(FLOAT_TO_RGBE, _src, _dst, count, pool);
+}
+
+int MOJODDS_floatToR11G11B10F(const void *_src, void *_dst, unsigned long count,
+                              MOJODDS_ThreadPool *pool)
+{
+    return convert_floats(FLOAT_TO_R11G11B10F, _src, _dst, count, pool);
+}
+
+// end of mojodds_float.c ...
+
@@ -0,0 +1,173 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// This is stuff shared between the .c files; apps shouldn't include it.
+
+#ifndef _INCL_MOJODDS_INTERNAL_H_
+#define _INCL_MOJODDS_INTERNAL_H_
+
+#include <stddef.h>
+
+#ifdef _MSC_VER
+typedef unsigned __int8 uint8;
+typedef unsigned __int16 uint16;
+typedef unsigned __int32 uint32;
+typedef unsigned __int64 uint64;
+typedef __int32 sint32;
+#else
+#include <stdint.h>
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int32_t sint32;
+#endif
+
+#ifndef UINT32_MAX
+#define UINT32_MAX 0xFFFFFFFF
+#endif
+
+#define STATICARRAYLEN(x) ( (sizeof ((x))) / (sizeof ((x)[0])) )
+
+#define MAX( a, b ) ((a) > (b) ? (a) : (b))
+#define MIN( a, b ) ((a) < (b) ? (a) : (b))
+
+#define GL_UNSIGNED_BYTE 0x1401
+#define GL_UNSIGNED_SHORT 0x1403
+#define GL_FLOAT 0x1406
+#define GL_HALF_FLOAT 0x140B
+#define GL_RED 0x1903
+#define GL_ALPHA 0x1906
+#define GL_RGB 0x1907
+#define GL_RGBA 0x1908
+#define GL_LUMINANCE 0x1909
+#define GL_LUMINANCE_ALPHA 0x190A
+#define GL_ALPHA8 0x803C
+#define GL_LUMINANCE8 0x8040
+#define GL_LUMINANCE16 0x8042
+#define GL_LUMINANCE4_ALPHA4 0x8043
+#define GL_RGB4 0x804F
+#define GL_RGB5 0x8050
+#define GL_RGB8 0x8051
+#define GL_RGBA4 0x8056
+#define GL_RGB5_A1 0x8057
+#define GL_RGBA8 0x8058
+#define GL_RGB10_A2 0x8059
+#define GL_RGBA16 0x805B
+#define GL_LUMINANCE8_ALPHA8 0x8045
+#define GL_BGR 0x80E0
+#define GL_BGRA 0x80E1
+#define GL_RG 0x8227
+#define GL_R8 0x8229
+#define GL_RG8 0x822B
+#define GL_R16F 0x822D
+#define GL_R32F 0x822E
+#define GL_RG16F 0x822F
+#define GL_RG32F 0x8230
+#define GL_UNSIGNED_SHORT_5_6_5 0x8363
+#define GL_UNSIGNED_SHORT_4_4_4_4_REV 0x8365
+#define GL_UNSIGNED_SHORT_1_5_5_5_REV 0x8366
+#define GL_UNSIGNED_INT_2_10_10_10_REV 0x8368
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_RGBA32F 0x8814
+#define GL_RGBA16F 0x881A
+#define GL_R11F_G11F_B10F 0x8C3A
+#define GL_UNSIGNED_INT_10F_11F_11F_REV 0x8C3B
+#define GL_SRGB8_ALPHA8 0x8C43
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#define GL_RGB565 0x8D62
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#define GL_COMPRESSED_SIGNED_RED_RGTC1 0x8DBC
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#define GL_COMPRESSED_SIGNED_RG_RGTC2 0x8DBE
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+
+// SIMD support. Kernels are compiled for their instruction set with a
+//  per-function target attribute and picked at runtime, so the library
+//  itself still builds with the compiler's default flags.
+#ifndef MOJODDS_NO_SIMD
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MOJODDS_HAVE_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MOJODDS_HAVE_NEON 1
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MOJODDS_TARGET(x)
+#else
+#define MOJODDS_TARGET(x) __attribute__((target(x)))
+#endif
+
+#define MOJODDS_CPU_SSE2 (1 << 0)
+#define MOJODDS_CPU_AVX2 (1 << 1)
+#define MOJODDS_CPU_NEON (1 << 2)
+#define MOJODDS_CPU_F16C (1 << 3)  // with AVX, which it needs.
+
+// Instruction sets we may use right now; zero if MOJODDS_useSIMD(0).
+unsigned int mojodds_cpu_features(void);
+
+// CPUs online, at least 1. In mojodds_platform.c.
+unsigned int mojodds_cpu_count(void);
+
+// Call fn(data, i) for every i in [0, count), spread across pool's threads
+//  and the calling thread. Returns when all calls are done. A NULL pool runs
+//  everything on the calling thread.
+typedef void (*mojodds_parallel_fn)(void *data, unsigned int index);
+void mojodds_parallel_for(MOJODDS_ThreadPool *pool, unsigned int count,
+                          mojodds_parallel_fn fn, void *data);
+
+// Nonzero if bitCount is 8, 16, 24 or 32 and the R, G, B, A masks are
+//  contiguous, don't overlap and fit in it, with at least one color mask.
+//  In mojodds.c.
+int mojodds_check_masks(uint32 bitCount, const uint32 *masks);
+
+// Fill in layout's mips and facelen from its w, h, depth, miplevels,
+//  blockDim and blockSize. Zero if the chain wouldn't fit in 32 bits.
+//  In mojodds.c.
+int mojodds_calc_mips(MOJODDS_Layout *layout);
+
+// Block decoders: decode (blocks) horizontally-adjacent blocks at src into a
+//  strip of pixels four rows tall at dst. Rows of dst are (pitch) bytes apart.
+typedef void (*mojodds_decode_fn)(const uint8 *src, unsigned int blocks,
+                                  uint8 *dst, size_t pitch);
+
+// IEEE half float conversions, rounding to nearest even like F16C and NEON
+//  do. In mojodds_float.c.
+float mojodds_half_to_float(uint16 h);
+uint16 mojodds_float_to_half(float f);
+
+// BPTC kernels, in mojodds_bptc.c.
+void mojodds_decode_bc7_scalar(const uint8 *src, unsigned int blocks,
+                               uint8 *dst, size_t pitch);
+void mojodds_decode_bc6h_uf16_half(const uint8 *src, unsigned int blocks,
+                                   uint8 *dst, size_t pitch);
+void mojodds_decode_bc6h_sf16_half(const uint8 *src, unsigned int blocks,
+                                   uint8 *dst, size_t pitch);
+void mojodds_decode_bc6h_uf16_float(const uint8 *src, unsigned int blocks,
+                                    uint8 *dst, size_t pitch);
+void mojodds_decode_bc6h_sf16_float(const uint8 *src, unsigned int blocks,
+                                    uint8 *dst, size_t pitch);
+#ifdef MOJODDS_HAVE_X86
+void mojodds_decode_bc7_sse2(const uint8 *src, unsigned int blocks,
+                             uint8 *dst, size_t pitch);
+#endif
+#ifdef MOJODDS_HAVE_NEON
+void mojodds_decode_bc7_neon(const uint8 *src, unsigned int blocks,
+                             uint8 *dst, size_t pitch);
+#endif
+
+#endif
+
+/* end of mojodds_internal.h ... */
+
@@ -0,0 +1,1009 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Asynchronous loading, and the MOJODDS_*Loader() and MOJODDS_load() entry
+//  points.
+//
+// Every request goes through the same three steps: read the first
+//  MOJODDS_HEADER_MAXLEN bytes, check them and plan the read with
+//  MOJODDS_planMipLoad(), then read the planned ranges back to back into the
+//  staging buffer. Requests that haven't started wait in a heap, ordered by
+//  firstmip and then submission order.
+//
+// The io_uring backend runs all of that on one thread, with up to
+//  queuedepth reads in flight; once a request's headers are in, its data
+//  reads go ahead of headers for requests that haven't started. We talk to
+//  the kernel with raw syscalls so there's no liburing to link. A read on
+//  an eventfd sits in the ring so MOJODDS_load() can wake the thread while
+//  it's waiting for completions. If the kernel won't give us a ring (too
+//  old, or a seccomp filter says no), or off Linux, a pool of threads does
+//  each request start to finish with pread().
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__) && !defined(MOJODDS_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define MOJODDS_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+#include "mojodds_thread.h"
+
+// Keeps a single read under 2GB, which is all some kernels will do at once.
+#define MAX_READ 0x40000000
+
+typedef struct LoadJob
+{
+    MOJODDS_LoadRequest req;
+    uint64 seq;  // submission order, to break ties.
+    int fd;
+    int ownfd;  // we opened fd from req.path, so we close it.
+    uint64 base;  // where the DDS file starts in fd.
+    uint64 filelen;
+    uint8 header[MOJODDS_HEADER_MAXLEN];
+    uint32 headerlen;
+    MOJODDS_Layout layout;  // the planned one, once the headers are in.
+    MOJODDS_ByteRange *ranges;
+    unsigned int numranges;
+    uint8 *buffer;
+    MOJODDS_error err;
+#ifdef MOJODDS_HAVE_IO_URING
+    unsigned int nextrange;  // first range not completely submitted.
+    uint64 nextoffset;  // bytes of it that are.
+    uint8 *nextdst;
+    unsigned int inflight;
+    int queued;  // on the ring's ready list.
+    struct LoadJob *next;
+#endif
+} LoadJob;
+
+#ifdef MOJODDS_HAVE_IO_URING
+typedef struct RingOp
+{
+    LoadJob *job;  // NULL for the eventfd read.
+    uint64 offset;
+    uint8 *dst;
+    size_t len;
+    struct iovec iov;
+    struct RingOp *next;
+} RingOp;
+
+typedef struct Ring
+{
+    int fd;
+    int wakefd;
+    uint64 wakebuf;
+    void *sqmap;
+    size_t sqmaplen;
+    void *cqmap;
+    size_t cqmaplen;
+    struct io_uring_sqe *sqes;
+    size_t sqeslen;
+    unsigned int *sqhead;
+    unsigned int *sqtail;
+    unsigned int sqmask;
+    unsigned int *sqarray;
+    unsigned int *cqhead;
+    unsigned int *cqtail;
+    unsigned int cqmask;
+    struct io_uring_cqe *cqes;
+    unsigned int tosubmit;  // queued since the last io_uring_enter().
+    RingOp *ops;  // queuedepth of them, then one for the eventfd.
+    unsigned int numops;
+    RingOp *freeops;
+    LoadJob *readyhead;  // started jobs with data left to queue.
+    LoadJob *readytail;
+} Ring;
+#endif
+
+struct MOJODDS_Loader
+{
+    Mutex lock;
+    Cond wake;  // pread workers sleep on this until there's a job (or quit).
+    Cond idle;  // MOJODDS_waitLoader() sleeps on this.
+    LoadJob **heap;
+    unsigned int heaplen;
+    unsigned int heapcap;
+    uint64 nextseq;
+    unsigned int outstanding;  // submitted but not called back yet.
+    int quit;
+    unsigned int numthreads;
+    Thread *threads;
+#ifdef MOJODDS_HAVE_IO_URING
+    Ring *ring;  // NULL if the workers use pread().
+#endif
+};
+
+
+// Higher firstmip goes first, then whoever asked first.
+static int job_before(const LoadJob *a, const LoadJob *b)
+{
+    if (a->req.firstmip != b->req.firstmip) {
+        return a->req.firstmip > b->req.firstmip;
+    }
+    return a->seq < b->seq;
+}
+
+// Call with the loader locked.
+static int heap_push(MOJODDS_Loader *loader, LoadJob *job)
+{
+    unsigned int i;
+
+    if (loader->heaplen == loader->heapcap) {
+        const unsigned int cap = loader->heapcap ? (loader->heapcap * 2) : 64;
+        LoadJob **heap = (LoadJob **) realloc(loader->heap, sizeof (LoadJob *) * cap);
+        if (heap == NULL) {
+            return 0;
+        }
+        loader->heap = heap;
+        loader->heapcap = cap;
+    }
+
+    i = loader->heaplen++;
+    while (i > 0) {
+        const unsigned int parent = (i - 1) / 2;
+        if (!job_before(job, loader->heap[parent])) {
+            break;
+        }
+        loader->heap[i] = loader->heap[parent];
+        i = parent;
+    }
+    loader->heap[i] = job;
+    return 1;
+}
+
+// Call with the loader locked. NULL if there's nothing waiting.
+static LoadJob *heap_pop(MOJODDS_Loader *loader)
+{
+    LoadJob *retval;
+    LoadJob *last;
+    unsigned int i = 0;
+
+    if (loader->heaplen == 0) {
+        return NULL;
+    }
+
+    retval = loader->heap[0];
+    last = loader->heap[--loader->heaplen];
+    while (1) {
+        unsigned int child = (i * 2) + 1;
+        if (child >= loader->heaplen) {
+            break;
+        } else if ((child + 1 < loader->heaplen) &&
+                   job_before(loader->heap[child + 1], loader->heap[child])) {
+            child++;
+        }
+        if (!job_before(loader->heap[child], last)) {
+            break;
+        }
+        loader->heap[i] = loader->heap[child];
+        i = child;
+    }
+    if (loader->heaplen > 0) {
+        loader->heap[i] = last;
+    }
+    return retval;
+}
+
+
+#ifdef _WIN32
+#define close_fd(fd) _close(fd)
+#else
+#define close_fd(fd) close(fd)
+#endif
+
+// Opens the file if need be and works out how much of fd is ours.
+static int job_open(LoadJob *job)
+{
+    uint64 size;
+#ifdef _WIN32
+    struct _stati64 statbuf;
+#else
+    struct stat statbuf;
+#endif
+
+    if (job->req.path != NULL) {
+#ifdef _WIN32
+        job->fd = _open(job->req.path, _O_RDONLY | _O_BINARY);
+#else
+        job->fd = open(job->req.path, O_RDONLY);
+#endif
+        if (job->fd == -1) {
+            job->err = MOJODDS_ERR_IO;
+            return 0;
+        }
+        job->ownfd = 1;
+    }
+
+    if (job->req.len != 0) {
+        job->filelen = job->req.len;
+        return 1;
+    }
+
+#ifdef _WIN32
+    if (_fstati64(job->fd, &statbuf) == -1) {
+#else
+    if (fstat(job->fd, &statbuf) == -1) {
+#endif
+        job->err = MOJODDS_ERR_IO;
+        return 0;
+    }
+
+    size = (uint64) statbuf.st_size;
+    if (job->base > size) {
+        job->err = MOJODDS_ERR_IO;
+        return 0;
+    }
+    job->filelen = size - job->base;
+    return 1;
+}
+
+// Bytes of header to read: all of them, unless the file is shorter.
+static uint32 job_header_len(const LoadJob *job)
+{
+    return (uint32) MIN(job->filelen, (uint64) MOJODDS_HEADER_MAXLEN);
+}
+
+// Headers are in; check them, plan the read and find somewhere to put it.
+static int job_plan(LoadJob *job)
+{
+    MOJODDS_Layout full;
+    const MOJODDS_MipLevel *first;
+    unsigned long needed = 0;
+    unsigned int i;
+
+    job->err = MOJODDS_validate(job->header, job->headerlen,
+                                (unsigned long) MIN(job->filelen, (uint64) ULONG_MAX),
+                                &full);
+    if (job->err != MOJODDS_ERR_NONE) {
+        return 0;
+    }
+
+    // One range per face is always enough.
+    job->ranges = (MOJODDS_ByteRange *) malloc(sizeof (MOJODDS_ByteRange) * full.faces);
+    if (job->ranges == NULL) {
+        job->err = MOJODDS_ERR_NO_BUFFER;
+        return 0;
+    }
+
+    first = &full.mips[MIN(job->req.firstmip, full.miplevels - 1)];
+    if (!MOJODDS_planMipLoad(&full, MAX(MAX(first->w, first->h), first->d), 0,
+                             job->ranges, full.faces, &job->numranges,
+                             &job->layout)) {
+        job->err = MOJODDS_ERR_BAD_HEADER;  // can't happen for a valid layout.
+        return 0;
+    }
+
+    for (i = 0; i < job->numranges; i++) {
+        needed += job->ranges[i].len;
+    }
+
+    if (job->req.buffer != NULL) {
+        job->buffer = (uint8 *) job->req.buffer;
+        if (job->req.bufferlen < needed) {
+            job->err = MOJODDS_ERR_NO_BUFFER;
+            return 0;
+        }
+    } else if (job->req.bufferfn != NULL) {
+        job->buffer = (uint8 *) job->req.bufferfn(job->req.userdata, &job->layout, needed);
+    }
+
+    if (job->buffer == NULL) {
+        job->err = MOJODDS_ERR_NO_BUFFER;
+        return 0;
+    }
+
+    job->layout.tex = job->buffer;
+    return 1;
+}
+
+// Call back and forget about it. Call with the loader unlocked.
+static void job_finish(MOJODDS_Loader *loader, LoadJob *job)
+{
+    if (job->ownfd) {
+        close_fd(job->fd);
+    }
+
+    job->req.callback(job->req.userdata, job->err,
+                      (job->err == MOJODDS_ERR_NONE) ? &job->layout : NULL,
+                      job->buffer);
+
+    free(job->ranges);
+    free(job);
+
+    mutex_lock(&loader->lock);
+    if (--loader->outstanding == 0) {
+        cond_broadcast(&loader->idle);
+    }
+    mutex_unlock(&loader->lock);
+}
+
+
+// Read len bytes at offset of fd, all of them, or fail.
+static int read_at(const int fd, uint64 offset, uint8 *dst, uint64 len)
+{
+    while (len > 0) {
+        const unsigned int cpy = (unsigned int) MIN(len, (uint64) MAX_READ);
+#ifdef _WIN32
+        OVERLAPPED ov;
+        DWORD rc = 0;
+        memset(&ov, '\0', sizeof (ov));
+        ov.Offset = (DWORD) offset;
+        ov.OffsetHigh = (DWORD) (offset >> 32);
+        if (!ReadFile((HANDLE) _get_osfhandle(fd), dst, cpy, &rc, &ov)) {
+            return 0;
+        }
+#else
+        const ssize_t rc = pread(fd, dst, cpy, (off_t) offset);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+#endif
+        if (rc == 0) {
+            return 0;  // file got shorter on us.
+        }
+        offset += (uint64) rc;
+        dst += rc;
+        len -= (uint64) rc;
+    }
+    return 1;
+}
+
+static void run_job_pread(LoadJob *job)
+{
+    uint8 *dst;
+    unsigned int i;
+
+    if (!job_open(job)) {
+        return;
+    }
+
+    job->headerlen = job_header_len(job);
+    if (!read_at(job->fd, job->base, job->header, job->headerlen)) {
+        job->err = MOJODDS_ERR_IO;
+        return;
+    } else if (!job_plan(job)) {
+        return;
+    }
+
+    dst = job->buffer;
+    for (i = 0; i < job->numranges; i++) {
+        const MOJODDS_ByteRange *range = &job->ranges[i];
+        if (!read_at(job->fd, job->base + range->offset, dst, range->len)) {
+            job->err = MOJODDS_ERR_IO;
+            return;
+        }
+        dst += range->len;
+    }
+}
+
+static void pread_loop(MOJODDS_Loader *loader)
+{
+    mutex_lock(&loader->lock);
+    while (1) {
+        LoadJob *job;
+        while ((loader->heaplen == 0) && (!loader->quit)) {
+            cond_wait(&loader->wake, &loader->lock);
+        }
+
+        job = heap_pop(loader);
+        if (job == NULL) {
+            break;  // quitting, and nothing left to do.
+        }
+
+        mutex_unlock(&loader->lock);
+        run_job_pread(job);
+        job_finish(loader, job);
+        mutex_lock(&loader->lock);
+    }
+    mutex_unlock(&loader->lock);
+}
+
+
+#ifdef MOJODDS_HAVE_IO_URING
+static void ring_destroy(Ring *ring)
+{
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqeslen);
+    }
+    if ((ring->cqmap != NULL) && (ring->cqmap != ring->sqmap)) {
+        munmap(ring->cqmap, ring->cqmaplen);
+    }
+    if (ring->sqmap != NULL) {
+        munmap(ring->sqmap, ring->sqmaplen);
+    }
+    if (ring->wakefd != -1) {
+        close(ring->wakefd);
+    }
+    if (ring->fd != -1) {
+        close(ring->fd);
+    }
+    free(ring->ops);
+    free(ring);
+}
+
+static void *ring_map(const int fd, const size_t len, const off_t offset)
+{
+    void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+// NULL if the kernel won't do it; the caller falls back to pread.
+static Ring *ring_create(const unsigned int queuedepth)
+{
+    Ring *ring = (Ring *) calloc(1, sizeof (*ring));
+    struct io_uring_params params;
+    uint8 *sq;
+    uint8 *cq;
+    unsigned int i;
+
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->fd = -1;
+    ring->wakefd = -1;
+    ring->numops = queuedepth + 1;
+    ring->ops = (RingOp *) calloc(ring->numops, sizeof (RingOp));
+    if (ring->ops == NULL) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    // every op in flight has a submission slot; the kernel makes the
+    //  completion queue twice as big, so it can't overflow either.
+    memset(&params, '\0', sizeof (params));
+    ring->fd = (int) syscall(__NR_io_uring_setup, ring->numops, &params);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    ring->sqmaplen = params.sq_off.array + (params.sq_entries * sizeof (unsigned int));
+    ring->cqmaplen = params.cq_off.cqes + (params.cq_entries * sizeof (struct io_uring_cqe));
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sqmaplen = ring->cqmaplen = MAX(ring->sqmaplen, ring->cqmaplen);
+    }
+#endif
+
+    ring->sqmap = ring_map(ring->fd, ring->sqmaplen, IORING_OFF_SQ_RING);
+    if (ring->sqmap == NULL) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cqmap = ring->sqmap;
+    } else
+#endif
+    {
+        ring->cqmap = ring_map(ring->fd, ring->cqmaplen, IORING_OFF_CQ_RING);
+    }
+
+    ring->sqeslen = params.sq_entries * sizeof (struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) ring_map(ring->fd, ring->sqeslen, IORING_OFF_SQES);
+    if ((ring->cqmap == NULL) || (ring->sqes == NULL)) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    sq = (uint8 *) ring->sqmap;
+    cq = (uint8 *) ring->cqmap;
+    ring->sqhead = (unsigned int *) (sq + params.sq_off.head);
+    ring->sqtail = (unsigned int *) (sq + params.sq_off.tail);
+    ring->sqmask = *((unsigned int *) (sq + params.sq_off.ring_mask));
+    ring->sqarray = (unsigned int *) (sq + params.sq_off.array);
+    ring->cqhead = (unsigned int *) (cq + params.cq_off.head);
+    ring->cqtail = (unsigned int *) (cq + params.cq_off.tail);
+    ring->cqmask = *((unsigned int *) (cq + params.cq_off.ring_mask));
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    ring->wakefd = eventfd(0, EFD_CLOEXEC);
+    if (ring->wakefd == -1) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    for (i = 0; i < queuedepth; i++) {
+        ring->ops[i].next = ring->freeops;
+        ring->freeops = &ring->ops[i];
+    }
+
+    return ring;
+}
+
+static void ring_queue(Ring *ring, RingOp *op, const int fd)
+{
+    const unsigned int tail = *ring->sqtail;  // only we write it.
+    const unsigned int index = tail & ring->sqmask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    op->iov.iov_base = op->dst;
+    op->iov.iov_len = MIN(op->len, (size_t) MAX_READ);
+
+    // READV rather than READ, which needs 5.6.
+    memset(sqe, '\0', sizeof (*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = op->offset;
+    sqe->addr = (unsigned long) &op->iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64) (size_t) op;
+
+    ring->sqarray[index] = index;
+    __atomic_store_n(ring->sqtail, tail + 1, __ATOMIC_RELEASE);
+    ring->tosubmit++;
+}
+
+static void ring_queue_wake(Ring *ring)
+{
+    RingOp *op = &ring->ops[ring->numops - 1];
+    op->job = NULL;
+    op->offset = 0;
+    op->dst = (uint8 *) &ring->wakebuf;
+    op->len = sizeof (ring->wakebuf);
+    ring_queue(ring, op, ring->wakefd);
+}
+
+static void ring_queue_read(Ring *ring, LoadJob *job, const uint64 offset,
+                            uint8 *dst, const size_t len)
+{
+    RingOp *op = ring->freeops;
+    ring->freeops = op->next;
+    op->job = job;
+    op->offset = offset;
+    op->dst = dst;
+    op->len = len;
+    job->inflight++;
+    ring_queue(ring, op, job->fd);
+}
+
+static void ring_ready(Ring *ring, LoadJob *job)
+{
+    job->next = NULL;
+    job->queued = 1;
+    if (ring->readytail) {
+        ring->readytail->next = job;
+    } else {
+        ring->readyhead = job;
+    }
+    ring->readytail = job;
+}
+
+// Queue as many data reads as there are free ops, oldest job first.
+static void ring_fill_reads(MOJODDS_Loader *loader, Ring *ring)
+{
+    while ((ring->readyhead != NULL) && (ring->freeops != NULL)) {
+        LoadJob *job = ring->readyhead;
+        if ((job->err == MOJODDS_ERR_NONE) && (job->nextrange < job->numranges)) {
+            const MOJODDS_ByteRange *range = &job->ranges[job->nextrange];
+            const uint64 left = range->len - job->nextoffset;
+            const size_t len = (size_t) MIN(left, (uint64) MAX_READ);
+            ring_queue_read(ring, job, job->base + range->offset + job->nextoffset,
+                            job->nextdst, len);
+            job->nextdst += len;
+            job->nextoffset += len;
+            if (job->nextoffset == range->len) {
+                job->nextrange++;
+                job->nextoffset = 0;
+            }
+            if (job->nextrange < job->numranges) {
+                continue;  // more to queue for this one.
+            }
+        }
+
+        // all queued (or it failed); off the list.
+        ring->readyhead = job->next;
+        if (ring->readyhead == NULL) {
+            ring->readytail = NULL;
+        }
+        job->queued = 0;
+        if (job->inflight == 0) {
+            job_finish(loader, job);  // failed with nothing in flight.
+        }
+    }
+}
+
+// Start jobs off the heap while there are free ops: open, queue the header.
+static void ring_start_jobs(MOJODDS_Loader *loader, Ring *ring)
+{
+    while (ring->freeops != NULL) {
+        LoadJob *job;
+        mutex_lock(&loader->lock);
+        job = heap_pop(loader);
+        mutex_unlock(&loader->lock);
+
+        if (job == NULL) {
+            break;
+        } else if (!job_open(job)) {
+            job_finish(loader, job);
+            continue;
+        }
+
+        job->headerlen = job_header_len(job);
+        if (job->headerlen == 0) {
+            job_plan(job);  // empty; let MOJODDS_validate() say so.
+            job_finish(loader, job);
+            continue;
+        }
+        ring_queue_read(ring, job, job->base, job->header, job->headerlen);
+    }
+}
+
+// An op's read finished with result res: carry on, or finish up its job.
+static void ring_complete(MOJODDS_Loader *loader, Ring *ring, RingOp *op,
+                          const int res)
+{
+    LoadJob *job = op->job;
+
+    if ((res == -EINTR) || (res == -EAGAIN)) {
+        ring_queue(ring, op, job->fd);  // try again.
+        return;
+    } else if (res <= 0) {
+        job->err = MOJODDS_ERR_IO;  // zero means the file got shorter on us.
+    } else if ((size_t) res < op->len) {
+        op->offset += (uint64) res;
+        op->dst += res;
+        op->len -= (size_t) res;
+        if (job->err == MOJODDS_ERR_NONE) {
+            ring_queue(ring, op, job->fd);  // short read; get the rest.
+            return;
+        }
+    }
+
+    op->next = ring->freeops;
+    ring->freeops = op;
+    job->inflight--;
+
+    if ((job->err == MOJODDS_ERR_NONE) && (job->layout.tex == NULL)) {
+        // that was the headers; tex is set once the read is planned.
+        if (job_plan(job)) {
+            job->nextdst = job->buffer;
+            ring_ready(ring, job);
+            return;
+        }
+    }
+
+    if ((job->inflight == 0) && (!job->queued)) {
+        job_finish(loader, job);
+    }
+}
+
+// The ring is unusable: fail every job it started, so the loader still
+//  goes idle, whether it was waiting on reads or waiting to queue them.
+static void ring_fail_jobs(MOJODDS_Loader *loader, Ring *ring)
+{
+    RingOp *op;
+    unsigned int i;
+
+    for (op = ring->freeops; op != NULL; op = op->next) {
+        op->job = NULL;  // so only the ops still in flight name a job.
+    }
+
+    while (ring->readyhead != NULL) {
+        LoadJob *job = ring->readyhead;
+        ring->readyhead = job->next;
+        job->queued = 0;
+        job->err = MOJODDS_ERR_IO;
+        if (job->inflight == 0) {
+            job_finish(loader, job);
+        }
+    }
+    ring->readytail = NULL;
+
+    for (i = 0; i < ring->numops - 1; i++) {
+        LoadJob *job = ring->ops[i].job;
+        if (job != NULL) {
+            ring->ops[i].job = NULL;
+            job->err = MOJODDS_ERR_IO;
+            if ((--job->inflight == 0) && (!job->queued)) {
+                job_finish(loader, job);
+            }
+        }
+    }
+}
+
+static void ring_loop(MOJODDS_Loader *loader)
+{
+    Ring *ring = loader->ring;
+    const RingOp *wakeop = &ring->ops[ring->numops - 1];
+
+    ring_queue_wake(ring);
+
+    while (1) {
+        unsigned int head;
+        long rc;
+
+        // headers of new jobs wait until the ones already started are
+        //  reading, so the jobs the heap said to do first finish first.
+        ring_fill_reads(loader, ring);
+        ring_start_jobs(loader, ring);
+
+        rc = syscall(__NR_io_uring_enter, ring->fd, ring->tosubmit, 1,
+                     IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rc < 0) {
+            if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) {
+                continue;
+            }
+            ring_fail_jobs(loader, ring);
+            pread_loop(loader);  // the ones that haven't started still can.
+            return;
+        }
+        ring->tosubmit -= (unsigned int) rc;
+
+        head = *ring->cqhead;
+        while (head != __atomic_load_n(ring->cqtail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cqmask];
+            RingOp *op = (RingOp *) (size_t) cqe->user_data;
+            const int res = cqe->res;
+            head++;
+            __atomic_store_n(ring->cqhead, head, __ATOMIC_RELEASE);
+
+            if (op == wakeop) {
+                int quit;
+                mutex_lock(&loader->lock);
+                quit = loader->quit;
+                mutex_unlock(&loader->lock);
+                if (quit) {
+                    return;  // the loader is idle; nothing is in flight.
+                }
+                ring_queue_wake(ring);
+            } else {
+                ring_complete(loader, ring, op, res);
+            }
+        }
+    }
+}
+
+static void ring_wake(Ring *ring)
+{
+    const uint64 one = 1;
+    while ((write(ring->wakefd, &one, sizeof (one)) == -1) && (errno == EINTR)) {
+        // try again.
+    }
+}
+#endif
+
+
+static void loader_loop(MOJODDS_Loader *loader)
+{
+#ifdef MOJODDS_HAVE_IO_URING
+    if (loader->ring != NULL) {
+        ring_loop(loader);
+        return;
+    }
+#endif
+    pread_loop(loader);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI loader_thread(LPVOID arg)
+{
+    loader_loop((MOJODDS_Loader *) arg);
+    return 0;
+}
+#else
+static void *loader_thread(void *arg)
+{
+    loader_loop((MOJODDS_Loader *) arg);
+    return NULL;
+}
+#endif
+
+
+MOJODDS_Loader *MOJODDS_createLoader(unsigned int threads,
+                                     unsigned int queuedepth,
+                                     unsigned int flags)
+{
+    MOJODDS_Loader *loader = (MOJODDS_Loader *) calloc(1, sizeof (*loader));
+    unsigned int i;
+
+    if (loader == NULL) {
+        return NULL;
+    }
+
+    if (threads == 0) {
+        threads = mojodds_cpu_count();
+    }
+    if (queuedepth == 0) {
+        queuedepth = 32;
+    }
+
+#ifdef MOJODDS_HAVE_IO_URING
+    if (!(flags & MOJODDS_LOADER_PREAD)) {
+        loader->ring = ring_create(queuedepth);
+        if (loader->ring != NULL) {
+            threads = 1;  // it does all the work.
+        }
+    }
+#else
+    (void) flags;
+#endif
+
+    loader->threads = (Thread *) calloc(threads, sizeof (Thread));
+    if (loader->threads == NULL) {
+#ifdef MOJODDS_HAVE_IO_URING
+        if (loader->ring != NULL) {
+            ring_destroy(loader->ring);
+        }
+#endif
+        free(loader);
+        return NULL;
+    }
+
+    mutex_init(&loader->lock);
+    cond_init(&loader->wake);
+    cond_init(&loader->idle);
+
+    for (i = 0; i < threads; i++) {
+#ifdef _WIN32
+        loader->threads[i] = CreateThread(NULL, 0, loader_thread, loader, 0, NULL);
+        if (loader->threads[i] == NULL) {
+            break;
+        }
+#else
+        if (pthread_create(&loader->threads[i], NULL, loader_thread, loader) != 0) {
+            break;
+        }
+#endif
+        loader->numthreads++;
+    }
+
+    if (loader->numthreads == 0) {
+        MOJODDS_destroyLoader(loader);
+        return NULL;
+    }
+
+    return loader;
+}
+
+const char *MOJODDS_getLoaderBackend(const MOJODDS_Loader *loader)
+{
+#ifdef MOJODDS_HAVE_IO_URING
+    if (loader->ring != NULL) {
+        return "io_uring";
+    }
+#else
+    (void) loader;
+#endif
+    return "pread";
+}
+
+int MOJODDS_load(MOJODDS_Loader *loader, const MOJODDS_LoadRequest *req)
+{
+    LoadJob *job;
+    int wake;
+
+    if ((req == NULL) || (req->callback == NULL)) {
+        return 0;
+    } else if ((req->buffer == NULL) && (req->bufferfn == NULL)) {
+        return 0;  // nowhere to put it.
+    } else if ((req->path == NULL) && (req->fd < 0)) {
+        return 0;
+    }
+
+    job = (LoadJob *) calloc(1, sizeof (*job));
+    if (job == NULL) {
+        return 0;
+    }
+
+    memcpy(&job->req, req, sizeof (*req));
+    job->fd = (req->path != NULL) ? -1 : req->fd;
+    job->base = req->offset;
+
+    mutex_lock(&loader->lock);
+    job->seq = loader->nextseq++;
+    // if others are waiting, the ring is full, and the next completion
+    //  wakes its thread anyhow.
+    wake = (loader->heaplen == 0);
+    if (!heap_push(loader, job)) {
+        mutex_unlock(&loader->lock);
+        free(job);
+        return 0;
+    }
+    loader->outstanding++;
+    cond_signal(&loader->wake);
+    mutex_unlock(&loader->lock);
+
+#ifdef MOJODDS_HAVE_IO_URING
+    if ((loader->ring != NULL) && wake) {
+        ring_wake(loader->ring);
+    }
+#else
+    (void) wake;
+#endif
+    return 1;
+}
+
+void MOJODDS_waitLoader(MOJODDS_Loader *loader)
+{
+    mutex_lock(&loader->lock);
+    while (loader->outstanding > 0) {
+        cond_wait(&loader->idle, &loader->lock);
+    }
+    mutex_unlock(&loader->lock);
+}
+
+void MOJODDS_destroyLoader(MOJODDS_Loader *loader)
+{
+    unsigned int i;
+
+    if (loader == NULL) {
+        return;
+    }
+
+    MOJODDS_waitLoader(loader);
+
+    mutex_lock(&loader->lock);
+    loader->quit = 1;
+    cond_broadcast(&loader->wake);
+    mutex_unlock(&loader->lock);
+
+#ifdef MOJODDS_HAVE_IO_URING
+    if (loader->ring != NULL) {
+        ring_wake(loader->ring);
+    }
+#endif
+
+    for (i = 0; i < loader->numthreads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(loader->threads[i], INFINITE);
+        CloseHandle(loader->threads[i]);
+#else
+        pthread_join(loader->threads[i], NULL);
+#endif
+    }
+
+#ifdef MOJODDS_HAVE_IO_URING
+    if (loader->ring != NULL) {
+        ring_destroy(loader->ring);
+    }
+#endif
+    cond_destroy(&loader->idle);
+    cond_destroy(&loader->wake);
+    mutex_destroy(&loader->lock);
+    free(loader->heap);
+    free(loader->threads);
+    free(loader);
+}
+
+// end of mojodds_loader.c ...
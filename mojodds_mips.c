@@ -0,0 +1,592 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Mipmap generation for the uncompressed 8-bit formats, and the
+//  MOJODDS_generateMips() entry point.
+//
+// Each level is resampled from the one above it with a separable filter, in
+//  floats, four channels to a pixel: first down the columns into a scratch
+//  row, then across it. The SIMD kernels do four channels per instruction
+//  and must add things up in the same order as the scalar ones, so the
+//  results match bit for bit. Converting to and from bytes (and sRGB) and
+//  alpha coverage are scalar.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+#define PI 3.14159265358979323846
+
+// dst = the sum of weights[t] * rows[t][i], for every float in the row.
+typedef void (*mips_vertical_fn)(float *dst, const float * const *rows,
+                                 const float *weights, unsigned int taps,
+                                 unsigned int count);
+
+// dst pixel x = the sum of weights[t] * src pixel index[t], with (taps)
+//  entries of index and weights for each output pixel.
+typedef void (*mips_horizontal_fn)(float *dst, const float *src,
+                                   const unsigned int *index,
+                                   const float *weights, unsigned int taps,
+                                   unsigned int pixels);
+
+
+// Filters...
+
+static double sinc(const double x)
+{
+    return (x == 0.0) ? 1.0 : (sin(PI * x) / (PI * x));
+}
+
+static double bessel_i0(const double x)
+{
+    const double half = x * 0.5;
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+    for (k = 1; k < 32; k++) {
+        term *= half / (double) k;
+        sum += term * term;
+    }
+    return sum;
+}
+
+// Kaiser-windowed sinc, three lobes, alpha 4.
+static double kaiser(const double x)
+{
+    const double width = 3.0;
+    const double alpha = 4.0;
+    if ((x <= -width) || (x >= width)) {
+        return 0.0;
+    }
+    return sinc(x) * bessel_i0(alpha * sqrt(1.0 - ((x / width) * (x / width)))) / bessel_i0(alpha);
+}
+
+static double lanczos3(const double x)
+{
+    if ((x <= -3.0) || (x >= 3.0)) {
+        return 0.0;
+    }
+    return sinc(x) * sinc(x / 3.0);
+}
+
+// Which source pixels, and how much of each, make up each pixel along one
+//  axis of the next level down. Taps past the edge clamp to it.
+typedef struct
+{
+    unsigned int taps;
+    unsigned int *index;
+    float *weights;
+} FilterTable;
+
+static int build_filter_table(FilterTable *table, const unsigned int srclen,
+                              const unsigned int dstlen,
+                              const MOJODDS_mipFilter filter)
+{
+    const double scale = ((double) srclen) / ((double) dstlen);
+    const double radius = (filter == MOJODDS_MIPFILTER_BOX) ? 0.5 : 3.0;
+    const double support = radius * scale;
+    unsigned int i, t;
+
+    table->taps = ((unsigned int) ceil(support * 2.0)) + 2;
+    table->index = (unsigned int *) calloc(((size_t) dstlen) * table->taps, sizeof (unsigned int));
+    table->weights = (float *) calloc(((size_t) dstlen) * table->taps, sizeof (float));
+    if ((table->index == NULL) || (table->weights == NULL)) {
+        free(table->index);
+        free(table->weights);
+        return 0;
+    }
+
+    for (i = 0; i < dstlen; i++) {
+        const double center = (i + 0.5) * scale;
+        const int first = (int) floor(center - support);
+        unsigned int *index = table->index + (i * table->taps);
+        float *weights = table->weights + (i * table->taps);
+        double w[64];
+        double total = 0.0;
+
+        assert(table->taps <= STATICARRAYLEN(w));
+        for (t = 0; t < table->taps; t++) {
+            const int pos = first + (int) t;
+            if (filter == MOJODDS_MIPFILTER_BOX) {
+                // how much of source pixel pos the output pixel covers.
+                const double lo = MAX((double) pos, center - support);
+                const double hi = MIN((double) (pos + 1), center + support);
+                w[t] = (hi > lo) ? (hi - lo) : 0.0;
+            } else {
+                const double x = ((pos + 0.5) - center) / scale;
+                w[t] = (filter == MOJODDS_MIPFILTER_KAISER) ? kaiser(x) : lanczos3(x);
+            }
+            total += w[t];
+            index[t] = (unsigned int) MIN(MAX(pos, 0), ((int) srclen) - 1);
+        }
+
+        for (t = 0; t < table->taps; t++) {
+            weights[t] = (float) (w[t] / total);
+        }
+    }
+    return 1;
+}
+
+static void free_filter_table(FilterTable *table)
+{
+    free(table->index);
+    free(table->weights);
+}
+
+
+// Scalar reference kernels...
+
+static void vertical_scalar(float *dst, const float * const *rows,
+                            const float *weights, unsigned int taps,
+                            unsigned int count)
+{
+    unsigned int i, t;
+    for (i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (t = 0; t < taps; t++) {
+            sum += weights[t] * rows[t][i];
+        }
+        dst[i] = sum;
+    }
+}
+
+static void horizontal_scalar(float *dst, const float *src,
+                              const unsigned int *index, const float *weights,
+                              unsigned int taps, unsigned int pixels)
+{
+    unsigned int x, t, c;
+    for (x = 0; x < pixels; x++, dst += 4, index += taps, weights += taps) {
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (t = 0; t < taps; t++) {
+            const float *px = src + (index[t] * 4);
+            for (c = 0; c < 4; c++) {
+                sum[c] += weights[t] * px[c];
+            }
+        }
+        memcpy(dst, sum, sizeof (sum));
+    }
+}
+
+
+#ifdef MOJODDS_HAVE_X86
+
+static MOJODDS_TARGET("sse2") void vertical_sse2(float *dst,
+                                                 const float * const *rows,
+                                                 const float *weights,
+                                                 unsigned int taps,
+                                                 unsigned int count)
+{
+    unsigned int i, t;
+    for (i = 0; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (t = 0; t < taps; t++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+        }
+        _mm_storeu_ps(dst + i, sum);
+    }
+    assert(i == count);  // rows are whole pixels.
+}
+
+static MOJODDS_TARGET("sse2") void horizontal_sse2(float *dst,
+                                                   const float *src,
+                                                   const unsigned int *index,
+                                                   const float *weights,
+                                                   unsigned int taps,
+                                                   unsigned int pixels)
+{
+    unsigned int x, t;
+    for (x = 0; x < pixels; x++, dst += 4, index += taps, weights += taps) {
+        __m128 sum = _mm_setzero_ps();
+        for (t = 0; t < taps; t++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(src + (index[t] * 4))));
+        }
+        _mm_storeu_ps(dst, sum);
+    }
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+
+#ifdef MOJODDS_HAVE_NEON
+
+// Multiply and add separately; a fused vmla/vfma would round differently
+//  from the scalar code.
+
+static void vertical_neon(float *dst, const float * const *rows,
+                          const float *weights, unsigned int taps,
+                          unsigned int count)
+{
+    unsigned int i, t;
+    for (i = 0; i + 4 <= count; i += 4) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (t = 0; t < taps; t++) {
+            sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(rows[t] + i), weights[t]));
+        }
+        vst1q_f32(dst + i, sum);
+    }
+    assert(i == count);  // rows are whole pixels.
+}
+
+static void horizontal_neon(float *dst, const float *src,
+                            const unsigned int *index, const float *weights,
+                            unsigned int taps, unsigned int pixels)
+{
+    unsigned int x, t;
+    for (x = 0; x < pixels; x++, dst += 4, index += taps, weights += taps) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (t = 0; t < taps; t++) {
+            sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(src + (index[t] * 4)), weights[t]));
+        }
+        vst1q_f32(dst, sum);
+    }
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+// Converting to and from bytes...
+
+static float srgb_to_linear(const float v)
+{
+    return (v <= 0.04045f) ? (v / 12.92f) : (float) pow((v + 0.055) / 1.055, 2.4);
+}
+
+static float linear_to_srgb(const float v)
+{
+    return (v <= 0.0031308f) ? (v * 12.92f) : (float) ((1.055 * pow(v, 1.0 / 2.4)) - 0.055);
+}
+
+// linear to sRGB through a table, interpolating between its entries;
+//  table[i] is linear_to_srgb(i / SRGB_STEPS).
+#define SRGB_STEPS 4096
+
+static float table_to_srgb(const float *table, const float v)
+{
+    float pos, frac;
+    int i;
+
+    if (v <= 0.0f) {
+        return 0.0f;
+    } else if (v >= 1.0f) {
+        return 1.0f;
+    }
+    pos = v * SRGB_STEPS;
+    i = (int) pos;
+    frac = pos - (float) i;
+    return table[i] + ((table[i + 1] - table[i]) * frac);
+}
+
+static uint8 to_byte(const float v)
+{
+    if (v <= 0.0f) {
+        return 0;
+    } else if (v >= 1.0f) {
+        return 0xFF;
+    }
+    return (uint8) ((v * 255.0f) + 0.5f);
+}
+
+// Where each float channel comes from in a pixel of glfmt; -1 for none.
+//  Color goes in 0-2 and alpha in 3, whatever order the bytes are in.
+static int channel_map(const uint32 glfmt, int map[4])
+{
+    switch (glfmt) {
+        case GL_BGRA: map[0] = 0; map[1] = 1; map[2] = 2; map[3] = 3; return 4;
+        case GL_BGR: map[0] = 0; map[1] = 1; map[2] = 2; map[3] = -1; return 3;
+        case GL_LUMINANCE_ALPHA: map[0] = 0; map[1] = -1; map[2] = -1; map[3] = 1; return 2;
+        case GL_LUMINANCE8: map[0] = 0; map[1] = -1; map[2] = -1; map[3] = -1; return 1;
+        case GL_ALPHA8: map[0] = -1; map[1] = -1; map[2] = -1; map[3] = 0; return 1;
+    }
+    return 0;
+}
+
+static void unpack_level(float *dst, const uint8 *src, const size_t pixels,
+                         const int map[4], const int bpp, const float *lut)
+{
+    size_t i;
+    int c;
+    for (i = 0; i < pixels; i++, src += bpp, dst += 4) {
+        for (c = 0; c < 4; c++) {
+            if (map[c] < 0) {
+                dst[c] = (c == 3) ? 1.0f : 0.0f;
+            } else {
+                dst[c] = (c == 3) ? (src[map[c]] / 255.0f) : lut[src[map[c]]];
+            }
+        }
+    }
+}
+
+// alphascale is 1 unless we're preserving alpha coverage. srgbtable is NULL
+//  for linear color.
+static void pack_level(uint8 *dst, const float *src, const size_t pixels,
+                       const int map[4], const int bpp,
+                       const float *srgbtable, const float alphascale)
+{
+    size_t i;
+    int c;
+    for (i = 0; i < pixels; i++, src += 4, dst += bpp) {
+        for (c = 0; c < 4; c++) {
+            if (map[c] < 0) {
+                continue;
+            } else if (c == 3) {
+                dst[map[c]] = to_byte(src[c] * alphascale);
+            } else {
+                dst[map[c]] = to_byte(srgbtable ? table_to_srgb(srgbtable, src[c]) : src[c]);
+            }
+        }
+    }
+}
+
+static float alpha_coverage(const float *src, const size_t pixels,
+                            const float ref, const float scale)
+{
+    size_t i, covered = 0;
+    for (i = 0; i < pixels; i++) {
+        if (MIN(src[(i * 4) + 3] * scale, 1.0f) >= ref) {
+            covered++;
+        }
+    }
+    return ((float) covered) / ((float) pixels);
+}
+
+// Binary search for the alpha scale that gets this level's coverage closest
+//  to the top level's, so alpha-tested edges don't thin out as you go down.
+static float coverage_scale(const float *src, const size_t pixels,
+                            const float ref, const float target)
+{
+    float lo = 0.0f;
+    float hi = 4.0f;
+    float best = 1.0f;
+    float besterr = 2.0f;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        const float mid = (lo + hi) * 0.5f;
+        const float coverage = alpha_coverage(src, pixels, ref, mid);
+        const float err = (coverage > target) ? (coverage - target) : (target - coverage);
+        if (err < besterr) {
+            besterr = err;
+            best = mid;
+        }
+        if (coverage < target) {
+            lo = mid;
+        } else if (coverage > target) {
+            hi = mid;
+        } else {
+            break;
+        }
+    }
+    return best;
+}
+
+
+typedef struct
+{
+    mips_vertical_fn vertical;
+    mips_horizontal_fn horizontal;
+    const float *src;
+    unsigned int sw;
+    float *dst;
+    unsigned int dw;
+    unsigned int dh;
+    const FilterTable *xtable;
+    const FilterTable *ytable;
+    float *scratch;  // a row of sw pixels per band.
+    unsigned int rowsPerBand;
+} MipJob;
+
+static void mip_band(void *data, unsigned int band)
+{
+    const MipJob *job = (const MipJob *) data;
+    const unsigned int end = MIN((band + 1) * job->rowsPerBand, job->dh);
+    const size_t srcpitch = ((size_t) job->sw) * 4;
+    float *scratch = job->scratch + (band * srcpitch);
+    const float *rows[64];
+    unsigned int y, t;
+
+    assert(job->ytable->taps <= STATICARRAYLEN(rows));
+    for (y = band * job->rowsPerBand; y < end; y++) {
+        const unsigned int *index = job->ytable->index + (y * job->ytable->taps);
+        for (t = 0; t < job->ytable->taps; t++) {
+            rows[t] = job->src + (index[t] * srcpitch);
+        }
+        job->vertical(scratch, rows, job->ytable->weights + (y * job->ytable->taps),
+                      job->ytable->taps, job->sw * 4);
+        job->horizontal(job->dst + (((size_t) y) * job->dw * 4), scratch,
+                        job->xtable->index, job->xtable->weights,
+                        job->xtable->taps, job->dw);
+    }
+}
+
+// Filter the float level at src (sw*sh) down to dst (dw*dh).
+static int downsample(MipJob *job, const unsigned int sh,
+                      const MOJODDS_mipFilter filter, MOJODDS_ThreadPool *pool)
+{
+    FilterTable xtable, ytable;
+    unsigned int bands;
+
+    if (!build_filter_table(&xtable, job->sw, job->dw, filter)) {
+        return 0;
+    } else if (!build_filter_table(&ytable, sh, job->dh, filter)) {
+        free_filter_table(&xtable);
+        return 0;
+    }
+
+    job->xtable = &xtable;
+    job->ytable = &ytable;
+    // no more than 64 bands, since each needs its own scratch row.
+    job->rowsPerBand = MAX((job->dh + 63) / 64, 1);
+    bands = (job->dh + job->rowsPerBand - 1) / job->rowsPerBand;
+    job->scratch = (float *) malloc(((size_t) bands) * job->sw * 4 * sizeof (float));
+    if (job->scratch != NULL) {
+        mojodds_parallel_for(pool, bands, mip_band, job);
+    }
+
+    free(job->scratch);
+    free_filter_table(&xtable);
+    free_filter_table(&ytable);
+    return (job->scratch != NULL);
+}
+
+unsigned long MOJODDS_getMipChainSize(unsigned int glfmt, unsigned int w,
+                                      unsigned int h, unsigned int miplevels)
+{
+    unsigned int blockDim = 0;
+    unsigned int blockSize = 0;
+    uint64 total = 0;
+    unsigned int i;
+
+    if (!MOJODDS_getFormatInfo(glfmt, &blockDim, &blockSize, NULL, NULL, NULL)) {
+        return 0;
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    }
+
+    for (i = 0; (miplevels == 0) || (i < miplevels); i++) {
+        total += ((uint64) ((w + blockDim - 1) / blockDim)) * ((h + blockDim - 1) / blockDim) * blockSize;
+        if ((miplevels == 0) && (w == 1) && (h == 1)) {
+            break;
+        }
+        w = MAX(w >> 1, 1);
+        h = MAX(h >> 1, 1);
+    }
+
+    return (total > (unsigned long) -1) ? 0 : (unsigned long) total;
+}
+
+int MOJODDS_generateMips(unsigned int glfmt, const void *_tex,
+                         unsigned int w, unsigned int h,
+                         const MOJODDS_MipDesc *desc, void *_dst,
+                         unsigned long _dstlen, unsigned int *_miplevels,
+                         MOJODDS_ThreadPool *pool)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    const unsigned long chainlen = MOJODDS_getMipChainSize(glfmt, w, h, 0);
+    uint8 *dst = (uint8 *) _dst;
+    MipJob job;
+    float lut[256];
+    float srgbtable[SRGB_STEPS + 1];
+    float *levels[2];
+    float target = 0.0f;
+    int map[4];
+    int bpp;
+    unsigned int level, i;
+
+    bpp = channel_map(glfmt, map);
+    if (bpp == 0) {
+        return 0;  // unsupported format.
+    } else if ((chainlen == 0) || (chainlen > _dstlen)) {
+        return 0;  // not enough room for the chain.
+    } else if (((uint64) w) * h * 4 * sizeof (float) > (size_t) -1) {
+        return 0;
+    }
+
+    memset(&job, '\0', sizeof (job));
+    job.vertical = vertical_scalar;
+    job.horizontal = horizontal_scalar;
+#ifdef MOJODDS_HAVE_X86
+    if (cpu & MOJODDS_CPU_SSE2) {
+        job.vertical = vertical_sse2;
+        job.horizontal = horizontal_sse2;
+    }
+#elif defined(MOJODDS_HAVE_NEON)
+    if (cpu & MOJODDS_CPU_NEON) {
+        job.vertical = vertical_neon;
+        job.horizontal = horizontal_neon;
+    }
+#endif
+    (void) cpu;
+
+    // ping-pong between two float levels; the second only ever holds
+    //  level 1 or smaller.
+    levels[0] = (float *) malloc(((size_t) w) * h * 4 * sizeof (float));
+    levels[1] = (float *) malloc(((size_t) MAX(w / 2, 1)) * MAX(h / 2, 1) * 4 * sizeof (float));
+    if ((levels[0] == NULL) || (levels[1] == NULL)) {
+        free(levels[0]);
+        free(levels[1]);
+        return 0;
+    }
+
+    for (i = 0; i < 256; i++) {
+        lut[i] = desc->srgb ? srgb_to_linear(i / 255.0f) : (i / 255.0f);
+    }
+    for (i = 0; desc->srgb && (i <= SRGB_STEPS); i++) {
+        srgbtable[i] = linear_to_srgb(((float) i) / SRGB_STEPS);
+    }
+
+    memmove(dst, _tex, ((size_t) w) * h * bpp);
+    unpack_level(levels[0], dst, ((size_t) w) * h, map, bpp, lut);
+    if ((desc->alphaRef > 0.0f) && (map[3] >= 0)) {
+        target = alpha_coverage(levels[0], ((size_t) w) * h, desc->alphaRef, 1.0f);
+    }
+
+    dst += ((size_t) w) * h * bpp;
+    for (level = 1; (w > 1) || (h > 1); level++) {
+        const unsigned int dw = MAX(w >> 1, 1);
+        const unsigned int dh = MAX(h >> 1, 1);
+        const size_t pixels = ((size_t) dw) * dh;
+        float alphascale = 1.0f;
+
+        job.src = levels[(level - 1) & 1];
+        job.sw = w;
+        job.dst = levels[level & 1];
+        job.dw = dw;
+        job.dh = dh;
+        if (!downsample(&job, h, desc->filter, pool)) {
+            free(levels[0]);
+            free(levels[1]);
+            return 0;
+        }
+
+        if ((desc->alphaRef > 0.0f) && (map[3] >= 0)) {
+            alphascale = coverage_scale(job.dst, pixels, desc->alphaRef, target);
+        }
+        pack_level(dst, job.dst, pixels, map, bpp, desc->srgb ? srgbtable : NULL, alphascale);
+        dst += pixels * bpp;
+        w = dw;
+        h = dh;
+    }
+
+    free(levels[0]);
+    free(levels[1]);
+    if (_miplevels) {
+        *_miplevels = level;
+    }
+    return 1;
+}
+
+// end of mojodds_mips.c ...
+
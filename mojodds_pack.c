@@ -0,0 +1,716 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Texture packs: many DDS files in one, and the MOJODDS_writePack(),
+//  MOJODDS_*Pack() and MOJODDS_*PackEntry() entry points.
+//
+// A pack is a header, an index and then the DDS files themselves, whole and
+//  unchanged, each placed so its pixel data starts on a multiple of the
+//  pack's alignment; mapped at a page boundary, every subresource pointer is
+//  then as aligned as the format allows. The index is one fixed-size entry
+//  per name, sorted by name for a binary search, holding where the file is,
+//  an XXH64 of its bytes, and its layout as MOJODDS_getLayout() would find
+//  it, so a lookup never touches the file's own pages. Files with the same
+//  bytes are only stored once.
+//
+// Everything is little endian. The header is:
+//
+//    0  "MDDSPACK"
+//    8  u32 version (1)
+//   12  u32 entry count
+//   16  u32 alignment
+//   20  u32 mip record count
+//   24  u64 offset of the entries (ENTRY_LEN bytes each)
+//   32  u64 offset of the mip records (MIP_LEN bytes each)
+//   40  u64 offset of the names (NUL-terminated, back to back)
+//   48  u64 length of the names
+//   56  u64 length of the whole pack
+//
+// An entry is:
+//
+//    0  u64 offset of the DDS file      40  u32 name offset
+//    8  u64 its length                  44  u32 name length, without NUL
+//   16  u64 XXH64 of it, seed 0         48  u32 index of its first mip record
+//   24  u64 texlen                      52  u32 dataoffset
+//   32  u64 facelen                     56  u32 glfmt, textureType, w, h,
+//                                               depth, miplevels,
+//                                               arraySize, faces, blockDim,
+//                                               blockSize, bitCount,
+//                                               masks[4] and premultiplied,
+//                                               then zeros to 128.
+//
+// and a mip record is u64 offset, len and slicelen, then u32 w, h, d and a
+//  zero. Nothing in a pack is trusted: opening one checks every entry
+//  against the pack's length, and its mip records against its format and
+//  dimensions, so a bad pack can't send a pointer outside the mapping.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#define PACK_VERSION 1
+#define HEADER_LEN 64
+#define ENTRY_LEN 128
+#define MIP_LEN 40
+
+struct MOJODDS_Pack
+{
+    MOJODDS_File *file;
+    const uint8 *base;
+    uint64 len;
+    uint32 count;
+    uint32 alignment;
+    const uint8 *entries;
+    const uint8 *mips;
+    uint32 nummips;
+    const char *names;
+    uint64 nameslen;
+};
+
+typedef struct PackItem
+{
+    const char *name;
+    size_t namelen;
+    const uint8 *data;
+    uint64 len;
+    uint64 hash;
+    uint64 offset;  // where it goes in the pack.
+    uint32 rank;  // by name.
+    uint32 firstmip;
+    uint32 nameoffset;
+    MOJODDS_Layout layout;
+    struct PackItem *owner;  // the item whose copy of these bytes is stored.
+} PackItem;
+
+
+static uint32 get32(const uint8 *ptr)
+{
+    return (((uint32) ptr[0]) <<  0) | (((uint32) ptr[1]) <<  8) |
+           (((uint32) ptr[2]) << 16) | (((uint32) ptr[3]) << 24) ;
+}
+
+static uint64 get64(const uint8 *ptr)
+{
+    return ((uint64) get32(ptr)) | (((uint64) get32(ptr + 4)) << 32);
+}
+
+static void put32(uint8 *ptr, const uint32 val)
+{
+    ptr[0] = (uint8) (val >>  0);
+    ptr[1] = (uint8) (val >>  8);
+    ptr[2] = (uint8) (val >> 16);
+    ptr[3] = (uint8) (val >> 24);
+}
+
+static void put64(uint8 *ptr, const uint64 val)
+{
+    put32(ptr, (uint32) val);
+    put32(ptr + 4, (uint32) (val >> 32));
+}
+
+
+// XXH64, as specified at https://github.com/Cyan4973/xxHash; it's fast,
+//  and anyone else reading a pack can check the hashes with the reference
+//  code.
+#define XXH_PRIME1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME3 0x165667B19E3779F9ULL
+#define XXH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME5 0x27D4EB2F165667C5ULL
+
+static uint64 xxh_rotl(const uint64 val, const int bits)
+{
+    return (val << bits) | (val >> (64 - bits));
+}
+
+static uint64 xxh_round(uint64 acc, const uint64 input)
+{
+    acc += input * XXH_PRIME2;
+    acc = xxh_rotl(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static uint64 xxh_merge(uint64 acc, const uint64 val)
+{
+    acc ^= xxh_round(0, val);
+    return (acc * XXH_PRIME1) + XXH_PRIME4;
+}
+
+static uint64 xxh64(const uint8 *ptr, const uint64 len)
+{
+    const uint8 *end = ptr + len;
+    uint64 hash;
+
+    if (len >= 32) {
+        const uint8 *limit = end - 32;
+        uint64 v1 = XXH_PRIME1 + XXH_PRIME2;
+        uint64 v2 = XXH_PRIME2;
+        uint64 v3 = 0;
+        uint64 v4 = 0 - XXH_PRIME1;
+        do {
+            v1 = xxh_round(v1, get64(ptr));
+            v2 = xxh_round(v2, get64(ptr + 8));
+            v3 = xxh_round(v3, get64(ptr + 16));
+            v4 = xxh_round(v4, get64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        hash = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+        hash = xxh_merge(hash, v1);
+        hash = xxh_merge(hash, v2);
+        hash = xxh_merge(hash, v3);
+        hash = xxh_merge(hash, v4);
+    } else {
+        hash = XXH_PRIME5;
+    }
+
+    hash += len;
+
+    while (end - ptr >= 8) {
+        hash ^= xxh_round(0, get64(ptr));
+        hash = (xxh_rotl(hash, 27) * XXH_PRIME1) + XXH_PRIME4;
+        ptr += 8;
+    }
+
+    if (end - ptr >= 4) {
+        hash ^= ((uint64) get32(ptr)) * XXH_PRIME1;
+        hash = (xxh_rotl(hash, 23) * XXH_PRIME2) + XXH_PRIME3;
+        ptr += 4;
+    }
+
+    while (ptr < end) {
+        hash ^= ((uint64) *ptr) * XXH_PRIME5;
+        hash = xxh_rotl(hash, 11) * XXH_PRIME1;
+        ptr++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+static int compare_names(const void *_a, const void *_b)
+{
+    const PackItem *a = *((const PackItem * const *) _a);
+    const PackItem *b = *((const PackItem * const *) _b);
+    return strcmp(a->name, b->name);
+}
+
+static int compare_contents(const void *_a, const void *_b)
+{
+    const PackItem *a = *((const PackItem * const *) _a);
+    const PackItem *b = *((const PackItem * const *) _b);
+    if (a->hash != b->hash) {
+        return (a->hash < b->hash) ? -1 : 1;
+    } else if (a->len != b->len) {
+        return (a->len < b->len) ? -1 : 1;
+    }
+    return memcmp(a->data, b->data, (size_t) a->len);
+}
+
+static int write_padding(MOJODDS_WriteFn writefn, void *userdata, uint64 len)
+{
+    static const uint8 zeros[256] = { 0 };
+    while (len > 0) {
+        const size_t cpy = (size_t) MIN(len, sizeof (zeros));
+        if (!writefn(userdata, zeros, (unsigned long) cpy)) {
+            return 0;
+        }
+        len -= cpy;
+    }
+    return 1;
+}
+
+static void serialize_entry(uint8 *ptr, const PackItem *item)
+{
+    const MOJODDS_Layout *layout = &item->layout;
+    unsigned int i;
+
+    memset(ptr, '\0', ENTRY_LEN);
+    put64(ptr + 0, item->owner->offset);
+    put64(ptr + 8, item->len);
+    put64(ptr + 16, item->hash);
+    put64(ptr + 24, layout->texlen);
+    put64(ptr + 32, layout->facelen);
+    put32(ptr + 40, item->nameoffset);
+    put32(ptr + 44, (uint32) item->namelen);
+    put32(ptr + 48, item->firstmip);
+    put32(ptr + 52, (uint32) layout->dataoffset);
+    put32(ptr + 56, layout->glfmt);
+    put32(ptr + 60, (uint32) layout->textureType);
+    put32(ptr + 64, layout->w);
+    put32(ptr + 68, layout->h);
+    put32(ptr + 72, layout->depth);
+    put32(ptr + 76, layout->miplevels);
+    put32(ptr + 80, layout->arraySize);
+    put32(ptr + 84, layout->faces);
+    put32(ptr + 88, layout->blockDim);
+    put32(ptr + 92, layout->blockSize);
+    put32(ptr + 96, layout->bitCount);
+    for (i = 0; i < 4; i++) {
+        put32(ptr + 100 + (i * 4), layout->masks[i]);
+    }
+    put32(ptr + 116, (uint32) layout->premultiplied);
+}
+
+static void serialize_mip(uint8 *ptr, const MOJODDS_MipLevel *mip)
+{
+    put64(ptr + 0, mip->offset);
+    put64(ptr + 8, mip->len);
+    put64(ptr + 16, mip->slicelen);
+    put32(ptr + 24, mip->w);
+    put32(ptr + 28, mip->h);
+    put32(ptr + 32, mip->d);
+    put32(ptr + 36, 0);
+}
+
+int MOJODDS_writePack(const MOJODDS_PackInput *inputs, unsigned int count,
+                      unsigned int alignment, MOJODDS_WriteFn writefn,
+                      void *userdata)
+{
+    PackItem *items = NULL;
+    PackItem **sorted = NULL;
+    uint8 *index = NULL;
+    uint64 entriesoffset;
+    uint64 mipsoffset;
+    uint64 namesoffset;
+    uint64 nameslen = 0;
+    uint64 indexlen;
+    uint64 pos;
+    uint32 nummips = 0;
+    unsigned int i;
+    int retval = 0;
+
+    if (alignment == 0) {
+        alignment = 1;
+    }
+
+    if ((alignment & (alignment - 1)) != 0) {
+        return 0;  // must be a power of two.
+    } else if (alignment > (1 << 30)) {
+        return 0;
+    } else if ((inputs == NULL) && (count > 0)) {
+        return 0;
+    } else if (count > (UINT32_MAX - HEADER_LEN) / ENTRY_LEN) {
+        return 0;
+    }
+
+    items = (PackItem *) calloc(MAX(count, 1), sizeof (PackItem));
+    sorted = (PackItem **) malloc(sizeof (PackItem *) * MAX(count, 1));
+    if ((items == NULL) || (sorted == NULL)) {
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        const MOJODDS_PackInput *input = &inputs[i];
+        PackItem *item = &items[i];
+        if ((input->name == NULL) || (input->name[0] == '\0') || (input->data == NULL)) {
+            goto done;
+        } else if (!MOJODDS_getLayout(input->data, input->len, &item->layout)) {
+            goto done;
+        }
+
+        item->name = input->name;
+        item->namelen = strlen(input->name);
+        item->data = (const uint8 *) input->data;
+        item->len = input->len;
+        item->hash = xxh64(item->data, item->len);
+        item->firstmip = nummips;
+        nummips += item->layout.miplevels;  // at most 32 each, so no overflow.
+        nameslen += item->namelen + 1;
+        if (nameslen > UINT32_MAX) {
+            goto done;  // name offsets are 32 bits.
+        }
+        sorted[i] = item;
+    }
+
+    qsort(sorted, count, sizeof (PackItem *), compare_names);
+    for (i = 0; i < count; i++) {
+        sorted[i]->rank = i;
+    }
+
+    // files with the same bytes share one copy, stored with the first of
+    //  them by name, since that's the order they're written in.
+    qsort(sorted, count, sizeof (PackItem *), compare_contents);
+    for (i = 0; i < count; ) {
+        PackItem *owner = sorted[i];
+        unsigned int end = i + 1;
+        unsigned int j;
+        while ((end < count) && (compare_contents(&sorted[i], &sorted[end]) == 0)) {
+            if (sorted[end]->rank < owner->rank) {
+                owner = sorted[end];
+            }
+            end++;
+        }
+        for (j = i; j < end; j++) {
+            sorted[j]->owner = owner;
+        }
+        i = end;
+    }
+
+    qsort(sorted, count, sizeof (PackItem *), compare_names);  // back again.
+    for (i = 1; i < count; i++) {
+        if (strcmp(sorted[i - 1]->name, sorted[i]->name) == 0) {
+            goto done;  // two files by the same name.
+        }
+    }
+
+    entriesoffset = HEADER_LEN;
+    mipsoffset = entriesoffset + (((uint64) count) * ENTRY_LEN);
+    namesoffset = mipsoffset + (((uint64) nummips) * MIP_LEN);
+    indexlen = namesoffset + nameslen;
+    if (indexlen != (size_t) indexlen) {
+        goto done;
+    }
+
+    index = (uint8 *) calloc(1, (size_t) indexlen);
+    if (index == NULL) {
+        goto done;
+    }
+
+    // lay out the files in name order, each so its pixels are aligned.
+    pos = indexlen;
+    nameslen = 0;
+    for (i = 0; i < count; i++) {
+        PackItem *item = sorted[i];
+        const uint64 dataoffset = item->layout.dataoffset;
+        unsigned int mip;
+
+        if (item->owner == item) {
+            item->offset = (((pos + dataoffset) + alignment - 1) & ~((uint64) alignment - 1)) - dataoffset;
+            pos = item->offset + item->len;
+        }
+
+        item->nameoffset = (uint32) nameslen;
+        memcpy(index + namesoffset + nameslen, item->name, item->namelen + 1);
+        nameslen += item->namelen + 1;
+
+        for (mip = 0; mip < item->layout.miplevels; mip++) {
+            serialize_mip(index + mipsoffset + (((uint64) item->firstmip + mip) * MIP_LEN), &item->layout.mips[mip]);
+        }
+    }
+
+    // owners all have their offsets now.
+    for (i = 0; i < count; i++) {
+        serialize_entry(index + entriesoffset + (((uint64) i) * ENTRY_LEN), sorted[i]);
+    }
+
+    memcpy(index, "MDDSPACK", 8);
+    put32(index + 8, PACK_VERSION);
+    put32(index + 12, count);
+    put32(index + 16, alignment);
+    put32(index + 20, nummips);
+    put64(index + 24, entriesoffset);
+    put64(index + 32, mipsoffset);
+    put64(index + 40, namesoffset);
+    put64(index + 48, nameslen);
+    put64(index + 56, pos);
+
+    if (!writefn(userdata, index, (unsigned long) indexlen)) {
+        goto done;
+    }
+
+    pos = indexlen;
+    for (i = 0; i < count; i++) {
+        const PackItem *item = sorted[i];
+        if (item->owner != item) {
+            continue;
+        } else if (!write_padding(writefn, userdata, item->offset - pos)) {
+            goto done;
+        } else if (!writefn(userdata, item->data, (unsigned long) item->len)) {
+            goto done;
+        }
+        pos = item->offset + item->len;
+    }
+
+    retval = 1;
+
+done:
+    free(index);
+    free(sorted);
+    free(items);
+    return retval;
+}
+
+
+static int check_entry(const MOJODDS_Pack *pack, const uint8 *entry)
+{
+    const uint64 offset = get64(entry + 0);
+    const uint64 len = get64(entry + 8);
+    const uint64 texlen = get64(entry + 24);
+    const uint64 facelen = get64(entry + 32);
+    const uint32 nameoffset = get32(entry + 40);
+    const uint32 namelen = get32(entry + 44);
+    const uint32 firstmip = get32(entry + 48);
+    const uint32 dataoffset = get32(entry + 52);
+    const uint32 glfmt = get32(entry + 56);
+    const uint32 textureType = get32(entry + 60);
+    const uint32 w = get32(entry + 64);
+    const uint32 h = get32(entry + 68);
+    const uint32 depth = get32(entry + 72);
+    const uint32 miplevels = get32(entry + 76);
+    const uint32 arraySize = get32(entry + 80);
+    const uint32 faces = get32(entry + 84);
+    const uint32 blockDim = get32(entry + 88);
+    const uint32 blockSize = get32(entry + 92);
+    const uint64 perElement = (textureType == MOJODDS_TEXTURE_CUBE) ? 6 : 1;
+    unsigned int fmtBlockDim = 0;
+    unsigned int fmtBlockSize = 0;
+    MOJODDS_Layout layout;
+    uint32 i;
+
+    if ((((uint64) nameoffset) + namelen) >= pack->nameslen) {
+        return 0;
+    } else if (pack->names[nameoffset + namelen] != '\0') {
+        return 0;
+    } else if (memchr(pack->names + nameoffset, '\0', namelen) != NULL) {
+        return 0;
+    } else if ((offset > pack->len) || (len > pack->len - offset)) {
+        return 0;
+    } else if ((dataoffset > len) || (texlen > len - dataoffset)) {
+        return 0;
+    } else if ((textureType > MOJODDS_TEXTURE_VOLUME) || (faces == 0)) {
+        return 0;
+    } else if ((facelen > texlen / faces) || (facelen * faces != texlen)) {
+        return 0;
+    } else if ((miplevels == 0) || (miplevels > MOJODDS_MAX_MIPLEVELS)) {
+        return 0;
+    } else if ((miplevels > pack->nummips) || (firstmip > pack->nummips - miplevels)) {
+        return 0;
+    } else if (!MOJODDS_getFormatInfo(glfmt, &fmtBlockDim, &fmtBlockSize, NULL, NULL, NULL)) {
+        return 0;
+    } else if ((blockDim != fmtBlockDim) || (blockSize != fmtBlockSize)) {
+        return 0;
+    } else if ((w == 0) || (h == 0) || (depth == 0) || (arraySize == 0)) {
+        return 0;
+    } else if ((textureType != MOJODDS_TEXTURE_VOLUME) && (depth != 1)) {
+        return 0;
+    } else if ((textureType == MOJODDS_TEXTURE_VOLUME) && (arraySize != 1)) {
+        return 0;
+    } else if ((textureType == MOJODDS_TEXTURE_CUBE) && (w != h)) {
+        return 0;
+    } else if (((uint64) faces) != perElement * arraySize) {
+        return 0;
+    }
+
+    // the mip records must be what the format and dimensions work out to,
+    //  or callers would read past a level believing it's bigger than it is.
+    memset(&layout, '\0', sizeof (layout));
+    layout.w = w;
+    layout.h = h;
+    layout.depth = depth;
+    layout.miplevels = miplevels;
+    layout.blockDim = blockDim;
+    layout.blockSize = blockSize;
+    if (!mojodds_calc_mips(&layout) || (layout.facelen != facelen)) {
+        return 0;
+    }
+
+    for (i = 0; i < miplevels; i++) {
+        const uint8 *mip = pack->mips + (((uint64) firstmip + i) * MIP_LEN);
+        const MOJODDS_MipLevel *calc = &layout.mips[i];
+        if ((get64(mip + 0) != calc->offset) || (get64(mip + 8) != calc->len)) {
+            return 0;
+        } else if (get64(mip + 16) != calc->slicelen) {
+            return 0;
+        } else if ((get32(mip + 24) != calc->w) || (get32(mip + 28) != calc->h)) {
+            return 0;
+        } else if (get32(mip + 32) != calc->d) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+MOJODDS_Pack *MOJODDS_openPack(const char *path)
+{
+    MOJODDS_Pack *pack = NULL;
+    unsigned long len = 0;
+    const uint8 *base;
+    uint64 entriesoffset;
+    uint64 mipsoffset;
+    uint64 namesoffset;
+    uint32 i;
+
+    pack = (MOJODDS_Pack *) calloc(1, sizeof (MOJODDS_Pack));
+    if (pack == NULL) {
+        return NULL;
+    }
+
+    pack->file = MOJODDS_openFile(path);
+    if (pack->file == NULL) {
+        free(pack);
+        return NULL;
+    }
+
+    base = (const uint8 *) MOJODDS_getFileData(pack->file, &len);
+    if ((len < HEADER_LEN) || (memcmp(base, "MDDSPACK", 8) != 0)) {
+        goto bad;
+    } else if (get32(base + 8) != PACK_VERSION) {
+        goto bad;
+    } else if (get64(base + 56) != len) {
+        goto bad;  // truncated, or something stuck on the end.
+    }
+
+    pack->base = base;
+    pack->len = len;
+    pack->count = get32(base + 12);
+    pack->alignment = get32(base + 16);
+    pack->nummips = get32(base + 20);
+    entriesoffset = get64(base + 24);
+    mipsoffset = get64(base + 32);
+    namesoffset = get64(base + 40);
+    pack->nameslen = get64(base + 48);
+
+    if ((pack->alignment == 0) || ((pack->alignment & (pack->alignment - 1)) != 0)) {
+        goto bad;
+    } else if ((entriesoffset > len) || ((((uint64) pack->count) * ENTRY_LEN) > len - entriesoffset)) {
+        goto bad;
+    } else if ((mipsoffset > len) || ((((uint64) pack->nummips) * MIP_LEN) > len - mipsoffset)) {
+        goto bad;
+    } else if ((namesoffset > len) || (pack->nameslen > len - namesoffset)) {
+        goto bad;
+    }
+
+    pack->entries = base + entriesoffset;
+    pack->mips = base + mipsoffset;
+    pack->names = (const char *) (base + namesoffset);
+
+    // this reads the whole index once, which is far less than the first
+    //  lookup into an unchecked one could cost.
+    for (i = 0; i < pack->count; i++) {
+        const uint8 *entry = pack->entries + (((uint64) i) * ENTRY_LEN);
+        if (!check_entry(pack, entry)) {
+            goto bad;
+        } else if (i > 0) {
+            const uint8 *prev = entry - ENTRY_LEN;
+            if (strcmp(pack->names + get32(prev + 40), pack->names + get32(entry + 40)) >= 0) {
+                goto bad;  // out of order, or a name twice.
+            }
+        }
+    }
+
+    return pack;
+
+bad:
+    MOJODDS_close(pack->file);
+    free(pack);
+    return NULL;
+}
+
+unsigned int MOJODDS_getPackCount(const MOJODDS_Pack *pack)
+{
+    return pack->count;
+}
+
+int MOJODDS_findPackEntry(const MOJODDS_Pack *pack, const char *name,
+                          unsigned int *_index)
+{
+    uint32 lo = 0;
+    uint32 hi = pack->count;
+
+    while (lo < hi) {
+        const uint32 mid = lo + ((hi - lo) / 2);
+        const uint8 *entry = pack->entries + (((uint64) mid) * ENTRY_LEN);
+        const int cmp = strcmp(name, pack->names + get32(entry + 40));
+        if (cmp == 0) {
+            *_index = mid;
+            return 1;
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return 0;
+}
+
+int MOJODDS_getPackEntry(const MOJODDS_Pack *pack, unsigned int index,
+                         MOJODDS_PackEntry *_entry)
+{
+    const uint8 *entry;
+    const uint8 *mip;
+    MOJODDS_Layout *layout = &_entry->layout;
+    uint32 i;
+
+    if (index >= pack->count) {
+        return 0;
+    }
+
+    entry = pack->entries + (((uint64) index) * ENTRY_LEN);
+    _entry->name = pack->names + get32(entry + 40);
+    _entry->data = pack->base + get64(entry + 0);
+    _entry->len = (unsigned long) get64(entry + 8);
+    _entry->hash = get64(entry + 16);
+
+    memset(layout, '\0', sizeof (*layout));
+    layout->dataoffset = get32(entry + 52);
+    layout->tex = ((const uint8 *) _entry->data) + layout->dataoffset;
+    layout->texlen = (unsigned long) get64(entry + 24);
+    layout->facelen = (unsigned long) get64(entry + 32);
+    layout->glfmt = get32(entry + 56);
+    layout->textureType = (MOJODDS_textureType) get32(entry + 60);
+    layout->w = get32(entry + 64);
+    layout->h = get32(entry + 68);
+    layout->depth = get32(entry + 72);
+    layout->miplevels = get32(entry + 76);
+    layout->arraySize = get32(entry + 80);
+    layout->faces = get32(entry + 84);
+    layout->blockDim = get32(entry + 88);
+    layout->blockSize = get32(entry + 92);
+    layout->bitCount = get32(entry + 96);
+    for (i = 0; i < 4; i++) {
+        layout->masks[i] = get32(entry + 100 + (i * 4));
+    }
+    layout->premultiplied = get32(entry + 116) ? 1 : 0;
+
+    mip = pack->mips + (((uint64) get32(entry + 48)) * MIP_LEN);
+    for (i = 0; i < layout->miplevels; i++, mip += MIP_LEN) {
+        layout->mips[i].offset = (unsigned long) get64(mip + 0);
+        layout->mips[i].len = (unsigned long) get64(mip + 8);
+        layout->mips[i].slicelen = (unsigned long) get64(mip + 16);
+        layout->mips[i].w = get32(mip + 24);
+        layout->mips[i].h = get32(mip + 28);
+        layout->mips[i].d = get32(mip + 32);
+    }
+
+    return 1;
+}
+
+int MOJODDS_checkPackEntry(const MOJODDS_Pack *pack, unsigned int index)
+{
+    const uint8 *entry;
+
+    if (index >= pack->count) {
+        return 0;
+    }
+
+    entry = pack->entries + (((uint64) index) * ENTRY_LEN);
+    return xxh64(pack->base + get64(entry + 0), get64(entry + 8)) == get64(entry + 16);
+}
+
+unsigned int MOJODDS_getPackAlignment(const MOJODDS_Pack *pack)
+{
+    return pack->alignment;
+}
+
+void MOJODDS_closePack(MOJODDS_Pack *pack)
+{
+    if (pack != NULL) {
+        MOJODDS_close(pack->file);
+        free(pack);
+    }
+}
+
+// end of mojodds_pack.c ...
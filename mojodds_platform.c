@@ -0,0 +1,627 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Threads, CPU detection and file mapping; with mojodds_loader.c and
+//  mojodds_cache.c, the only parts of MojoDDS that care which platform
+//  they're running on.
+
+// -std=c99 hides madvise() and posix_fadvise() from glibc's headers.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include <errno.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(MOJODDS_NO_SIMD)
+#include <intrin.h>
+#endif
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+#include "mojodds_thread.h"
+
+#if defined(MOJODDS_HAVE_X86) && !(defined(_MSC_VER) && !defined(__clang__))
+#include <cpuid.h>
+#endif
+
+typedef struct Job
+{
+    void (*fn)(void *data);
+    void *data;
+    struct Job *next;
+} Job;
+
+struct MOJODDS_ThreadPool
+{
+    Mutex lock;
+    Cond wake;  // workers sleep on this until there's a job (or quit).
+    Cond done;  // parallel_for callers sleep on this.
+    Job *head;
+    Job *tail;
+    int quit;
+    unsigned int numthreads;
+    Thread *threads;
+};
+
+// One parallel_for call. Lives on the caller's stack; helper jobs that the
+//  pool picks up hold a reference until they return.
+typedef struct ParallelFor
+{
+    MOJODDS_ThreadPool *pool;
+    mojodds_parallel_fn fn;
+    void *data;
+    unsigned int count;
+    unsigned int next;
+    unsigned int finished;
+    unsigned int refs;
+    Job *jobs;
+} ParallelFor;
+
+
+unsigned int mojodds_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (unsigned int) MAX(info.dwNumberOfProcessors, 1);
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (unsigned int) count : 1;
+#endif
+}
+
+
+static void worker_loop(MOJODDS_ThreadPool *pool)
+{
+    mutex_lock(&pool->lock);
+    while (1) {
+        Job *job;
+        while ((pool->head == NULL) && (!pool->quit)) {
+            cond_wait(&pool->wake, &pool->lock);
+        }
+
+        if (pool->head == NULL) {
+            break;  // quitting, and nothing left to do.
+        }
+
+        job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+
+        mutex_unlock(&pool->lock);
+        job->fn(job->data);
+        mutex_lock(&pool->lock);
+    }
+    mutex_unlock(&pool->lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_thread(LPVOID arg)
+{
+    worker_loop((MOJODDS_ThreadPool *) arg);
+    return 0;
+}
+#else
+static void *worker_thread(void *arg)
+{
+    worker_loop((MOJODDS_ThreadPool *) arg);
+    return NULL;
+}
+#endif
+
+
+MOJODDS_ThreadPool *MOJODDS_createThreadPool(unsigned int threads)
+{
+    MOJODDS_ThreadPool *pool = (MOJODDS_ThreadPool *) calloc(1, sizeof (*pool));
+    unsigned int i;
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (threads == 0) {
+        threads = mojodds_cpu_count();
+    }
+
+    pool->threads = (Thread *) calloc(threads, sizeof (Thread));
+    if (pool->threads == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    mutex_init(&pool->lock);
+    cond_init(&pool->wake);
+    cond_init(&pool->done);
+
+    for (i = 0; i < threads; i++) {
+#ifdef _WIN32
+        pool->threads[i] = CreateThread(NULL, 0, worker_thread, pool, 0, NULL);
+        if (pool->threads[i] == NULL) {
+            break;
+        }
+#else
+        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0) {
+            break;
+        }
+#endif
+        pool->numthreads++;
+    }
+
+    if (pool->numthreads == 0) {
+        MOJODDS_destroyThreadPool(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void MOJODDS_destroyThreadPool(MOJODDS_ThreadPool *pool)
+{
+    unsigned int i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    mutex_lock(&pool->lock);
+    pool->quit = 1;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->numthreads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+
+    cond_destroy(&pool->done);
+    cond_destroy(&pool->wake);
+    mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+
+// Pull indices off a parallel_for until there aren't any left.
+//  Call with the pool locked; returns with it locked.
+static void parallel_for_run(ParallelFor *pf)
+{
+    MOJODDS_ThreadPool *pool = pf->pool;
+    while (pf->next < pf->count) {
+        const unsigned int index = pf->next++;
+        mutex_unlock(&pool->lock);
+        pf->fn(pf->data, index);
+        mutex_lock(&pool->lock);
+        if (++pf->finished == pf->count) {
+            cond_broadcast(&pool->done);
+        }
+    }
+}
+
+static void parallel_for_helper(void *data)
+{
+    ParallelFor *pf = (ParallelFor *) data;
+    MOJODDS_ThreadPool *pool = pf->pool;
+    mutex_lock(&pool->lock);
+    parallel_for_run(pf);
+    if (--pf->refs == 0) {
+        cond_broadcast(&pool->done);
+    }
+    mutex_unlock(&pool->lock);
+}
+
+void mojodds_parallel_for(MOJODDS_ThreadPool *pool, unsigned int count,
+                          mojodds_parallel_fn fn, void *data)
+{
+    ParallelFor pf;
+    unsigned int helpers;
+    unsigned int i;
+
+    if (count == 0) {
+        return;
+    }
+
+    helpers = (pool != NULL) ? MIN(pool->numthreads, count - 1) : 0;
+    memset(&pf, '\0', sizeof (pf));
+    if (helpers > 0) {
+        pf.jobs = (Job *) malloc(sizeof (Job) * helpers);
+        if (pf.jobs == NULL) {
+            helpers = 0;  // just do it all on this thread.
+        }
+    }
+
+    if (helpers == 0) {
+        for (i = 0; i < count; i++) {
+            fn(data, i);
+        }
+        return;
+    }
+
+    pf.pool = pool;
+    pf.fn = fn;
+    pf.data = data;
+    pf.count = count;
+    pf.refs = helpers;
+
+    mutex_lock(&pool->lock);
+    for (i = 0; i < helpers; i++) {
+        Job *job = &pf.jobs[i];
+        job->fn = parallel_for_helper;
+        job->data = &pf;
+        job->next = NULL;
+        if (pool->tail) {
+            pool->tail->next = job;
+        } else {
+            pool->head = job;
+        }
+        pool->tail = job;
+    }
+    cond_broadcast(&pool->wake);
+
+    parallel_for_run(&pf);
+
+    // Helpers that never got a thread have nothing left to do; pull them
+    //  back out of the queue instead of waiting for a worker to free up.
+    if (pf.refs > 0) {
+        Job *prev = NULL;
+        Job *job = pool->head;
+        while (job != NULL) {
+            Job *next = job->next;
+            if (job->data == &pf) {
+                if (prev) {
+                    prev->next = next;
+                } else {
+                    pool->head = next;
+                }
+                if (pool->tail == job) {
+                    pool->tail = prev;
+                }
+                pf.refs--;
+            } else {
+                prev = job;
+            }
+            job = next;
+        }
+    }
+
+    while ((pf.finished < pf.count) || (pf.refs > 0)) {
+        cond_wait(&pool->done, &pool->lock);
+    }
+    mutex_unlock(&pool->lock);
+
+    free(pf.jobs);
+}
+
+
+struct MOJODDS_File
+{
+    const uint8 *data;
+    size_t len;
+#ifdef _WIN32
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+static const uint8 empty_file[1] = { 0 };
+
+MOJODDS_File *MOJODDS_openFile(const char *path)
+{
+    MOJODDS_File *file = (MOJODDS_File *) calloc(1, sizeof (*file));
+#ifdef _WIN32
+    HANDLE handle;
+    LARGE_INTEGER size;
+#else
+    struct stat statbuf;
+#endif
+
+    if (file == NULL) {
+        return NULL;
+    }
+
+#ifdef _WIN32
+    handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        free(file);
+        return NULL;
+    } else if (!GetFileSizeEx(handle, &size) || (((ULONGLONG) size.QuadPart) > ULONG_MAX)) {
+        CloseHandle(handle);
+        free(file);
+        return NULL;
+    }
+
+    file->len = (size_t) size.QuadPart;
+    if (file->len == 0) {
+        file->data = empty_file;  // can't map zero bytes.
+    } else {
+        // the mapping keeps the file open; we don't need the handle after.
+        file->mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (file->mapping != NULL) {
+            file->data = (const uint8 *) MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+    CloseHandle(handle);
+#else
+    file->fd = open(path, O_RDONLY);
+    if (file->fd == -1) {
+        free(file);
+        return NULL;
+    } else if ((fstat(file->fd, &statbuf) == -1) || (((unsigned long long) statbuf.st_size) > ULONG_MAX)) {
+        close(file->fd);
+        free(file);
+        return NULL;
+    }
+
+    file->len = (size_t) statbuf.st_size;
+    if (file->len == 0) {
+        file->data = empty_file;  // can't map zero bytes.
+    } else {
+        void *ptr = mmap(NULL, file->len, PROT_READ, MAP_SHARED, file->fd, 0);
+        file->data = (ptr == MAP_FAILED) ? NULL : (const uint8 *) ptr;
+    }
+#endif
+
+    if (file->data == NULL) {
+        MOJODDS_close(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+const void *MOJODDS_getFileData(const MOJODDS_File *file, unsigned long *_len)
+{
+    *_len = (unsigned long) file->len;
+    return file->data;
+}
+
+void MOJODDS_close(MOJODDS_File *file)
+{
+    if (file == NULL) {
+        return;
+    }
+
+#ifdef _WIN32
+    if ((file->data != NULL) && (file->data != empty_file)) {
+        UnmapViewOfFile(file->data);
+    }
+    if (file->mapping != NULL) {
+        CloseHandle(file->mapping);
+    }
+#else
+    if ((file->data != NULL) && (file->data != empty_file)) {
+        munmap((void *) file->data, file->len);
+    }
+    close(file->fd);
+#endif
+    free(file);
+}
+
+// Byte range of mips [firstmip, firstmip+mipcount) of one face, relative
+//  to the start of the file. Fails if the layout isn't of this file.
+static int mip_range(const MOJODDS_File *file, const MOJODDS_Layout *layout,
+                     const unsigned int face, const unsigned int firstmip,
+                     const unsigned int mipcount, size_t *_offset,
+                     size_t *_len)
+{
+    const MOJODDS_MipLevel *first;
+    const MOJODDS_MipLevel *last;
+    size_t offset;
+
+    if ((face >= layout->faces) || (mipcount == 0) ||
+        (firstmip >= layout->miplevels) ||
+        (mipcount > layout->miplevels - firstmip)) {
+        return 0;
+    } else if (((const uint8 *) layout->tex) != (file->data + layout->dataoffset)) {
+        return 0;
+    }
+
+    first = &layout->mips[firstmip];
+    last = &layout->mips[firstmip + mipcount - 1];
+    offset = layout->dataoffset + (face * layout->facelen) + first->offset;
+    *_offset = offset;
+    *_len = (size_t) ((last->offset + last->len) - first->offset);
+    assert(offset + *_len <= file->len);
+    return 1;
+}
+
+#ifndef _WIN32
+// madvise() wants a page-aligned start.
+static void page_align(const MOJODDS_File *file, const size_t offset,
+                       const size_t len, void **_ptr, size_t *_len)
+{
+    static size_t pagesize = 0;  // benign race: same answer everywhere.
+    size_t start;
+    if (pagesize == 0) {
+        const long rc = sysconf(_SC_PAGESIZE);
+        pagesize = (rc > 0) ? (size_t) rc : 4096;
+    }
+    start = offset - (offset % pagesize);
+    *_ptr = (void *) (file->data + start);
+    *_len = len + (offset - start);
+}
+#endif
+
+int MOJODDS_prefetchMips(const MOJODDS_File *file,
+                         const MOJODDS_Layout *layout, unsigned int face,
+                         unsigned int firstmip, unsigned int mipcount)
+{
+    size_t offset, len;
+    if (!mip_range(file, layout, face, firstmip, mipcount, &offset, &len)) {
+        return 0;
+    }
+
+#ifdef _WIN32
+    // !!! FIXME: PrefetchVirtualMemory() on Windows 8 and later.
+    (void) offset;
+    (void) len;
+#else
+    {
+        void *ptr;
+        size_t alignedlen;
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(file->fd, (off_t) offset, (off_t) len, POSIX_FADV_WILLNEED);
+#endif
+        page_align(file, offset, len, &ptr, &alignedlen);
+        madvise(ptr, alignedlen, MADV_WILLNEED);
+    }
+#endif
+    return 1;
+}
+
+int MOJODDS_releaseMips(const MOJODDS_File *file,
+                        const MOJODDS_Layout *layout, unsigned int face,
+                        unsigned int firstmip, unsigned int mipcount)
+{
+    size_t offset, len;
+    if (!mip_range(file, layout, face, firstmip, mipcount, &offset, &len)) {
+        return 0;
+    }
+
+#ifdef _WIN32
+    // File-backed pages just age out of the working set here.
+    (void) offset;
+    (void) len;
+#else
+    {
+        // It's a read-only shared mapping, so dropping the pages is safe;
+        //  touching them again just reads them back in.
+        void *ptr;
+        size_t alignedlen;
+        page_align(file, offset, len, &ptr, &alignedlen);
+        madvise(ptr, alignedlen, MADV_DONTNEED);
+#if defined(POSIX_FADV_DONTNEED)
+        posix_fadvise(file->fd, (off_t) offset, (off_t) len, POSIX_FADV_DONTNEED);
+#endif
+    }
+#endif
+    return 1;
+}
+
+
+static int write_fd(void *userdata, const void *data, unsigned long len)
+{
+    const int fd = *((const int *) userdata);
+    const uint8 *ptr = (const uint8 *) data;
+    while (len > 0) {
+        const unsigned int cpy = (unsigned int) MIN(len, 0x40000000);
+#ifdef _WIN32
+        const int rc = _write(fd, ptr, cpy);
+#else
+        const ssize_t rc = write(fd, ptr, cpy);
+#endif
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        ptr += rc;
+        len -= (unsigned long) rc;
+    }
+    return 1;
+}
+
+int MOJODDS_writeFd(const MOJODDS_WriteDesc *desc,
+                    const void * const *subresources, int fd)
+{
+    return MOJODDS_write(desc, subresources, write_fd, &fd);
+}
+
+int MOJODDS_writePackFd(const MOJODDS_PackInput *inputs, unsigned int count,
+                        unsigned int alignment, int fd)
+{
+    return MOJODDS_writePack(inputs, count, alignment, write_fd, &fd);
+}
+
+static int simd_enabled = 1;
+
+int MOJODDS_useSIMD(int enable)
+{
+    const int retval = simd_enabled;
+    simd_enabled = enable ? 1 : 0;
+    return retval;
+}
+
+static unsigned int detect_cpu_features(void)
+{
+    unsigned int retval = 0;
+#if defined(MOJODDS_HAVE_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    if (info[3] & (1 << 26)) {
+        retval |= MOJODDS_CPU_SSE2;
+    }
+    // AVX2 and F16C need the OS to save the YMM registers, too.
+    if ((info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6)) {
+        if ((info[2] & (1 << 28)) && (info[2] & (1 << 29))) {
+            retval |= MOJODDS_CPU_F16C;
+        }
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            retval |= MOJODDS_CPU_AVX2;
+        }
+    }
+#elif defined(MOJODDS_HAVE_X86)
+    // __builtin_cpu_supports() only knows "f16c" from GCC 11 on, so ask the
+    //  CPU directly, the same way as above.
+    unsigned int eax, ebx, ecx, edx;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        retval |= MOJODDS_CPU_SSE2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        retval |= MOJODDS_CPU_AVX2;
+    }
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 27))) {
+        unsigned int xcr0, xcr0hi;
+        __asm__ __volatile__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+        if (((xcr0 & 0x6) == 0x6) && (ecx & (1 << 28)) && (ecx & (1 << 29))) {
+            retval |= MOJODDS_CPU_F16C;
+        }
+    }
+#elif defined(MOJODDS_HAVE_NEON)
+    retval |= MOJODDS_CPU_NEON;  // always there on 64-bit ARM.
+#endif
+    return retval;
+}
+
+unsigned int mojodds_cpu_features(void)
+{
+    // benign race: every thread computes the same answer.
+    static int detected = 0;
+    static unsigned int features = 0;
+    if (!detected) {
+        features = detect_cpu_features();
+        detected = 1;
+    }
+    return simd_enabled ? features : 0;
+}
+
+// end of mojodds_platform.c ...
+
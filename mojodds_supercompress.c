@@ -0,0 +1,684 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Supercompressed files, and the MOJODDS_writeSupercompressed(),
+//  MOJODDS_getSupercompressedLayout() and MOJODDS_decompress() entry points.
+//
+// A supercompressed file is a DDS file whose pixel data has been cut into
+//  chunks and run through a general-purpose compressor. Every subresource
+//  (one mip level of one face) is compressed on its own, split into chunks
+//  of at most CHUNK_MAX bytes so a big top level doesn't end up on one
+//  thread, which means any set of levels can be decompressed, in parallel,
+//  straight to where they go in the caller's buffer. A chunk that doesn't
+//  get smaller is stored as-is.
+//
+// Everything is little endian. The file is:
+//
+//    0  "MDDSCOMP"
+//    8  u32 version (1)
+//   12  u32 length of the DDS headers (128 or 148)
+//   16  u32 chunk count
+//   20  u32 zero
+//   24  the DDS file's headers, magic and all
+//
+// then one 24-byte record per chunk: u64 offset from the start of the file,
+//  u32 compressed length, u32 uncompressed length, u32 codec and a zero.
+//  Chunks are in file order (each face's levels, biggest first) and each
+//  level's chunks add up to exactly that level; then comes the compressed
+//  data. LZ4 chunks are raw LZ4 blocks, as LZ4_decompress_safe() takes, and
+//  the compressor for them is built in; zstd chunks are zstd frames, and
+//  need libzstd and MOJODDS_HAVE_ZSTD.
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef MOJODDS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#define SUPER_VERSION 1
+#define HEADER_LEN 24
+#define RECORD_LEN 24
+#define CHUNK_MAX (256 * 1024)
+
+typedef struct
+{
+    const uint8 *src;
+    uint8 *dst;
+    uint32 srclen;
+    uint32 dstlen;
+    uint32 codec;
+    int ok;
+} Chunk;
+
+typedef struct
+{
+    Chunk *chunks;
+    unsigned int codec;
+    int level;
+} CompressJob;
+
+
+static uint32 get32(const uint8 *ptr)
+{
+    return (((uint32) ptr[0]) <<  0) | (((uint32) ptr[1]) <<  8) |
+           (((uint32) ptr[2]) << 16) | (((uint32) ptr[3]) << 24) ;
+}
+
+static uint64 get64(const uint8 *ptr)
+{
+    return ((uint64) get32(ptr)) | (((uint64) get32(ptr + 4)) << 32);
+}
+
+static void put32(uint8 *ptr, const uint32 val)
+{
+    ptr[0] = (uint8) (val >>  0);
+    ptr[1] = (uint8) (val >>  8);
+    ptr[2] = (uint8) (val >> 16);
+    ptr[3] = (uint8) (val >> 24);
+}
+
+static void put64(uint8 *ptr, const uint64 val)
+{
+    put32(ptr, (uint32) val);
+    put32(ptr + 4, (uint32) (val >> 32));
+}
+
+
+// LZ4 block format: a token byte with 4 bits each of literal length and
+//  match length (15 meaning more bytes follow, each added on until one
+//  isn't 255), the literals, then a 16-bit offset back to the match, which
+//  is at least 4 bytes. The last sequence is literals only, and has to
+//  cover the last LZ4_LASTLITERALS bytes; no match can start in the last
+//  LZ4_MFLIMIT.
+#define LZ4_MINMATCH 4
+#define LZ4_LASTLITERALS 5
+#define LZ4_MFLIMIT 12
+#define LZ4_MAXOFFSET 65535
+#define LZ4_HASHLOG 14
+
+static size_t lz4_bound(const size_t len)
+{
+    return len + (len / 255) + 16;
+}
+
+static uint32 lz4_hash(const uint8 *ptr)
+{
+    uint32 seq;
+    memcpy(&seq, ptr, sizeof (seq));
+    return (seq * 2654435761U) >> (32 - LZ4_HASHLOG);
+}
+
+static uint8 *lz4_put_length(uint8 *op, size_t len)
+{
+    while (len >= 255) {
+        *(op++) = 255;
+        len -= 255;
+    }
+    *(op++) = (uint8) len;
+    return op;
+}
+
+// matchlen is zero for the last, literals-only, sequence.
+static uint8 *lz4_put_sequence(uint8 *op, const uint8 *literals,
+                               const size_t litlen, const size_t offset,
+                               const size_t matchlen)
+{
+    const size_t extra = (matchlen > 0) ? (matchlen - LZ4_MINMATCH) : 0;
+    uint8 *token = op++;
+
+    *token = (uint8) ((MIN(litlen, 15) << 4) | MIN(extra, 15));
+    if (litlen >= 15) {
+        op = lz4_put_length(op, litlen - 15);
+    }
+    memcpy(op, literals, litlen);
+    op += litlen;
+
+    if (matchlen > 0) {
+        *(op++) = (uint8) (offset & 0xFF);
+        *(op++) = (uint8) (offset >> 8);
+        if (extra >= 15) {
+            op = lz4_put_length(op, extra - 15);
+        }
+    }
+    return op;
+}
+
+// Greedy, one candidate per hash, skipping ahead faster the longer it goes
+//  without a match, like LZ4's own fast mode. table has 1 << LZ4_HASHLOG
+//  zeroed entries, each a position + 1. dst needs lz4_bound(len) bytes.
+static size_t lz4_compress(const uint8 *src, const size_t len, uint8 *dst,
+                           uint32 *table)
+{
+    uint8 *op = dst;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    if (len > LZ4_MFLIMIT) {
+        const size_t limit = len - LZ4_MFLIMIT;  // matches start before here...
+        const size_t matchlimit = len - LZ4_LASTLITERALS;  // ...and end by here.
+        unsigned int misses = 0;
+
+        while (ip < limit) {
+            const uint32 h = lz4_hash(src + ip);
+            const uint32 candidate = table[h];
+            table[h] = (uint32) (ip + 1);
+
+            if ((candidate != 0) && (ip - (candidate - 1) <= LZ4_MAXOFFSET) &&
+                (memcmp(src + candidate - 1, src + ip, LZ4_MINMATCH) == 0)) {
+                size_t ref = candidate - 1;
+                size_t matchlen = LZ4_MINMATCH;
+
+                // grow it backwards into the literals, then forwards.
+                while ((ip > anchor) && (ref > 0) && (src[ip - 1] == src[ref - 1])) {
+                    ip--;
+                    ref--;
+                    matchlen++;
+                }
+                while ((ip + matchlen < matchlimit) && (src[ref + matchlen] == src[ip + matchlen])) {
+                    matchlen++;
+                }
+
+                op = lz4_put_sequence(op, src + anchor, ip - anchor, ip - ref, matchlen);
+                ip += matchlen;
+                anchor = ip;
+                misses = 0;
+                if (ip < limit) {
+                    table[lz4_hash(src + ip - 2)] = (uint32) (ip - 2 + 1);
+                }
+            } else {
+                ip += 1 + (misses++ >> 6);
+            }
+        }
+    }
+
+    op = lz4_put_sequence(op, src + anchor, len - anchor, 0, 0);
+    return (size_t) (op - dst);
+}
+
+// Never reads or writes outside src and dst, whatever src holds; returns
+//  zero unless it decodes to exactly dstlen bytes.
+static int lz4_decompress(const uint8 *src, const size_t srclen, uint8 *dst,
+                          const size_t dstlen)
+{
+    const uint8 *ip = src;
+    const uint8 *iend = src + srclen;
+    uint8 *op = dst;
+    uint8 *oend = dst + dstlen;
+
+    for (;;) {
+        size_t litlen;
+        size_t matchlen;
+        size_t offset;
+        const uint8 *match;
+        uint32 token;
+
+        if (ip >= iend) {
+            return 0;
+        }
+
+        token = *(ip++);
+        litlen = token >> 4;
+        if (litlen == 15) {
+            uint32 b;
+            do {
+                if (ip >= iend) {
+                    return 0;
+                }
+                b = *(ip++);
+                litlen += b;
+            } while (b == 255);
+        }
+
+        if ((litlen > (size_t) (iend - ip)) || (litlen > (size_t) (oend - op))) {
+            return 0;
+        } else if ((litlen <= 16) && (iend - ip >= 16) && (oend - op >= 16)) {
+            memcpy(op, ip, 16);  // most runs are short; a fixed size is faster.
+        } else {
+            memcpy(op, ip, litlen);
+        }
+        op += litlen;
+        ip += litlen;
+
+        if (ip == iend) {
+            break;  // that was the last sequence.
+        } else if (iend - ip < 2) {
+            return 0;
+        }
+
+        offset = ((size_t) ip[0]) | (((size_t) ip[1]) << 8);
+        ip += 2;
+        if ((offset == 0) || (offset > (size_t) (op - dst))) {
+            return 0;
+        }
+
+        matchlen = token & 15;
+        if (matchlen == 15) {
+            uint32 b;
+            do {
+                if (ip >= iend) {
+                    return 0;
+                }
+                b = *(ip++);
+                matchlen += b;
+            } while (b == 255);
+        }
+        matchlen += LZ4_MINMATCH;
+
+        if (matchlen > (size_t) (oend - op)) {
+            return 0;
+        }
+
+        // the match can overlap what it's producing, which is how runs are
+        //  encoded, so only copy as far back as the offset at a time.
+        match = op - offset;
+        if ((offset >= 16) && (matchlen <= 16) && (oend - op >= 16)) {
+            memcpy(op, match, 16);
+            op += matchlen;
+        } else if (offset >= matchlen) {
+            memcpy(op, match, matchlen);
+            op += matchlen;
+        } else if (offset >= 8) {
+            while (matchlen >= 8) {
+                memcpy(op, match, 8);
+                op += 8;
+                match += 8;
+                matchlen -= 8;
+            }
+            memcpy(op, match, matchlen);
+            op += matchlen;
+        } else {
+            while (matchlen--) {
+                *(op++) = *(match++);
+            }
+        }
+    }
+
+    return op == oend;
+}
+
+
+int MOJODDS_haveCodec(unsigned int codec)
+{
+    switch (codec) {
+        case MOJODDS_CODEC_STORED: return 1;
+        case MOJODDS_CODEC_LZ4: return 1;
+#ifdef MOJODDS_HAVE_ZSTD
+        case MOJODDS_CODEC_ZSTD: return 1;
+#endif
+        default: break;
+    }
+    return 0;
+}
+
+static void compress_chunk(void *data, unsigned int index)
+{
+    const CompressJob *job = (const CompressJob *) data;
+    Chunk *chunk = &job->chunks[index];
+    uint8 *dst = NULL;
+    size_t dstlen = 0;
+
+    // stored unless compressing it works and helps.
+    chunk->dst = NULL;
+    chunk->dstlen = chunk->srclen;
+    chunk->codec = MOJODDS_CODEC_STORED;
+
+    if (job->codec == MOJODDS_CODEC_LZ4) {
+        uint32 *table = (uint32 *) calloc(1 << LZ4_HASHLOG, sizeof (uint32));
+        dst = (uint8 *) malloc(lz4_bound(chunk->srclen));
+        if ((table != NULL) && (dst != NULL)) {
+            dstlen = lz4_compress(chunk->src, chunk->srclen, dst, table);
+        }
+        free(table);
+    }
+#ifdef MOJODDS_HAVE_ZSTD
+    else if (job->codec == MOJODDS_CODEC_ZSTD) {
+        const size_t bound = ZSTD_compressBound(chunk->srclen);
+        dst = (uint8 *) malloc(bound);
+        if (dst != NULL) {
+            const size_t rc = ZSTD_compress(dst, bound, chunk->src, chunk->srclen, job->level);
+            dstlen = ZSTD_isError(rc) ? 0 : rc;
+        }
+    }
+#endif
+
+    if ((dstlen > 0) && (dstlen < chunk->srclen)) {
+        chunk->dst = dst;
+        chunk->dstlen = (uint32) dstlen;
+        chunk->codec = job->codec;
+    } else {
+        free(dst);
+    }
+}
+
+int MOJODDS_writeSupercompressed(const void *_ptr, const unsigned long _len,
+                                 unsigned int codec, int level,
+                                 MOJODDS_ThreadPool *pool,
+                                 MOJODDS_WriteFn writefn, void *userdata)
+{
+    const uint8 *ptr = (const uint8 *) _ptr;
+    MOJODDS_Layout layout;
+    CompressJob job;
+    Chunk *chunks = NULL;
+    uint8 *table = NULL;
+    uint8 header[HEADER_LEN];
+    uint64 numchunks = 0;
+    uint64 offset;
+    uint32 face;
+    uint32 mip;
+    uint32 i;
+    int retval = 0;
+
+    if (!MOJODDS_haveCodec(codec)) {
+        return 0;
+    } else if (MOJODDS_validate(ptr, _len, _len, &layout) != MOJODDS_ERR_NONE) {
+        return 0;
+    } else if (layout.tex == NULL) {
+        return 0;
+    }
+
+    for (face = 0; face < layout.faces; face++) {
+        for (mip = 0; mip < layout.miplevels; mip++) {
+            numchunks += (layout.mips[mip].len + CHUNK_MAX - 1) / CHUNK_MAX;
+        }
+    }
+
+    if (numchunks > (UINT32_MAX / RECORD_LEN)) {
+        return 0;
+    }
+
+    chunks = (Chunk *) calloc((size_t) MAX(numchunks, 1), sizeof (Chunk));
+    table = (uint8 *) malloc((size_t) MAX(numchunks * RECORD_LEN, 1));
+    if ((chunks == NULL) || (table == NULL)) {
+        goto done;
+    }
+
+    i = 0;
+    for (face = 0; face < layout.faces; face++) {
+        const uint8 *facedata = ((const uint8 *) layout.tex) + (((uint64) face) * layout.facelen);
+        for (mip = 0; mip < layout.miplevels; mip++) {
+            const uint8 *src = facedata + layout.mips[mip].offset;
+            uint64 remaining = layout.mips[mip].len;
+            while (remaining > 0) {
+                const uint32 cpy = (uint32) MIN(remaining, CHUNK_MAX);
+                chunks[i].src = src;
+                chunks[i].srclen = cpy;
+                src += cpy;
+                remaining -= cpy;
+                i++;
+            }
+        }
+    }
+
+    job.chunks = chunks;
+    job.codec = codec;
+    job.level = level;
+    mojodds_parallel_for(pool, (unsigned int) numchunks, compress_chunk, &job);
+
+    offset = HEADER_LEN + layout.dataoffset + (numchunks * RECORD_LEN);
+    for (i = 0; i < numchunks; i++) {
+        uint8 *record = table + (((uint64) i) * RECORD_LEN);
+        put64(record + 0, offset);
+        put32(record + 8, chunks[i].dstlen);
+        put32(record + 12, chunks[i].srclen);
+        put32(record + 16, chunks[i].codec);
+        put32(record + 20, 0);
+        offset += chunks[i].dstlen;
+    }
+
+    memcpy(header, "MDDSCOMP", 8);
+    put32(header + 8, SUPER_VERSION);
+    put32(header + 12, (uint32) layout.dataoffset);
+    put32(header + 16, (uint32) numchunks);
+    put32(header + 20, 0);
+
+    if (!writefn(userdata, header, HEADER_LEN)) {
+        goto done;
+    } else if (!writefn(userdata, ptr, layout.dataoffset)) {
+        goto done;
+    } else if ((numchunks > 0) && !writefn(userdata, table, (unsigned long) (numchunks * RECORD_LEN))) {
+        goto done;
+    }
+
+    for (i = 0; i < numchunks; i++) {
+        const Chunk *chunk = &chunks[i];
+        const void *data = (chunk->dst != NULL) ? chunk->dst : chunk->src;
+        if (!writefn(userdata, data, chunk->dstlen)) {
+            goto done;
+        }
+    }
+
+    retval = 1;
+
+done:
+    for (i = 0; chunks && (i < numchunks); i++) {
+        free(chunks[i].dst);
+    }
+    free(chunks);
+    free(table);
+    return retval;
+}
+
+int MOJODDS_isSupercompressed(const void *_ptr, const unsigned long _len)
+{
+    return (_len >= HEADER_LEN) && (memcmp(_ptr, "MDDSCOMP", 8) == 0);
+}
+
+// Check the container against _len and the layout its headers describe,
+//  and plan the load from firstmip down. Nothing in it is trusted.
+static MOJODDS_error parse_container(const uint8 *ptr, const unsigned long _len,
+                                     const unsigned int firstmip,
+                                     MOJODDS_Layout *full,
+                                     MOJODDS_Layout *planned,
+                                     const uint8 **_table, uint32 *_numchunks)
+{
+    const uint64 len = _len;
+    MOJODDS_ByteRange *ranges = NULL;
+    MOJODDS_error err;
+    const MOJODDS_MipLevel *first;
+    const uint8 *table;
+    uint64 filled = 0;
+    uint32 headerlen;
+    uint32 numchunks;
+    uint32 subresource = 0;
+    uint32 numranges = 0;
+    uint32 i;
+    int planned_ok;
+
+    if (!MOJODDS_isSupercompressed(ptr, _len)) {
+        return MOJODDS_ERR_NOT_DDS;
+    } else if (get32(ptr + 8) != SUPER_VERSION) {
+        return MOJODDS_ERR_BAD_HEADER;
+    }
+
+    headerlen = get32(ptr + 12);
+    numchunks = get32(ptr + 16);
+    if ((headerlen > MOJODDS_HEADER_MAXLEN) || (headerlen > len - HEADER_LEN)) {
+        return MOJODDS_ERR_TRUNCATED_HEADER;
+    }
+
+    // there's no pixel data after the headers, so say the file is as big
+    //  as it needs to be; the chunks are checked against the layout below.
+    err = MOJODDS_validate(ptr + HEADER_LEN, headerlen, ULONG_MAX, full);
+    if (err != MOJODDS_ERR_NONE) {
+        return err;
+    } else if (full->dataoffset != headerlen) {
+        return MOJODDS_ERR_BAD_HEADER;
+    }
+    full->tex = NULL;
+
+    table = ptr + HEADER_LEN + headerlen;
+    if (((uint64) numchunks) * RECORD_LEN > len - HEADER_LEN - headerlen) {
+        return MOJODDS_ERR_CORRUPT;
+    }
+
+    // every level of every face, in order, made of chunks that add up.
+    for (i = 0; i < numchunks; i++) {
+        const uint8 *record = table + (((uint64) i) * RECORD_LEN);
+        const uint64 offset = get64(record + 0);
+        const uint32 clen = get32(record + 8);
+        const uint32 ulen = get32(record + 12);
+        const uint32 codec = get32(record + 16);
+        const MOJODDS_MipLevel *mip;
+
+        if (subresource >= ((uint64) full->faces) * full->miplevels) {
+            return MOJODDS_ERR_CORRUPT;  // more chunks than levels.
+        }
+        mip = &full->mips[subresource % full->miplevels];
+
+        if ((offset > len) || (clen > len - offset) || (ulen == 0)) {
+            return MOJODDS_ERR_CORRUPT;
+        } else if (codec > MOJODDS_CODEC_ZSTD) {
+            return MOJODDS_ERR_CORRUPT;
+        } else if ((codec == MOJODDS_CODEC_STORED) && (clen != ulen)) {
+            return MOJODDS_ERR_CORRUPT;
+        } else if (ulen > mip->len - filled) {
+            return MOJODDS_ERR_CORRUPT;
+        }
+
+        filled += ulen;
+        if (filled == mip->len) {
+            subresource++;
+            filled = 0;
+        }
+    }
+
+    if ((subresource != ((uint64) full->faces) * full->miplevels) || (filled != 0)) {
+        return MOJODDS_ERR_CORRUPT;  // ran out before the last level.
+    }
+
+    // one range per face is always enough.
+    ranges = (MOJODDS_ByteRange *) malloc(sizeof (MOJODDS_ByteRange) * full->faces);
+    if (ranges == NULL) {
+        return MOJODDS_ERR_NO_BUFFER;
+    }
+    first = &full->mips[MIN(firstmip, full->miplevels - 1)];
+    planned_ok = MOJODDS_planMipLoad(full, MAX(MAX(first->w, first->h), first->d), 0,
+                                     ranges, full->faces, &numranges, planned);
+    free(ranges);
+    if (!planned_ok) {
+        return MOJODDS_ERR_BAD_HEADER;  // can't happen for a valid layout.
+    }
+
+    *_table = table;
+    *_numchunks = numchunks;
+    return MOJODDS_ERR_NONE;
+}
+
+MOJODDS_error MOJODDS_getSupercompressedLayout(const void *_ptr,
+                                               const unsigned long _len,
+                                               unsigned int firstmip,
+                                               MOJODDS_Layout *_layout)
+{
+    MOJODDS_Layout full;
+    const uint8 *table = NULL;
+    uint32 numchunks = 0;
+    return parse_container((const uint8 *) _ptr, _len, firstmip, &full,
+                           _layout, &table, &numchunks);
+}
+
+static void decompress_chunk(void *data, unsigned int index)
+{
+    Chunk *chunk = &((Chunk *) data)[index];
+    chunk->ok = 0;
+    if (chunk->codec == MOJODDS_CODEC_STORED) {
+        memcpy(chunk->dst, chunk->src, chunk->dstlen);
+        chunk->ok = 1;
+    } else if (chunk->codec == MOJODDS_CODEC_LZ4) {
+        chunk->ok = lz4_decompress(chunk->src, chunk->srclen, chunk->dst, chunk->dstlen);
+    }
+#ifdef MOJODDS_HAVE_ZSTD
+    else if (chunk->codec == MOJODDS_CODEC_ZSTD) {
+        const size_t rc = ZSTD_decompress(chunk->dst, chunk->dstlen, chunk->src, chunk->srclen);
+        chunk->ok = !ZSTD_isError(rc) && (rc == chunk->dstlen);
+    }
+#endif
+}
+
+MOJODDS_error MOJODDS_decompress(const void *_ptr, const unsigned long _len,
+                                 unsigned int firstmip, void *_dst,
+                                 unsigned long _dstlen,
+                                 MOJODDS_ThreadPool *pool,
+                                 MOJODDS_Layout *_layout)
+{
+    const uint8 *ptr = (const uint8 *) _ptr;
+    uint8 *dst = (uint8 *) _dst;
+    MOJODDS_Layout full;
+    MOJODDS_Layout planned;
+    MOJODDS_error err;
+    Chunk *chunks = NULL;
+    const uint8 *table = NULL;
+    uint64 filled = 0;
+    uint32 numchunks = 0;
+    uint32 subresource = 0;
+    uint32 skipped;
+    uint32 count = 0;
+    uint32 i;
+
+    err = parse_container(ptr, _len, firstmip, &full, &planned, &table, &numchunks);
+    if (err != MOJODDS_ERR_NONE) {
+        return err;
+    } else if ((dst == NULL) || (_dstlen < planned.texlen)) {
+        return MOJODDS_ERR_NO_BUFFER;
+    }
+
+    chunks = (Chunk *) malloc(sizeof (Chunk) * MAX(numchunks, 1));
+    if (chunks == NULL) {
+        return MOJODDS_ERR_NO_BUFFER;
+    }
+
+    // the planned layout is the levels from skipped down, each face's
+    //  packed together.
+    skipped = full.miplevels - planned.miplevels;
+    for (i = 0; i < numchunks; i++) {
+        const uint8 *record = table + (((uint64) i) * RECORD_LEN);
+        const uint32 face = subresource / full.miplevels;
+        const uint32 mip = subresource % full.miplevels;
+        const uint32 ulen = get32(record + 12);
+
+        if (mip >= skipped) {
+            Chunk *chunk = &chunks[count++];
+            chunk->src = ptr + get64(record + 0);
+            chunk->srclen = get32(record + 8);
+            chunk->dst = dst + (((uint64) face) * planned.facelen) +
+                         planned.mips[mip - skipped].offset + filled;
+            chunk->dstlen = ulen;
+            chunk->codec = get32(record + 16);
+            if (!MOJODDS_haveCodec(chunk->codec)) {
+                free(chunks);
+                return MOJODDS_ERR_NO_CODEC;
+            }
+        }
+
+        filled += ulen;
+        if (filled == full.mips[mip].len) {
+            subresource++;
+            filled = 0;
+        }
+    }
+
+    mojodds_parallel_for(pool, count, decompress_chunk, chunks);
+
+    for (i = 0; i < count; i++) {
+        if (!chunks[i].ok) {
+            err = MOJODDS_ERR_CORRUPT;
+            break;
+        }
+    }
+    free(chunks);
+
+    if (err == MOJODDS_ERR_NONE) {
+        *_layout = planned;
+        _layout->tex = dst;
+    }
+    return err;
+}
+
+// end of mojodds_supercompress.c ...
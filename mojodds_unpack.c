@@ -0,0 +1,352 @@
+/**
+ * MojoDDS; tools for dealing with DDS files.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+// Unpacking legacy RGB bitmask layouts to RGBA8, and the
+//  MOJODDS_unpackMasked() entry point.
+//
+// The scalar reference handles any masks a DDS file can have, and scales
+//  each channel with round(v * 255 / max). The SIMD kernels take every layout
+//  whose channels are 8 bits or narrower (565, 1555, 4444, 8888 in any
+//  order, and so on) and get the same rounding from a 16-bit multiply, add
+//  and shift by 6, with constants per channel width that were checked
+//  against the division for every input. Bit replication, which is cheaper,
+//  is off by one for some 5- and 6-bit values, so don't swap it in.
+
+#include <string.h>
+#include <assert.h>
+
+#include "mojodds.h"
+#include "mojodds_internal.h"
+
+#if defined(MOJODDS_HAVE_X86)
+#include <emmintrin.h>
+#elif defined(MOJODDS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef struct
+{
+    uint32 bytes;  // per source pixel.
+    uint32 masks[4];  // R, G, B, A.
+    uint32 shift[4];  // of each mask's lowest bit.
+    uint32 max[4];  // masks[i] >> shift[i]; zero if the channel is missing.
+    int simd;  // nonzero if every channel fits in 8 bits.
+    uint16 mul[4];  // (v * mul + add) >> 6 for the SIMD kernels.
+    uint16 add[4];
+} MaskInfo;
+
+typedef void (*unpack_fn)(const MaskInfo *info, const uint8 *src,
+                          unsigned int pixels, uint8 *dst);
+
+// Multiplier and addend for (v * mul + add) >> 6 == round(v * 255 / max),
+//  by channel width. Every product fits in 16 bits.
+static const uint16 ScaleMul[9] = { 0, 16320, 5440, 2336, 1088, 527, 259, 129, 64 };
+static const uint16 ScaleAdd[9] = { 0, 0, 0, 0, 0, 23, 33, 0, 0 };
+
+static void init_mask_info(MaskInfo *info, const uint32 bitCount,
+                           const uint32 *masks)
+{
+    int i;
+
+    memset(info, '\0', sizeof (*info));
+    info->bytes = bitCount / 8;
+    info->simd = 1;
+    for (i = 0; i < 4; i++) {
+        const uint32 mask = masks[i];
+        uint32 bits = 0;
+        info->masks[i] = mask;
+        if (mask != 0) {
+            while (((mask >> info->shift[i]) & 1) == 0) {
+                info->shift[i]++;
+            }
+            info->max[i] = mask >> info->shift[i];
+            while ((bits < 32) && ((info->max[i] >> bits) & 1)) {
+                bits++;
+            }
+        }
+
+        if (bits > 8) {
+            info->simd = 0;
+        } else if (bits > 0) {
+            info->mul[i] = ScaleMul[bits];
+            info->add[i] = ScaleAdd[bits];
+        } else if (i == 3) {
+            info->add[i] = 255 << 6;  // no alpha: opaque.
+        }
+    }
+}
+
+static uint32 read_pixel(const uint8 *src, const uint32 bytes)
+{
+    switch (bytes) {
+        case 1: return src[0];
+        case 2: return ((uint32) src[0]) | (((uint32) src[1]) << 8);
+        case 3: return ((uint32) src[0]) | (((uint32) src[1]) << 8) | (((uint32) src[2]) << 16);
+    }
+    return ((uint32) src[0]) | (((uint32) src[1]) << 8) |
+           (((uint32) src[2]) << 16) | (((uint32) src[3]) << 24);
+}
+
+static void unpack_scalar(const MaskInfo *info, const uint8 *src,
+                          unsigned int pixels, uint8 *dst)
+{
+    while (pixels--) {
+        const uint32 px = read_pixel(src, info->bytes);
+        int i;
+        for (i = 0; i < 4; i++) {
+            const uint64 max = info->max[i];
+            if (max == 0) {
+                dst[i] = (i == 3) ? 255 : 0;
+            } else {
+                const uint64 v = (px & info->masks[i]) >> info->shift[i];
+                dst[i] = (uint8) (((v * 510) + max) / (max * 2));
+            }
+        }
+        src += info->bytes;
+        dst += 4;
+    }
+}
+
+
+#ifdef MOJODDS_HAVE_X86
+
+// Eight pixels at src, as two vectors of 32-bit lanes.
+static MOJODDS_TARGET("sse2") void sse2_load8(const MaskInfo *info,
+                                             const uint8 *src, __m128i px[2])
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v;
+
+    switch (info->bytes) {
+        case 1:
+            v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) src), zero);
+            px[0] = _mm_unpacklo_epi16(v, zero);
+            px[1] = _mm_unpackhi_epi16(v, zero);
+            break;
+        case 2:
+            v = _mm_loadu_si128((const __m128i *) src);
+            px[0] = _mm_unpacklo_epi16(v, zero);
+            px[1] = _mm_unpackhi_epi16(v, zero);
+            break;
+        case 3:
+            px[0] = _mm_setr_epi32((int) read_pixel(src, 3), (int) read_pixel(src + 3, 3),
+                                   (int) read_pixel(src + 6, 3), (int) read_pixel(src + 9, 3));
+            px[1] = _mm_setr_epi32((int) read_pixel(src + 12, 3), (int) read_pixel(src + 15, 3),
+                                   (int) read_pixel(src + 18, 3), (int) read_pixel(src + 21, 3));
+            break;
+        default:
+            px[0] = _mm_loadu_si128((const __m128i *) src);
+            px[1] = _mm_loadu_si128((const __m128i *) (src + 16));
+            break;
+    }
+}
+
+// One channel of eight pixels, scaled to 0-255 in 16-bit lanes.
+static MOJODDS_TARGET("sse2") __m128i sse2_channel(const MaskInfo *info,
+                                                  const __m128i px[2],
+                                                  const int i)
+{
+    const __m128i shift = _mm_cvtsi32_si128((int) info->shift[i]);
+    const __m128i max = _mm_set1_epi32((int) info->max[i]);
+    const __m128i lo = _mm_and_si128(_mm_srl_epi32(px[0], shift), max);
+    const __m128i hi = _mm_and_si128(_mm_srl_epi32(px[1], shift), max);
+    const __m128i v = _mm_packs_epi32(lo, hi);  // max <= 255, so no saturation.
+    const __m128i scaled = _mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16((short) info->mul[i])),
+                                         _mm_set1_epi16((short) info->add[i]));
+    return _mm_srli_epi16(scaled, 6);
+}
+
+static MOJODDS_TARGET("sse2") void unpack_sse2(const MaskInfo *info,
+                                              const uint8 *src,
+                                              unsigned int pixels, uint8 *dst)
+{
+    const size_t srcstep = 8 * info->bytes;
+
+    assert(info->simd);
+    for (; pixels >= 8; pixels -= 8) {
+        __m128i px[2];
+        __m128i r, g, b, a, rg, ba;
+        sse2_load8(info, src, px);
+        r = sse2_channel(info, px, 0);
+        g = sse2_channel(info, px, 1);
+        b = sse2_channel(info, px, 2);
+        a = sse2_channel(info, px, 3);
+        rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+        _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(rg, ba));
+        src += srcstep;
+        dst += 32;
+    }
+
+    unpack_scalar(info, src, pixels, dst);
+}
+
+#endif  // MOJODDS_HAVE_X86
+
+
+#ifdef MOJODDS_HAVE_NEON
+
+static void neon_load8(const MaskInfo *info, const uint8 *src, uint32x4_t px[2])
+{
+    uint16x8_t v;
+
+    switch (info->bytes) {
+        case 1:
+            v = vmovl_u8(vld1_u8(src));
+            px[0] = vmovl_u16(vget_low_u16(v));
+            px[1] = vmovl_u16(vget_high_u16(v));
+            break;
+        case 2:
+            v = vreinterpretq_u16_u8(vld1q_u8(src));
+            px[0] = vmovl_u16(vget_low_u16(v));
+            px[1] = vmovl_u16(vget_high_u16(v));
+            break;
+        case 3: {
+            uint32 tmp[8];
+            int i;
+            for (i = 0; i < 8; i++) {
+                tmp[i] = read_pixel(src + (i * 3), 3);
+            }
+            px[0] = vld1q_u32(tmp);
+            px[1] = vld1q_u32(tmp + 4);
+            break;
+        }
+        default:
+            px[0] = vreinterpretq_u32_u8(vld1q_u8(src));
+            px[1] = vreinterpretq_u32_u8(vld1q_u8(src + 16));
+            break;
+    }
+}
+
+static uint8x8_t neon_channel(const MaskInfo *info, const uint32x4_t px[2],
+                              const int i)
+{
+    const int32x4_t shift = vdupq_n_s32(-((sint32) info->shift[i]));
+    const uint32x4_t max = vdupq_n_u32(info->max[i]);
+    const uint32x4_t lo = vandq_u32(vshlq_u32(px[0], shift), max);
+    const uint32x4_t hi = vandq_u32(vshlq_u32(px[1], shift), max);
+    const uint16x8_t v = vcombine_u16(vmovn_u32(lo), vmovn_u32(hi));
+    const uint16x8_t scaled = vmlaq_u16(vdupq_n_u16(info->add[i]), v, vdupq_n_u16(info->mul[i]));
+    return vshrn_n_u16(scaled, 6);
+}
+
+static void unpack_neon(const MaskInfo *info, const uint8 *src,
+                        unsigned int pixels, uint8 *dst)
+{
+    const size_t srcstep = 8 * info->bytes;
+
+    assert(info->simd);
+    for (; pixels >= 8; pixels -= 8) {
+        uint32x4_t px[2];
+        uint8x8x4_t rgba;
+        neon_load8(info, src, px);
+        rgba.val[0] = neon_channel(info, px, 0);
+        rgba.val[1] = neon_channel(info, px, 1);
+        rgba.val[2] = neon_channel(info, px, 2);
+        rgba.val[3] = neon_channel(info, px, 3);
+        vst4_u8(dst, rgba);
+        src += srcstep;
+        dst += 32;
+    }
+
+    unpack_scalar(info, src, pixels, dst);
+}
+
+#endif  // MOJODDS_HAVE_NEON
+
+
+static unpack_fn find_unpacker(const MaskInfo *info)
+{
+    const unsigned int cpu = mojodds_cpu_features();
+    if (info->simd) {
+        #if defined(MOJODDS_HAVE_X86)
+        if (cpu & MOJODDS_CPU_SSE2) {
+            return unpack_sse2;
+        }
+        #elif defined(MOJODDS_HAVE_NEON)
+        if (cpu & MOJODDS_CPU_NEON) {
+            return unpack_neon;
+        }
+        #endif
+    }
+    (void) cpu;
+    return unpack_scalar;
+}
+
+
+typedef struct
+{
+    MaskInfo info;
+    unpack_fn fn;
+    const uint8 *src;
+    uint8 *dst;
+    size_t srcpitch;
+    size_t dstpitch;
+    unsigned int w;
+    unsigned int h;
+    unsigned int rowsPerBand;
+} UnpackJob;
+
+static void unpack_band(void *data, unsigned int band)
+{
+    const UnpackJob *job = (const UnpackJob *) data;
+    const unsigned int end = MIN((band + 1) * job->rowsPerBand, job->h);
+    unsigned int y;
+
+    for (y = band * job->rowsPerBand; y < end; y++) {
+        job->fn(&job->info, job->src + (y * job->srcpitch), job->w,
+                job->dst + (y * job->dstpitch));
+    }
+}
+
+int MOJODDS_unpackMasked(unsigned int bitCount, const unsigned int *masks,
+                         const void *_src, unsigned long _srclen,
+                         unsigned int w, unsigned int h, void *_dst,
+                         unsigned long _dstpitch, MOJODDS_ThreadPool *pool)
+{
+    UnpackJob job;
+    uint32 m[4];
+    unsigned int bands;
+
+    if (masks == NULL) {
+        return 0;
+    }
+
+    m[0] = masks[0];
+    m[1] = masks[1];
+    m[2] = masks[2];
+    m[3] = masks[3];
+    if (!mojodds_check_masks(bitCount, m)) {
+        return 0;
+    } else if ((w == 0) || (h == 0)) {
+        return 0;
+    }
+
+    memset(&job, '\0', sizeof (job));
+    init_mask_info(&job.info, bitCount, m);
+    job.fn = find_unpacker(&job.info);
+    job.src = (const uint8 *) _src;
+    job.dst = (uint8 *) _dst;
+    job.srcpitch = ((size_t) w) * job.info.bytes;
+    job.dstpitch = (size_t) _dstpitch;
+    job.w = w;
+    job.h = h;
+
+    if (((uint64) job.srcpitch) * h > _srclen) {
+        return 0;  // not enough source data.
+    } else if (((uint64) w) * 4 > _dstpitch) {
+        return 0;  // rows would overlap.
+    }
+
+    // Bands of roughly 64k pixels, like MOJODDS_decode().
+    job.rowsPerBand = MAX(65536 / w, 1);
+    bands = (h + job.rowsPerBand - 1) / job.rowsPerBand;
+    mojodds_parallel_for(pool, bands, unpack_band, &job);
+    return 1;
+}
+
+// end of mojodds_unpack.c ...